@@ -1,330 +1,290 @@
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
-#include <map>
 #include <string>
+#include <string_view>
 #include <chrono>
 #include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
 class HomeAutomation;
 
 class State {
-protected:
-    HomeAutomation *statemachine;
-
 public:
     virtual ~State() {}
 
-    void set_context(HomeAutomation *statemachine) {
-        this->statemachine = statemachine;
-    }
-
-    virtual std::string get_name() {
+    virtual std::string_view get_name() const {
         return "Unknown";
     }
 
-    virtual void motionDetected() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void motionDetected(HomeAutomation *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 
-    virtual void noMotion() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void noMotion(HomeAutomation *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 
-    virtual void lightOn() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void lightOn(HomeAutomation *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 
-    virtual void lightOff() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void lightOff(HomeAutomation *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 
-    virtual void temperatureRise() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void temperatureRise(HomeAutomation *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 
-    virtual void temperatureDrop() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void temperatureDrop(HomeAutomation *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 };
 
 class HomeAutomation {
 private:
-    State* state = nullptr;
+    const State* state = nullptr;
 public:
     bool isMotionDetected = false;
     bool isLightOn = false;
     int currentTemperature = 22;
     int targetTemperature = 24;
-    HomeAutomation(State* initial_state) {
-        initial_state->set_context(this);
+    HomeAutomation(const State* initial_state) {
         state = initial_state;
-        std::cout << "[" << state->get_name() <<  "]" << std::endl;
-    }
-
-    ~HomeAutomation() {
-        if (state != nullptr) {
-            delete state;
-        }
+        SM_TRACE_TRANSITION("[" << state->get_name() << "]");
     }
 
-    void transition_to(State *new_state) {
-        std::cout << state->get_name() << " ===> " << new_state->get_name() << std::endl;
-        if (state != nullptr) {
-            delete state;
-        }
-        new_state->set_context(this);
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());
         state = new_state;
     }
     void motionDetected() {
-        state->motionDetected();
+        state->motionDetected(this);
     }
     void noMotion() {
-        state->noMotion();
+        state->noMotion(this);
     }
     void lightOn() {
-        state->lightOn();
+        state->lightOn(this);
     }
     void lightOff() {
-        state->lightOff();
+        state->lightOff(this);
     }
     void temperatureRise() {
-        state->temperatureRise();
+        state->temperatureRise(this);
     }
     void temperatureDrop() {
-        state->temperatureDrop();
+        state->temperatureDrop(this);
     }
 };
 
 class Idle : public State {
 public:
-    std::string get_name() override { return "Idle"; }
-    void motionDetected() override;
-    void noMotion() override;
-    void temperatureRise() override;
-    void temperatureDrop() override;
+    static const Idle instance;
+    std::string_view get_name() const override { return "Idle"; }
+    void motionDetected(HomeAutomation *statemachine) const override;
+    void noMotion(HomeAutomation *statemachine) const override;
+    void temperatureRise(HomeAutomation *statemachine) const override;
+    void temperatureDrop(HomeAutomation *statemachine) const override;
 };
 class MotionDetected : public State {
 public:
-    std::string get_name() override { return "MotionDetected"; }
-    void motionDetected() override;
-    void lightOn() override;
-    void lightOff() override;
-    void temperatureRise() override;
-    void temperatureDrop() override;
+    static const MotionDetected instance;
+    std::string_view get_name() const override { return "MotionDetected"; }
+    void motionDetected(HomeAutomation *statemachine) const override;
+    void lightOn(HomeAutomation *statemachine) const override;
+    void lightOff(HomeAutomation *statemachine) const override;
+    void temperatureRise(HomeAutomation *statemachine) const override;
+    void temperatureDrop(HomeAutomation *statemachine) const override;
 };
 class LightOn : public State {
 public:
-    std::string get_name() override { return "LightOn"; }
-    void noMotion() override;
-    void lightOff() override;
-    void temperatureRise() override;
-    void temperatureDrop() override;
+    static const LightOn instance;
+    std::string_view get_name() const override { return "LightOn"; }
+    void noMotion(HomeAutomation *statemachine) const override;
+    void lightOff(HomeAutomation *statemachine) const override;
+    void temperatureRise(HomeAutomation *statemachine) const override;
+    void temperatureDrop(HomeAutomation *statemachine) const override;
 };
 class Heating : public State {
 public:
-    std::string get_name() override { return "Heating"; }
-    void temperatureDrop() override;
-    void temperatureRise() override;
-    void lightOn() override;
-    void lightOff() override;
+    static const Heating instance;
+    std::string_view get_name() const override { return "Heating"; }
+    void temperatureDrop(HomeAutomation *statemachine) const override;
+    void temperatureRise(HomeAutomation *statemachine) const override;
+    void lightOn(HomeAutomation *statemachine) const override;
+    void lightOff(HomeAutomation *statemachine) const override;
 };
     // Idle
+    const Idle Idle::instance;
 
-    void Idle::motionDetected() {
-        if (true) {
-
-            statemachine->transition_to(new MotionDetected);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Idle::motionDetected(HomeAutomation *statemachine) const {
+        statemachine->transition_to(&MotionDetected::instance);
     }
     
 
-    void Idle::noMotion() {
-        if (true) {
-
-            statemachine->transition_to(new Idle);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Idle::noMotion(HomeAutomation *statemachine) const {
+        statemachine->transition_to(&Idle::instance);
     }
     
 
-    void Idle::temperatureRise() {
-        if (true) {
-
-            statemachine->transition_to(new Heating);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Idle::temperatureRise(HomeAutomation *statemachine) const {
+        statemachine->transition_to(&Heating::instance);
     }
     
 
-    void Idle::temperatureDrop() {
-        if (true) {
-            std::cout << "System is Idle, Motion: " << statemachine->isMotionDetected << std::endl;
-            statemachine->transition_to(new Idle);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Idle::temperatureDrop(HomeAutomation *statemachine) const {
+        std::cout << "System is Idle, Motion: " << statemachine->isMotionDetected << '\n';
+        statemachine->transition_to(&Idle::instance);
     }
     
     // MotionDetected
+    const MotionDetected MotionDetected::instance;
 
-    void MotionDetected::motionDetected() {
+    void MotionDetected::motionDetected(HomeAutomation *statemachine) const {
         if (statemachine->isMotionDetected) {
-
-            statemachine->transition_to(new Idle);
+            statemachine->transition_to(&Idle::instance);
         } else {
-            std::cout << "Transition not allowed." << std::endl;
+            SM_TRACE("Transition not allowed.");
         }
     }
     
 
-    void MotionDetected::lightOn() {
-        if (true) {
-            std::cout << "Lights are ON, Motion: " << statemachine->isMotionDetected << std::endl;
-            statemachine->transition_to(new LightOn);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void MotionDetected::lightOn(HomeAutomation *statemachine) const {
+        std::cout << "Lights are ON, Motion: " << statemachine->isMotionDetected << '\n';
+        statemachine->transition_to(&LightOn::instance);
     }
     
 
-    void MotionDetected::lightOff() {
-        if (true) {
-
-            statemachine->transition_to(new Idle);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void MotionDetected::lightOff(HomeAutomation *statemachine) const {
+        statemachine->transition_to(&Idle::instance);
     }
     
 
-    void MotionDetected::temperatureRise() {
-        if (true) {
-
-            statemachine->transition_to(new Heating);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void MotionDetected::temperatureRise(HomeAutomation *statemachine) const {
+        statemachine->transition_to(&Heating::instance);
     }
     
 
-    void MotionDetected::temperatureDrop() {
-        if (true) {
-            std::cout << "Motion Detected, turning on lights" << std::endl;
-            std::cout << "Run Command: turnOnLights()" << std::endl;
-            statemachine->transition_to(new Idle);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void MotionDetected::temperatureDrop(HomeAutomation *statemachine) const {
+        std::cout << "Motion Detected, turning on lights" << '\n';
+        std::cout << "Run Command: turnOnLights()" << '\n';
+        statemachine->transition_to(&Idle::instance);
     }
     
     // LightOn
+    const LightOn LightOn::instance;
 
-    void LightOn::noMotion() {
-        if (true) {
-
-            statemachine->transition_to(new Idle);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void LightOn::noMotion(HomeAutomation *statemachine) const {
+        statemachine->transition_to(&Idle::instance);
     }
     
 
-    void LightOn::lightOff() {
-        if (true) {
-
-            statemachine->transition_to(new Idle);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void LightOn::lightOff(HomeAutomation *statemachine) const {
+        statemachine->transition_to(&Idle::instance);
     }
     
 
-    void LightOn::temperatureRise() {
-        if (true) {
-
-            statemachine->transition_to(new Heating);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void LightOn::temperatureRise(HomeAutomation *statemachine) const {
+        statemachine->transition_to(&Heating::instance);
     }
     
 
-    void LightOn::temperatureDrop() {
-        if (true) {
-
-            statemachine->transition_to(new Idle);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void LightOn::temperatureDrop(HomeAutomation *statemachine) const {
+        statemachine->transition_to(&Idle::instance);
     }
     
     // Heating
+    const Heating Heating::instance;
 
-    void Heating::temperatureDrop() {
+    void Heating::temperatureDrop(HomeAutomation *statemachine) const {
         if ((statemachine->currentTemperature < statemachine->targetTemperature)) {
-
-            statemachine->transition_to(new Idle);
+            statemachine->transition_to(&Idle::instance);
         } else {
-            std::cout << "Transition not allowed." << std::endl;
+            SM_TRACE("Transition not allowed.");
         }
     }
     
 
-    void Heating::temperatureRise() {
-        if (true) {
-
-            statemachine->transition_to(new Heating);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Heating::temperatureRise(HomeAutomation *statemachine) const {
+        statemachine->transition_to(&Heating::instance);
     }
     
 
-    void Heating::lightOn() {
-        if (true) {
-
-            statemachine->transition_to(new LightOn);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Heating::lightOn(HomeAutomation *statemachine) const {
+        statemachine->transition_to(&LightOn::instance);
     }
     
 
-    void Heating::lightOff() {
-        if (true) {
-            std::cout << "Heating the home, Current Temperature: " << statemachine->currentTemperature << std::endl;
-            std::cout << "Run Command: startHeating()" << std::endl;
-            statemachine->transition_to(new Idle);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Heating::lightOff(HomeAutomation *statemachine) const {
+        std::cout << "Heating the home, Current Temperature: " << statemachine->currentTemperature << '\n';
+        std::cout << "Run Command: startHeating()" << '\n';
+        statemachine->transition_to(&Idle::instance);
     }
     
 
 typedef void (HomeAutomation::*Event)();
 
-int main() {
-    HomeAutomation *statemachine = new HomeAutomation(new Idle);
-
-    static std::map<std::string, Event> event_by_name;
-    event_by_name["motionDetected"] = &HomeAutomation::motionDetected;
-    event_by_name["noMotion"] = &HomeAutomation::noMotion;
-    event_by_name["lightOn"] = &HomeAutomation::lightOn;
-    event_by_name["lightOff"] = &HomeAutomation::lightOff;
-    event_by_name["temperatureRise"] = &HomeAutomation::temperatureRise;
-    event_by_name["temperatureDrop"] = &HomeAutomation::temperatureDrop;
-    for (std::string input; std::getline(std::cin, input);) {
-        std::map<std::string, Event>::const_iterator event_by_name_it = event_by_name.find(input);
-        if (event_by_name_it == event_by_name.end()) {
-            std::cout << "There is no event <" << input << "> in the HomeAutomation statemachine." << std::endl;
-            continue;
-        }
-        Event event_invoker = event_by_name_it->second;
-        (statemachine->*event_invoker)();
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 6;
+constexpr std::int32_t event_displacements[event_slot_count] = { -6, -5, 0, -4, 1, -1 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "lightOn", "temperatureDrop", "noMotion", "motionDetected", "lightOff", "temperatureRise" };
+constexpr Event event_slot_values[event_slot_count] = { &HomeAutomation::lightOn, &HomeAutomation::temperatureDrop, &HomeAutomation::noMotion, &HomeAutomation::motionDetected, &HomeAutomation::lightOff, &HomeAutomation::temperatureRise };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0xb3043cfee596987aull;
+constexpr Event event_ids[6] = { &HomeAutomation::motionDetected, &HomeAutomation::noMotion, &HomeAutomation::lightOn, &HomeAutomation::lightOff, &HomeAutomation::temperatureRise, &HomeAutomation::temperatureDrop };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    HomeAutomation *statemachine = new HomeAutomation(&Idle::instance);
+
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 6, [statemachine](std::size_t id, std::uint64_t) { (statemachine->*event_ids[id])(); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the HomeAutomation statemachine.");
+                return;
+            }
+            (statemachine->*event_slot_values[slot])();
+        });
     }
 
     delete statemachine;
-    return 0;
+    return status;
 }
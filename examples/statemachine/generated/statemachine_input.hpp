@@ -0,0 +1,338 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+// Input of the main() of generated machines, shared by all backends and the
+// library driver. Text lines are handed out as std::string_views into a
+// memory-mapped file or large stdin blocks; binary event streams (see
+// event-stream.ts) are decoded straight from the buffer.
+
+#ifndef STATEMACHINE_INPUT_HPP
+#define STATEMACHINE_INPUT_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define STATEMACHINE_POSIX_IO 1
+#endif
+
+namespace statemachine_input {
+
+// Calls on_line for every newline-terminated line of [data, data + size) and returns
+// the number of bytes consumed; an unterminated tail is left to the caller.
+template <typename OnLine>
+std::size_t split_lines(const char *data, std::size_t size, OnLine &on_line) {
+    std::size_t begin = 0;
+    while (begin < size) {
+        const void *newline = std::memchr(data + begin, '\n', size - begin);
+        if (newline == nullptr) {
+            break;
+        }
+        const std::size_t end = static_cast<std::size_t>(static_cast<const char *>(newline) - data);
+        on_line(std::string_view(data + begin, end - begin));
+        begin = end + 1;
+    }
+    return begin;
+}
+
+// Called before every blocking read of stdin; machines with setTimeout run their
+// timers from here while waiting for input.
+inline void (*before_stdin_read)() = nullptr;
+
+#ifdef STATEMACHINE_POSIX_IO
+constexpr int stdin_fd = STDIN_FILENO;
+#else
+constexpr int stdin_fd = 0;
+#endif
+
+// Appends up to capacity - filled bytes read from fd to buffer, growing it when full;
+// returns false at the end of the input. Without POSIX read, fd is always stdin.
+inline bool read_more(int fd, std::vector<char> &buffer, std::size_t &filled) {
+    if (fd == stdin_fd && before_stdin_read != nullptr) {
+        before_stdin_read();
+    }
+    if (filled == buffer.size()) {
+        buffer.resize(buffer.size() * 2);
+    }
+#ifdef STATEMACHINE_POSIX_IO
+    for (;;) {
+        const ssize_t count = read(fd, buffer.data() + filled, buffer.size() - filled);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        filled += static_cast<std::size_t>(count);
+        return true;
+    }
+#else
+    static_cast<void>(fd);
+    std::cin.read(buffer.data() + filled, static_cast<std::streamsize>(buffer.size() - filled));
+    filled += static_cast<std::size_t>(std::cin.gcount());
+    return std::cin.gcount() > 0;
+#endif
+}
+
+// Calls on_data once with the whole contents of the file, memory-mapped where possible.
+// Pipes, /dev/stdin and process substitutions cannot be mapped and have no size, so
+// they are passed to on_stream as an open descriptor and read block by block instead.
+template <typename OnData, typename OnStream>
+int map_file(const char *path, OnData on_data, [[maybe_unused]] OnStream on_stream) {
+#ifdef STATEMACHINE_POSIX_IO
+    const int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        std::cerr << "Cannot read events from " << path << ": " << std::strerror(errno) << std::endl;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 1;
+    }
+    if (!S_ISREG(info.st_mode)) {
+        const int status = on_stream(fd);
+        close(fd);
+        return status;
+    }
+    const std::size_t size = static_cast<std::size_t>(info.st_size);
+    int status = 0;
+    if (size == 0) {
+        status = on_data(static_cast<const char *>(nullptr), size);
+    } else {
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            std::cerr << "Cannot map " << path << ": " << std::strerror(errno) << std::endl;
+            close(fd);
+            return 1;
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        status = on_data(static_cast<const char *>(mapped), size);
+        munmap(mapped, size);
+    }
+    close(fd);
+    return status;
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Cannot read events from " << path << std::endl;
+        return 1;
+    }
+    const std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return on_data(contents.data(), contents.size());
+#endif
+}
+
+// Feeds every line read from fd to on_line, reading it in 1 MiB blocks.
+template <typename OnLine>
+int read_lines(int fd, OnLine &on_line) {
+    std::vector<char> buffer(1 << 20);
+    std::size_t filled = 0;
+    while (read_more(fd, buffer, filled)) {
+        const std::size_t consumed = split_lines(buffer.data(), filled, on_line);
+        std::memmove(buffer.data(), buffer.data() + consumed, filled - consumed);
+        filled -= consumed;
+        // Output is flushed once per block rather than per line, which still answers
+        // every line of an interactive session.
+        std::cout.flush();
+    }
+    if (filled > 0) {
+        on_line(std::string_view(buffer.data(), filled));
+    }
+    return 0;
+}
+
+// Feeds every line of the file named by path, or of stdin if path is null, to on_line.
+template <typename OnLine>
+int read_events(const char *path, OnLine on_line) {
+    if (path != nullptr) {
+        return map_file(path, [&on_line](const char *data, std::size_t size) {
+            const std::size_t consumed = split_lines(data, size, on_line);
+            if (consumed < size) {
+                on_line(std::string_view(data + consumed, size - consumed));
+            }
+            return 0;
+        }, [&on_line](int fd) {
+            return read_lines(fd, on_line);
+        });
+    }
+#ifdef STATEMACHINE_POSIX_IO
+    return read_lines(stdin_fd, on_line);
+#else
+    // std::cin.read only returns once the whole block is filled, which would hold back
+    // the answers of an interactive session, so stdin is read line by line here.
+    std::string line;
+    for (;;) {
+        if (before_stdin_read != nullptr) {
+            before_stdin_read();
+        }
+        if (!std::getline(std::cin, line)) {
+            break;
+        }
+        on_line(std::string_view(line));
+        std::cout.flush();
+    }
+    return 0;
+#endif
+}
+
+// Decodes a stream written by `statemachine-cli encode-events` and calls
+// on_event(id, timestamp) per record, where id indexes the model's events. The
+// input may arrive in pieces of any size: a record cut off at the end of one
+// piece is decoded once the caller passes it again with the rest.
+class event_stream_decoder {
+public:
+    event_stream_decoder(std::uint64_t fingerprint, std::size_t event_count)
+        : fingerprint(fingerprint), event_count(event_count) {}
+
+    // Decodes the complete records of [data, data + size) and sets consumed to the
+    // bytes used; returns false after reporting a malformed stream.
+    template <typename OnEvent>
+    bool decode(const char *data, std::size_t size, std::size_t &consumed, OnEvent &on_event) {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+        consumed = 0;
+        if (id_width == 0) {
+            if (size < 16) {
+                return true;
+            }
+            if (!read_header(bytes)) {
+                return false;
+            }
+            consumed = 16;
+        }
+        for (std::size_t at = consumed; size - at >= id_width;) {
+            const std::size_t id = id_width == 1 ? bytes[at] : (bytes[at] | (std::size_t{bytes[at + 1]} << 8));
+            at += id_width;
+            std::uint64_t delta = 0;
+            if (timestamps) {
+                for (unsigned shift = 0;; shift += 7) {
+                    if (shift > 63) {
+                        std::cerr << "Truncated event stream." << std::endl;
+                        return false;
+                    }
+                    if (at == size) {
+                        return true;
+                    }
+                    const unsigned char byte = bytes[at++];
+                    delta |= std::uint64_t{byte & 0x7fu} << shift;
+                    if ((byte & 0x80) == 0) {
+                        break;
+                    }
+                }
+            }
+            if (id >= event_count) {
+                std::cerr << "Event id " << id << " is out of range." << std::endl;
+                return false;
+            }
+            timestamp += delta;
+            consumed = at;
+            on_event(id, timestamp);
+        }
+        return true;
+    }
+
+    // Called at the end of the input with the bytes decode left over; returns false
+    // after reporting a stream that ended early.
+    bool finish(std::size_t leftover) const {
+        if (id_width == 0) {
+            std::cerr << "Input is not an event stream." << std::endl;
+            return false;
+        }
+        if (leftover > 0) {
+            std::cerr << "Truncated event stream." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::uint64_t fingerprint;
+    std::size_t event_count;
+    std::size_t id_width = 0; // 0 until the header is read
+    bool timestamps = false;
+    std::uint64_t timestamp = 0;
+
+    bool read_header(const unsigned char *bytes) {
+        if (std::memcmp(bytes, "SMEV", 4) != 0 || bytes[4] != 1 || (bytes[5] != 1 && bytes[5] != 2)) {
+            std::cerr << "Input is not an event stream." << std::endl;
+            return false;
+        }
+        std::uint64_t stream_fingerprint = 0;
+        for (int i = 7; i >= 0; --i) {
+            stream_fingerprint = (stream_fingerprint << 8) | bytes[8 + i];
+        }
+        if (stream_fingerprint != fingerprint) {
+            std::cerr << "Event stream was encoded for a different statemachine." << std::endl;
+            return false;
+        }
+        id_width = bytes[5];
+        timestamps = (bytes[6] & 1) != 0;
+        return true;
+    }
+};
+
+// Decodes a binary event stream from the file named by path, or from stdin if path
+// is null, as event_stream_decoder does. Stdin and other unmappable input go through
+// the same fixed block buffer as text input, so memory stays constant however long
+// the stream is.
+template <typename OnEvent>
+int read_event_stream(const char *path, std::uint64_t fingerprint, std::size_t event_count, OnEvent on_event) {
+    event_stream_decoder decoder(fingerprint, event_count);
+    std::size_t consumed = 0;
+    const auto read_blocks = [&](int fd) {
+        std::vector<char> buffer(1 << 20);
+        std::size_t filled = 0;
+        while (read_more(fd, buffer, filled)) {
+            if (!decoder.decode(buffer.data(), filled, consumed, on_event)) {
+                return 1;
+            }
+            std::memmove(buffer.data(), buffer.data() + consumed, filled - consumed);
+            filled -= consumed;
+            std::cout.flush();
+        }
+        return decoder.finish(filled) ? 0 : 1;
+    };
+    if (path != nullptr) {
+        return map_file(path, [&](const char *data, std::size_t size) {
+            return decoder.decode(data, size, consumed, on_event) && decoder.finish(size - consumed) ? 0 : 1;
+        }, read_blocks);
+    }
+    return read_blocks(stdin_fd);
+}
+
+// Command line of a generated machine: `[--binary] [events-file]`.
+struct input_arguments {
+    bool binary = false;
+    const char *path = nullptr;
+};
+
+inline input_arguments parse_arguments(int argc, char **argv) {
+    input_arguments arguments;
+    int next = 1;
+    if (next < argc && std::string_view(argv[next]) == "--binary") {
+        arguments.binary = true;
+        ++next;
+    }
+    if (next < argc) {
+        arguments.path = argv[next];
+    }
+    return arguments;
+}
+
+} // namespace statemachine_input
+
+#endif // STATEMACHINE_INPUT_HPP
@@ -0,0 +1,71 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+// Queue of the events that arrive while a transition waits in setTimeout, shared
+// by statemachine_runtime.hpp, the timers of the virtual and table backends and
+// library mode. It does not depend on iostream, so libraries can include it.
+
+#ifndef STATEMACHINE_QUEUE_HPP
+#define STATEMACHINE_QUEUE_HPP
+
+#include <array>
+#include <cstddef>
+
+namespace statemachine_queue {
+
+enum class queue_overflow {
+    drop_oldest, // the oldest queued event makes room for the new one
+    drop_newest, // the new event is dropped silently
+    reject       // the new event is dropped and reported
+};
+
+// Fixed-capacity ring of the events waiting for a suspended transition. The storage is
+// part of the machine, so memory stays constant however bursty the input is. Only the
+// thread dispatching events touches it.
+template <typename T, std::size_t Capacity, queue_overflow Overflow>
+class event_queue {
+    static_assert(Capacity > 0, "the event queue needs room for at least one event");
+
+public:
+    // Returns false if the queue is full and the new event was dropped.
+    bool push(T event) {
+        if (count == Capacity) {
+            if constexpr (Overflow != queue_overflow::drop_oldest) {
+                return false;
+            }
+            first = next(first);
+            --count;
+        }
+        const std::size_t last = first + count;
+        items[last < Capacity ? last : last - Capacity] = event;
+        ++count;
+        return true;
+    }
+
+    T pop() {
+        const T event = items[first];
+        first = next(first);
+        --count;
+        return event;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+private:
+    static std::size_t next(std::size_t index) {
+        return index + 1 == Capacity ? 0 : index + 1;
+    }
+
+    std::array<T, Capacity> items{};
+    std::size_t first = 0;
+    std::size_t count = 0;
+};
+
+} // namespace statemachine_queue
+
+#endif // STATEMACHINE_QUEUE_HPP
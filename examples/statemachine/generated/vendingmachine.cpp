@@ -1,231 +1,405 @@
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
-#include <map>
 #include <string>
+#include <string_view>
 #include <chrono>
 #include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <queue>
+#ifdef STATEMACHINE_POSIX_IO
+#include <poll.h>
+#endif
+#include "statemachine_queue.hpp"
 class VendingMachine;
 
-class State {
-protected:
-    VendingMachine *statemachine;
+namespace statemachine_timer {
+
+using clock = std::chrono::steady_clock;
 
+// Event loop for transitions suspended in setTimeout. Timers are kept in a min-heap
+// and resumed in deadline order (ties in the order they were started).
+class scheduler {
 public:
-    virtual ~State() {}
+    static scheduler &instance() {
+        static scheduler shared;
+        return shared;
+    }
+
+    void schedule(clock::time_point deadline, std::coroutine_handle<> handle) {
+        timers.push(timer{deadline, next_sequence++, handle});
+    }
+
+    // Resumes every timer that is due and returns whether any are left.
+    bool run_due() {
+        while (!timers.empty() && timers.top().deadline <= clock::now()) {
+            const std::coroutine_handle<> handle = timers.top().handle;
+            timers.pop();
+            handle.resume();
+        }
+        return !timers.empty();
+    }
+
+#ifdef STATEMACHINE_POSIX_IO
+    // Returns once the input on fd is readable, running due timers while waiting.
+    void run_until_readable(int fd) {
+        for (;;) {
+            const bool pending = run_due();
+            std::cout.flush();
+            if (!pending) {
+                return;
+            }
+            const auto delay = std::chrono::ceil<std::chrono::milliseconds>(timers.top().deadline - clock::now());
+            pollfd input{fd, POLLIN, 0};
+            if (poll(&input, 1, static_cast<int>(std::max<std::chrono::milliseconds::rep>(delay.count(), 0))) != 0) {
+                return;
+            }
+        }
+    }
+#endif
+
+    // Sleeps until every pending timer has fired.
+    void run_until_idle() {
+        while (run_due()) {
+            std::cout.flush();
+            std::this_thread::sleep_until(timers.top().deadline);
+        }
+    }
+
+private:
+    struct timer {
+        clock::time_point deadline;
+        std::uint64_t sequence;
+        std::coroutine_handle<> handle;
+
+        bool operator>(const timer &other) const {
+            return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+        }
+    };
 
-    void set_context(VendingMachine *statemachine) {
-        this->statemachine = statemachine;
+    std::priority_queue<timer, std::vector<timer>, std::greater<timer>> timers;
+    std::uint64_t next_sequence = 0;
+};
+
+// Awaitable of setTimeout: suspends the transition and resumes it from the scheduler.
+struct sleep_for {
+    std::chrono::milliseconds duration;
+
+    bool await_ready() const noexcept {
+        return duration.count() <= 0;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) const {
+        scheduler::instance().schedule(clock::now() + duration, handle);
     }
 
-    virtual std::string get_name() {
+    void await_resume() const noexcept {}
+};
+
+// Fire-and-forget coroutine of a transition body; it starts eagerly and its frame
+// is freed when the body returns.
+struct task {
+    struct promise_type {
+        task get_return_object() noexcept {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept {
+            std::terminate();
+        }
+    };
+};
+
+// Installed as before_stdin_read, so suspended transitions keep completing while the
+// program waits for input.
+inline void run_timers_until_input() {
+#ifdef STATEMACHINE_POSIX_IO
+    scheduler::instance().run_until_readable(STDIN_FILENO);
+#else
+    scheduler::instance().run_due();
+#endif
+}
+
+} // namespace statemachine_timer
+
+class State {
+public:
+    virtual ~State() {}
+
+    virtual std::string_view get_name() const {
         return "Unknown";
     }
 
-    virtual void insertCoin() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void insertCoin(VendingMachine *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 
-    virtual void selectItem() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void selectItem(VendingMachine *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 
-    virtual void dispenseItem() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void dispenseItem(VendingMachine *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 
-    virtual void cancel() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void cancel(VendingMachine *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 };
 
 class VendingMachine {
 private:
-    State* state = nullptr;
+    const State* state = nullptr;
 public:
     int balance = 0;
-    bool itemSelected = (false || (balance < 0));
+    bool itemSelected = (balance < 0);
     int itemPrice = 10;
     int stock = 10;
-    VendingMachine(State* initial_state) {
-        initial_state->set_context(this);
+    VendingMachine(const State* initial_state) {
         state = initial_state;
-        std::cout << "[" << state->get_name() <<  "]" << std::endl;
+        SM_TRACE_TRANSITION("[" << state->get_name() << "]");
     }
 
-    ~VendingMachine() {
-        if (state != nullptr) {
-            delete state;
-        }
-    }
-
-    void transition_to(State *new_state) {
-        std::cout << state->get_name() << " ===> " << new_state->get_name() << std::endl;
-        if (state != nullptr) {
-            delete state;
-        }
-        new_state->set_context(this);
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());
         state = new_state;
     }
     void insertCoin() {
-        state->insertCoin();
+        state->insertCoin(this);
     }
     void selectItem() {
-        state->selectItem();
+        state->selectItem(this);
     }
     void dispenseItem() {
-        state->dispenseItem();
+        state->dispenseItem(this);
     }
     void cancel() {
-        state->cancel();
+        state->cancel(this);
+    }
+    
+    using event_handle = void (VendingMachine::*)();
+    bool suspended = false;
+    statemachine_queue::event_queue<event_handle, 64, statemachine_queue::queue_overflow::reject> pending;
+
+    void post(event_handle event) {
+        if (suspended) {
+            if (!pending.push(event)) {
+                SM_TRACE("The event queue is full; the event is rejected.");
+            }
+            return;
+        }
+        (this->*event)();
+    }
+
+    void resume_pending() {
+        suspended = false;
+        while (!suspended && !pending.empty()) {
+            (this->*pending.pop())();
+        }
     }
 };
 
 class Idle : public State {
 public:
-    std::string get_name() override { return "Idle"; }
-    void insertCoin() override;
+    static const Idle instance;
+    std::string_view get_name() const override { return "Idle"; }
+    void insertCoin(VendingMachine *statemachine) const override;
 };
 class AwaitingSelection : public State {
 public:
-    std::string get_name() override { return "AwaitingSelection"; }
-    void insertCoin() override;
-    void selectItem() override;
-    void cancel() override;
+    static const AwaitingSelection instance;
+    std::string_view get_name() const override { return "AwaitingSelection"; }
+    void insertCoin(VendingMachine *statemachine) const override;
+    void selectItem(VendingMachine *statemachine) const override;
+    void cancel(VendingMachine *statemachine) const override;
 };
 class ProcessingSelection : public State {
 public:
-    std::string get_name() override { return "ProcessingSelection"; }
-    void dispenseItem() override;
-    void cancel() override;
+    static const ProcessingSelection instance;
+    std::string_view get_name() const override { return "ProcessingSelection"; }
+    void dispenseItem(VendingMachine *statemachine) const override;
+    void cancel(VendingMachine *statemachine) const override;
 };
 class Dispensing : public State {
 public:
-    std::string get_name() override { return "Dispensing"; }
-    void insertCoin() override;
-    void dispenseItem() override;
+    static const Dispensing instance;
+    std::string_view get_name() const override { return "Dispensing"; }
+    void insertCoin(VendingMachine *statemachine) const override;
+    void dispenseItem(VendingMachine *statemachine) const override;
 };
     // Idle
+    const Idle Idle::instance;
 
-    void Idle::insertCoin() {
-        if (true) {
-            std::cout << "Please insert a coin" << std::endl;
-            statemachine->transition_to(new AwaitingSelection);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Idle::insertCoin(VendingMachine *statemachine) const {
+        std::cout << "Please insert a coin" << '\n';
+        statemachine->transition_to(&AwaitingSelection::instance);
     }
     
     // AwaitingSelection
+    const AwaitingSelection AwaitingSelection::instance;
 
-    void AwaitingSelection::insertCoin() {
-        if (((statemachine->balance < statemachine->itemPrice))) {
+    static statemachine_timer::task AwaitingSelection_insertCoin_run(VendingMachine *statemachine) {
             statemachine->balance = (statemachine->balance + 10);
-            std::cout << "Balance updated: " << statemachine->balance << std::endl;
+            std::cout << "Balance updated: " << statemachine->balance << '\n';
+            SM_TRACE("Delaying transition for 1000 milliseconds...");
+            co_await statemachine_timer::sleep_for{std::chrono::milliseconds(1000)};
+            std::cout << "Run Command: notifyUser()" << '\n';
+        statemachine->transition_to(&AwaitingSelection::instance);
+        statemachine->resume_pending();
+    }
 
-            std::cout << "Delaying transition for 1000 milliseconds..." << std::endl;
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        
-            std::cout << "Run Command: notifyUser()" << std::endl;
-            statemachine->transition_to(new AwaitingSelection);
+    void AwaitingSelection::insertCoin(VendingMachine *statemachine) const {
+        if ((statemachine->balance < statemachine->itemPrice)) {
+            statemachine->suspended = true;
+            AwaitingSelection_insertCoin_run(statemachine);
         } else {
-            std::cout << "Transition not allowed." << std::endl;
+            SM_TRACE("Transition not allowed.");
         }
     }
     
 
-    void AwaitingSelection::selectItem() {
-        if (((statemachine->balance >= statemachine->itemPrice))) {
+    void AwaitingSelection::selectItem(VendingMachine *statemachine) const {
+        if ((statemachine->balance >= statemachine->itemPrice)) {
             statemachine->itemSelected = true;
-            std::cout << "Item selected." << std::endl;
-            statemachine->transition_to(new ProcessingSelection);
+            std::cout << "Item selected." << '\n';
+            statemachine->transition_to(&ProcessingSelection::instance);
         } else {
-            std::cout << "Transition not allowed." << std::endl;
+            SM_TRACE("Transition not allowed.");
         }
     }
     
 
-    void AwaitingSelection::cancel() {
-        if (true) {
-            std::cout << "Transaction cancelled." << std::endl;
-            statemachine->balance = 0;
-            statemachine->itemSelected = false;
-            statemachine->transition_to(new Idle);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void AwaitingSelection::cancel(VendingMachine *statemachine) const {
+        std::cout << "Transaction cancelled." << '\n';
+        statemachine->balance = 0;
+        statemachine->itemSelected = false;
+        statemachine->transition_to(&Idle::instance);
     }
     
     // ProcessingSelection
+    const ProcessingSelection ProcessingSelection::instance;
 
-    void ProcessingSelection::dispenseItem() {
-        if (((statemachine->itemSelected && (statemachine->stock > 0)))) {
-            std::cout << "Dispensing item..." << std::endl;
+    static statemachine_timer::task ProcessingSelection_dispenseItem_run(VendingMachine *statemachine) {
+            std::cout << "Dispensing item..." << '\n';
+            SM_TRACE("Delaying transition for 2000 milliseconds...");
+            co_await statemachine_timer::sleep_for{std::chrono::milliseconds(2000)};
+        statemachine->transition_to(&Dispensing::instance);
+        statemachine->resume_pending();
+    }
 
-            std::cout << "Delaying transition for 2000 milliseconds..." << std::endl;
-            std::this_thread::sleep_for(std::chrono::milliseconds(2000));
-        
-            statemachine->transition_to(new Dispensing);
+    void ProcessingSelection::dispenseItem(VendingMachine *statemachine) const {
+        if ((statemachine->itemSelected && (statemachine->stock > 0))) {
+            statemachine->suspended = true;
+            ProcessingSelection_dispenseItem_run(statemachine);
         } else {
-            std::cout << "Transition not allowed." << std::endl;
+            SM_TRACE("Transition not allowed.");
         }
     }
     
 
-    void ProcessingSelection::cancel() {
-        if (true) {
-            std::cout << "Transaction cancelled." << std::endl;
-            statemachine->balance = 0;
-            statemachine->itemSelected = false;
-            statemachine->transition_to(new Idle);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void ProcessingSelection::cancel(VendingMachine *statemachine) const {
+        std::cout << "Transaction cancelled." << '\n';
+        statemachine->balance = 0;
+        statemachine->itemSelected = false;
+        statemachine->transition_to(&Idle::instance);
     }
     
     // Dispensing
+    const Dispensing Dispensing::instance;
 
-    void Dispensing::insertCoin() {
-        if (true) {
-            statemachine->balance = (statemachine->balance - statemachine->itemPrice);
-            std::cout << "Item dispensed. Balance: " << statemachine->balance << std::endl;
-            statemachine->stock = (statemachine->stock - 1);
-            std::cout << "Run Command: playSound()" << std::endl;
-            statemachine->transition_to(new Idle);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Dispensing::insertCoin(VendingMachine *statemachine) const {
+        statemachine->balance = (statemachine->balance - statemachine->itemPrice);
+        std::cout << "Item dispensed. Balance: " << statemachine->balance << '\n';
+        statemachine->stock = (statemachine->stock - 1);
+        std::cout << "Run Command: playSound()" << '\n';
+        statemachine->transition_to(&Idle::instance);
     }
     
 
-    void Dispensing::dispenseItem() {
-        if (true) {
-            std::cout << "Insufficient stock." << std::endl;
-            statemachine->transition_to(new Idle);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Dispensing::dispenseItem(VendingMachine *statemachine) const {
+        std::cout << "Insufficient stock." << '\n';
+        statemachine->transition_to(&Idle::instance);
     }
     
 
 typedef void (VendingMachine::*Event)();
 
-int main() {
-    VendingMachine *statemachine = new VendingMachine(new Idle);
-
-    static std::map<std::string, Event> event_by_name;
-    event_by_name["insertCoin"] = &VendingMachine::insertCoin;
-    event_by_name["selectItem"] = &VendingMachine::selectItem;
-    event_by_name["dispenseItem"] = &VendingMachine::dispenseItem;
-    event_by_name["cancel"] = &VendingMachine::cancel;
-    for (std::string input; std::getline(std::cin, input);) {
-        std::map<std::string, Event>::const_iterator event_by_name_it = event_by_name.find(input);
-        if (event_by_name_it == event_by_name.end()) {
-            std::cout << "There is no event <" << input << "> in the VendingMachine statemachine." << std::endl;
-            continue;
-        }
-        Event event_invoker = event_by_name_it->second;
-        (statemachine->*event_invoker)();
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 4;
+constexpr std::int32_t event_displacements[event_slot_count] = { 1, 7, 0, 0 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "dispenseItem", "selectItem", "cancel", "insertCoin" };
+constexpr Event event_slot_values[event_slot_count] = { &VendingMachine::dispenseItem, &VendingMachine::selectItem, &VendingMachine::cancel, &VendingMachine::insertCoin };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0x0387ef7a0069523aull;
+constexpr Event event_ids[4] = { &VendingMachine::insertCoin, &VendingMachine::selectItem, &VendingMachine::dispenseItem, &VendingMachine::cancel };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    VendingMachine *statemachine = new VendingMachine(&Idle::instance);
+
+    statemachine_input::before_stdin_read = statemachine_timer::run_timers_until_input;
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 4, [statemachine](std::size_t id, std::uint64_t) { statemachine->post(event_ids[id]); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the VendingMachine statemachine.");
+                return;
+            }
+            statemachine->post(event_slot_values[slot]);
+        });
     }
+    statemachine_timer::scheduler::instance().run_until_idle();
 
     delete statemachine;
-    return 0;
+    return status;
 }
@@ -0,0 +1,63 @@
+// Harness of bench-batch.mjs: replays one trace through Machine::dispatch per event and through
+// Machine::dispatch_batch, and prints the trace length and the best ns per event of both.
+// BENCH_HEADER and BENCH_NAMESPACE name the generated library.
+
+#include BENCH_HEADER
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace BENCH_NAMESPACE;
+
+// Records a trace the machine accepts, so both loops run transitions rather than rejections.
+static std::vector<Event> record(std::size_t size) {
+    std::mt19937 random(42);
+    std::vector<Event> trace;
+    Machine<> machine;
+    for (std::size_t attempts = 0; trace.size() < size && attempts < size * 64; ++attempts) {
+        const Event event = static_cast<Event>(random() % event_count);
+        if (machine.dispatch(event) == Result::transitioned) {
+            trace.push_back(event);
+        }
+    }
+    return trace;
+}
+
+template <typename Run>
+static double best_ns_per_event(std::size_t size, Run run) {
+    double best = 1e300;
+    for (int round = 0; round < 5; ++round) {
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / static_cast<double>(size));
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    const std::vector<Event> trace = record(argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000);
+    State single{};
+    State batched{};
+    const double per_event = best_ns_per_event(trace.size(), [&] {
+        Machine<> machine;
+        for (const Event event : trace) {
+            machine.dispatch(event);
+        }
+        single = machine.current_state();
+    });
+    const double batch = best_ns_per_event(trace.size(), [&] {
+        Machine<> machine;
+        machine.dispatch_batch(trace.data(), trace.size());
+        batched = machine.current_state();
+    });
+    if (single != batched) {
+        std::fprintf(stderr, "dispatch_batch ended in another state than dispatch\n");
+        return 1;
+    }
+    std::printf("%zu %.2f %.2f\n", trace.size(), per_event, batch);
+    return 0;
+}
@@ -0,0 +1,38 @@
+// Compares Machine::dispatch_batch with per-event Machine::dispatch on the sample machines in example/.
+// Needs a build (`npm run build`) and a C++20 compiler; usage: npm run bench:batch [-- <events> [<compiler>]]
+import { execFileSync } from 'node:child_process';
+import * as fs from 'node:fs';
+import * as os from 'node:os';
+import * as path from 'node:path';
+import { fileURLToPath } from 'node:url';
+
+const root = path.resolve(path.dirname(fileURLToPath(import.meta.url)), '..');
+const events = process.argv[2] ?? '1000000';
+const compiler = process.argv[3] ?? process.env.CXX ?? 'g++';
+const work = fs.mkdtempSync(path.join(os.tmpdir(), 'statemachine-bench-'));
+
+console.log('machine                   events   dispatch ns/event   dispatch_batch ns/event   speedup');
+for (const file of fs.readdirSync(path.join(root, 'example')).filter(name => name.endsWith('.statemachine')).sort()) {
+    const name = path.basename(file, '.statemachine');
+    const destination = path.join(work, name);
+    const row = name.padEnd(24);
+    try {
+        execFileSync(process.execPath, [path.join(root, 'bin', 'cli.js'), 'generate', path.join(root, 'example', file), '-d', destination, '--mode', 'library', '--trace', 'none'], { stdio: 'pipe' });
+    } catch {
+        console.log(`${row}skipped: the model does not generate`);
+        continue;
+    }
+    const header = fs.readdirSync(destination).find(generated => generated.endsWith('.hpp'));
+    const headerText = fs.readFileSync(path.join(destination, header), 'utf-8');
+    if (headerText.includes('run_timers')) {
+        console.log(`${row}skipped: transitions wait in setTimeout`);
+        continue;
+    }
+    const namespace = /^namespace (\w+) \{/m.exec(headerText)[1];
+    const binary = path.join(destination, 'bench');
+    execFileSync(compiler, ['-std=c++20', '-O2', `-I${destination}`, `-DBENCH_HEADER="${header}"`, `-DBENCH_NAMESPACE=${namespace}`,
+        path.join(root, 'scripts', 'bench-batch.cpp'), path.join(destination, header.replace(/\.hpp$/, '.cpp')), '-o', binary], { stdio: 'inherit' });
+    const [count, perEvent, batch] = execFileSync(binary, [events], { encoding: 'utf-8' }).trim().split(' ').map(Number);
+    console.log(`${row}${String(count).padStart(8)}   ${perEvent.toFixed(2).padStart(17)}   ${batch.toFixed(2).padStart(23)}   ${(perEvent / batch).toFixed(2).padStart(6)}x`);
+}
+fs.rmSync(work, { recursive: true, force: true });
@@ -0,0 +1,233 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+import { FIXED_WIDTH_TYPES } from './interpret-util.js';
+import { type Attribute, type Expression, type Statemachine, isBinExpr, isGroup, isLiteral, isNegBoolExpr, isNegIntExpr, isRef } from '../language-server/generated/ast.js';
+
+/* How attributes become members of the generated machine: as declared, or packed by planAttributeLayout */
+export type AttributeLayout = 'declared' | 'packed';
+
+export const ATTRIBUTE_LAYOUTS: AttributeLayout[] = ['declared', 'packed'];
+
+/* Inclusive range of values an int attribute can hold */
+export interface Interval {
+    low: number;
+    high: number;
+}
+
+const INT_MIN = -(2 ** 31);
+const INT_MAX = 2 ** 31 - 1;
+const FULL: Interval = { low: INT_MIN, high: INT_MAX };
+
+/* Rounds of growth after which an attribute is assumed to take any int value, e.g. a counter incremented by a transition */
+const WIDENING_ROUNDS = 8;
+
+function clamp(interval: Interval): Interval {
+    return interval.low < INT_MIN || interval.high > INT_MAX ? FULL : interval;
+}
+
+function hull(values: number[]): Interval {
+    return clamp({ low: Math.min(...values), high: Math.max(...values) });
+}
+
+export function evalInterval(e: Expression, ranges: Map<Attribute, Interval>): Interval {
+    if (isGroup(e)) {
+        return evalInterval(e.ge, ranges);
+    }
+    if (isLiteral(e)) {
+        return typeof e.val === 'number' && Number.isInteger(e.val) ? clamp({ low: e.val, high: e.val }) : FULL;
+    }
+    if (isRef(e)) {
+        return (e.val.ref && ranges.get(e.val.ref)) ?? FULL;
+    }
+    if (isNegIntExpr(e)) {
+        const operand = evalInterval(e.ne, ranges);
+        return clamp({ low: -operand.high, high: -operand.low });
+    }
+    if (isBinExpr(e)) {
+        const a = evalInterval(e.e1, ranges);
+        const b = evalInterval(e.e2, ranges);
+        switch (e.op) {
+            case '+': return clamp({ low: a.low + b.low, high: a.high + b.high });
+            case '-': return clamp({ low: a.low - b.high, high: a.high - b.low });
+            case '*': return hull([a.low * b.low, a.low * b.high, a.high * b.low, a.high * b.high]);
+            case '/':
+                // A divisor range without zero has a single sign, where truncating division is monotonic in both operands
+                return b.low <= 0 && b.high >= 0 ? FULL : hull([a.low / b.low, a.low / b.high, a.high / b.low, a.high / b.high].map(Math.trunc));
+        }
+    }
+    return FULL;
+}
+
+/* Values every int attribute can hold, over-approximated flow-insensitively: the initial value joined with every value
+   any assignment to it can produce, iterated to a fixpoint. Attributes still growing after a few rounds get the whole
+   int range, and so does one without a default value, which starts out indeterminate in C++. Only the assignments of
+   `transitions` count, which defaults to every transition of the machine */
+export function inferAttributeRanges(statemachine: Statemachine, transitions = statemachine.states.flatMap(state => state.transitions)): Map<Attribute, Interval> {
+    const ranges = new Map<Attribute, Interval>();
+    for (const attribute of statemachine.attributes.filter(attribute => attribute.type === 'int')) {
+        ranges.set(attribute, attribute.defaultValue ? evalInterval(attribute.defaultValue, ranges) : FULL);
+    }
+    const assignments = transitions.flatMap(transition => transition.actions)
+        .flatMap(action => action.assignment?.variable.ref && ranges.has(action.assignment.variable.ref) ? [action.assignment] : []);
+    for (let round = 1, changed = true; changed; round++) {
+        changed = false;
+        for (const assignment of assignments) {
+            const attribute = assignment.variable.ref!;
+            const current = ranges.get(attribute)!;
+            const value = evalInterval(assignment.value, ranges);
+            if (value.low < current.low || value.high > current.high) {
+                ranges.set(attribute, round > WIDENING_ROUNDS ? FULL : { low: Math.min(current.low, value.low), high: Math.max(current.high, value.high) });
+                changed = true;
+            }
+        }
+    }
+    return ranges;
+}
+
+/* Smallest integer type holding every value of the range */
+export function storageType(range: Interval): { type: string, size: number } {
+    if (range.low >= 0) {
+        if (range.high <= 0xff) {
+            return { type: 'std::uint8_t', size: 1 };
+        }
+        if (range.high <= 0xffff) {
+            return { type: 'std::uint16_t', size: 2 };
+        }
+    } else {
+        if (range.low >= -0x80 && range.high <= 0x7f) {
+            return { type: 'std::int8_t', size: 1 };
+        }
+        if (range.low >= -0x8000 && range.high <= 0x7fff) {
+            return { type: 'std::int16_t', size: 2 };
+        }
+    }
+    return { type: 'int', size: 4 };
+}
+
+/* hot: read by a guard; warm: used by other actions; cold: only printed, or not used at all */
+type Heat = 0 | 1 | 2;
+
+function referencedAttributes(e: Expression, into: Set<Attribute>): Set<Attribute> {
+    if (isRef(e) && e.val.ref) {
+        into.add(e.val.ref);
+    } else if (isGroup(e)) {
+        referencedAttributes(e.ge, into);
+    } else if (isBinExpr(e)) {
+        referencedAttributes(e.e1, into);
+        referencedAttributes(e.e2, into);
+    } else if (isNegIntExpr(e) || isNegBoolExpr(e)) {
+        referencedAttributes(e.ne, into);
+    }
+    return into;
+}
+
+function attributeHeat(statemachine: Statemachine): Map<Attribute, Heat> {
+    const transitions = statemachine.states.flatMap(state => state.transitions);
+    const hot = new Set<Attribute>();
+    const warm = new Set<Attribute>();
+    for (const transition of transitions) {
+        if (transition.guard) {
+            referencedAttributes(transition.guard, hot);
+        }
+        for (const action of transition.actions) {
+            if (action.assignment) {
+                referencedAttributes(action.assignment.value, warm);
+                if (action.assignment.variable.ref) {
+                    warm.add(action.assignment.variable.ref);
+                }
+            }
+        }
+    }
+    return new Map(statemachine.attributes.map(attribute => [attribute, hot.has(attribute) ? 0 : warm.has(attribute) ? 1 : 2]));
+}
+
+/* One member of a packed machine; bool attributes are one-bit bitfields sharing a byte */
+export interface AttributeSlot {
+    attribute: Attribute;
+    type: string;
+    size: number;
+    bitfield: boolean;
+}
+
+export interface LayoutOptions {
+    /* Attributes may be set from outside the model, as through set_<attribute>() in library mode and the freestanding
+       profile; int attributes then keep int, as the model's assignments do not bound their values */
+    externalWrites?: boolean;
+}
+
+/* Packed layout: int attributes get the smallest type holding the range inferAttributeRanges finds, fixed-width ones keep
+   their type, all bool attributes become adjacent bitfields, and members read by guards come first so that dispatch
+   touches as few cache lines as possible. Members are ordered by heat and then by decreasing size; where a member would need padding, a smaller one
+   from further back that fits the gap is moved forward instead */
+export function planAttributeLayout(statemachine: Statemachine, options: LayoutOptions = {}): AttributeSlot[] {
+    const cache = plans.get(statemachine) ?? new Map<boolean, AttributeSlot[]>();
+    plans.set(statemachine, cache);
+    let plan = cache.get(options.externalWrites ?? false);
+    if (plan === undefined) {
+        plan = computeAttributeLayout(statemachine, options);
+        cache.set(options.externalWrites ?? false, plan);
+    }
+    return plan;
+}
+
+const plans = new WeakMap<Statemachine, Map<boolean, AttributeSlot[]>>();
+
+/* Members placed together: an integer attribute, or all the bitfields, which the hottest bool decides the heat of */
+interface LayoutUnit {
+    slots: AttributeSlot[];
+    size: number;
+    heat: Heat;
+}
+
+function computeAttributeLayout(statemachine: Statemachine, options: LayoutOptions): AttributeSlot[] {
+    const ranges = options.externalWrites ? new Map<Attribute, Interval>() : inferAttributeRanges(statemachine);
+    const heat = attributeHeat(statemachine);
+    const units: LayoutUnit[] = statemachine.attributes.filter(attribute => attribute.type !== 'bool').map(attribute => {
+        const fixed = FIXED_WIDTH_TYPES[attribute.type];
+        const { type, size } = fixed ? { type: fixed.cpp, size: fixed.bits / 8 } : storageType(ranges.get(attribute) ?? FULL);
+        return { slots: [{ attribute, type, size, bitfield: false }], size, heat: heat.get(attribute)! };
+    });
+    const bools = statemachine.attributes.filter(attribute => attribute.type === 'bool');
+    if (bools.length > 0) {
+        units.push({
+            slots: bools.map(attribute => ({ attribute, type: 'bool', size: 0, bitfield: true })),
+            size: Math.ceil(bools.length / 8),
+            heat: Math.min(...bools.map(attribute => heat.get(attribute)!)) as Heat
+        });
+    }
+    // The bitfields are aligned to a byte, so among units of one byte they go last, where they cannot leave a gap
+    const alignment = (unit: LayoutUnit) => unit.slots[0].bitfield ? 1 : unit.size;
+    units.sort((a, b) => a.heat - b.heat || alignment(b) - alignment(a) || a.size - b.size);
+    const placed: LayoutUnit[] = [];
+    let offset = 0;
+    while (units.length > 0) {
+        const padding = (alignment(units[0]) - offset % alignment(units[0])) % alignment(units[0]);
+        const filler = padding === 0 ? -1 : units.findIndex(unit => unit.size <= padding && offset % alignment(unit) === 0);
+        const [unit] = units.splice(Math.max(filler, 0), 1);
+        offset += (filler < 0 ? padding : 0) + unit.size;
+        placed.push(unit);
+    }
+    return placed.flatMap(unit => unit.slots);
+}
+
+/* Size of the packed attributes, including the padding before a member aligned to its size */
+export function packedAttributesSize(slots: AttributeSlot[], offset = 0): number {
+    let size = offset;
+    let bits = 0;
+    for (const slot of slots) {
+        if (slot.bitfield) {
+            if (bits % 8 === 0) {
+                size++;
+            }
+            bits++;
+        } else {
+            bits = 0;
+            size = Math.ceil(size / slot.size) * slot.size + slot.size;
+        }
+    }
+    return size;
+}
@@ -0,0 +1,107 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+import { isStringLiteral, type PrintStatement, type Statemachine } from '../language-server/generated/ast.js';
+import { eventStreamFingerprint } from './event-stream.js';
+
+/*
+ * Log written by machines generated with `--log=binary` (see src/runtime/statemachine_log.hpp):
+ *
+ *   magic "SMLG" | version u8 | 3 reserved bytes | fingerprint u64 LE
+ *
+ * followed by records of a u16 LE format id and one i64 LE per argument of that format.
+ */
+export const LOG_FILE_MAGIC = 'SMLG';
+export const LOG_FILE_HEADER_SIZE = 16;
+
+/* A format prints parts[0], args[0], parts[1], ...; `state` arguments are state indices and print as the state name */
+export interface LogFormat {
+    parts: string[];
+    args: Array<'value' | 'state'>;
+}
+
+export interface LogFormats {
+    formats: LogFormat[];
+    ids: Map<PrintStatement, number>;
+}
+
+const logFormatsCache = new WeakMap<Statemachine, LogFormats>();
+
+/* Formats 0 and 1 are the initial state and transitions, then one per distinct print action in model order */
+export function buildLogFormats(statemachine: Statemachine): LogFormats {
+    const cached = logFormatsCache.get(statemachine);
+    if (cached) {
+        return cached;
+    }
+    const formats: LogFormat[] = [
+        { parts: ['[', ']'], args: ['state'] },
+        { parts: ['', ' ===> ', ''], args: ['state', 'state'] },
+    ];
+    const byKey = new Map<string, number>();
+    const ids = new Map<PrintStatement, number>();
+    for (const state of statemachine.states) {
+        for (const transition of state.transitions) {
+            for (const action of transition.actions) {
+                if (!action.print) {
+                    continue;
+                }
+                const format: LogFormat = { parts: [''], args: [] };
+                for (const value of action.print.values) {
+                    if (isStringLiteral(value)) {
+                        format.parts[format.parts.length - 1] += value.value;
+                    } else {
+                        format.args.push('value');
+                        format.parts.push('');
+                    }
+                }
+                const key = JSON.stringify(format);
+                if (!byKey.has(key)) {
+                    byKey.set(key, formats.length);
+                    formats.push(format);
+                }
+                ids.set(action.print, byKey.get(key)!);
+            }
+        }
+    }
+    const result = { formats, ids };
+    logFormatsCache.set(statemachine, result);
+    return result;
+}
+
+/* Turns a binary log back into the text the machine would have printed with `--log=text` */
+export function decodeBinaryLog(statemachine: Statemachine, log: Buffer): string {
+    if (log.length < LOG_FILE_HEADER_SIZE || log.subarray(0, 4).toString('latin1') !== LOG_FILE_MAGIC || log[4] !== 1) {
+        throw new Error('input is not a binary statemachine log');
+    }
+    if (log.readBigUInt64LE(8) !== eventStreamFingerprint(statemachine)) {
+        throw new Error(`log was not written by the ${statemachine.name} statemachine`);
+    }
+    const { formats } = buildLogFormats(statemachine);
+    const lines: string[] = [];
+    for (let at = LOG_FILE_HEADER_SIZE; at < log.length;) {
+        if (at + 2 > log.length) {
+            throw new Error(`truncated record at offset ${at}`);
+        }
+        const id = log.readUInt16LE(at);
+        const format = formats[id];
+        if (format === undefined) {
+            throw new Error(`unknown format ${id} at offset ${at}`);
+        }
+        if (at + 2 + 8 * format.args.length > log.length) {
+            throw new Error(`truncated record at offset ${at}`);
+        }
+        at += 2;
+        let line = format.parts[0];
+        format.args.forEach((kind, index) => {
+            const value = log.readBigInt64LE(at);
+            at += 8;
+            line += kind === 'state' ? statemachine.states[Number(value)]?.name ?? `<state ${value}>` : value.toString();
+            line += format.parts[index + 1];
+        });
+        lines.push(line);
+    }
+    return lines.map(line => line + '\n').join('');
+}
@@ -5,13 +5,19 @@
  ******************************************************************************/
 
 // import chalk from 'chalk';
-import { Command } from 'commander';
+import { Command, InvalidArgumentError, Option } from 'commander';
 import { NodeFileSystem } from 'langium/node';
 import type { Statemachine } from '../language-server/generated/ast.js';
 import { StatemachineLanguageMetaData } from '../language-server/generated/module.js';
 import { createStatemachineServices } from '../language-server/statemachine-module.js';
 import { extractAstNode } from './cli-util.js';
-import { generateCpp } from './generator.js';
+import { describeMinimization, describePruning, generateCpp, type GeneratorOptions } from './generator.js';
+import { TRACE_LEVELS } from './generator-util.js';
+import { encodeEventStream, type EncodeEventsOptions } from './event-stream.js';
+import { decodeBinaryLog } from './binary-log.js';
+import { estimateFootprint } from './generator-freestanding.js';
+import { DEFAULT_QUEUE_CAPACITY, QUEUE_OVERFLOW_POLICIES, parseQueueCapacity, type EventQueueOptions } from './event-queue.js';
+import { ATTRIBUTE_LAYOUTS } from './attribute-layout.js';
 import * as url from 'node:url';
 import * as fs from 'node:fs/promises';
 import * as path from 'node:path';
@@ -19,11 +25,11 @@ import { interpretStatemachine, interpretStatemachineStatic } from './interprete
 // import { eventsAreValid } from './interpret-util.js';
 import chalk from 'chalk';
 
-export const interpret = async (fileName: string): Promise<void> => {
+export const interpret = async (fileName: string, opts: EventQueueOptions): Promise<void> => {
     const services = createStatemachineServices(NodeFileSystem).statemachine;
     const model = await extractAstNode<Statemachine>(fileName, StatemachineLanguageMetaData.fileExtensions, services);
     console.log('Interpreting model...', model.$type, typeof model);
-    interpretStatemachine(model);
+    interpretStatemachine(model, opts);
 };
 
 /*by @Eclipse-Langium */
@@ -38,8 +44,18 @@ export const interpretStatic = async (fileName: string, events: string[]): Promi
 export const generateAction = async (fileName: string, opts: GenerateOptions): Promise<void> => {
     const services = createStatemachineServices(NodeFileSystem).statemachine;
     const statemachine = await extractAstNode<Statemachine>(fileName, StatemachineLanguageMetaData.fileExtensions, services);
-    const generatedFilePath = generateCpp(statemachine, fileName, opts.destination);
+    const generatedFilePath = generateCpp(statemachine, fileName, opts.destination, opts);
     console.log(chalk.green(`C++ code generated successfully: ${generatedFilePath}`));
+    if (opts.profile === 'freestanding') {
+        const footprint = estimateFootprint({ ...opts, statemachine, fileName, destination: '' });
+        console.log(`${statemachine.name} footprint estimate (32-bit target): RAM ${footprint.ram} bytes, stack ${footprint.stack} bytes for prints, ROM ~${footprint.rom} bytes`);
+    }
+    if (opts.prune) {
+        console.log(describePruning({ ...opts, statemachine, fileName, destination: '' }));
+    }
+    if (opts.minimize) {
+        console.log(describeMinimization({ ...opts, statemachine, fileName, destination: '' }));
+    }
 };
 
 
@@ -51,15 +67,68 @@ export const generateAst = async (fileName: string, opts: GenerateOptions): Prom
     console.log(serializedAst);
 };
 
-export type GenerateOptions = {
+export type GenerateOptions = GeneratorOptions & {
     destination?: string;
 }
 
+export const encodeEvents = async (fileName: string, textLog: string, opts: EncodeOptions): Promise<void> => {
+    const services = createStatemachineServices(NodeFileSystem).statemachine;
+    const statemachine = await extractAstNode<Statemachine>(fileName, StatemachineLanguageMetaData.fileExtensions, services);
+    const output = opts.output ?? path.join(path.dirname(textLog), `${path.basename(textLog, path.extname(textLog))}.smev`);
+    try {
+        const stream = encodeEventStream(statemachine, await fs.readFile(textLog, 'utf-8'), opts);
+        await fs.writeFile(output, stream);
+        console.log(chalk.green(`Event stream encoded successfully: ${output} (${stream.length} bytes)`));
+    } catch (error) {
+        console.error(chalk.red(`${textLog}: ${error instanceof Error ? error.message : error}`));
+        process.exit(1);
+    }
+};
+
+export type EncodeOptions = EncodeEventsOptions & {
+    output?: string;
+}
+
+export const decodeLog = async (fileName: string, log: string): Promise<void> => {
+    const services = createStatemachineServices(NodeFileSystem).statemachine;
+    const statemachine = await extractAstNode<Statemachine>(fileName, StatemachineLanguageMetaData.fileExtensions, services);
+    try {
+        process.stdout.write(decodeBinaryLog(statemachine, await fs.readFile(log)));
+    } catch (error) {
+        console.error(chalk.red(`${log}: ${error instanceof Error ? error.message : error}`));
+        process.exit(1);
+    }
+};
+
 const __dirname = url.fileURLToPath(new URL('.', import.meta.url));
 
 const packagePath = path.resolve(__dirname, '..', '..', 'package.json');
 const packageContent = await fs.readFile(packagePath, 'utf-8');
 
+function queueCapacityOption(): Option {
+    return new Option('--queue-capacity <n>', 'events that can wait while a transition is in flight').argParser(value => {
+        try {
+            return parseQueueCapacity(value);
+        } catch (error) {
+            throw new InvalidArgumentError((error as Error).message);
+        }
+    }).default(DEFAULT_QUEUE_CAPACITY);
+}
+
+function shardsOption(): Option {
+    return new Option('--shards <n>', 'write a header, n sources defining the states and one with main(), to compile in parallel').argParser(value => {
+        const shards = Number(value);
+        if (!Number.isInteger(shards) || shards < 1) {
+            throw new InvalidArgumentError(`the number of shards must be a positive integer, got '${value}'`);
+        }
+        return shards;
+    });
+}
+
+function queueOverflowOption(): Option {
+    return new Option('--queue-overflow <policy>', 'what happens to an event arriving while the event queue is full').choices(QUEUE_OVERFLOW_POLICIES).default('reject');
+}
+
 const program = new Command();
 
 program.version(JSON.parse(packageContent).version);
@@ -68,8 +137,39 @@ program
     .command('generate')
     .argument('<file>', `possible file extensions: ${StatemachineLanguageMetaData.fileExtensions.join(', ')}`)
     .option('-d, --destination <dir>', 'destination directory of generating')
+    .addOption(new Option('-b, --backend <backend>', 'dispatch strategy of the generated C++').choices(['virtual', 'table', 'crtp']).default('virtual'))
+    .addOption(new Option('-t, --trace <level>', 'diagnostic output compiled into the generated C++').choices(TRACE_LEVELS).default('all'))
+    .addOption(new Option('-l, --log <mode>', 'print actions and transitions as text or into a deferred binary log').choices(['text', 'binary']).default('text'))
+    .addOption(new Option('-m, --mode <mode>', 'a program reading events from stdin, or a library with a dispatch API').choices(['program', 'library']).default('program'))
+    .addOption(new Option('--timeouts <mode>', 'whether setTimeout suspends the transition (C++20) or blocks the program').choices(['coroutine', 'blocking']).default('coroutine'))
+    .addOption(queueCapacityOption())
+    .addOption(queueOverflowOption())
+    .addOption(new Option('-p, --profile <profile>', 'hosted C++, or freestanding C++ without iostream, exceptions, RTTI or heap').choices(['hosted', 'freestanding']).default('hosted'))
+    .addOption(new Option('--layout <layout>', 'attributes as declared, or packed into narrow types and bitfields ordered by use').choices(ATTRIBUTE_LAYOUTS).default('declared'))
+    .option('--prune', 'leave out states unreachable from the initial state and transitions that can never fire')
+    .option('--minimize', 'merge states that behave the same, keeping their names as aliases for tracing')
+    .addOption(shardsOption())
+    .option('--module', 'with --shards, also write a C++20 module interface exporting the machine and its states')
+    .option('--line-directives', 'emit #line directives so that debuggers and profilers point at the .statemachine file')
+    .option('--probes', 'compile USDT probes into the machine for bpftrace and perf to attach to at run time')
+    .option('--stats', 'count and time the transitions of every state and event, written as JSON on exit and on SIGUSR1')
+    .option('--timeline', 'record transitions, actions and delays into per-thread rings, written as a Chrome trace on exit and on SIGUSR2')
     .description('generates a C++ CLI to walk over states')
     .action(generateAction);
+program
+    .command('encode-events')
+    .argument('<file>', `possible file extensions: ${StatemachineLanguageMetaData.fileExtensions.join(', ')}`)
+    .argument('<textlog>', 'event log with one event name per line')
+    .option('-o, --output <file>', 'binary event stream to write (default: <textlog>.smev)')
+    .option('-t, --timestamps', 'lines are `<timestamp> <event>`; timestamps are stored as varint deltas')
+    .description('encodes a text event log into the binary event stream read by generated machines with --binary')
+    .action(encodeEvents);
+program
+    .command('decode-log')
+    .argument('<file>', `possible file extensions: ${StatemachineLanguageMetaData.fileExtensions.join(', ')}`)
+    .argument('<log>', 'binary log written by a machine generated with --log binary')
+    .description('prints a binary statemachine log as text')
+    .action(decodeLog);
 program
     .command('generate-ast')
     .argument('<file>', `possible file extensions: ${StatemachineLanguageMetaData.fileExtensions.join(', ')}`)
@@ -79,8 +179,10 @@ program
 program
     .command('interpret')
     .argument('<file>', `possible file extensions: ${StatemachineLanguageMetaData.fileExtensions.join(', ')}`)
+    .addOption(queueCapacityOption())
+    .addOption(queueOverflowOption())
     .description('Interpret a statemachine model with a sequence of events')
-    .action((file) => interpret(file));
+    .action((file, opts) => interpret(file, opts));
 
 program
     .command('interpret-static')
@@ -0,0 +1,73 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+/* What happens to an event arriving while a transition is in flight and the event queue is full */
+export type QueueOverflow = 'drop-oldest' | 'drop-newest' | 'reject';
+
+export const QUEUE_OVERFLOW_POLICIES: QueueOverflow[] = ['drop-oldest', 'drop-newest', 'reject'];
+
+export const DEFAULT_QUEUE_CAPACITY = 64;
+
+export interface EventQueueOptions {
+    queueCapacity?: number;
+    queueOverflow?: QueueOverflow;
+}
+
+/* Bounded FIFO of the interpreter with the overflow policies of the generated event_queue: push and shift are O(1)
+   and the ring is allocated once, so bursts of input cannot grow it */
+export class EventQueue<T> {
+    readonly capacity: number;
+    readonly overflow: QueueOverflow;
+    private readonly items: Array<T | undefined>;
+    private first = 0;
+    private count = 0;
+
+    constructor(options: EventQueueOptions = {}) {
+        this.capacity = options.queueCapacity ?? DEFAULT_QUEUE_CAPACITY;
+        this.overflow = options.queueOverflow ?? 'reject';
+        if (!Number.isInteger(this.capacity) || this.capacity < 1) {
+            throw new Error(`event queue capacity must be a positive integer, got ${this.capacity}`);
+        }
+        this.items = new Array<T | undefined>(this.capacity);
+    }
+
+    get length(): number {
+        return this.count;
+    }
+
+    /* Returns false if the queue is full and the new item was dropped */
+    push(item: T): boolean {
+        if (this.count === this.capacity) {
+            if (this.overflow !== 'drop-oldest') {
+                return false;
+            }
+            this.shift();
+        }
+        this.items[(this.first + this.count) % this.capacity] = item;
+        this.count++;
+        return true;
+    }
+
+    shift(): T | undefined {
+        if (this.count === 0) {
+            return undefined;
+        }
+        const item = this.items[this.first];
+        this.items[this.first] = undefined;
+        this.first = (this.first + 1) % this.capacity;
+        this.count--;
+        return item;
+    }
+}
+
+/* Parses the value of a --queue-capacity option */
+export function parseQueueCapacity(value: string): number {
+    const capacity = Number(value);
+    if (!Number.isInteger(capacity) || capacity < 1) {
+        throw new Error(`queue capacity must be a positive integer, got '${value}'`);
+    }
+    return capacity;
+}
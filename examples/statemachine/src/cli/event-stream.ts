@@ -0,0 +1,95 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+import type { Statemachine } from '../language-server/generated/ast.js';
+
+/*
+ * Binary event stream consumed by generated machines with `--binary`:
+ *
+ *   magic "SMEV" | version u8 | id width u8 (1 or 2) | flags u8 | reserved u8 | fingerprint u64 LE
+ *
+ * followed by one record per event: the event id (index into `Statemachine.events`, little endian)
+ * and, if EVENT_STREAM_TIMESTAMPS is set, the ULEB128 delta to the previous record's timestamp.
+ */
+export const EVENT_STREAM_MAGIC = 'SMEV';
+export const EVENT_STREAM_VERSION = 1;
+export const EVENT_STREAM_HEADER_SIZE = 16;
+export const EVENT_STREAM_TIMESTAMPS = 1;
+
+export interface EncodeEventsOptions {
+    timestamps?: boolean;
+}
+
+/* 64-bit FNV-1a over the machine name and its ordered event names; a stream only replays against the model it was encoded for */
+export function eventStreamFingerprint(statemachine: Statemachine): bigint {
+    const mask = (1n << 64n) - 1n;
+    let hash = 0xcbf29ce484222325n;
+    const text = [statemachine.name, ...statemachine.events.map(event => event.name)].join('\n');
+    for (const byte of Buffer.from(text, 'utf-8')) {
+        hash = ((hash ^ BigInt(byte)) * 0x100000001b3n) & mask;
+    }
+    return hash;
+}
+
+/* Width in bytes of an event id, matching idType() of the generated event enums */
+export function eventIdWidth(statemachine: Statemachine): number {
+    return statemachine.events.length <= 256 ? 1 : 2;
+}
+
+/* Encodes a text log with one event name per line, or `<timestamp> <event>` per line if options.timestamps is set */
+export function encodeEventStream(statemachine: Statemachine, textLog: string, options: EncodeEventsOptions = {}): Buffer {
+    const ids = new Map(statemachine.events.map((event, index) => [event.name, index]));
+    const width = eventIdWidth(statemachine);
+    const bytes: number[] = [];
+    let previous = 0n;
+
+    textLog.split(/\r?\n/).forEach((line, index) => {
+        if (line.trim().length === 0) {
+            return;
+        }
+        let name = line.trim();
+        let timestamp = 0n;
+        if (options.timestamps) {
+            const match = /^(\d+)\s+(\S+)$/.exec(name);
+            if (!match) {
+                throw new Error(`line ${index + 1}: expected '<timestamp> <event>' but found '${line}'`);
+            }
+            timestamp = BigInt(match[1]);
+            name = match[2];
+            if (timestamp < previous) {
+                throw new Error(`line ${index + 1}: timestamp ${timestamp} is smaller than the previous one`);
+            }
+        }
+        const id = ids.get(name);
+        if (id === undefined) {
+            throw new Error(`line ${index + 1}: there is no event <${name}> in the ${statemachine.name} statemachine`);
+        }
+        bytes.push(id & 0xff);
+        if (width === 2) {
+            bytes.push(id >> 8);
+        }
+        if (options.timestamps) {
+            pushVarint(bytes, timestamp - previous);
+            previous = timestamp;
+        }
+    });
+
+    const header = Buffer.alloc(EVENT_STREAM_HEADER_SIZE);
+    header.write(EVENT_STREAM_MAGIC, 0, 'latin1');
+    header.writeUInt8(EVENT_STREAM_VERSION, 4);
+    header.writeUInt8(width, 5);
+    header.writeUInt8(options.timestamps ? EVENT_STREAM_TIMESTAMPS : 0, 6);
+    header.writeBigUInt64LE(eventStreamFingerprint(statemachine), 8);
+    return Buffer.concat([header, Buffer.from(bytes)]);
+}
+
+function pushVarint(bytes: number[], value: bigint): void {
+    while (value >= 0x80n) {
+        bytes.push(Number(value & 0x7fn) | 0x80);
+        value >>= 7n;
+    }
+    bytes.push(Number(value));
+}
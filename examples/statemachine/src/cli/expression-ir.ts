@@ -0,0 +1,420 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+import { type Action, type Attribute, type Expression, type Transition, isBinExpr, isGroup, isLiteral, isNegBoolExpr, isNegIntExpr, isRef, isStringLiteral } from '../language-server/generated/ast.js';
+import type { StatemachineEnv } from './interpreter.js';
+import { evalFixedWidthOperation, FIXED_WIDTH_TYPES, integerTypeOf, wrapToType } from './interpret-util.js';
+
+/*
+ * Typed IR between the AST and the C++ emitters. Guards and action values are lowered into it, optimized (constant
+ * folding, boolean simplification and algebraic identities), and within a transition repeated subexpressions move into
+ * const locals before the result is printed as C++. Expressions of the language have no side effects, which is what
+ * makes dropping, reordering and sharing their evaluation valid.
+ */
+
+/* `type` is 'bool' or an integer attribute type: comparisons are bool, arithmetic has the type of its operands */
+export type IrExpression =
+    | { kind: 'constant', type: string, value: number | boolean | bigint }
+    | { kind: 'load', type: string, attribute: Attribute }
+    | { kind: 'unary', type: string, op: '-' | '!', operand: IrExpression }
+    | { kind: 'binary', type: string, op: string, left: IrExpression, right: IrExpression }
+    | { kind: 'local', type: string, name: string };
+
+const ARITHMETIC = ['+', '-', '*', '/'];
+const FIXED_WIDTH_OPERATIONS: Record<string, string> = { '+': 'add', '-': 'sub', '*': 'mul', '/': 'div' };
+const NEGATED_COMPARISONS: Record<string, string> = { '<': '>=', '>=': '<', '>': '<=', '<=': '>', '==': '!=', '!=': '==' };
+
+/* C++ type of an attribute type; fixed-width types map to the <cstdint> types of their width */
+export function cppType(type: string): string {
+    return FIXED_WIDTH_TYPES[type]?.cpp ?? type;
+}
+
+/* With `env`, references must also be in scope there, as the code generators require */
+export function lowerExpression(e: Expression, env?: StatemachineEnv): IrExpression {
+    if (isGroup(e)) {
+        return lowerExpression(e.ge, env);
+    } else if (isLiteral(e)) {
+        if (e.val === undefined) {
+            throw new Error('Literal value is undefined');
+        }
+        return { kind: 'constant', type: typeof e.val === 'boolean' ? 'bool' : 'int', value: e.val };
+    } else if (isRef(e)) {
+        if (!e.val.ref || (env !== undefined && !env.has(e.val.$refText))) {
+            throw new Error(`${e.val.$refText} Reference is undefined in this scope`);
+        }
+        return { kind: 'load', type: e.val.ref.type, attribute: e.val.ref };
+    } else if (isNegIntExpr(e)) {
+        return { kind: 'unary', type: integerTypeOf(e), op: '-', operand: lowerExpression(e.ne, env) };
+    } else if (isNegBoolExpr(e)) {
+        return { kind: 'unary', type: 'bool', op: '!', operand: lowerExpression(e.ne, env) };
+    } else if (isBinExpr(e)) {
+        const type = ARITHMETIC.includes(e.op) ? integerTypeOf(e) : 'bool';
+        return { kind: 'binary', type, op: e.op, left: lowerExpression(e.e1, env), right: lowerExpression(e.e2, env) };
+    }
+    throw new Error('Unhandled Expression: ' + e);
+}
+
+/* The optimized value of an assignment to, or the default value of, an attribute of type `type` */
+export function lowerAssignedValue(e: Expression, type: string, env?: StatemachineEnv): IrExpression {
+    return convertConstant(optimizeExpression(lowerExpression(e, env)), type);
+}
+
+function isIntegral(value: number | boolean | bigint): value is number | bigint {
+    return typeof value === 'bigint' || Number.isInteger(value);
+}
+
+function constant(type: string, value: number | boolean | bigint): IrExpression {
+    return { kind: 'constant', type, value };
+}
+
+function isConstant(node: IrExpression, value: number | boolean): boolean {
+    return node.kind === 'constant' && (typeof node.value === 'boolean' ? node.value === value : Number(node.value) === value);
+}
+
+/* A constant used as a fixed-width value is wrapped into the type, as its conversion in C++ does */
+function convertConstant(node: IrExpression, type: string): IrExpression {
+    return node.kind === 'constant' && type in FIXED_WIDTH_TYPES && isIntegral(node.value) ? constant(type, wrapToType(node.value, type)) : node;
+}
+
+export function optimizeExpression(node: IrExpression): IrExpression {
+    if (node.kind === 'unary') {
+        return simplifyUnary(node.op, node.type, optimizeExpression(node.operand));
+    } else if (node.kind === 'binary') {
+        const arithmetic = ARITHMETIC.includes(node.op);
+        const left = optimizeExpression(node.left);
+        const right = optimizeExpression(node.right);
+        return simplifyBinary(node.op, node.type, arithmetic ? convertConstant(left, node.type) : left, arithmetic ? convertConstant(right, node.type) : right);
+    }
+    return node;
+}
+
+function simplifyUnary(op: '-' | '!', type: string, operand: IrExpression): IrExpression {
+    if (operand.kind === 'constant' && op === '!' && typeof operand.value === 'boolean') {
+        return constant('bool', !operand.value);
+    } else if (operand.kind === 'constant' && op === '-' && isIntegral(operand.value)) {
+        return constant(type, type in FIXED_WIDTH_TYPES ? wrapToType(-BigInt(operand.value), type) : -operand.value);
+    } else if (operand.kind === 'unary' && operand.op === op) {
+        return operand.operand;
+    } else if (op === '!' && operand.kind === 'binary' && NEGATED_COMPARISONS[operand.op]) {
+        return { ...operand, op: NEGATED_COMPARISONS[operand.op] };
+    }
+    return { kind: 'unary', type, op, operand };
+}
+
+function simplifyBinary(op: string, type: string, left: IrExpression, right: IrExpression): IrExpression {
+    if (left.kind === 'constant' && right.kind === 'constant') {
+        const value = evaluateConstant(op, type, left, right);
+        if (value !== undefined) {
+            return constant(type, value);
+        }
+    }
+    switch (op) {
+        case '&&':
+        case '||': {
+            // `a && true` is `a` and `a && false` is false, the other way round for ||
+            const neutral = op === '&&';
+            if (isConstant(left, neutral) || isConstant(right, !neutral) || sameExpression(left, right)) {
+                return right;
+            } else if (isConstant(right, neutral) || isConstant(left, !neutral)) {
+                return left;
+            }
+            break;
+        }
+        case '==':
+        case '!=': {
+            const [known, other] = left.kind === 'constant' ? [left, right] : [right, left];
+            if (known.kind === 'constant' && typeof known.value === 'boolean' && other.kind !== 'constant') {
+                return known.value === (op === '==') ? other : simplifyUnary('!', 'bool', other);
+            }
+            break;
+        }
+        case '+':
+            if (isConstant(left, 0)) {
+                return right;
+            }
+            if (isConstant(right, 0)) {
+                return left;
+            }
+            break;
+        case '-':
+            if (isConstant(right, 0)) {
+                return left;
+            }
+            break;
+        case '*':
+            if (isConstant(left, 1) || isConstant(right, 0)) {
+                return right;
+            }
+            if (isConstant(right, 1) || isConstant(left, 0)) {
+                return left;
+            }
+            break;
+        case '/':
+            if (isConstant(right, 1)) {
+                return left;
+            }
+            break;
+    }
+    return { kind: 'binary', type, op, left, right };
+}
+
+/* Folds like the interpreter evaluates; fractional literals and division by zero are left to run time */
+function evaluateConstant(op: string, type: string, left: IrExpression & { kind: 'constant' }, right: IrExpression & { kind: 'constant' }): number | boolean | bigint | undefined {
+    const a = left.value;
+    const b = right.value;
+    if (typeof a === 'boolean' || typeof b === 'boolean') {
+        if (typeof a !== typeof b) {
+            return undefined;
+        }
+        switch (op) {
+            case '&&': return a && b;
+            case '||': return a || b;
+            case '==': return a === b;
+            case '!=': return a !== b;
+        }
+        return undefined;
+    }
+    if (!isIntegral(a) || !isIntegral(b) || (op === '/' && Number(b) === 0)) {
+        return undefined;
+    }
+    if (op === '==' || op === '!=') {
+        return (BigInt(a) === BigInt(b)) === (op === '==');
+    }
+    const operandType = ARITHMETIC.includes(op) ? type : left.type in FIXED_WIDTH_TYPES ? left.type : right.type;
+    if (typeof a === 'bigint' || typeof b === 'bigint' || operandType in FIXED_WIDTH_TYPES) {
+        return evalFixedWidthOperation(op, BigInt(a), BigInt(b), operandType);
+    }
+    switch (op) {
+        case '+': return a + b;
+        case '-': return a - b;
+        case '*': return a * b;
+        case '/': return Math.trunc(a / b);
+        case '<': return a < b;
+        case '>': return a > b;
+        case '<=': return a <= b;
+        case '>=': return a >= b;
+    }
+    return undefined;
+}
+
+/* `stamp` tells apart loads of an attribute before and after an assignment to it */
+function expressionKey(node: IrExpression, stamp: (attribute: Attribute) => string): string {
+    switch (node.kind) {
+        case 'constant': return `${node.type}:${node.value}`;
+        case 'load': return stamp(node.attribute);
+        case 'local': return node.name;
+        case 'unary': return `${node.op}(${expressionKey(node.operand, stamp)})`;
+        case 'binary': return `(${expressionKey(node.left, stamp)} ${node.op} ${expressionKey(node.right, stamp)})`;
+    }
+}
+
+function sameExpression(a: IrExpression, b: IrExpression): boolean {
+    const stamp = (attribute: Attribute) => attribute.name;
+    return expressionKey(a, stamp) === expressionKey(b, stamp);
+}
+
+function constantLiteral(value: number | boolean | bigint): string {
+    // The literal 9223372036854775808 has no signed type, so the smallest i64 cannot be written as its negation
+    return value === -(2n ** 63n) ? '(-9223372036854775807 - 1)' : value.toString();
+}
+
+/* `refPrefix` is prepended to attribute names, e.g. `statemachine->` or the prefix of batch locals */
+export function emitExpression(node: IrExpression, refPrefix: string): string {
+    switch (node.kind) {
+        case 'constant':
+            return constantLiteral(node.value);
+        case 'load':
+            return refPrefix + node.attribute.name;
+        case 'local':
+            return node.name;
+        case 'unary': {
+            const operand = emitExpression(node.operand, refPrefix);
+            return node.op === '-' && node.type in FIXED_WIDTH_TYPES ? `fixed_width::sub<${cppType(node.type)}>(0, ${operand})` : `${node.op}${operand}`;
+        }
+        case 'binary': {
+            const left = emitExpression(node.left, refPrefix);
+            const right = emitExpression(node.right, refPrefix);
+            if (ARITHMETIC.includes(node.op) && node.type in FIXED_WIDTH_TYPES) {
+                return `fixed_width::${FIXED_WIDTH_OPERATIONS[node.op]}<${cppType(node.type)}>(${left}, ${right})`;
+            }
+            return `(${left} ${node.op} ${right})`;
+        }
+    }
+}
+
+/* Whether a transition's guard always holds (true), never holds (false) or depends on the attributes (undefined) */
+export function guardOutcome(transition: Transition): boolean | undefined {
+    if (transition.guard === undefined) {
+        return true;
+    }
+    try {
+        const guard = optimizeExpression(lowerExpression(transition.guard));
+        return guard.kind === 'constant' && typeof guard.value === 'boolean' ? guard.value : undefined;
+    } catch {
+        // Unresolved references are reported when the guard is generated
+        return undefined;
+    }
+}
+
+/* C++ of a transition's guard and action values. Expressions lowered together share const locals, which are declared
+   before the guard or the first action using them */
+export interface TransitionCode {
+    /* Undefined when the guard always holds; `false` when it never does */
+    condition?: string;
+    fires: boolean;
+    guardLocals: string[];
+    actionLocals: Map<Action, string[]>;
+    expressions: Map<Expression, string>;
+}
+
+/* What is lowered together: only the guard or the actions if they end up in different functions, such as a guard
+   function and an action function or a coroutine */
+export type TransitionParts = 'guard' | 'actions' | 'both';
+
+interface Root {
+    expression?: Expression;
+    node: IrExpression;
+    statement: number;
+    stamp: (attribute: Attribute) => string;
+}
+
+interface Local {
+    reference: IrExpression & { kind: 'local' };
+    node: IrExpression;
+    statement: number;
+    stamp: (attribute: Attribute) => string;
+}
+
+/* `barrier` tells which actions may run host code that sets attributes, so that no value read before them is reused
+   after them; `setTimeout` always is one. Loads of attributes are only shared behind a pointer (a `refPrefix` ending in
+   `->`), as the compiler keeps locals in registers anyway */
+export function planTransitionCode(transition: Transition, env: StatemachineEnv, refPrefix: string, parts: TransitionParts, barrier: (action: Action) => boolean): TransitionCode {
+    const roots: Root[] = [];
+    const versions = new Map<Attribute, number>();
+    let epoch = 0;
+    const currentStamp = () => {
+        const snapshot = new Map(versions);
+        const at = epoch;
+        return (attribute: Attribute) => `${attribute.name}@${at}.${snapshot.get(attribute) ?? 0}`;
+    };
+    let fires = true;
+    let guardRoot: Root | undefined;
+    if (parts !== 'actions' && transition.guard !== undefined) {
+        const guard = optimizeExpression(lowerExpression(transition.guard, env));
+        if (guard.kind === 'constant') {
+            fires = guard.value === true;
+        } else {
+            guardRoot = { expression: transition.guard, node: guard, statement: -1, stamp: currentStamp() };
+            roots.push(guardRoot);
+        }
+    }
+    if (parts !== 'guard') {
+        transition.actions.forEach((action, index) => {
+            if (action.assignment) {
+                const target = action.assignment.variable.ref!;
+                roots.push({ expression: action.assignment.value, node: lowerAssignedValue(action.assignment.value, target.type, env), statement: index, stamp: currentStamp() });
+                versions.set(target, (versions.get(target) ?? 0) + 1);
+            } else if (action.print) {
+                for (const value of action.print.values) {
+                    if (!isStringLiteral(value)) {
+                        roots.push({ expression: value, node: optimizeExpression(lowerExpression(value, env)), statement: index, stamp: currentStamp() });
+                    }
+                }
+            }
+            if (action.setTimeout || barrier(action)) {
+                epoch++;
+            }
+        });
+    }
+    const locals = eliminateCommonSubexpressions(roots, refPrefix.endsWith('->'));
+    const declarations = (statement: number) => locals.filter(local => local.statement === statement)
+        .map(local => `const ${cppType(local.node.type)} ${local.reference.name} = ${emitExpression(local.node, refPrefix)};`);
+    const expressions = new Map(roots.map(root => [root.expression!, emitExpression(root.node, refPrefix)]));
+    return {
+        condition: guardRoot ? emitExpression(guardRoot.node, refPrefix) : fires ? undefined : 'false',
+        fires,
+        guardLocals: declarations(-1),
+        actionLocals: new Map(parts === 'guard' ? [] : transition.actions.map((action, index) => [action, declarations(index)])),
+        expressions
+    };
+}
+
+function containsDivision(node: IrExpression): boolean {
+    if (node.kind === 'unary') {
+        return containsDivision(node.operand);
+    } else if (node.kind === 'binary') {
+        return node.op === '/' || containsDivision(node.left) || containsDivision(node.right);
+    }
+    return false;
+}
+
+function expressionSize(node: IrExpression): number {
+    if (node.kind === 'unary') {
+        return 1 + expressionSize(node.operand);
+    } else if (node.kind === 'binary') {
+        return 1 + expressionSize(node.left) + expressionSize(node.right);
+    }
+    return 1;
+}
+
+/* Repeatedly moves the largest expression occurring at least twice into a local, replacing every occurrence; locals are
+   declared at the statement of the first occurrence. Divisions stay where they are, as evaluating one ahead of a
+   guard that protects it could divide by zero */
+function eliminateCommonSubexpressions(roots: Root[], shareLoads: boolean): Local[] {
+    const locals: Local[] = [];
+    for (;;) {
+        const occurrences = new Map<string, { count: number, size: number, node: IrExpression, statement: number, stamp: Root['stamp'] }>();
+        const visit = (node: IrExpression, statement: number, stamp: Root['stamp']) => {
+            if (node.kind === 'unary') {
+                visit(node.operand, statement, stamp);
+            } else if (node.kind === 'binary') {
+                visit(node.left, statement, stamp);
+                visit(node.right, statement, stamp);
+            }
+            const candidate = node.kind === 'load' ? shareLoads : (node.kind === 'unary' || node.kind === 'binary') && !containsDivision(node);
+            if (!candidate) {
+                return;
+            }
+            const key = expressionKey(node, stamp);
+            const seen = occurrences.get(key);
+            if (seen) {
+                seen.count++;
+                seen.statement = Math.min(seen.statement, statement);
+            } else {
+                occurrences.set(key, { count: 1, size: expressionSize(node), node, statement, stamp });
+            }
+        };
+        [...locals, ...roots].forEach(root => visit(root.node, root.statement, root.stamp));
+        let best: [string, { count: number, size: number, node: IrExpression, statement: number, stamp: Root['stamp'] }] | undefined;
+        for (const entry of occurrences) {
+            if (entry[1].count > 1 && (best === undefined || entry[1].size > best[1].size || (entry[1].size === best[1].size && entry[1].statement < best[1].statement))) {
+                best = entry;
+            }
+        }
+        if (best === undefined) {
+            // A local only uses those chosen after it, which are smaller; declared first, they are numbered first
+            const ordered = locals.reverse().sort((a, b) => a.statement - b.statement);
+            ordered.forEach((local, index) => local.reference.name = `cse_${index}`);
+            return ordered;
+        }
+        const [key, { node, statement, stamp }] = best;
+        const local: IrExpression & { kind: 'local' } = { kind: 'local', type: node.type, name: `cse_${locals.length}` };
+        const replace = (current: IrExpression, currentStamp: Root['stamp']): IrExpression => {
+            if (current.kind !== 'local' && current.kind !== 'constant' && expressionKey(current, currentStamp) === key) {
+                return local;
+            } else if (current.kind === 'unary') {
+                return { ...current, operand: replace(current.operand, currentStamp) };
+            } else if (current.kind === 'binary') {
+                return { ...current, left: replace(current.left, currentStamp), right: replace(current.right, currentStamp) };
+            }
+            return current;
+        };
+        for (const root of [...locals, ...roots]) {
+            root.node = replace(root.node, root.stamp);
+        }
+        locals.push({ reference: local, node, statement, stamp });
+    }
+}
@@ -0,0 +1,145 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+import * as path from 'node:path';
+import * as url from 'node:url';
+import { type Generated, expandToNode as toNode, joinToNode as join } from 'langium/generate';
+import type { State, Transition } from '../language-server/generated/ast.js';
+import type { StatemachineEnv } from './interpreter.js';
+import { type GeneratorContext, checkSingleTransitionPerEvent, fingerprintLiteral, generateTraceLevel, generateLogInclude, generateLogOpen, generateLogClose, generateTimerIncludes, generateTimerScheduler, queueCapacity, queueOverflowLiteral, suspendsOnTimeout, usesCoroutineTimeouts, generateEventLookup, idType, joinWithExtraNL, generateAttributeDeclaration, generatePackedAttributes, generateMemberInitializers, generateFixedWidthHelpers, planTransition, generateGuardLocals, generateActions } from './generator-util.js';
+import { stateDisplayName, stateEnumerators } from './state-minimization.js';
+
+export const RUNTIME_HEADER = 'statemachine_runtime.hpp';
+
+/* Location of a header-only runtime file, which is shipped with the sources (src/runtime) and copied next to generated machines */
+export function runtimeHeaderPath(header: string): string {
+    const dirname = url.fileURLToPath(new URL('.', import.meta.url));
+    return path.resolve(dirname, '..', '..', 'src', 'runtime', header);
+}
+
+/* CRTP backend: only the model-specific traits, machine class and transition specializations; dispatch lives in the runtime header */
+export function generateCrtpCppContent(ctx: GeneratorContext, env: StatemachineEnv): Generated {
+    const name = ctx.statemachine.name;
+    return toNode`
+        ${generateTraceLevel(ctx)}
+        ${generateLogInclude(ctx)}
+        #include "${RUNTIME_HEADER}"
+        #include <cstdint>
+        #include <chrono>
+        #include <thread>
+        ${generateTimerIncludes(ctx)}
+
+        ${generateTimerScheduler(ctx)}
+        ${generateFixedWidthHelpers(ctx)}
+        enum class ${name}State : ${idType(ctx.statemachine.states.length)} {
+            ${join(stateEnumerators(ctx.statemachine), { separator: ',', appendNewLineIfNotEmpty: true })}
+        };
+
+        enum class ${name}Event : ${idType(ctx.statemachine.events.length)} {
+            ${join(ctx.statemachine.events, event => event.name, { separator: ',', appendNewLineIfNotEmpty: true })}
+        };
+
+        ${generateEventLookup(ctx, `${name}Event`, event => `${name}Event::${event.name}`)}
+
+        struct ${name}Traits {
+            using state_id = ${name}State;
+            using event_id = ${name}Event;
+            static constexpr std::size_t state_count = ${ctx.statemachine.states.length};
+            static constexpr std::size_t event_count = ${ctx.statemachine.events.length};
+            static constexpr std::string_view machine_name = "${name}";
+            static constexpr std::uint64_t fingerprint = ${fingerprintLiteral(ctx.statemachine)};
+            static constexpr std::size_t queue_capacity = ${queueCapacity(ctx)};
+            static constexpr statemachine_queue::queue_overflow queue_policy = ${queueOverflowLiteral(ctx)};
+            static constexpr std::string_view state_names[state_count] = {
+                ${join(ctx.statemachine.states, state => `"${stateDisplayName(state)}"`, { separator: ',', appendNewLineIfNotEmpty: true })}
+            };
+            ${ctx.statemachine.events.length > 0 ? toNode`
+                static constexpr std::string_view event_names[event_count] = {
+                    ${join(ctx.statemachine.events, event => `"${event.name}"`, { separator: ',', appendNewLineIfNotEmpty: true })}
+                };
+            ` : undefined}
+
+            static bool find_event(std::string_view name, event_id &event) {
+                const int slot = find_event_slot(name);
+                if (slot < 0) {
+                    return false;
+                }
+                event = event_slot_values[slot];
+                return true;
+            }
+        };
+
+        class ${name} : public statemachine_runtime::machine<${name}, ${name}Traits> {
+        public:
+            ${ctx.layout === 'packed' ? generatePackedAttributes(ctx, env) : joinWithExtraNL(ctx.statemachine.attributes, attribute => toNode`
+                ${generateAttributeDeclaration(attribute, env)}
+            `)}
+            ${name}()${generateMemberInitializers(ctx, env, [`machine(state_id::${ctx.statemachine.init.$refText})`])} {}
+        };
+
+        namespace statemachine_runtime {
+        ${joinWithExtraNL(ctx.statemachine.states, state => generateCrtpStateSpecializations(ctx, state, env))}
+        } // namespace statemachine_runtime
+
+        int main(int argc, char **argv) {
+            std::ios::sync_with_stdio(false);
+            ${generateLogOpen(ctx, `${name}Traits::fingerprint`)}
+            ${name} statemachine;
+            ${usesCoroutineTimeouts(ctx) ? 'statemachine_input::before_stdin_read = statemachine_timer::run_timers_until_input;' : undefined}
+            const int status = statemachine.run(argc, argv);
+            ${usesCoroutineTimeouts(ctx) ? 'statemachine_timer::scheduler::instance().run_until_idle();' : undefined}
+            ${generateLogClose(ctx)}
+            return status;
+        }
+    `;
+}
+
+function generateCrtpStateSpecializations(ctx: GeneratorContext, state: State, env: StatemachineEnv): Generated {
+    checkSingleTransitionPerEvent(state, 'crtp');
+    return toNode`
+        // ${state.name}
+        ${joinWithExtraNL(state.transitions, transition => generateCrtpTransition(ctx, state, transition, env))}
+    `;
+}
+
+function generateCrtpTransition(ctx: GeneratorContext, state: State, transition: Transition, env: StatemachineEnv): Generated {
+    const name = ctx.statemachine.name;
+    const code = planTransition(transition, env, ctx, 'statemachine->', 'guard');
+    const guardBody = `${generateGuardLocals(code)}
+        return ${code.condition ?? 'true'};`;
+    if (suspendsOnTimeout(ctx, transition)) {
+        return `
+template <>
+struct transition<${name}Traits::state_id::${state.name}, ${name}Traits::event_id::${transition.event.$refText}> {
+    static constexpr bool defined = true;
+    static constexpr bool suspends = true;
+    static constexpr ${name}Traits::state_id target = ${name}Traits::state_id::${transition.state.$refText};
+
+    static bool guard([[maybe_unused]] ${name} *statemachine) {${guardBody}
+    }
+
+    static statemachine_timer::task action(${name} *statemachine) {
+${generateActions(transition, env, ctx)}
+        statemachine->complete_transition(target);
+    }
+};
+`;
+    }
+    return `
+template <>
+struct transition<${name}Traits::state_id::${state.name}, ${name}Traits::event_id::${transition.event.$refText}> {
+    static constexpr bool defined = true;
+    static constexpr ${name}Traits::state_id target = ${name}Traits::state_id::${transition.state.$refText};
+
+    static bool guard([[maybe_unused]] ${name} *statemachine) {${guardBody}
+    }
+
+    static void action([[maybe_unused]] ${name} *statemachine) {
+${generateActions(transition, env, ctx)}
+    }
+};
+`;
+}
@@ -0,0 +1,356 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+import { type Generated, expandToNode as toNode, joinToNode as join, toString } from 'langium/generate';
+import { isStringLiteral, type State, type Transition } from '../language-server/generated/ast.js';
+import type { StatemachineEnv } from './interpreter.js';
+import { type GeneratorContext, generateEventLookup, idType, joinWithExtraNL, generateAttributeDeclaration, generatePackedAttributes, generateMemberInitializers, generateFixedWidthHelpers, cppType, planTransition, generateGuardLocals, generateActions, generateActionLines, printCapacity, literalBytes, generatePrintBuffer, usesPrints, packedLayout } from './generator-util.js';
+import { generateAlternatives, groupTransitionsByEvent } from './guard-dispatch.js';
+import { libraryFileNames, libraryNamespace } from './generator-library.js';
+import { packedAttributesSize } from './attribute-layout.js';
+import { FIXED_WIDTH_TYPES } from './interpret-util.js';
+import { prunedContext } from './reachability.js';
+import { minimizedContext, stateDisplayName, stateEnumerators } from './state-minimization.js';
+
+export interface FreestandingFiles {
+    header: Generated;
+    source: Generated;
+}
+
+/* Freestanding profile: a plain Machine class for firmware. It compiles with -ffreestanding -fno-exceptions -fno-rtti, only
+   includes <cstddef> and <cstdint>, never allocates, and reaches the outside world through the function pointers of Hooks */
+export function generateFreestandingContent(ctx: GeneratorContext, env: StatemachineEnv): FreestandingFiles {
+    if (ctx.log === 'binary') {
+        throw new Error('The freestanding profile has no binary log; observe the machine through its print and transition hooks');
+    }
+    ctx = minimizedContext(prunedContext(ctx));
+    return {
+        header: generateFreestandingHeader(ctx, env),
+        source: generateFreestandingSource(ctx),
+    };
+}
+
+function usesDelays(ctx: GeneratorContext): boolean {
+    return ctx.statemachine.states.some(state => state.transitions.some(transition => transition.actions.some(action => action.setTimeout !== undefined)));
+}
+
+function generateFreestandingHeader(ctx: GeneratorContext, env: StatemachineEnv): Generated {
+    const namespace = libraryNamespace(ctx);
+    const guard = `${namespace.toUpperCase()}_HPP`;
+    const commands = ctx.statemachine.commands;
+    const prints = usesPrints(ctx.statemachine);
+    // Declaring the attributes first puts them into env, which the transitions' expressions are checked against
+    const attributes = ctx.layout === 'packed' ? generatePackedAttributes(ctx, env, true) : joinWithExtraNL(ctx.statemachine.attributes, attribute => generateAttributeDeclaration(attribute, env, true));
+    return toNode`
+        #ifndef ${guard}
+        #define ${guard}
+
+        // Freestanding build of the ${ctx.statemachine.name} statemachine: no iostream, exceptions, RTTI
+        // or heap. A Machine lives in static storage and only talks to the firmware through Hooks.
+
+        #include <cstddef>
+        #include <cstdint>
+
+        namespace ${namespace} {
+
+        ${generateFixedWidthHelpers(ctx)}
+        enum class State : ${idType(ctx.statemachine.states.length)} {
+            ${join(stateEnumerators(ctx.statemachine), { separator: ',', appendNewLineIfNotEmpty: true })}
+        };
+
+        enum class Event : ${idType(ctx.statemachine.events.length)} {
+            ${join(ctx.statemachine.events, event => event.name, { separator: ',', appendNewLineIfNotEmpty: true })}
+        };
+        ${commands.length > 0 ? toNode`
+
+            enum class Command : ${idType(commands.length)} {
+                ${join(commands, command => command.name, { separator: ',', appendNewLineIfNotEmpty: true })}
+            };
+        ` : undefined}
+
+        constexpr std::size_t state_count = ${ctx.statemachine.states.length};
+        constexpr std::size_t event_count = ${ctx.statemachine.events.length};
+
+        enum class Result : std::uint8_t {
+            transitioned, // the machine is in the target state of the transition
+            rejected,     // the guard of the transition did not hold
+            impossible    // the current state has no transition for the event
+        };
+
+        // Model names of states${commands.length > 0 ? ', events and commands' : ' and events'}, as NUL-terminated strings in ROM.
+        const char *state_name(State state);
+        const char *event_name(Event event);
+        ${commands.length > 0 ? 'const char *command_name(Command command);' : undefined}
+
+        // Looks up an event by the length characters at name; returns false if the model has no such event.
+        bool find_event(const char *name, std::size_t length, Event &event);
+
+        // Provided by the firmware; a null hook skips its output.
+        struct Hooks {
+            ${prints ? 'void (*print)(const char *text, std::size_t length);' : undefined}
+            ${commands.length > 0 ? 'void (*command)(Command command);' : undefined}
+            void (*transition)(State from, State to);
+            ${usesDelays(ctx) ? 'void (*delay_ms)(std::uint32_t milliseconds);' : undefined}
+        };
+        ${prints ? toNode`
+
+            namespace detail {
+
+            ${generatePrintBuffer()}
+
+            } // namespace detail
+        ` : undefined}
+
+        class Machine {
+        public:
+            // constexpr, so a Machine in static storage is initialized without startup code.
+            constexpr explicit Machine(Hooks hooks)${generateMemberInitializers(ctx, env, ['hooks(hooks)'])} {}
+
+            ${generateFreestandingDispatch(ctx)}
+
+            State current_state() const {
+                return state;
+            }
+            ${joinWithExtraNL(ctx.statemachine.attributes, attribute => toNode`
+
+                ${cppType(attribute.type)} get_${attribute.name}() const {
+                    return ${attribute.name};
+                }
+
+                void set_${attribute.name}(${cppType(attribute.type)} value) {
+                    ${attribute.name} = value;
+                }
+            `)}
+
+        private:
+            void change_state(State target) {
+                const State from = state;
+                state = target;
+                if (hooks.transition) {
+                    hooks.transition(from, target);
+                }
+            }
+
+            ${joinWithExtraNL(ctx.statemachine.states, state => generateFreestandingStateTransitions(ctx, state, env))}
+            Hooks hooks;
+            ${attributes}
+            State state = State::${ctx.statemachine.init.$refText};
+        };
+
+        } // namespace ${namespace}
+
+        #endif // ${guard}
+
+    `;
+}
+
+/* The name tables and the event lookup; a constexpr name view stands in for std::string_view, which is not freestanding */
+function generateFreestandingSource(ctx: GeneratorContext): Generated {
+    const namespace = libraryNamespace(ctx);
+    const { events, commands } = ctx.statemachine;
+    return toNode`
+        #include "${libraryFileNames(ctx).header}"
+
+        namespace ${namespace} {
+
+        namespace {
+
+        struct name {
+            const char *data;
+            std::size_t size;
+
+            template <std::size_t Size>
+            constexpr name(const char (&text)[Size]) : data(text), size(Size - 1) {}
+
+            constexpr name(const char *data, std::size_t size) : data(data), size(size) {}
+
+            constexpr const char *begin() const {
+                return data;
+            }
+
+            constexpr const char *end() const {
+                return data + size;
+            }
+
+            constexpr bool operator==(const name &other) const {
+                if (size != other.size) {
+                    return false;
+                }
+                for (std::size_t i = 0; i < size; ++i) {
+                    if (data[i] != other.data[i]) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        };
+
+        constexpr const char *state_names[state_count] = {
+            ${join(ctx.statemachine.states, state => `"${stateDisplayName(state)}"`, { separator: ',', appendNewLineIfNotEmpty: true })}
+        };
+        ${events.length > 0 ? toNode`
+
+            constexpr const char *event_names[event_count] = {
+                ${join(events, event => `"${event.name}"`, { separator: ',', appendNewLineIfNotEmpty: true })}
+            };
+        ` : undefined}
+        ${commands.length > 0 ? toNode`
+
+            constexpr const char *command_names[] = {
+                ${join(commands, command => `"${command.name}"`, { separator: ',', appendNewLineIfNotEmpty: true })}
+            };
+        ` : undefined}
+
+        ${generateEventLookup(ctx, 'Event', event => `Event::${event.name}`, 'name')}
+
+        } // namespace
+
+        const char *state_name(State state) {
+            return state_names[static_cast<std::size_t>(state)];
+        }
+
+        const char *event_name(${events.length > 0 ? 'Event event' : 'Event'}) {
+            return ${events.length > 0 ? 'event_names[static_cast<std::size_t>(event)]' : '""'};
+        }
+        ${commands.length > 0 ? toNode`
+
+            const char *command_name(Command command) {
+                return command_names[static_cast<std::size_t>(command)];
+            }
+        ` : undefined}
+
+        bool find_event(const char *text, std::size_t length, ${events.length > 0 ? 'Event &event' : 'Event &'}) {
+            const int slot = find_event_slot(name(text, length));
+            ${events.length > 0 ? toNode`
+                if (slot < 0) {
+                    return false;
+                }
+                event = event_slot_values[slot];
+                return true;
+            ` : toNode`
+                return slot >= 0;
+            `}
+        }
+
+        } // namespace ${namespace}
+
+    `;
+}
+
+function transitionFunctionName(state: State, transition: Transition): string {
+    return `${state.name}_${transition.event.$refText}`;
+}
+
+function generateFreestandingStateTransitions(ctx: GeneratorContext, state: State, env: StatemachineEnv): Generated {
+    if (state.transitions.length === 0) {
+        return undefined;
+    }
+    return toNode`
+        // ${state.name}
+        ${joinWithExtraNL(groupTransitionsByEvent(state), group => group.length === 1
+            ? generateFreestandingTransition(ctx, state, group[0], env)
+            : generateFreestandingAlternatives(ctx, state, group, env))}
+    `;
+}
+
+function generateFreestandingAlternatives(ctx: GeneratorContext, state: State, group: Transition[], env: StatemachineEnv): string {
+    const body = (transition: Transition) => [...generateActionLines(transition, env, ctx), `statemachine->change_state(State::${transition.state.$refText});`, 'return Result::transitioned;'];
+    const lines = generateAlternatives(group, env, 'statemachine->', body, ['return Result::rejected;']).map(line => toString(line));
+    return `
+    static Result ${transitionFunctionName(state, group[0])}([[maybe_unused]] Machine *statemachine) {
+${lines.map(line => `        ${line}`).join('\n')}
+    }
+`;
+}
+
+function generateFreestandingTransition(ctx: GeneratorContext, state: State, transition: Transition, env: StatemachineEnv): string {
+    const code = planTransition(transition, env, ctx);
+    if (!code.fires) {
+        return `
+    static Result ${transitionFunctionName(state, transition)}([[maybe_unused]] Machine *statemachine) {
+        return Result::rejected;
+    }
+`;
+    }
+    const guard = generateGuardLocals(code) + (code.condition === undefined ? '' : `
+        if (!(${code.condition})) {
+            return Result::rejected;
+        }`);
+    return `
+    static Result ${transitionFunctionName(state, transition)}([[maybe_unused]] Machine *statemachine) {${guard}
+${generateActions(transition, env, ctx, 'statemachine->', code)}
+        statemachine->change_state(State::${transition.state.$refText});
+        return Result::transitioned;
+    }
+`;
+}
+
+function generateFreestandingDispatch(ctx: GeneratorContext): Generated {
+    return toNode`
+        Result dispatch(Event event) {
+            switch (state) {
+            ${join(ctx.statemachine.states, state => toNode`
+                case State::${state.name}:
+                    ${state.transitions.length === 0 ? 'break;' : toNode`
+                        switch (event) {
+                        ${join(groupTransitionsByEvent(state), ([transition]) => toNode`
+                            case Event::${transition.event.$refText}:
+                                return ${transitionFunctionName(state, transition)}(this);
+                        `, { appendNewLineIfNotEmpty: true })}
+                        default:
+                            break;
+                        }
+                        break;
+                    `}
+            `, { appendNewLineIfNotEmpty: true })}
+            }
+            ${ctx.statemachine.events.length === 0 ? 'static_cast<void>(event);' : undefined}
+            return Result::impossible;
+        }
+    `;
+}
+
+export interface FootprintEstimate {
+    ram: number;   // the Machine object
+    stack: number; // the largest print buffer, on top of the dispatch call chain
+    rom: number;   // name and lookup tables plus a rough size of the dispatch code
+}
+
+/* Static footprint of a freestanding machine on a 32-bit target (4-byte pointers and int). RAM and the tables are exact
+   for the usual ABIs; the code size is a rough per-transition and per-action average at -Os */
+export function estimateFootprint(ctx: GeneratorContext): FootprintEstimate {
+    ctx = minimizedContext(prunedContext(ctx));
+    const { states, events, commands, attributes } = ctx.statemachine;
+    const pointer = 4;
+    const align = (size: number, alignment: number) => Math.ceil(size / alignment) * alignment;
+    const transitions = states.flatMap(state => state.transitions);
+    const actions = transitions.flatMap(transition => transition.actions);
+
+    const hooks = [actions.some(action => action.print), commands.length > 0, true, actions.some(action => action.setTimeout)].filter(Boolean).length;
+    let ram = hooks * pointer;
+    if (ctx.layout === 'packed') {
+        ram = packedAttributesSize(packedLayout(ctx), ram);
+    } else {
+        for (const attribute of attributes) {
+            const size = attribute.type === 'bool' ? 1 : (FIXED_WIDTH_TYPES[attribute.type]?.bits ?? 32) / 8;
+            ram = align(ram, size) + size;
+        }
+    }
+    ram = align(ram + 1, pointer);
+
+    const stack = actions.reduce((largest, action) => action.print ? Math.max(largest, align(printCapacity(action.print.values) + pointer, pointer)) : largest, 0);
+
+    const strings = (names: string[]) => names.reduce((size, name) => size + name.length + 1, 0);
+    const eventNames = events.map(event => event.name);
+    const tables = strings(states.map(stateDisplayName)) + states.length * pointer
+        + strings(eventNames) + events.length * pointer
+        + strings(commands.map(command => command.name)) + commands.length * pointer
+        // perfect hash: displacements, name views of the slots and the event ids
+        + events.length * (4 + 2 * pointer + (events.length <= 256 ? 1 : 2));
+    const literals = actions.reduce((size, action) => size + (action.print?.values.reduce((length, value) => length + (isStringLiteral(value) ? literalBytes(value.value) + 1 : 0), 0) ?? 0), 0);
+    const code = 64 + states.length * 8 + transitions.length * 24 + actions.length * 16;
+    return { ram, stack, rom: tables + literals + code };
+}
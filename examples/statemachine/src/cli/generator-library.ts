@@ -0,0 +1,759 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+import { type Generated, expandToNode as toNode, joinToNode as join, toString } from 'langium/generate';
+import type { State, Transition } from '../language-server/generated/ast.js';
+import type { StatemachineEnv } from './interpreter.js';
+import { type GeneratorContext, generateEventLookup, generateEventReaderInclude, generateEventStreamFingerprint, generateTraceMacros, generateTimerIncludes, QUEUE_HEADER, queueCapacity, queueOverflowLiteral, suspendsOnTimeout, usesCoroutineTimeouts, idType, joinWithExtraNL, generateAttributeDeclaration, generatePackedAttributes, generateMemberInitializers, generateFixedWidthHelpers, cppType, planTransition, generateGuardLocals, generateActions, generateActionLines, generateAction, generatePrintBuffer, usesPrints } from './generator-util.js';
+import { generateAlternatives, groupTransitionsByEvent, reachableAlternatives } from './guard-dispatch.js';
+import { prunedContext } from './reachability.js';
+import { minimizedContext, stateDisplayName, stateEnumerators } from './state-minimization.js';
+
+export interface LibraryFiles {
+    header: Generated;
+    source: Generated;
+    driver: Generated;
+}
+
+export interface LibraryFileNames {
+    header: string;
+    source: string;
+    driver: string;
+}
+
+/* `<name>.hpp` and `<name>.cpp` make up the library; `<name>_main.cpp` is the optional stdin driver */
+export function libraryFileNames(ctx: GeneratorContext): LibraryFileNames {
+    const base = ctx.fileName?.replace(/\.cpp$/, '') ?? ctx.statemachine.name;
+    return { header: `${base}.hpp`, source: `${base}.cpp`, driver: `${base}_main.cpp` };
+}
+
+/* Namespace of a library machine: its name in snake_case, e.g. TrafficLight -> traffic_light */
+export function libraryNamespace(ctx: GeneratorContext): string {
+    return ctx.statemachine.name.replace(/([a-z0-9])([A-Z])/g, '$1_$2').toLowerCase();
+}
+
+/* Library mode: a Machine class template with dispatch(Event) in its own namespace, free of iostream; commands call the host's
+   Commands policy and other output reaches the host through hooks */
+export function generateLibraryContent(ctx: GeneratorContext, env: StatemachineEnv): LibraryFiles {
+    if (ctx.log === 'binary') {
+        throw new Error('Library mode has no binary log; observe the machine through its on_print and on_transition hooks');
+    }
+    ctx = minimizedContext(prunedContext(ctx));
+    return {
+        header: generateLibraryHeader(ctx, env),
+        source: generateLibrarySource(ctx),
+        driver: generateLibraryDriver(ctx),
+    };
+}
+
+function generateLibraryHeader(ctx: GeneratorContext, env: StatemachineEnv): Generated {
+    const namespace = libraryNamespace(ctx);
+    const guard = `${namespace.toUpperCase()}_HPP`;
+    const coroutines = usesCoroutineTimeouts(ctx);
+    const prints = usesPrints(ctx.statemachine);
+    // Declaring the attributes first puts them into env, which the transitions' expressions are checked against. Attributes
+    // without a default value are value-initialized, so get_<attribute>() is defined before the first assignment
+    const attributes = ctx.layout === 'packed' ? generatePackedAttributes(ctx, env, true) : joinWithExtraNL(ctx.statemachine.attributes, attribute => generateAttributeDeclaration(attribute, env, true));
+    const bitfieldInitializers = generateMemberInitializers(ctx, env);
+    return toNode`
+        #ifndef ${guard}
+        #define ${guard}
+
+        #include <cstddef>
+        #include <cstdint>
+        #include <optional>
+        #include <string_view>
+        #include <utility>
+        #if __has_include(<span>)
+        #include <span>
+        #endif
+        ${coroutines ? toNode`
+            #include <chrono>
+            #include <coroutine>
+            #include <exception>
+        ` : undefined}
+        ${usesBlockingTimeouts(ctx) ? toNode`
+            #include <chrono>
+            #include <thread>
+        ` : undefined}
+
+        #include "${QUEUE_HEADER}"
+
+        namespace ${namespace} {
+
+        ${generateFixedWidthHelpers(ctx)}
+        enum class State : ${idType(ctx.statemachine.states.length)} {
+            ${join(stateEnumerators(ctx.statemachine), { separator: ',', appendNewLineIfNotEmpty: true })}
+        };
+
+        enum class Event : ${idType(ctx.statemachine.events.length)} {
+            ${join(ctx.statemachine.events, event => event.name, { separator: ',', appendNewLineIfNotEmpty: true })}
+        };
+
+        constexpr std::size_t state_count = ${ctx.statemachine.states.length};
+        constexpr std::size_t event_count = ${ctx.statemachine.events.length};
+
+        enum class Result : std::uint8_t {
+            transitioned, // the machine is in the target state of the transition
+            rejected,     // the guard of the transition did not hold
+            impossible,   // the current state has no transition for the event
+            ${coroutines ? 'suspended,    // the transition waits in setTimeout until run_timers completes it' : undefined}
+            queued,       // another transition is in flight; the event is dispatched after it
+            dropped       // another transition is in flight and the event queue is full
+        };
+
+        // Outcome of Machine::dispatch_batch.
+        struct BatchResult {
+            std::size_t processed;   // events taken from the batch${coroutines ? '; fewer only if a transition suspended' : ''}
+            std::size_t rejected_at; // index of the first rejected, impossible or dropped event, or processed if there was none
+            Result rejection;        // the result of that event, else Result::transitioned
+        };
+
+        std::string_view state_name(State state);
+        std::string_view event_name(Event event);
+
+        // Looks up an event by its name in the model.
+        std::optional<Event> find_event(std::string_view name);
+
+        // Default Commands policy: every command of the model is a no-op. A host policy derives
+        // from it and hides the commands it implements; the others still compile to nothing.
+        struct NoCommands {
+            ${join(ctx.statemachine.commands, command => `void ${command.name}() {}`, { appendNewLineIfNotEmpty: true })}
+        };
+        ${coroutines || prints ? toNode`
+
+            namespace detail {
+            ${prints ? toNode`
+
+                ${generatePrintBuffer()}
+            ` : undefined}
+            ${coroutines ? toNode`
+
+                // Fire-and-forget coroutine of a transition body; it starts eagerly and its frame
+                // is freed when the body returns.
+                struct task {
+                    struct promise_type {
+                        task get_return_object() noexcept {
+                            return {};
+                        }
+
+                        std::suspend_never initial_suspend() noexcept {
+                            return {};
+                        }
+
+                        std::suspend_never final_suspend() noexcept {
+                            return {};
+                        }
+
+                        void return_void() noexcept {}
+
+                        void unhandled_exception() noexcept {
+                            std::terminate();
+                        }
+                    };
+                };
+            ` : undefined}
+
+            } // namespace detail
+        ` : undefined}
+
+        // Command actions call the members of Commands directly, so they inline into dispatch.
+        template <typename Commands = NoCommands>
+        class Machine {
+        public:
+            Commands commands;
+            // Hooks are optional; an unset hook costs a single branch. They are plain function
+            // pointers, so calling them never allocates, and hook_context is passed to them unchanged.
+            void *hook_context = nullptr;
+            void (*on_transition)(void *context, State from, State to) = nullptr;
+            // The text is formatted into a stack buffer and only valid during the call.
+            void (*on_print)(void *context, std::string_view text) = nullptr;
+            // Events dispatched while a transition is in flight, such as those a hook or command
+            // dispatches, are queued, and dispatch returns Result::queued. Their own result is passed
+            // to on_queued_result once they are dispatched.
+            void (*on_queued_result)(void *context, Event event, Result result) = nullptr;
+
+            ${bitfieldInitializers ? `Machine()${bitfieldInitializers} {}` : 'Machine() = default;'}
+
+            explicit Machine(Commands commands)${generateMemberInitializers(ctx, env, ['commands(std::move(commands))'])} {}
+            ${coroutines ? toNode`
+
+                Machine(const Machine &) = delete;
+                Machine &operator=(const Machine &) = delete;
+
+                ~Machine() {
+                    if (waiting) {
+                        waiting.destroy();
+                    }
+                }
+            ` : undefined}
+
+            ${generateLibraryDispatch(ctx)}
+
+            ${generateLibraryBatchDispatch(ctx, env)}
+            #ifdef __cpp_lib_span
+
+            BatchResult dispatch_batch(std::span<const Event> events) {
+                return dispatch_batch(events.data(), events.size());
+            }
+            #endif
+
+            State current_state() const {
+                return state;
+            }
+            ${coroutines ? toNode`
+
+                // Completes the suspended transition once its delay has elapsed and dispatches the
+                // events queued meanwhile; returns whether a transition is still suspended.
+                bool run_timers() {
+                    if (waiting && std::chrono::steady_clock::now() >= deadline) {
+                        const std::coroutine_handle<> handle = waiting;
+                        waiting = nullptr;
+                        dispatching = true;
+                        handle.resume();
+                        dispatching = false;
+                        dispatch_pending();
+                    }
+                    return static_cast<bool>(waiting);
+                }
+
+                bool suspended() const {
+                    return static_cast<bool>(waiting);
+                }
+
+                // When the suspended transition is due to continue.
+                std::chrono::steady_clock::time_point next_deadline() const {
+                    return deadline;
+                }
+            ` : undefined}
+            ${joinWithExtraNL(ctx.statemachine.attributes, attribute => toNode`
+
+                ${cppType(attribute.type)} get_${attribute.name}() const {
+                    return ${attribute.name};
+                }
+
+                void set_${attribute.name}(${cppType(attribute.type)} value) {
+                    ${attribute.name} = value;
+                }
+            `)}
+
+        private:
+            ${coroutines ? toNode`
+                // Awaitable of setTimeout: parks the transition on its machine until run_timers resumes it.
+                struct delay {
+                    Machine *machine;
+                    std::chrono::milliseconds duration;
+
+                    bool await_ready() const noexcept {
+                        return false;
+                    }
+
+                    void await_suspend(std::coroutine_handle<> handle) const {
+                        machine->waiting = handle;
+                        machine->deadline = std::chrono::steady_clock::now() + duration;
+                    }
+
+                    void await_resume() const noexcept {}
+                };
+
+            ` : undefined}
+            void change_state(State target) {
+                const State from = state;
+                state = target;
+                if (on_transition) {
+                    on_transition(hook_context, from, target);
+                }
+            }
+
+            ${generateTakeTransition(ctx)}
+
+            // Dispatches the queued events in arrival order${coroutines ? ' until a transition suspends' : ''}.
+            void dispatch_pending() {
+                while (${coroutines ? '!waiting && ' : ''}!pending.empty()) {
+                    const Event event = pending.pop();
+                    dispatching = true;
+                    const Result result = take_transition(event);
+                    dispatching = false;
+                    if (on_queued_result) {
+                        on_queued_result(hook_context, event, result);
+                    }
+                }
+            }
+
+            ${joinWithExtraNL(ctx.statemachine.states, state => generateLibraryStateTransitions(ctx, state, env))}
+            State state = State::${ctx.statemachine.init.$refText};
+            bool dispatching = false;
+            ${attributes}
+            ${coroutines ? toNode`
+                std::coroutine_handle<> waiting;
+                std::chrono::steady_clock::time_point deadline;
+            ` : undefined}
+            statemachine_queue::event_queue<Event, ${queueCapacity(ctx)}, ${queueOverflowLiteral(ctx)}> pending;
+        };
+
+        } // namespace ${namespace}
+
+        #endif // ${guard}
+
+    `;
+}
+
+/* The source only holds the name tables; everything the Commands policy can reach lives in the header */
+function generateLibrarySource(ctx: GeneratorContext): Generated {
+    const namespace = libraryNamespace(ctx);
+    const events = ctx.statemachine.events;
+    return toNode`
+        #include "${libraryFileNames(ctx).header}"
+
+        namespace ${namespace} {
+
+        namespace {
+
+        constexpr std::string_view state_names[state_count] = {
+            ${join(ctx.statemachine.states, state => `"${stateDisplayName(state)}"`, { separator: ',', appendNewLineIfNotEmpty: true })}
+        };
+        ${events.length > 0 ? toNode`
+
+            constexpr std::string_view event_names[event_count] = {
+                ${join(events, event => `"${event.name}"`, { separator: ',', appendNewLineIfNotEmpty: true })}
+            };
+        ` : undefined}
+
+        ${generateEventLookup(ctx, 'Event', event => `Event::${event.name}`)}
+
+        } // namespace
+
+        std::string_view state_name(State state) {
+            return state_names[static_cast<std::size_t>(state)];
+        }
+
+        std::string_view event_name(${events.length > 0 ? 'Event event' : 'Event'}) {
+            return ${events.length > 0 ? 'event_names[static_cast<std::size_t>(event)]' : '{}'};
+        }
+
+        std::optional<Event> find_event(std::string_view name) {
+            ${events.length > 0 ? toNode`
+                const int slot = find_event_slot(name);
+                if (slot < 0) {
+                    return std::nullopt;
+                }
+                return event_slot_values[slot];
+            ` : toNode`
+                static_cast<void>(find_event_slot(name));
+                return std::nullopt;
+            `}
+        }
+
+        } // namespace ${namespace}
+
+    `;
+}
+
+function usesBlockingTimeouts(ctx: GeneratorContext): boolean {
+    return ctx.timeouts === 'blocking' && ctx.statemachine.states.some(state => state.transitions.some(transition => transition.actions.some(action => action.setTimeout !== undefined)));
+}
+
+function transitionFunctionName(state: State, transition: Transition): string {
+    return `${state.name}_${transition.event.$refText}`;
+}
+
+function generateLibraryStateTransitions(ctx: GeneratorContext, state: State, env: StatemachineEnv): Generated {
+    if (state.transitions.length === 0) {
+        return undefined;
+    }
+    return toNode`
+        // ${state.name}
+        ${joinWithExtraNL(groupTransitionsByEvent(state), group => group.length === 1
+            ? generateLibraryTransition(ctx, state, group[0], env)
+            : generateLibraryAlternatives(ctx, state, group, env))}
+    `;
+}
+
+/* One function for all alternatives of an event; a suspending alternative runs in its own coroutine */
+function generateLibraryAlternatives(ctx: GeneratorContext, state: State, group: Transition[], env: StatemachineEnv): string {
+    const functionName = transitionFunctionName(state, group[0]);
+    const coroutineName = (transition: Transition) => `${functionName}_${group.indexOf(transition)}_run`;
+    const coroutines = reachableAlternatives(group).filter(transition => suspendsOnTimeout(ctx, transition)).map(transition => `
+    static detail::task ${coroutineName(transition)}(Machine *statemachine) {
+${generateActions(transition, env, ctx)}
+        statemachine->change_state(State::${transition.state.$refText});
+    }
+`);
+    const body = (transition: Transition) => suspendsOnTimeout(ctx, transition)
+        ? [`${coroutineName(transition)}(statemachine);`, 'return statemachine->waiting ? Result::suspended : Result::transitioned;']
+        : [...generateActionLines(transition, env, ctx), `statemachine->change_state(State::${transition.state.$refText});`, 'return Result::transitioned;'];
+    const lines = generateAlternatives(group, env, 'statemachine->', body, ['return Result::rejected;']).map(line => toString(line));
+    return `${coroutines.join('')}
+    static Result ${functionName}([[maybe_unused]] Machine *statemachine) {
+${lines.map(line => `        ${line}`).join('\n')}
+    }
+`;
+}
+
+function generateLibraryTransition(ctx: GeneratorContext, state: State, transition: Transition, env: StatemachineEnv): string {
+    const suspends = suspendsOnTimeout(ctx, transition);
+    const code = planTransition(transition, env, ctx, 'statemachine->', suspends ? 'guard' : 'both');
+    const functionName = transitionFunctionName(state, transition);
+    if (!code.fires) {
+        return `
+    static Result ${functionName}([[maybe_unused]] Machine *statemachine) {
+        return Result::rejected;
+    }
+`;
+    }
+    const guard = generateGuardLocals(code) + (code.condition === undefined ? '' : `
+        if (!(${code.condition})) {
+            return Result::rejected;
+        }`);
+    if (suspends) {
+        return `
+    static detail::task ${functionName}_run(Machine *statemachine) {
+${generateActions(transition, env, ctx)}
+        statemachine->change_state(State::${transition.state.$refText});
+    }
+
+    static Result ${functionName}(Machine *statemachine) {${guard}
+        ${functionName}_run(statemachine);
+        return statemachine->waiting ? Result::suspended : Result::transitioned;
+    }
+`;
+    }
+    return `
+    static Result ${functionName}([[maybe_unused]] Machine *statemachine) {${guard}
+${generateActions(transition, env, ctx, 'statemachine->', code)}
+        statemachine->change_state(State::${transition.state.$refText});
+        return Result::transitioned;
+    }
+`;
+}
+
+/* While this holds, a transition is in flight and dispatched events are queued */
+function inFlight(ctx: GeneratorContext): string {
+    return usesCoroutineTimeouts(ctx) ? 'dispatching || waiting' : 'dispatching';
+}
+
+function generateLibraryDispatch(ctx: GeneratorContext): Generated {
+    const busy = inFlight(ctx);
+    return toNode`
+        Result dispatch(Event event) {
+            if (${busy}) {
+                return pending.push(event) ? Result::queued : Result::dropped;
+            }
+            dispatching = true;
+            const Result result = take_transition(event);
+            dispatching = false;
+            dispatch_pending();
+            return result;
+        }
+    `;
+}
+
+/* The switch over the state and the event behind dispatch */
+function generateTakeTransition(ctx: GeneratorContext): Generated {
+    return toNode`
+        Result take_transition(Event event) {
+            switch (state) {
+            ${join(ctx.statemachine.states, state => toNode`
+                case State::${state.name}:
+                    ${state.transitions.length === 0 ? 'break;' : toNode`
+                        switch (event) {
+                        ${join(groupTransitionsByEvent(state), ([transition]) => toNode`
+                            case Event::${transition.event.$refText}:
+                                return ${transitionFunctionName(state, transition)}(this);
+                        `, { appendNewLineIfNotEmpty: true })}
+                        default:
+                            break;
+                        }
+                        break;
+                    `}
+            `, { appendNewLineIfNotEmpty: true })}
+            }
+            ${ctx.statemachine.events.length === 0 ? 'static_cast<void>(event);' : undefined}
+            return Result::impossible;
+        }
+    `;
+}
+
+/* Batch entry point: the same transitions as dispatch, inlined into one loop over the events with the state and the
+   attributes in locals. They are stored back when the batch ends, around a transition that may suspend and around every
+   hook and command, which run host code that may read or set the attributes */
+function generateLibraryBatchDispatch(ctx: GeneratorContext, env: StatemachineEnv): Generated {
+    const coroutines = usesCoroutineTimeouts(ctx);
+    const attributes = ctx.statemachine.attributes;
+    const storeBack = toNode`
+        state = current;
+        ${join(attributes, attribute => `${attribute.name} = ${BATCH_LOCAL_PREFIX}${attribute.name};`, { appendNewLineIfNotEmpty: true })}
+    `;
+    const reload = toNode`
+        current = state;
+        ${join(attributes, attribute => `${BATCH_LOCAL_PREFIX}${attribute.name} = ${attribute.name};`, { appendNewLineIfNotEmpty: true })}
+    `;
+    return toNode`
+        // Same as calling dispatch for every event, but the state and the attributes stay in locals
+        // between the hooks and commands; before each of them they are stored back, and after it
+        // reloaded, so host code sees and changes the machine as it would during dispatch.
+        BatchResult dispatch_batch(const Event *events, std::size_t size) {
+            if (${inFlight(ctx)}) {
+                BatchResult queued{size, size, Result::transitioned};
+                for (std::size_t i = 0; i < size; ++i) {
+                    if (!pending.push(events[i]) && queued.rejection == Result::transitioned) {
+                        queued.rejected_at = i;
+                        queued.rejection = Result::dropped;
+                    }
+                }
+                return queued;
+            }
+            dispatching = true;
+            [[maybe_unused]] Machine *const statemachine = this;
+            State current = state;
+            ${join(attributes, attribute => `${cppType(attribute.type)} ${BATCH_LOCAL_PREFIX}${attribute.name} = ${attribute.name};`, { appendNewLineIfNotEmpty: true })}
+            BatchResult result{size, size, Result::transitioned};
+            for (std::size_t i = 0; i < size; ++i) {
+                Result outcome = Result::impossible;
+                switch (current) {
+                ${join(ctx.statemachine.states, state => toNode`
+                    case State::${state.name}:
+                        ${state.transitions.length === 0 ? 'break;' : toNode`
+                            switch (events[i]) {
+                            ${join(groupTransitionsByEvent(state), group => toNode`
+                                case Event::${group[0].event.$refText}:
+                                    ${generateBatchTransition(ctx, state, group, env, storeBack, reload)}
+                            `, { appendNewLineIfNotEmpty: true })}
+                            default:
+                                break;
+                            }
+                            break;
+                        `}
+                `, { appendNewLineIfNotEmpty: true })}
+                }
+                if ((outcome == Result::rejected || outcome == Result::impossible) && result.rejection == Result::transitioned) {
+                    result.rejected_at = i;
+                    result.rejection = outcome;
+                }
+                ${coroutines ? toNode`
+                    if (outcome == Result::suspended) {
+                        result.processed = i + 1;
+                        break;
+                    }
+                ` : undefined}
+                // Events the hooks and commands dispatched follow the one that raised them, as with dispatch
+                if (!pending.empty()) {
+                    ${storeBack}
+                    dispatching = false;
+                    dispatch_pending();
+                    dispatching = true;
+                    ${reload}
+                    ${coroutines ? toNode`
+                        if (waiting) {
+                            result.processed = i + 1;
+                            break;
+                        }
+                    ` : undefined}
+                }
+            }
+            ${storeBack}
+            dispatching = false;
+            return result;
+        }
+    `;
+}
+
+const BATCH_LOCAL_PREFIX = 'local_';
+
+function generateBatchTransition(ctx: GeneratorContext, state: State, group: Transition[], env: StatemachineEnv, storeBack: Generated, reload: Generated): Generated {
+    if (reachableAlternatives(group).some(transition => suspendsOnTimeout(ctx, transition))) {
+        // The coroutine works on the members, so they are synchronised around it
+        return toNode`
+            ${storeBack}
+            outcome = ${transitionFunctionName(state, group[0])}(this);
+            ${reload}
+            break;
+        `;
+    }
+    if (group.length === 1) {
+        const code = planTransition(group[0], env, ctx, BATCH_LOCAL_PREFIX);
+        if (!code.fires) {
+            return toNode`
+                outcome = Result::rejected;
+                break;
+            `;
+        }
+        const guard = code.condition === undefined ? [] : [`if (!(${code.condition})) {`, '    outcome = Result::rejected;', '    break;', '}'];
+        const target = `State::${group[0].state.$refText}`;
+        const lines = [...code.guardLocals, ...guard, ...generateBatchActionLines(ctx, group[0], env, code), ...generateBatchTransitionHook(ctx, target)];
+        const hasLocals = code.guardLocals.length > 0 || [...code.actionLocals.values()].some(locals => locals.length > 0);
+        const transition = toNode`
+            ${join(lines, line => line, { appendNewLineIfNotEmpty: true })}
+            current = ${target};
+            outcome = Result::transitioned;
+        `;
+        // Locals are braced, as later case labels must not jump over them
+        return hasLocals ? toNode`
+            {
+                ${transition}
+            }
+            break;
+        ` : toNode`
+            ${transition}
+            break;
+        `;
+    }
+    const body = (transition: Transition) => [
+        ...generateBatchActionLines(ctx, transition, env),
+        ...generateBatchTransitionHook(ctx, `State::${transition.state.$refText}`),
+        `current = State::${transition.state.$refText};`,
+        'outcome = Result::transitioned;'
+    ];
+    const lines = generateAlternatives(group, env, BATCH_LOCAL_PREFIX, body, ['outcome = Result::rejected;']);
+    // Braced, as a decision tree declares a local that later case labels must not jump over
+    return toNode`
+        {
+            ${join(lines, line => line, { appendNewLineIfNotEmpty: true })}
+        }
+        break;
+    `;
+}
+
+/* Stores the batch's locals into the members before host code runs, and reloads them after it */
+function syncBatchLocals(ctx: GeneratorContext, state: string, lines: string[]): string[] {
+    const attributes = ctx.statemachine.attributes;
+    return [
+        `state = ${state};`,
+        ...attributes.map(attribute => `${attribute.name} = ${BATCH_LOCAL_PREFIX}${attribute.name};`),
+        ...lines,
+        ...attributes.map(attribute => `${BATCH_LOCAL_PREFIX}${attribute.name} = ${attribute.name};`)
+    ];
+}
+
+/* generateActionLines on the batch's locals, with prints and commands between syncBatchLocals */
+function generateBatchActionLines(ctx: GeneratorContext, transition: Transition, env: StatemachineEnv, code = planTransition(transition, env, ctx, BATCH_LOCAL_PREFIX, 'actions')): string[] {
+    return transition.actions.flatMap(action => {
+        const lines = [...(code.actionLocals.get(action) ?? []), ...generateAction(action, env, ctx, BATCH_LOCAL_PREFIX, code).split('\n')]
+            .filter(line => line.trim().length > 0)
+            .map(line => line.replace(/^ {12}/, ''));
+        return action.print !== undefined || action.command !== undefined ? syncBatchLocals(ctx, 'current', lines) : lines;
+    });
+}
+
+/* on_transition runs after the state changed, as in change_state */
+function generateBatchTransitionHook(ctx: GeneratorContext, target: string): string[] {
+    return [
+        'if (on_transition) {',
+        ...syncBatchLocals(ctx, target, [`on_transition(hook_context, current, ${target});`]).map(line => `    ${line}`),
+        '}'
+    ];
+}
+
+/* Optional `<name>_main.cpp`: the stdin/file loop of the standalone program on top of the library API */
+function generateLibraryDriver(ctx: GeneratorContext): Generated {
+    const namespace = libraryNamespace(ctx);
+    const coroutines = usesCoroutineTimeouts(ctx);
+    return toNode`
+        #include "${libraryFileNames(ctx).header}"
+
+        #include <cstddef>
+        #include <cstdint>
+        #include <iostream>
+        #include <string>
+        #include <string_view>
+        #include <chrono>
+        #include <thread>
+        ${generateEventReaderInclude()}
+        ${generateTraceMacros(ctx)}
+        ${generateTimerIncludes(ctx)}
+
+        ${generateEventStreamFingerprint(ctx)}
+
+        ${ctx.statemachine.commands.length > 0 ? toNode`
+            // Commands policy of the driver: reports every command like the standalone program.
+            struct PrintCommands : ${namespace}::NoCommands {
+                ${joinWithExtraNL(ctx.statemachine.commands, command => toNode`
+                    void ${command.name}() {
+                        std::cout << "Run Command: ${command.name}()" << '\\n';
+                    }
+                `)}
+            };
+
+        ` : undefined}
+        static ${namespace}::Machine<${ctx.statemachine.commands.length > 0 ? 'PrintCommands' : ''}> machine;
+        ${coroutines ? toNode`
+
+            // Installed as before_stdin_read, so suspended transitions keep completing while the
+            // program waits for input.
+            static void run_timers_until_input() {
+                for (;;) {
+                    const bool waiting = machine.run_timers();
+                    std::cout.flush();
+                    if (!waiting) {
+                        return;
+                    }
+            #ifdef STATEMACHINE_POSIX_IO
+                    const auto delay = std::chrono::ceil<std::chrono::milliseconds>(machine.next_deadline() - std::chrono::steady_clock::now());
+                    pollfd input{STDIN_FILENO, POLLIN, 0};
+                    if (poll(&input, 1, static_cast<int>(std::max<std::chrono::milliseconds::rep>(delay.count(), 0))) != 0) {
+                        return;
+                    }
+            #else
+                    return;
+            #endif
+                }
+            }
+        ` : undefined}
+
+        static void report([[maybe_unused]] ${namespace}::Result result) {
+            if (result == ${namespace}::Result::rejected) {
+                SM_TRACE("Transition not allowed.");
+            } else if (result == ${namespace}::Result::impossible) {
+                SM_TRACE("Impossible event for the current state.");
+            }${(ctx.queueOverflow ?? 'reject') === 'reject' && coroutines ? toNode` else if (result == ${namespace}::Result::dropped) {
+                SM_TRACE("The event queue is full; the event is rejected.");
+            }` : ''}
+        }
+
+        int main(int argc, char **argv) {
+            std::ios::sync_with_stdio(false);
+            machine.on_transition = [](void *, [[maybe_unused]] ${namespace}::State from, [[maybe_unused]] ${namespace}::State to) {
+                SM_TRACE_TRANSITION(${namespace}::state_name(from) << " ===> " << ${namespace}::state_name(to));
+            };
+            machine.on_print = [](void *, std::string_view text) {
+                std::cout << text << '\\n';
+            };
+            ${coroutines ? toNode`
+                // Events typed while a transition was suspended are reported once they are dispatched
+                machine.on_queued_result = [](void *, ${namespace}::Event, ${namespace}::Result result) {
+                    report(result);
+                };
+            ` : undefined}
+            SM_TRACE_TRANSITION("[" << ${namespace}::state_name(machine.current_state()) << "]");
+
+            ${coroutines ? 'statemachine_input::before_stdin_read = run_timers_until_input;' : undefined}
+            const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+            int status = 0;
+            if (arguments.binary) {
+                status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, ${namespace}::event_count, [](std::size_t id, std::uint64_t) {
+                    report(machine.dispatch(static_cast<${namespace}::Event>(id)));
+                });
+            } else {
+                status = statemachine_input::read_events(arguments.path, [](std::string_view input) {
+                    const std::optional<${namespace}::Event> event = ${namespace}::find_event(input);
+                    if (!event) {
+                        SM_TRACE("There is no event <" << input << "> in the ${ctx.statemachine.name} statemachine.");
+                        return;
+                    }
+                    report(machine.dispatch(*event));
+                });
+            }
+            ${coroutines ? toNode`
+                while (machine.run_timers()) {
+                    std::cout.flush();
+                    std::this_thread::sleep_until(machine.next_deadline());
+                }
+            ` : undefined}
+            return status;
+        }
+
+    `;
+}
@@ -0,0 +1,244 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+import { type Generated, expandToNode as toNode, joinToNode as join } from 'langium/generate';
+import type { State, Transition } from '../language-server/generated/ast.js';
+import type { StatemachineEnv } from './interpreter.js';
+import { type GeneratorContext, checkSingleTransitionPerEvent, generateEventLookup, generateEventReaderInclude, generateEventStreamFingerprint, generateTraceMacros, generateLogInclude, generateLogOpen, generateLogClose, generateTimerIncludes, generateTimerScheduler, generateSuspensionMembers, suspendsOnTimeout, usesCoroutineTimeouts, idType, joinWithExtraNL, generateAttributeDeclaration, generatePackedAttributes, generateMemberInitializers, generateFixedWidthHelpers, planTransition, generateGuardLocals, generateActions } from './generator-util.js';
+import { stateDisplayName, stateEnumerators } from './state-minimization.js';
+import { guardOutcome } from './expression-ir.js';
+
+/* Table backend: dense state/event ids and a constexpr state x event transition table, so dispatch is a single indexed load */
+export function generateTableCppContent(ctx: GeneratorContext, env: StatemachineEnv): Generated {
+    const name = ctx.statemachine.name;
+    const coroutines = usesCoroutineTimeouts(ctx);
+    const traceTransition = ctx.log === 'binary'
+        ? 'SM_LOG_TRANSITION(static_cast<std::size_t>(state), static_cast<std::size_t>(target));'
+        : 'SM_TRACE_TRANSITION(state_names[static_cast<std::size_t>(state)] << " ===> " << state_names[static_cast<std::size_t>(target)]);';
+    return toNode`
+        #include <cstddef>
+        #include <cstdint>
+        #include <iostream>
+        #include <string>
+        #include <string_view>
+        #include <chrono>
+        #include <thread>
+        ${generateEventReaderInclude()}
+        ${generateTraceMacros(ctx)}
+        ${generateLogInclude(ctx)}
+        ${generateTimerIncludes(ctx)}
+
+        ${generateFixedWidthHelpers(ctx)}
+        enum class StateId : ${idType(ctx.statemachine.states.length)} {
+            ${join(stateEnumerators(ctx.statemachine), { separator: ',', appendNewLineIfNotEmpty: true })}
+        };
+
+        enum class EventId : ${idType(ctx.statemachine.events.length)} {
+            ${join(ctx.statemachine.events, event => event.name, { separator: ',', appendNewLineIfNotEmpty: true })}
+        };
+
+        constexpr std::size_t state_count = ${ctx.statemachine.states.length};
+        constexpr std::size_t event_count = ${ctx.statemachine.events.length};
+
+        constexpr std::string_view state_names[state_count] = {
+            ${join(ctx.statemachine.states, state => `"${stateDisplayName(state)}"`, { separator: ',', appendNewLineIfNotEmpty: true })}
+        };
+
+        ${generateTimerScheduler(ctx)}
+        class ${name};
+
+        struct TransitionEntry {
+            bool defined;
+            StateId target;
+            bool (*guard)(${name} *statemachine);
+            void (*action)(${name} *statemachine);
+            ${coroutines ? '// The action is a coroutine that completes the transition itself.' : undefined}
+            ${coroutines ? 'bool suspends;' : undefined}
+        };
+
+        class ${name} {
+        private:
+            StateId state;
+        public:
+            ${ctx.layout === 'packed' ? generatePackedAttributes(ctx, env) : joinWithExtraNL(ctx.statemachine.attributes, attribute => toNode`
+                ${generateAttributeDeclaration(attribute, env)}
+            `)}
+            ${name}(StateId initial_state)${generateMemberInitializers(ctx, env, ['state(initial_state)'])} {
+                ${ctx.log === 'binary' ? 'SM_LOG_STATE(static_cast<std::size_t>(state));' : 'SM_TRACE_TRANSITION("[" << state_names[static_cast<std::size_t>(state)] << "]");'}
+            }
+
+            void dispatch(EventId event);
+            ${coroutines ? 'void complete_transition(StateId target);' : undefined}
+            ${coroutines ? generateSuspensionMembers(ctx, 'EventId', event => `dispatch(${event})`) : undefined}
+        };
+
+        ${joinWithExtraNL(ctx.statemachine.states, state => generateTableStateFunctions(ctx, state, env))}
+        ${generateTableDispatch(ctx, traceTransition)}
+        ${coroutines ? toNode`
+
+            void ${name}::complete_transition(StateId target) {
+                ${traceTransition}
+                state = target;
+                resume_pending();
+            }
+        ` : undefined}
+
+        ${generateEventLookup(ctx, 'EventId', event => `EventId::${event.name}`)}
+
+        ${generateEventStreamFingerprint(ctx)}
+
+        ${generateTableMain(ctx)}
+
+    `;
+}
+
+/* The transition table and the dispatch indexing it. Without events there is nothing to index, and ISO C++ has no arrays
+   of length zero, so the table is left out and dispatch only reports the event */
+function generateTableDispatch(ctx: GeneratorContext, traceTransition: string): Generated {
+    const name = ctx.statemachine.name;
+    const coroutines = usesCoroutineTimeouts(ctx);
+    if (ctx.statemachine.events.length === 0) {
+        return toNode`
+            void ${name}::dispatch(EventId) {
+                SM_TRACE("Impossible event for the current state.");
+            }
+        `;
+    }
+    return toNode`
+        constexpr TransitionEntry transition_table[state_count][event_count] = {
+            ${join(ctx.statemachine.states, state => generateTableRow(ctx, state), { separator: ',', appendNewLineIfNotEmpty: true })}
+        };
+
+        void ${name}::dispatch(EventId event) {
+            const TransitionEntry &entry = transition_table[static_cast<std::size_t>(state)][static_cast<std::size_t>(event)];
+            if (!entry.defined) {
+                SM_TRACE("Impossible event for the current state.");
+                return;
+            }
+            if (entry.guard != nullptr && !entry.guard(this)) {
+                SM_TRACE("Transition not allowed.");
+                return;
+            }
+            ${coroutines ? toNode`
+                if (entry.suspends) {
+                    suspended = true;
+                    entry.action(this);
+                    return;
+                }
+            ` : undefined}
+            if (entry.action != nullptr) {
+                entry.action(this);
+            }
+            const StateId target = entry.target;
+            ${traceTransition}
+            state = target;
+        }
+    `;
+}
+
+function transitionFunctionName(state: State, transition: Transition): string {
+    return `${state.name}_${transition.event.$refText}`;
+}
+
+function generateTableStateFunctions(ctx: GeneratorContext, state: State, env: StatemachineEnv): Generated {
+    checkSingleTransitionPerEvent(state, 'table');
+    return toNode`
+        // ${state.name}
+        ${joinWithExtraNL(state.transitions, transition => generateTableTransitionFunctions(ctx, state, transition, env))}
+    `;
+}
+
+function generateTableTransitionFunctions(ctx: GeneratorContext, state: State, transition: Transition, env: StatemachineEnv): Generated {
+    const code = planTransition(transition, env, ctx, 'statemachine->', 'guard');
+    const functionName = transitionFunctionName(state, transition);
+    const guard = code.condition === undefined ? '' : `
+static bool ${functionName}_guard([[maybe_unused]] ${ctx.statemachine.name} *statemachine) {${generateGuardLocals(code, '    ')}
+    return ${code.condition};
+}
+`;
+    // A guard folding to false leaves the actions unreachable
+    if (!code.fires) {
+        return guard;
+    }
+    if (suspendsOnTimeout(ctx, transition)) {
+        return guard + `
+static statemachine_timer::task ${functionName}_run(${ctx.statemachine.name} *statemachine) {
+${generateActions(transition, env, ctx)}
+    statemachine->complete_transition(StateId::${transition.state.$refText});
+}
+
+static void ${functionName}_action(${ctx.statemachine.name} *statemachine) {
+    ${functionName}_run(statemachine);
+}
+`;
+    }
+    const action = transition.actions.length === 0 ? '' : `
+static void ${functionName}_action([[maybe_unused]] ${ctx.statemachine.name} *statemachine) {
+${generateActions(transition, env, ctx)}
+}
+`;
+    return guard + action;
+}
+
+function generateTableRow(ctx: GeneratorContext, state: State): Generated {
+    const coroutines = usesCoroutineTimeouts(ctx);
+    const cells = ctx.statemachine.events.map(event => {
+        const transition = state.transitions.find(t => t.event.$refText === event.name);
+        if (transition === undefined) {
+            return `{ false, StateId::${state.name}, nullptr, nullptr${coroutines ? ', false' : ''} }`;
+        }
+        const functionName = transitionFunctionName(state, transition);
+        const outcome = guardOutcome(transition);
+        const guard = outcome === true ? 'nullptr' : `&${functionName}_guard`;
+        const action = transition.actions.length === 0 || outcome === false ? 'nullptr' : `&${functionName}_action`;
+        const suspends = coroutines ? `, ${suspendsOnTimeout(ctx, transition)}` : '';
+        return `{ true, StateId::${transition.state.$refText}, ${guard}, ${action}${suspends} }`;
+    });
+    return toNode`
+        /* ${state.name} */ { ${cells.join(', ')} }
+    `;
+}
+
+function generateTableMain(ctx: GeneratorContext): Generated {
+    const coroutines = usesCoroutineTimeouts(ctx);
+    const dispatch = coroutines ? 'post' : 'dispatch';
+    return toNode`
+        int main(int argc, char **argv) {
+            std::ios::sync_with_stdio(false);
+            ${generateLogOpen(ctx, 'event_stream_fingerprint')}
+            ${ctx.statemachine.name} *statemachine = new ${ctx.statemachine.name}(StateId::${ctx.statemachine.init.$refText});
+
+            ${coroutines ? 'statemachine_input::before_stdin_read = statemachine_timer::run_timers_until_input;' : undefined}
+            const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+            int status = 0;
+            if (arguments.binary) {
+                status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, event_count, [statemachine](std::size_t id, std::uint64_t) {
+                    statemachine->${dispatch}(static_cast<EventId>(id));
+                });
+            } else {
+                ${ctx.statemachine.events.length === 0 ? toNode`
+                    status = statemachine_input::read_events(arguments.path, []([[maybe_unused]] std::string_view input) {
+                        SM_TRACE("There is no event <" << input << "> in the ${ctx.statemachine.name} statemachine.");
+                    });
+                ` : toNode`
+                    status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+                        const int slot = find_event_slot(input);
+                        if (slot < 0) {
+                            SM_TRACE("There is no event <" << input << "> in the ${ctx.statemachine.name} statemachine.");
+                            return;
+                        }
+                        statemachine->${dispatch}(event_slot_values[slot]);
+                    });
+                `}
+            }
+            ${coroutines ? 'statemachine_timer::scheduler::instance().run_until_idle();' : undefined}
+
+            delete statemachine;
+            ${generateLogClose(ctx)}
+            return status;
+        }
+    `;
+}
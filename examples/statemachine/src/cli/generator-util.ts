@@ -0,0 +1,762 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+import { type Generated, expandToNode as toNode, joinToNode as join, traceToNode } from 'langium/generate';
+import { Action, Attribute, Expression, isRef, isStringLiteral, Transition, type Event, type PrintValue, type State, type Statemachine } from '../language-server/generated/ast.js';
+import { StatemachineEnv } from './interpreter.js';
+import { coerceToAttributeType, evalExpression, FIXED_WIDTH_TYPES, integerTypeOf } from './interpret-util.js';
+import { type TransitionCode, type TransitionParts, cppType, emitExpression, lowerAssignedValue, lowerExpression, optimizeExpression, planTransitionCode } from './expression-ir.js';
+import { eventStreamFingerprint } from './event-stream.js';
+import { buildLogFormats } from './binary-log.js';
+import { DEFAULT_QUEUE_CAPACITY, type EventQueueOptions } from './event-queue.js';
+import { type AttributeLayout, type AttributeSlot, planAttributeLayout } from './attribute-layout.js';
+import { commandProbe } from './probes.js';
+
+/* Dispatch strategy of the generated C++: one class per state with virtual event methods, a constexpr transition table,
+   or specializations instantiated by the header-only CRTP runtime */
+export type CppBackend = 'virtual' | 'table' | 'crtp';
+
+/* Diagnostic output compiled into the generated C++: nothing, state changes only, or also rejected and unknown events */
+export type TraceLevel = 'none' | 'transitions' | 'all';
+
+export const TRACE_LEVELS: TraceLevel[] = ['none', 'transitions', 'all'];
+
+/* Target environment: a hosted program or library, or a freestanding build without iostream, exceptions, RTTI or heap */
+export type Profile = 'hosted' | 'freestanding';
+
+/* Where print actions and transition traces go: formatted to stdout, or deferred into the binary log of statemachine_log.hpp */
+export type LogMode = 'text' | 'binary';
+
+/* How setTimeout delays a transition: sleeping in place, or suspending a C++20 coroutine while other events are read */
+export type TimeoutMode = 'blocking' | 'coroutine';
+
+/* What is generated: a program reading events from stdin, or a namespaced library with a dispatch API and a separate driver */
+export type OutputMode = 'program' | 'library';
+
+export interface GeneratorOptions extends EventQueueOptions {
+    backend?: CppBackend;
+    trace?: TraceLevel;
+    log?: LogMode;
+    timeouts?: TimeoutMode;
+    mode?: OutputMode;
+    profile?: Profile;
+    layout?: AttributeLayout;
+    /* Leave out unreachable states and transitions that can never fire, see pruneStatemachine */
+    prune?: boolean;
+    /* Merge behaviourally equivalent states, keeping the other names as aliases, see minimizeStatemachine */
+    minimize?: boolean;
+    /* Write the virtual backend as a header, this many sources defining the states and one with main(), see generateShardedContent */
+    shards?: number;
+    /* With `shards`, also write a C++20 module interface */
+    module?: boolean;
+    /* Point the generated code back at the model with #line directives, see toStringWithLineDirectives */
+    lineDirectives?: boolean;
+    /* Compile USDT probes into the virtual backend, see generateProbeMacros */
+    probes?: boolean;
+    /* Count and time the dispatches of every (state, event) pair, see statemachine_stats.hpp */
+    stats?: boolean;
+    /* Record dispatches, prints, commands and delays for a Chrome trace, see statemachine_timeline.hpp */
+    timeline?: boolean;
+}
+
+export interface GeneratorContext extends GeneratorOptions {
+    statemachine: Statemachine;
+    fileName: string;
+    destination: string;
+}
+
+/* Smallest unsigned type able to hold the dense ids of `count` states or events */
+export function idType(count: number): string {
+    return count <= 256 ? 'std::uint8_t' : 'std::uint16_t';
+}
+
+/* Backends holding a single entry per (state, event) cannot represent alternative transitions */
+export function checkSingleTransitionPerEvent(state: State, backend: string): void {
+    const events = new Set<string>();
+    for (const transition of state.transitions) {
+        if (events.has(transition.event.$refText)) {
+            throw new Error(`State ${state.name} has more than one transition for event ${transition.event.$refText}, which the ${backend} backend does not support; use the virtual backend or library mode`);
+        }
+        events.add(transition.event.$refText);
+    }
+}
+
+export function joinWithExtraNL<T>(content: T[], toString: (e: T) => Generated): Generated {
+    return join(content, toString, { appendNewLineIfNotEmpty: true });
+}
+
+/* Seeded FNV-1a over the name with a murmur3 finalizer to mix the low bits; must stay in sync with the emitted event_hash */
+export function eventHash(seed: number, name: string): number {
+    let hash = (0x811c9dc5 ^ seed) >>> 0;
+    for (let i = 0; i < name.length; i++) {
+        hash = Math.imul(hash ^ name.charCodeAt(i), 0x01000193) >>> 0;
+    }
+    hash = Math.imul(hash ^ (hash >>> 16), 0x85ebca6b) >>> 0;
+    hash = Math.imul(hash ^ (hash >>> 13), 0xc2b2ae35) >>> 0;
+    return (hash ^ (hash >>> 16)) >>> 0;
+}
+
+export interface EventPerfectHash {
+    /* Per first-level bucket: a seed for the second hash, or -(slot + 1) for buckets holding a single name */
+    displacements: number[];
+    /* Per slot: the index of the name stored there */
+    slots: number[];
+}
+
+/* Builds a minimal perfect hash (hash and displace) over the event names, so lookup is two hashes and one final compare */
+export function buildEventPerfectHash(names: string[]): EventPerfectHash {
+    const size = names.length;
+    const buckets: number[][] = Array.from({ length: size }, () => []);
+    names.forEach((name, index) => buckets[eventHash(0, name) % size].push(index));
+    const displacements = new Array<number>(size).fill(0);
+    const slots = new Array<number>(size).fill(-1);
+    const order = buckets.map((_, bucket) => bucket).sort((a, b) => buckets[b].length - buckets[a].length);
+    for (const bucket of order.filter(b => buckets[b].length > 1)) {
+        for (let seed = 1; ; seed++) {
+            if (seed > 0x7fffffff) {
+                throw new Error('Could not build a perfect hash over the event names');
+            }
+            const positions = buckets[bucket].map(index => eventHash(seed, names[index]) % size);
+            if (positions.every((position, i) => slots[position] === -1 && positions.indexOf(position) === i)) {
+                positions.forEach((position, i) => slots[position] = buckets[bucket][i]);
+                displacements[bucket] = seed;
+                break;
+            }
+        }
+    }
+    const freeSlots = slots.map((index, slot) => index === -1 ? slot : -1).filter(slot => slot !== -1);
+    for (const bucket of order.filter(b => buckets[b].length === 1)) {
+        const slot = freeSlots.pop()!;
+        slots[slot] = buckets[bucket][0];
+        displacements[bucket] = -slot - 1;
+    }
+    return { displacements, slots };
+}
+
+/* Emits find_event_slot(std::string_view) and the slot tables; `valueOf` gives the dispatch handle stored per event.
+   `nameType` may replace std::string_view by any constexpr view of chars with begin(), end() and operator== */
+export function generateEventLookup(ctx: GeneratorContext, valueType: string, valueOf: (event: Event) => string, nameType = 'std::string_view'): Generated {
+    const events = ctx.statemachine.events;
+    if (events.length === 0) {
+        // The callers still index event_slot_values behind the failed lookup, and ISO C++ has no empty arrays
+        return toNode`
+            constexpr const ${valueType} *event_slot_values = nullptr;
+
+            inline int find_event_slot(${nameType}) {
+                return -1;
+            }
+        `;
+    }
+    const hash = buildEventPerfectHash(events.map(event => event.name));
+    return toNode`
+        constexpr std::uint32_t event_hash(std::uint32_t seed, ${nameType} name) {
+            std::uint32_t hash = 0x811c9dc5u ^ seed;
+            for (unsigned char c : name) {
+                hash = (hash ^ c) * 0x01000193u;
+            }
+            hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+            hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+            return hash ^ (hash >> 16);
+        }
+
+        constexpr std::size_t event_slot_count = ${events.length};
+        constexpr std::int32_t event_displacements[event_slot_count] = { ${hash.displacements.join(', ')} };
+        constexpr ${nameType} event_slot_names[event_slot_count] = { ${hash.slots.map(index => `"${events[index].name}"`).join(', ')} };
+        constexpr ${valueType} event_slot_values[event_slot_count] = { ${hash.slots.map(index => valueOf(events[index])).join(', ')} };
+
+        // Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+        inline int find_event_slot(${nameType} name) {
+            const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+            const std::size_t slot = displacement < 0
+                ? static_cast<std::size_t>(-displacement - 1)
+                : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+            return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+        }
+    `;
+}
+
+/* Fingerprint the generated machine expects in the header of a binary event stream, as a C++ literal */
+export function fingerprintLiteral(statemachine: Statemachine): string {
+    return `0x${eventStreamFingerprint(statemachine).toString(16).padStart(16, '0')}ull`;
+}
+
+export function generateEventStreamFingerprint(ctx: GeneratorContext): Generated {
+    return toNode`
+        constexpr std::uint64_t event_stream_fingerprint = ${fingerprintLiteral(ctx.statemachine)};
+    `;
+}
+
+/* Default of SM_TRACE_LEVEL (0 = none, 1 = transitions, 2 = all), which can still be overridden with -DSM_TRACE_LEVEL */
+export function generateTraceLevel(ctx: GeneratorContext): Generated {
+    return toNode`
+        #ifndef SM_TRACE_LEVEL
+        #define SM_TRACE_LEVEL ${TRACE_LEVELS.indexOf(ctx.trace ?? 'all')}
+        #endif
+    `;
+}
+
+/* SM_TRACE_TRANSITION and SM_TRACE print a line at the matching trace level and expand to nothing below it */
+export function generateTraceMacros(ctx: GeneratorContext): Generated {
+    return toNode`
+        ${generateTraceLevel(ctx)}
+        #if SM_TRACE_LEVEL >= 1
+        #define SM_TRACE_TRANSITION(output) (std::cout << output << '\\n')
+        #else
+        #define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+        #endif
+        #if SM_TRACE_LEVEL >= 2
+        #define SM_TRACE(output) (std::cout << output << '\\n')
+        #else
+        #define SM_TRACE(output) static_cast<void>(0)
+        #endif
+    `;
+}
+
+export const LOG_HEADER = 'statemachine_log.hpp';
+
+export const STATS_HEADER = 'statemachine_stats.hpp';
+
+export const TIMELINE_HEADER = 'statemachine_timeline.hpp';
+
+export const INPUT_HEADER = 'statemachine_input.hpp';
+
+export const QUEUE_HEADER = 'statemachine_queue.hpp';
+
+/* Includes the binary logger when it is selected; it has to follow the SM_TRACE_LEVEL default */
+export function generateLogInclude(ctx: GeneratorContext): Generated {
+    return ctx.log === 'binary' ? `#include "${LOG_HEADER}"` : undefined;
+}
+
+/* Opens the binary log before the machine logs its initial state; `fingerprint` names the C++ constant to write into its header */
+export function generateLogOpen(ctx: GeneratorContext, fingerprint: string): Generated {
+    if (ctx.log !== 'binary') {
+        return undefined;
+    }
+    return toNode`
+        if (!statemachine_log::open_log("${ctx.statemachine.name}.smlog", ${fingerprint})) {
+            std::cerr << "Cannot open the statemachine log: " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+    `;
+}
+
+export function generateLogClose(ctx: GeneratorContext): Generated {
+    return ctx.log === 'binary' ? 'statemachine_log::close_log();' : undefined;
+}
+
+/* Whether setTimeout suspends a coroutine (the default) instead of blocking the whole process in sleep_for */
+export function suspendsOnTimeout(ctx: GeneratorContext, transition: Transition): boolean {
+    return ctx.timeouts !== 'blocking' && transition.actions.some(action => action.setTimeout !== undefined);
+}
+
+export function usesCoroutineTimeouts(ctx: GeneratorContext): boolean {
+    return ctx.statemachine.states.some(state => state.transitions.some(transition => suspendsOnTimeout(ctx, transition)));
+}
+
+/* The `queue_overflow` enumerator of the configured policy */
+export function queueOverflowLiteral(ctx: GeneratorContext): string {
+    return `statemachine_queue::queue_overflow::${(ctx.queueOverflow ?? 'reject').replace('-', '_')}`;
+}
+
+export function queueCapacity(ctx: GeneratorContext): number {
+    return ctx.queueCapacity ?? DEFAULT_QUEUE_CAPACITY;
+}
+
+/* While a transition waits in setTimeout the machine is suspended: its state is still the source state, and events
+   arriving meanwhile are queued and dispatched in arrival order once the transition completes, as the interpreter does */
+export function generateSuspensionMembers(ctx: GeneratorContext, eventType: string, dispatch: (event: string) => string): Generated {
+    return toNode`
+
+        using event_handle = ${eventType};
+        bool suspended = false;
+        statemachine_queue::event_queue<event_handle, ${queueCapacity(ctx)}, ${queueOverflowLiteral(ctx)}> pending;
+
+        void post(event_handle event) {
+            if (suspended) {
+                ${(ctx.queueOverflow ?? 'reject') === 'reject' ? toNode`
+                    if (!pending.push(event)) {
+                        SM_TRACE("The event queue is full; the event is rejected.");
+                    }
+                ` : 'pending.push(event);'}
+                return;
+            }
+            ${dispatch('event')};
+        }
+
+        void resume_pending() {
+            suspended = false;
+            while (!suspended && !pending.empty()) {
+                ${dispatch('pending.pop()')};
+            }
+        }
+    `;
+}
+
+/* Headers of the timer scheduler and of the queue of events arriving meanwhile; they follow the event reader's include,
+   which defines STATEMACHINE_POSIX_IO */
+export function generateTimerIncludes(ctx: GeneratorContext): Generated {
+    if (!usesCoroutineTimeouts(ctx)) {
+        return undefined;
+    }
+    return toNode`
+        #include <algorithm>
+        #include <coroutine>
+        #include <exception>
+        #include <functional>
+        #include <queue>
+        #ifdef STATEMACHINE_POSIX_IO
+        #include <poll.h>
+        #endif
+        #include "${QUEUE_HEADER}"
+    `;
+}
+
+/* Single-threaded scheduler and awaitable behind coroutine timeouts; only emitted for machines that use setTimeout */
+export function generateTimerScheduler(ctx: GeneratorContext): Generated {
+    if (!usesCoroutineTimeouts(ctx)) {
+        return undefined;
+    }
+    return toNode`
+        namespace statemachine_timer {
+
+        using clock = std::chrono::steady_clock;
+
+        // Event loop for transitions suspended in setTimeout. Timers are kept in a min-heap
+        // and resumed in deadline order (ties in the order they were started).
+        class scheduler {
+        public:
+            static scheduler &instance() {
+                static scheduler shared;
+                return shared;
+            }
+
+            void schedule(clock::time_point deadline, std::coroutine_handle<> handle) {
+                timers.push(timer{deadline, next_sequence++, handle});
+            }
+
+            // Resumes every timer that is due and returns whether any are left.
+            bool run_due() {
+                while (!timers.empty() && timers.top().deadline <= clock::now()) {
+                    const std::coroutine_handle<> handle = timers.top().handle;
+                    timers.pop();
+                    handle.resume();
+                }
+                return !timers.empty();
+            }
+
+        #ifdef STATEMACHINE_POSIX_IO
+            // Returns once the input on fd is readable, running due timers while waiting.
+            void run_until_readable(int fd) {
+                for (;;) {
+                    const bool pending = run_due();
+                    std::cout.flush();
+                    if (!pending) {
+                        return;
+                    }
+                    const auto delay = std::chrono::ceil<std::chrono::milliseconds>(timers.top().deadline - clock::now());
+                    pollfd input{fd, POLLIN, 0};
+                    if (poll(&input, 1, static_cast<int>(std::max<std::chrono::milliseconds::rep>(delay.count(), 0))) != 0) {
+                        return;
+                    }
+                }
+            }
+        #endif
+
+            // Sleeps until every pending timer has fired.
+            void run_until_idle() {
+                while (run_due()) {
+                    std::cout.flush();
+                    std::this_thread::sleep_until(timers.top().deadline);
+                }
+            }
+
+        private:
+            struct timer {
+                clock::time_point deadline;
+                std::uint64_t sequence;
+                std::coroutine_handle<> handle;
+
+                bool operator>(const timer &other) const {
+                    return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+                }
+            };
+
+            std::priority_queue<timer, std::vector<timer>, std::greater<timer>> timers;
+            std::uint64_t next_sequence = 0;
+        };
+
+        // Awaitable of setTimeout: suspends the transition and resumes it from the scheduler.
+        struct sleep_for {
+            std::chrono::milliseconds duration;
+
+            bool await_ready() const noexcept {
+                return duration.count() <= 0;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) const {
+                scheduler::instance().schedule(clock::now() + duration, handle);
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        // Fire-and-forget coroutine of a transition body; it starts eagerly and its frame
+        // is freed when the body returns.
+        struct task {
+            struct promise_type {
+                task get_return_object() noexcept {
+                    return {};
+                }
+
+                std::suspend_never initial_suspend() noexcept {
+                    return {};
+                }
+
+                std::suspend_never final_suspend() noexcept {
+                    return {};
+                }
+
+                void return_void() noexcept {}
+
+                void unhandled_exception() noexcept {
+                    std::terminate();
+                }
+            };
+        };
+
+        // Installed as before_stdin_read, so suspended transitions keep completing while the
+        // program waits for input.
+        inline void run_timers_until_input() {
+        #ifdef STATEMACHINE_POSIX_IO
+            scheduler::instance().run_until_readable(STDIN_FILENO);
+        #else
+            scheduler::instance().run_due();
+        #endif
+        }
+
+        } // namespace statemachine_timer
+    `.appendNewLine().appendNewLine();
+}
+
+/* Includes the event reader of main(), see statemachine_input.hpp; it also defines STATEMACHINE_POSIX_IO on POSIX systems */
+export function generateEventReaderInclude(): Generated {
+    return `#include "${INPUT_HEADER}"`;
+}
+
+export { cppType };
+
+/* Whether the machine declares an attribute of a fixed-width type, and so needs the fixed_width helpers */
+export function usesFixedWidthTypes(statemachine: Statemachine): boolean {
+    return statemachine.attributes.some(attribute => attribute.type in FIXED_WIDTH_TYPES);
+}
+
+/* Wrapping arithmetic for fixed-width attributes: the operands are converted to std::uint64_t, where overflow is defined,
+   and the result is truncated back to the attribute's width. Emitted inside the machine's namespace, if it has one */
+export function generateFixedWidthHelpers(ctx: GeneratorContext): Generated {
+    if (!usesFixedWidthTypes(ctx.statemachine)) {
+        return undefined;
+    }
+    return toNode`
+        namespace fixed_width {
+            template <typename T>
+            constexpr T add(T a, T b) {
+                return static_cast<T>(static_cast<std::uint64_t>(a) + static_cast<std::uint64_t>(b));
+            }
+
+            template <typename T>
+            constexpr T sub(T a, T b) {
+                return static_cast<T>(static_cast<std::uint64_t>(a) - static_cast<std::uint64_t>(b));
+            }
+
+            template <typename T>
+            constexpr T mul(T a, T b) {
+                return static_cast<T>(static_cast<std::uint64_t>(a) * static_cast<std::uint64_t>(b));
+            }
+
+            // The smallest signed value divided by -1 overflows; it wraps around to itself, like the negation it is
+            template <typename T>
+            constexpr T div(T a, T b) {
+                return T(-1) < T(0) && b == T(-1) ? sub<T>(0, a) : static_cast<T>(a / b);
+            }
+        }
+    `;
+}
+
+/* `valueInitialize` gives attributes without a default value an initializer, as constexpr constructors require before C++20
+   and as hosts reading them before the first assignment require */
+export function generateAttributeDeclaration(attribute: Attribute, env: StatemachineEnv, valueInitialize = false): Generated {
+    // const defaultValue = getDefaultAttributeValue(attribute);
+
+    if (attribute.type !== 'int' && attribute.type !== 'bool' && !(attribute.type in FIXED_WIDTH_TYPES)) {
+        throw new Error(`Unsupported attribute type: ${attribute.type}`);
+    }
+
+    if (attribute.defaultValue === undefined) {
+        env.set(attribute.name, undefined);
+        return toNode`
+                        ${cppType(attribute.type)} ${attribute.name}${valueInitialize ? '{}' : ''};
+            `;
+    }
+
+    const defaultValueExprValue = evalExpression(attribute.defaultValue, env);
+    const defaultValueString = emitExpression(lowerAssignedValue(attribute.defaultValue, attribute.type, env), '');
+    env.set(attribute.name, coerceToAttributeType(defaultValueExprValue, attribute.type));
+    return toNode`
+                    ${cppType(attribute.type)} ${attribute.name} = ${defaultValueString};
+        `;
+}
+
+/* Hosts can set the attributes through set_<attribute>() in library mode and the freestanding profile, so there the values
+   the model assigns do not bound them */
+export function hostSetsAttributes(ctx: GeneratorContext): boolean {
+    return ctx.mode === 'library' || ctx.profile === 'freestanding';
+}
+
+/* The packed layout of the machine, see planAttributeLayout */
+export function packedLayout(ctx: GeneratorContext): AttributeSlot[] {
+    return planAttributeLayout(ctx.statemachine, { externalWrites: hostSetsAttributes(ctx) });
+}
+
+/* Members of the packed layout (see planAttributeLayout) in place of the declared attributes. The declarations still run in
+   model order, as they check the default values and put them into env; members are initialized with the evaluated
+   values, so their order does not matter */
+export function generatePackedAttributes(ctx: GeneratorContext, env: StatemachineEnv, valueInitialize = false): Generated {
+    ctx.statemachine.attributes.forEach(attribute => generateAttributeDeclaration(attribute, env, valueInitialize));
+    return join(packedLayout(ctx), slot => {
+        const name = slot.attribute.name;
+        if (slot.bitfield) {
+            return `bool ${name} : 1;`;
+        }
+        const value = env.get(name);
+        return `${slot.type} ${name}${value !== undefined ? ` = ${value}` : valueInitialize ? '{}' : ''};`;
+    }, { appendNewLineIfNotEmpty: true });
+}
+
+/* Bitfields only take default member initializers from C++20 on, so the constructors initialize packed bools; prepends
+   `leading`, the constructor's other initializers, and returns the initializer list or an empty string */
+export function generateMemberInitializers(ctx: GeneratorContext, env: StatemachineEnv, leading: string[] = []): string {
+    const bitfields = ctx.layout === 'packed' ? packedLayout(ctx).filter(slot => slot.bitfield) : [];
+    const initializers = [...leading, ...bitfields.map(slot => `${slot.attribute.name}(${env.get(slot.attribute.name) ?? false})`)];
+    return initializers.length > 0 ? ` : ${initializers.join(', ')}` : '';
+}
+
+/* std::int8_t and std::uint8_t are characters to iostream, so u8 values and packed attributes of that type are printed as ints */
+function printableValue(ctx: GeneratorContext, value: Expression, code: string): string {
+    const slot = ctx.layout === 'packed' && isRef(value) ? packedLayout(ctx).find(slot => slot.attribute === value.val.ref) : undefined;
+    return slot?.size === 1 || integerTypeOf(value) === 'u8' ? `static_cast<int>(${code})` : code;
+}
+
+/* C++ of a print value, taken from the transition's plan if there is one */
+function valueCode(value: Expression, env: StatemachineEnv, refPrefix: string, code?: TransitionCode): string {
+    return code?.expressions.get(value) ?? convertExpressionToString(value, env, refPrefix);
+}
+
+/* `refPrefix` is prepended to attribute names, e.g. to use locals instead of the machine's members; `code` is the plan
+   of the transition the action belongs to, see planTransition */
+export function generateAction(action: Action, env: StatemachineEnv, ctx: GeneratorContext, refPrefix = 'statemachine->', code?: TransitionCode): string {
+    if (ctx.profile === 'freestanding') {
+        return generateFreestandingAction(action, env, ctx, refPrefix, code);
+    }
+    if (ctx.mode === 'library') {
+        return generateLibraryAction(action, env, ctx, refPrefix, code);
+    }
+    if (action.setTimeout) {
+        const delay = ctx.timeouts === 'blocking'
+            ? `std::this_thread::sleep_for(std::chrono::milliseconds(${action.setTimeout.duration}));`
+            : `co_await statemachine_timer::sleep_for{std::chrono::milliseconds(${action.setTimeout.duration})};`;
+        return `
+            SM_TRACE("Delaying transition for ${action.setTimeout.duration} milliseconds...");
+${inTimelineSlice(ctx, `setTimeout(${action.setTimeout.duration} ms)`, `            ${delay}`, ctx.timeouts !== 'blocking')}
+        `;
+    } else if (action.assignment) {
+        const variableName = action.assignment.variable.ref?.name;
+        const value = code?.expressions.get(action.assignment.value)
+            ?? emitExpression(lowerAssignedValue(action.assignment.value, action.assignment.variable.ref!.type, env), refPrefix);
+        return `            ${refPrefix}${variableName} = ${value};`;
+    } else if (action.print && ctx.log === 'binary') {
+        const args = action.print.values.filter(value => !isStringLiteral(value))
+            .map(value => `, ${valueCode(value as Expression, env, refPrefix, code)}`);
+        return inTimelineSlice(ctx, 'print', `            statemachine_log::write(${buildLogFormats(ctx.statemachine).ids.get(action.print)}${args.join('')});`);
+    } else if (action.print) {
+        const values = action.print.values.map(value => {
+            if (isStringLiteral(value)) {
+                return `"${value.value}"`;  // Assuming value.val contains the string content
+            } else {
+                return printableValue(ctx, value, valueCode(value, env, refPrefix, code));
+            }
+        });
+        return inTimelineSlice(ctx, 'print', `            std::cout << ${values.join(' << ')} << '\\n';`);
+    } else if (action.command) {
+        const probe = commandProbe(ctx, action);
+        return `${probe ? `            ${probe}\n` : ''}${inTimelineSlice(ctx, `run ${action.command.$refText}`, `            std::cout << "Run Command: ${action.command.$refText}()" << '\\n';`)}`;
+    }
+    return '';
+}
+
+/* With --timeline, the lines of `code` become a slice named `name`; an `async` slice may end after the handler returns */
+function inTimelineSlice(ctx: GeneratorContext, name: string, code: string, async = false): string {
+    if (!ctx.timeline) {
+        return code;
+    }
+    const [begin, end] = async
+        ? [`SM_TIMELINE_ASYNC_BEGIN("${name}", statemachine);`, `SM_TIMELINE_ASYNC_END("${name}", statemachine);`]
+        : [`SM_TIMELINE_BEGIN("${name}");`, 'SM_TIMELINE_END();'];
+    return `            ${begin}\n${code}\n            ${end}`;
+}
+
+/* Library machines have no stdout: prints go to the host's hook, commands to its Commands policy, and delays suspend on the machine itself */
+function generateLibraryAction(action: Action, env: StatemachineEnv, ctx: GeneratorContext, refPrefix: string, code?: TransitionCode): string {
+    if (action.setTimeout) {
+        return ctx.timeouts === 'blocking'
+            ? `            std::this_thread::sleep_for(std::chrono::milliseconds(${action.setTimeout.duration}));`
+            : `            co_await Machine::delay{statemachine, std::chrono::milliseconds(${action.setTimeout.duration})};`;
+    } else if (action.print) {
+        return `            if (statemachine->on_print) {
+                detail::text<${printCapacity(action.print.values)}> text;
+                ${generatePrintAppends(action.print.values, env, refPrefix, code).join('\n                ')}
+                statemachine->on_print(statemachine->hook_context, std::string_view(text.data, text.size));
+            }`;
+    } else if (action.command) {
+        return `            statemachine->commands.${action.command.$refText}();`;
+    }
+    return generateAction(action, env, { ...ctx, mode: 'program' }, refPrefix, code);
+}
+
+/* Freestanding machines format prints into a stack buffer sized at generation time and hand them, commands and delays to
+   the firmware's hooks; an unset hook skips the action */
+function generateFreestandingAction(action: Action, env: StatemachineEnv, ctx: GeneratorContext, refPrefix: string, code?: TransitionCode): string {
+    if (action.setTimeout) {
+        return `            if (statemachine->hooks.delay_ms) {
+                statemachine->hooks.delay_ms(${action.setTimeout.duration});
+            }`;
+    } else if (action.print) {
+        return `            if (statemachine->hooks.print) {
+                detail::text<${printCapacity(action.print.values)}> text;
+                ${generatePrintAppends(action.print.values, env, refPrefix, code).join('\n                ')}
+                statemachine->hooks.print(text.data, text.size);
+            }`;
+    } else if (action.command) {
+        return `            if (statemachine->hooks.command) {
+                statemachine->hooks.command(Command::${action.command.$refText});
+            }`;
+    }
+    return generateAction(action, env, { ...ctx, profile: 'hosted' }, refPrefix, code);
+}
+
+/* Statements formatting a print action into a detail::text buffer named `text` */
+function generatePrintAppends(values: PrintValue[], env: StatemachineEnv, refPrefix: string, code?: TransitionCode): string[] {
+    return values.map(value => isStringLiteral(value)
+        ? `text.append("${value.value}");`
+        : `text.append(static_cast<long long>(${valueCode(value, env, refPrefix, code)}));`);
+}
+
+/* Whether any transition of the machine prints, and so needs the detail::text buffer */
+export function usesPrints(statemachine: Statemachine): boolean {
+    return statemachine.states.some(state => state.transitions.some(transition => transition.actions.some(action => action.print !== undefined)));
+}
+
+/* Stack buffer the library and freestanding machines format a print into without allocating; emitted inside namespace detail */
+export function generatePrintBuffer(): Generated {
+    return toNode`
+        // Stack buffer a print action is formatted into, sized by the generator for its longest output.
+        // Output beyond the capacity is cut off rather than written past the buffer.
+        template <std::size_t Capacity>
+        struct text {
+            char data[Capacity];
+            std::size_t size = 0;
+
+            void put(char c) {
+                if (size < Capacity) {
+                    data[size++] = c;
+                }
+            }
+
+            void append(const char *literal) {
+                while (*literal != '\\0') {
+                    put(*literal++);
+                }
+            }
+
+            void append(long long value) {
+                char digits[20];
+                std::size_t count = 0;
+                unsigned long long magnitude = value < 0 ? 0ull - static_cast<unsigned long long>(value) : static_cast<unsigned long long>(value);
+                do {
+                    digits[count++] = static_cast<char>('0' + magnitude % 10);
+                    magnitude /= 10;
+                } while (magnitude != 0);
+                if (value < 0) {
+                    put('-');
+                }
+                while (count > 0) {
+                    put(digits[--count]);
+                }
+            }
+        };
+    `;
+}
+
+/* Bytes of a string literal in the generated source, which is UTF-8 */
+export function literalBytes(text: string): number {
+    return Buffer.byteLength(text, 'utf8');
+}
+
+/* Longest text a print action can produce: its literals plus 20 characters per value, enough for any long long */
+export function printCapacity(values: PrintValue[]): number {
+    return Math.max(1, values.reduce((size, value) => size + (isStringLiteral(value) ? literalBytes(value.value) : 20), 0));
+}
+
+function checkGuardType(transition: Transition, env: StatemachineEnv): void {
+    if (transition.guard !== undefined && typeof evalExpression(transition.guard, env) !== 'boolean') {
+        throw new Error('Guard condition must be a boolean expression');
+    }
+}
+
+/* Returns the C++ condition of a transition's guard, or undefined for unguarded transitions */
+export function generateGuardCondition(transition: Transition, env: StatemachineEnv, refPrefix = 'statemachine->'): string | undefined {
+    if (transition.guard === undefined) {
+        return undefined;
+    }
+    checkGuardType(transition, env);
+    return convertExpressionToString(transition.guard, env, refPrefix);
+}
+
+/* Optimized C++ of a transition's guard and action values, sharing repeated subexpressions in locals (see
+   planTransitionCode). Library and freestanding hooks run host code, which may set attributes through the accessors, so
+   prints and commands there end the reuse of values read before them */
+export function planTransition(transition: Transition, env: StatemachineEnv, ctx: GeneratorContext, refPrefix = 'statemachine->', parts: TransitionParts = 'both'): TransitionCode {
+    if (parts !== 'actions') {
+        checkGuardType(transition, env);
+    }
+    const hostCode = ctx.mode === 'library' || ctx.profile === 'freestanding';
+    return planTransitionCode(transition, env, refPrefix, parts, action => hostCode && (action.print !== undefined || action.command !== undefined));
+}
+
+/* Declarations of a plan's locals, indented like actions */
+export function generateGuardLocals(code: TransitionCode, indentation = '        '): string {
+    return code.guardLocals.map(local => `\n${indentation}${local}`).join('');
+}
+
+export function generateActions(transition: Transition, env: StatemachineEnv, ctx: GeneratorContext, refPrefix = 'statemachine->', code = planTransition(transition, env, ctx, refPrefix, 'actions')): string {
+    return transition.actions.flatMap(action => [...(code.actionLocals.get(action) ?? []).map(local => `            ${local}`), generateAction(action, env, ctx, refPrefix, code)])
+        .filter(actionCode => actionCode.length > 0).join('\n');
+}
+
+/* The actions as separate lines without the indentation of a function body, for callers that nest them themselves */
+export function generateActionLines(transition: Transition, env: StatemachineEnv, ctx: GeneratorContext, refPrefix = 'statemachine->', code?: TransitionCode): string[] {
+    return generateActions(transition, env, ctx, refPrefix, code).split('\n').filter(line => line.trim().length > 0).map(line => line.replace(/^ {12}/, ''));
+}
+
+/* generateActionLines with each line traced to the action it comes from, see line-directives.ts */
+export function generateTracedActionLines(transition: Transition, env: StatemachineEnv, ctx: GeneratorContext, refPrefix = 'statemachine->', code = planTransition(transition, env, ctx, refPrefix, 'actions')): Generated[] {
+    return transition.actions.flatMap(action => [...(code.actionLocals.get(action) ?? []), ...generateAction(action, env, ctx, refPrefix, code).split('\n')]
+        .filter(line => line.trim().length > 0)
+        .map(line => traceToNode(action)(line.replace(/^ {12}/, ''))));
+}
+
+export function convertExpressionToString(e: Expression, env: StatemachineEnv, refPrefix: string): string {
+    return emitExpression(optimizeExpression(lowerExpression(e, env)), refPrefix);
+}
@@ -7,17 +7,29 @@
 
 import * as fs from 'node:fs';
 import * as path from 'node:path';
-import { type Generated, expandToNode as toNode, joinToNode as join, toString } from 'langium/generate';
-import { Action, Attribute, Expression, isBinExpr, isRef, isStringLiteral, Transition, type State, type Statemachine } from '../language-server/generated/ast.js';
+import { type Generated, CompositeGeneratorNode, expandToNode as toNode, expandTracedToNode, joinToNode as join, toString, traceToNode } from 'langium/generate';
+import { Transition, type State, type Statemachine } from '../language-server/generated/ast.js';
 import { extractDestinationAndName } from './cli-util.js';
 import { env, StatemachineEnv } from './interpreter.js';
-import { evalExpression } from './interpret-util.js';
-import { isNegExpr, isLiteral, isNegIntExpr, isNegBoolExpr, isGroup } from "../language-server/generated/ast.js";
-import chalk from 'chalk';
-
-export function generateCpp(statemachine: Statemachine, filePath: string, destination: string | undefined): string {
+import { type GeneratorContext, type GeneratorOptions, generateEventLookup, generateEventReaderInclude, generateEventStreamFingerprint, generateTraceMacros, generateLogInclude, generateLogOpen, generateLogClose, LOG_HEADER, STATS_HEADER, TIMELINE_HEADER, INPUT_HEADER, QUEUE_HEADER, generateTimerIncludes, generateTimerScheduler, generateSuspensionMembers, suspendsOnTimeout, usesCoroutineTimeouts, joinWithExtraNL, generateAttributeDeclaration, generatePackedAttributes, generateMemberInitializers, generateFixedWidthHelpers, planTransition, generateTracedActionLines, idType } from './generator-util.js';
+import { generateAlternatives, groupTransitionsByEvent, reachableAlternatives } from './guard-dispatch.js';
+import { generateTableCppContent } from './generator-table.js';
+import { generateCrtpCppContent, runtimeHeaderPath, RUNTIME_HEADER } from './generator-crtp.js';
+import { generateLibraryContent, libraryFileNames, libraryNamespace } from './generator-library.js';
+import { generateFreestandingContent } from './generator-freestanding.js';
+import { prunedContext } from './reachability.js';
+import { toStringWithLineDirectives } from './line-directives.js';
+import { generateProbeMacros, transitionProbe } from './probes.js';
+import { equivalentStates, mergedStateNames, minimizedContext, stateDisplayName } from './state-minimization.js';
+
+export type { AttributeLayout } from './attribute-layout.js';
+export type { CppBackend, GeneratorOptions, LogMode, OutputMode, Profile, TimeoutMode, TraceLevel } from './generator-util.js';
+export type { QueueOverflow } from './event-queue.js';
+
+export function generateCpp(statemachine: Statemachine, filePath: string, destination: string | undefined, options: GeneratorOptions = {}): string {
     const data = extractDestinationAndName(filePath, destination);
     const ctx = <GeneratorContext>{
+        ...options,
         statemachine,
         fileName: `${data.name}.cpp`,
         destination: data.destination,
@@ -25,13 +37,31 @@ export function generateCpp(statemachine: Statemachine, filePath: string, destin
     return generate(ctx);
 }
 
-interface GeneratorContext {
-    statemachine: Statemachine;
-    fileName: string;
-    destination: string;
-}
+/* Options instrumenting the handlers of the virtual backend, with what they do for the error message */
+const VIRTUAL_PROGRAM_OPTIONS = [
+    ['lineDirectives', '--line-directives follows the transitions, guards and actions traced by the virtual backend'],
+    ['probes', '--probes places USDT probes in the transition handlers of the virtual backend'],
+    ['stats', '--stats times the event dispatch of the virtual backend'],
+    ['timeline', '--timeline records the event dispatch and the actions of the virtual backend'],
+] as const;
 
 function generate(ctx: GeneratorContext): string {
+    if (ctx.shards !== undefined) {
+        return generateSharded(ctx);
+    }
+    if (ctx.module) {
+        throw new Error('--module writes the interface of a sharded machine, so it needs --shards');
+    }
+    const instrumented = VIRTUAL_PROGRAM_OPTIONS.find(([option]) => ctx[option]);
+    if (instrumented && (ctx.mode === 'library' || ctx.profile === 'freestanding' || (ctx.backend !== undefined && ctx.backend !== 'virtual'))) {
+        throw new Error(`${instrumented[1]}, so it needs --backend virtual, --mode program and the hosted profile`);
+    }
+    if (ctx.profile === 'freestanding') {
+        return generateFreestanding(ctx);
+    }
+    if (ctx.mode === 'library') {
+        return generateLibrary(ctx);
+    }
     const fileNode = generateCppContent(ctx);
 
     if (!fs.existsSync(ctx.destination)) {
@@ -39,58 +69,313 @@ function generate(ctx: GeneratorContext): string {
     }
 
     const generatedFilePath = path.join(ctx.destination, ctx.fileName);
-    fs.writeFileSync(generatedFilePath, toString(fileNode));
+    fs.writeFileSync(generatedFilePath, ctx.lineDirectives ? toStringWithLineDirectives(fileNode, path.resolve(generatedFilePath)) : toString(fileNode));
+    if (ctx.backend === 'crtp') {
+        fs.copyFileSync(runtimeHeaderPath(RUNTIME_HEADER), path.join(ctx.destination, RUNTIME_HEADER));
+    }
+    copyRuntimeHeaders(ctx);
     return generatedFilePath;
 
 }
 
-function joinWithExtraNL<T>(content: T[], toString: (e: T) => Generated): Generated {
-    return join(content, toString, { appendNewLineIfNotEmpty: true });
+/* Writes the library header and source and the stdin driver; returns the path of the header */
+function generateLibrary(ctx: GeneratorContext): string {
+    const files = generateLibraryContent(ctx, env);
+    const names = libraryFileNames(ctx);
+
+    if (!fs.existsSync(ctx.destination)) {
+        fs.mkdirSync(ctx.destination, { recursive: true });
+    }
+
+    fs.writeFileSync(path.join(ctx.destination, names.header), toString(files.header));
+    fs.writeFileSync(path.join(ctx.destination, names.source), toString(files.source));
+    fs.writeFileSync(path.join(ctx.destination, names.driver), toString(files.driver));
+    fs.copyFileSync(runtimeHeaderPath(INPUT_HEADER), path.join(ctx.destination, INPUT_HEADER));
+    fs.copyFileSync(runtimeHeaderPath(QUEUE_HEADER), path.join(ctx.destination, QUEUE_HEADER));
+    return path.join(ctx.destination, names.header);
+}
+
+/* Writes the freestanding header and source; returns the path of the header */
+function generateFreestanding(ctx: GeneratorContext): string {
+    const files = generateFreestandingContent(ctx, env);
+    const names = libraryFileNames(ctx);
+
+    if (!fs.existsSync(ctx.destination)) {
+        fs.mkdirSync(ctx.destination, { recursive: true });
+    }
+
+    fs.writeFileSync(path.join(ctx.destination, names.header), toString(files.header));
+    fs.writeFileSync(path.join(ctx.destination, names.source), toString(files.source));
+    return path.join(ctx.destination, names.header);
+}
+
+/* Writes the shared header, the state shards, the source with main() and the module interface; returns the path of the
+   header. Files whose content did not change are left alone, so that a build only recompiles the shards a model edit touches */
+function generateSharded(ctx: GeneratorContext): string {
+    const files = generateShardedContent(ctx);
+    const names = shardedFileNames(ctx, files.shards.length);
+
+    if (!fs.existsSync(ctx.destination)) {
+        fs.mkdirSync(ctx.destination, { recursive: true });
+    }
+
+    const write = (name: string, content: Generated) => {
+        const filePath = path.join(ctx.destination, name);
+        const text = ctx.lineDirectives ? toStringWithLineDirectives(content, path.resolve(filePath)) : toString(content);
+        if (!fs.existsSync(filePath) || fs.readFileSync(filePath, 'utf-8') !== text) {
+            fs.writeFileSync(filePath, text);
+        }
+    };
+    write(names.header, files.header);
+    files.shards.forEach((shard, index) => write(names.shards[index], shard));
+    write(names.main, files.main);
+    if (files.module) {
+        write(names.module, files.module);
+    }
+    copyRuntimeHeaders(ctx);
+    return path.join(ctx.destination, names.header);
+}
+
+/* The runtime headers the event reader, the event queue, the binary log, the statistics and the timeline include, next to
+   the generated code */
+function copyRuntimeHeaders(ctx: GeneratorContext): void {
+    fs.copyFileSync(runtimeHeaderPath(INPUT_HEADER), path.join(ctx.destination, INPUT_HEADER));
+    if (ctx.backend === 'crtp' || usesCoroutineTimeouts(ctx)) {
+        fs.copyFileSync(runtimeHeaderPath(QUEUE_HEADER), path.join(ctx.destination, QUEUE_HEADER));
+    }
+    if (ctx.log === 'binary') {
+        fs.copyFileSync(runtimeHeaderPath(LOG_HEADER), path.join(ctx.destination, LOG_HEADER));
+    }
+    if (ctx.stats) {
+        fs.copyFileSync(runtimeHeaderPath(STATS_HEADER), path.join(ctx.destination, STATS_HEADER));
+    }
+    if (ctx.timeline) {
+        fs.copyFileSync(runtimeHeaderPath(TIMELINE_HEADER), path.join(ctx.destination, TIMELINE_HEADER));
+    }
+}
+
+/* Non-empty lines of C++ generating with `ctx` produces, over all files of its mode */
+function countGeneratedLines(ctx: GeneratorContext): number {
+    const files = ctx.shards !== undefined ? shardedFiles(generateShardedContent(ctx))
+        : ctx.profile === 'freestanding' ? Object.values(generateFreestandingContent(ctx, env))
+        : ctx.mode === 'library' ? Object.values(generateLibraryContent(ctx, env)) : [generateCppContent(ctx)];
+    return files.reduce<number>((lines, file) => lines + toString(file).split('\n').filter(line => line.trim().length > 0).length, 0);
 }
+
+function plural(count: number, noun: string): string {
+    return `${count} ${noun}${count === 1 ? '' : 's'}`;
+}
+
+/* What `--prune` leaves out of the machine and how many lines of generated C++ that saves. The table and crtp backends
+   may only accept the pruned machine, once alternatives that can never fire are gone; then there is nothing to compare */
+export function describePruning(ctx: GeneratorContext): string {
+    const pruned = prunedContext({ ...ctx, prune: true }).statemachine;
+    const kept = new Set(pruned.states.flatMap(state => state.transitions));
+    const states = ctx.statemachine.states.length - pruned.states.length;
+    const transitions = ctx.statemachine.states.flatMap(state => state.transitions).filter(transition => !kept.has(transition)).length;
+    const summary = `${ctx.statemachine.name} pruned: ${plural(states, 'unreachable state')} and ${plural(transitions, 'transition')} that can never fire`;
+    let before: number;
+    try {
+        before = countGeneratedLines({ ...ctx, prune: false });
+    } catch {
+        return `${summary}; the ${ctx.backend} backend only accepts the pruned machine`;
+    }
+    const removed = before - countGeneratedLines({ ...ctx, prune: true });
+    return `${summary}; ${removed} of ${before} lines of C++ (${before > 0 ? Math.round(100 * removed / before) : 0}%) left out`;
+}
+
+/* Which states `--minimize` merges, each class written the way the generated code traces it */
+export function describeMinimization(ctx: GeneratorContext): string {
+    const merged = equivalentStates(prunedContext(ctx).statemachine).filter(members => members.length > 1);
+    if (merged.length === 0) {
+        return `${ctx.statemachine.name} minimized: no two states behave the same`;
+    }
+    const removed = merged.reduce((count, members) => count + members.length - 1, 0);
+    return `${ctx.statemachine.name} minimized: ${plural(removed, 'state')} merged away (${merged.map(members => members.map(state => state.name).join('|')).join(', ')})`;
+}
+
 // gen function
 export function generateCppContent(ctx: GeneratorContext): Generated {
+    ctx = minimizedContext(prunedContext(ctx));
+    if (ctx.backend === 'table') {
+        return generateTableCppContent(ctx, env);
+    } else if (ctx.backend === 'crtp') {
+        return generateCrtpCppContent(ctx, env);
+    }
+    return generateVirtualCppContent(ctx);
+}
+
+function generateVirtualCppContent(ctx: GeneratorContext): Generated {
     return toNode`
+        ${generateVirtualDeclarations(ctx)}
+        ${joinWithExtraNL(ctx.statemachine.states, state => generateStateDefinition(ctx, state, env))}
+
+        ${generateVirtualMain(ctx)}
+
+    `;
+}
+
+export interface ShardedFiles {
+    header: Generated;
+    shards: Generated[];
+    main: Generated;
+    module?: Generated;
+}
+
+export interface ShardedFileNames {
+    header: string;
+    shards: string[];
+    main: string;
+    module: string;
+}
+
+export function shardedFileNames(ctx: GeneratorContext, shardCount: number): ShardedFileNames {
+    const base = ctx.fileName?.replace(/\.cpp$/, '') ?? ctx.statemachine.name;
+    return {
+        header: `${base}.hpp`,
+        shards: Array.from({ length: shardCount }, (_, index) => `${base}_states${index}.cpp`),
+        main: `${base}.cpp`,
+        module: `${base}.cppm`,
+    };
+}
+
+function shardedFiles(files: ShardedFiles): Generated[] {
+    return [files.header, ...files.shards, files.main, ...(files.module ? [files.module] : [])];
+}
+
+/* Contiguous runs of the states in model order, balanced by their number of transitions, so that an edit to a few states
+   only changes the shards holding them. There are never more shards than states */
+export function shardStates(states: State[], count: number): State[][] {
+    const shards = Math.max(1, Math.min(count, states.length));
+    const weight = (state: State) => 1 + state.transitions.length;
+    const total = states.reduce((sum, state) => sum + weight(state), 0);
+    const slices: State[][] = Array.from({ length: shards }, () => []);
+    let before = 0;
+    for (const state of states) {
+        // Each state goes to the shard its middle falls into
+        slices[Math.min(shards - 1, Math.floor((before + weight(state) / 2) * shards / total))].push(state);
+        before += weight(state);
+    }
+    return slices.filter(slice => slice.length > 0);
+}
+
+/* The virtual backend split into translation units that compile in parallel: a header with the machine and the state
+   classes, `shards` sources defining the states, and a source with main(). With `module`, a C++20 module interface also
+   exports the machine and its states to code that imports it */
+export function generateShardedContent(ctx: GeneratorContext): ShardedFiles {
+    ctx = minimizedContext(prunedContext(ctx));
+    if ((ctx.backend !== undefined && ctx.backend !== 'virtual') || ctx.mode === 'library' || ctx.profile === 'freestanding') {
+        throw new Error('--shards splits the state classes of the virtual backend, so it needs --backend virtual, --mode program and the hosted profile');
+    }
+    if (ctx.shards === undefined || !Number.isInteger(ctx.shards) || ctx.shards < 1) {
+        throw new Error(`--shards needs a positive number of shards, got '${ctx.shards}'`);
+    }
+    const slices = shardStates(ctx.statemachine.states, ctx.shards);
+    const names = shardedFileNames(ctx, slices.length);
+    const guard = `${libraryNamespace(ctx).toUpperCase()}_HPP`;
+    // The header comes first: declaring the attributes puts them into env, which the transitions are checked against
+    const header = toNode`
+        #ifndef ${guard}
+        #define ${guard}
+
+        ${generateVirtualDeclarations(ctx)}
+
+        #endif // ${guard}
+    `;
+    const shards = slices.map(slice => toNode`
+        #include "${names.header}"
+
+        ${joinWithExtraNL(slice, state => generateStateDefinition(ctx, state, env))}
+    `);
+    const main = toNode`
+        #include "${names.header}"
+
+        ${generateVirtualMain(ctx)}
+    `;
+    return { header, shards, main, module: ctx.module ? generateModuleInterface(ctx, names.header) : undefined };
+}
+
+/* A module interface unit over the shared header: the header is included into the global module fragment and its
+   classes exported under their own names as aliases, so importers and the shards, which include the header, see the
+   same entities. Aliases rather than using-declarations, which GCC 12 does not export from the global module fragment */
+function generateModuleInterface(ctx: GeneratorContext, header: string): Generated {
+    const states = ctx.statemachine.states.flatMap(state => [state.name, ...mergedStateNames(state)]);
+    return toNode`
+        module;
+
+        #include "${header}"
+
+        export module ${ctx.statemachine.name};
+
+        export using State = ::State;
+        export using ${ctx.statemachine.name} = ::${ctx.statemachine.name};
+        ${join(states, state => `export using ${state} = ::${state};`, { appendNewLineIfNotEmpty: true })}
+    `;
+}
+
+/* Everything the state definitions and main() need: includes, macros, the machine class and the state classes */
+function generateVirtualDeclarations(ctx: GeneratorContext): Generated {
+    return toNode`
+        #include <cstddef>
+        #include <cstdint>
         #include <iostream>
-        #include <map>
         #include <string>
+        #include <string_view>
         #include <chrono>
         #include <thread>
+        ${generateEventReaderInclude()}
+        ${generateTraceMacros(ctx)}
+        ${generateProbeMacros(ctx)}
+        ${generateLogInclude(ctx)}
+        ${ctx.stats ? `#include "${STATS_HEADER}"` : undefined}
+        ${ctx.timeline ? `#include "${TIMELINE_HEADER}"` : undefined}
+        ${generateTimerIncludes(ctx)}
         class ${ctx.statemachine.name};
 
+        ${generateFixedWidthHelpers(ctx)}
+        ${generateTimerScheduler(ctx)}
         ${generateStateClass(ctx)}
 
         ${generateStatemachineClass(ctx, env)}
         
         ${joinWithExtraNL(ctx.statemachine.states, state => generateStateDeclaration(ctx, state))}
-        ${joinWithExtraNL(ctx.statemachine.states, state => generateStateDefinition(ctx, state, env))}
+    `;
+}
 
+function generateVirtualMain(ctx: GeneratorContext): Generated {
+    return toNode`
         typedef void (${ctx.statemachine.name}::*Event)();
 
-        ${generateMain(ctx, env)}
+        ${generateEventLookup(ctx, 'Event', event => `&${ctx.statemachine.name}::${event.name}`)}
 
+        ${generateEventStreamFingerprint(ctx)}
+        ${generateEventIds(ctx)}
+
+        ${generateMain(ctx, env)}
     `;
 }
 
+/* The binary log, the probes, the statistics and the timeline need the index of the current state */
+function usesStateIds(ctx: GeneratorContext): boolean {
+    return ctx.log === 'binary' || !!ctx.probes || !!ctx.stats || !!ctx.timeline;
+}
+
 function generateStateClass(ctx: GeneratorContext): Generated {
     return toNode`
         class State {
-        protected:
-            ${ctx.statemachine.name} *statemachine;
-
         public:
             virtual ~State() {}
 
-            void set_context(${ctx.statemachine.name} *statemachine) {
-                this->statemachine = statemachine;
-            }
-
-            virtual std::string get_name() {
+            virtual std::string_view get_name() const {
                 return "Unknown";
             }
+            ${usesStateIds(ctx) ? 'virtual std::size_t get_id() const = 0;' : undefined}
         ${joinWithExtraNL(ctx.statemachine.events, event => toNode`
             
-                virtual void ${event.name}() {
-                    std::cout << "Impossible event for the current state." << std::endl;
+                virtual void ${event.name}(${ctx.probes ? `[[maybe_unused]] ${ctx.statemachine.name} *statemachine` : `${ctx.statemachine.name} *`}) const {
+                    SM_TRACE("Impossible event for the current state.");
+                    ${ctx.probes ? `SM_PROBE(unknown_event, statemachine, get_id(), ${ctx.statemachine.events.indexOf(event)});` : undefined}
+                    ${ctx.stats ? 'SM_STATS_REJECT();' : undefined}
                 }
         `)}
         };
@@ -101,178 +386,220 @@ function generateStatemachineClass(ctx: GeneratorContext, env: StatemachineEnv):
     return toNode`
         class ${ctx.statemachine.name} {
         private:
-            State* state = nullptr;
+            const State* state = nullptr;
         public:
-            ${joinWithExtraNL(ctx.statemachine.attributes, attribute => toNode`
+            ${ctx.layout === 'packed' ? generatePackedAttributes(ctx, env) : joinWithExtraNL(ctx.statemachine.attributes, attribute => toNode`
                 ${generateAttributeDeclaration(attribute, env)}
             `)}
-            ${ctx.statemachine.name}(State* initial_state) {
-                initial_state->set_context(this);
+            ${ctx.statemachine.name}(const State* initial_state)${generateMemberInitializers(ctx, env)} {
                 state = initial_state;
-                std::cout << "[" << state->get_name() <<  "]" << std::endl;
+                ${ctx.log === 'binary' ? 'SM_LOG_STATE(state->get_id());' : 'SM_TRACE_TRANSITION("[" << state->get_name() << "]");'}
             }
 
-            ~${ctx.statemachine.name}() {
-                if (state != nullptr) {
-                    delete state;
-                }
+            // States are stateless flyweights, so a transition only swaps a pointer.
+            void transition_to(const State *new_state) {
+                ${ctx.log === 'binary' ? 'SM_LOG_TRANSITION(state->get_id(), new_state->get_id());' : 'SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());'}
+                state = new_state;
             }
+            ${ctx.probes || ctx.stats || ctx.timeline ? toNode`
 
-            void transition_to(State *new_state) {
-                std::cout << state->get_name() << " ===> " << new_state->get_name() << std::endl;
-                if (state != nullptr) {
-                    delete state;
+                std::size_t state_id() const {
+                    return state->get_id();
                 }
-                new_state->set_context(this);
-                state = new_state;
-            }
+            ` : undefined}
+            ${ctx.stats ? generateStatsMembers(ctx) : undefined}
+            ${ctx.timeline && ctx.statemachine.events.length > 0 ? toNode`
+                // Timeline slice of each dispatch, at state_id() * ${ctx.statemachine.events.length} + event.
+                static constexpr const char *timeline_slices[] = {
+                    ${join(ctx.statemachine.states.flatMap(state => ctx.statemachine.events.map(event => `"${stateDisplayName(state)}.${event.name}"`)), { separator: ',', appendNewLineIfNotEmpty: true })}
+                };
+            ` : undefined}
             ${joinWithExtraNL(ctx.statemachine.events, event => toNode`
                     void ${event.name}() {
-                        state->${event.name}();
+                        ${ctx.timeline ? 'SM_TIMELINE_FLUSH_PENDING();' : undefined}
+                        ${ctx.timeline ? `SM_TIMELINE_SLICE(timeline_slices[state_id() * ${ctx.statemachine.events.length} + ${ctx.statemachine.events.indexOf(event)}]);` : undefined}
+                        ${ctx.stats ? `SM_STATS_SCOPE(this, stats_pairs[state_id() * ${ctx.statemachine.events.length} + ${ctx.statemachine.events.indexOf(event)}]);` : undefined}
+                        state->${event.name}(this);
                     }
             `)}
+            ${usesCoroutineTimeouts(ctx) ? generateSuspensionMembers(ctx, `void (${ctx.statemachine.name}::*)()`, event => `(this->*${event})()`) : undefined}
         };
     `;
 }
 
+/* The stats recorder, and the dense id of each (state, event) pair: 1.. for the pairs with a transition, 0 for all others */
+function generateStatsMembers(ctx: GeneratorContext): Generated {
+    const { states, events } = ctx.statemachine;
+    const names: string[] = [];
+    const ids = states.flatMap(state => events.map(event => {
+        if (!state.transitions.some(transition => transition.event.$refText === event.name)) {
+            return 0;
+        }
+        names.push(`{"${stateDisplayName(state)}", "${event.name}"}`);
+        return names.length;
+    }));
+    return toNode`
+        #if SM_STATS
+            ${events.length > 0 ? toNode`
+                // Statistics id of each dispatch, at state_id() * ${events.length} + event; 0 where the state has no transition for the event.
+                static constexpr ${idType(names.length + 1)} stats_pairs[] = {${ids.join(', ')}};
+            ` : undefined}
+            statemachine_stats::recorder<${names.length}> stats{"${ctx.statemachine.name}", {${names.length > 0 ? `{${names.join(', ')}}` : ''}}};
+        #endif
+    `;
+}
+
 function generateStateDeclaration(ctx: GeneratorContext, state: State): Generated {
     return toNode`
         class ${state.name} : public State {
         public:
-            std::string get_name() override { return "${state.name}"; }
-            ${joinWithExtraNL(state.transitions, transition => `void ${transition.event.$refText}() override;`)}
+            static const ${state.name} instance;
+            std::string_view get_name() const override { return "${stateDisplayName(state)}"; }
+            ${usesStateIds(ctx) ? `std::size_t get_id() const override { return ${ctx.statemachine.states.indexOf(state)}; }` : undefined}
+            ${joinWithExtraNL(groupTransitionsByEvent(state), group => `void ${group[0].event.$refText}(${ctx.statemachine.name} *statemachine) const override;`)}
         };
+        ${join(mergedStateNames(state), alias => `using ${alias} = ${state.name};`, { appendNewLineIfNotEmpty: true })}
     `;
 }
 
-function generateAttributeDeclaration(attribute: Attribute, env: StatemachineEnv): Generated {
-    // const defaultValue = getDefaultAttributeValue(attribute);
+/* Lines joined by newlines, each behind `indentation`; traced lines keep their trace */
+function appendLines(node: CompositeGeneratorNode, lines: Generated[], indentation: string): CompositeGeneratorNode {
+    lines.forEach((line, index) => node.append(index === 0 ? '' : '\n', indentation, line));
+    return node;
+}
 
-    if (attribute.type !== 'int' && attribute.type !== 'bool') {
-        throw new Error(`Unsupported attribute type: ${attribute.type}`);
-    }
+/* The change to the target state and, with --probes, its exit probe, both traced to the target */
+function generateTargetLines(ctx: GeneratorContext, transition: Transition): Generated[] {
+    const target = traceToNode(transition, 'state');
+    const exit = transitionProbe(ctx, 'transition_exit', transition.state.$refText, transition);
+    return [target(`statemachine->transition_to(&${transition.state.$refText}::instance);`), ...(exit ? [target(exit)] : [])];
+}
 
-    if (attribute.defaultValue === undefined) {
-        env.set(attribute.name, undefined);
-        return toNode`
-                        ${attribute.type} ${attribute.name};
-            `;
-    }
+/* Rejection of an event whose guards do not hold */
+function generateRejectedLines(ctx: GeneratorContext, stateName: string, transition: Transition): string[] {
+    const rejected = transitionProbe(ctx, 'guard_rejected', stateName, transition);
+    return ['SM_TRACE("Transition not allowed.");', ...(rejected ? [rejected] : []), ...(ctx.stats ? ['SM_STATS_REJECT();'] : [])];
+}
 
-    const defaultValueExprValue = evalExpression(attribute.defaultValue, env);
-    const defaultValueString = convertExpressionToString(attribute.defaultValue, env, '')
-    env.set(attribute.name, defaultValueExprValue);
-    return toNode`
-                    ${attribute.type} ${attribute.name} = ${defaultValueString};
-        `;
-}
-
-function generateAction(action: Action, env: StatemachineEnv): string {
-    if (action.setTimeout) {
-        return `
-            std::cout << "Delaying transition for ${action.setTimeout.duration} milliseconds..." << std::endl;
-            std::this_thread::sleep_for(std::chrono::milliseconds(${action.setTimeout.duration}));
-        `;
-    } else if (action.assignment) {
-        const variableName = action.assignment.variable.ref?.name;
-        const value = convertExpressionToString(action.assignment.value, env, 'statemachine->');
-        return `            statemachine->${variableName} = ${value};`;
-    } else if (action.print) {
-        const values = action.print.values.map(value => {
-            if (isStringLiteral(value)) {
-                return `"${value.value}"`;  // Assuming value.val contains the string content
-            } else {
-                return convertExpressionToString(value, env, 'statemachine->');
-            }
-        });
-        return `            std::cout << ${values.join(' << ')} << std::endl;`;
-    } else if (action.command) {
-        return `            std::cout << "Run Command: ${action.command.$refText}()" << std::endl;`;
+/* setTimeout suspends the transition in a coroutine that runs the actions and completes the transition */
+function generateCoroutine(ctx: GeneratorContext, transition: Transition, coroutineName: string, machineName: string, env: StatemachineEnv): Generated {
+    return traceToNode(transition)(node => appendLines(appendLines(node.append(`
+    static statemachine_timer::task ${coroutineName}(${machineName} *statemachine) {
+`), generateTracedActionLines(transition, env, ctx), '            ').append(`
+`), generateTargetLines(ctx, transition), '        ').append(`
+        statemachine->resume_pending();
     }
-    return '';
+`));
 }
 
-function generateTransition(transition: Transition, stateName: string, env: StatemachineEnv): string {
-    if (transition.guard !== undefined && typeof evalExpression(transition.guard, env) !== 'boolean') {
-        throw new Error('Guard condition must be a boolean expression');
+/* A guard that always holds leaves no branch behind, and one that never holds leaves only the rejection. The handler is
+   traced to the transition, and its guard, actions and target to theirs */
+function generateTransition(ctx: GeneratorContext, transition: Transition, stateName: string, machineName: string, env: StatemachineEnv): Generated {
+    const suspends = suspendsOnTimeout(ctx, transition);
+    // A coroutine's actions run in another function, so they cannot reuse what the guard computed
+    const code = planTransition(transition, env, ctx, 'statemachine->', suspends ? 'guard' : 'both');
+    const signature = `void ${stateName}::${transition.event.$refText}(${code.fires ? '' : '[[maybe_unused]] '}${machineName} *statemachine) const`;
+    const entry = transitionProbe(ctx, 'transition_entry', stateName, transition);
+    if (!code.fires) {
+        return traceToNode(transition)(node => appendLines(node.append(`
+    ${signature} {
+`), [...(entry ? [entry] : []), ...generateRejectedLines(ctx, stateName, transition)], '        ').append(`
+    }
+    `));
     }
+    const coroutineName = `${stateName}_${transition.event.$refText}_run`;
+    const body: Generated[] = suspends
+        ? ['statemachine->suspended = true;', `${coroutineName}(statemachine);`]
+        : [...generateTracedActionLines(transition, env, ctx, 'statemachine->', code), ...generateTargetLines(ctx, transition)];
+    const guard = traceToNode(transition, 'guard');
+    const lines: Generated[] = code.condition === undefined
+        ? [...code.guardLocals, ...body]
+        : [...code.guardLocals.map(local => guard(local)), guard(`if (${code.condition}) {`), ...body.map(line => new CompositeGeneratorNode('    ', line)), '} else {', ...generateRejectedLines(ctx, stateName, transition).map(line => `    ${line}`), '}'];
+    return traceToNode(transition)(node => appendLines(node.append(suspends ? generateCoroutine(ctx, transition, coroutineName, machineName, env) : '', `
+    ${signature} {
+`), entry ? [entry, ...lines] : lines, '        ').append(`
+    }
+    `));
+}
 
-    const guardCondition = transition.guard != undefined ? convertExpressionToString(transition.guard, env, 'statemachine->') : "true";
-    const actionsCode = transition.actions.map(action => `${generateAction(action, env)}`).filter(actionCode => actionCode.length > 0)
-        .join('\n');
-
-    return `
-    void ${stateName}::${transition.event.$refText}() {
-        if (${guardCondition}) {
-${transition.actions?.length > 0 ? actionsCode : ''}
-            statemachine->transition_to(new ${transition.state.$refText});
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+/* One handler for several alternatives of the same event: the first whose guard holds is taken (see guard-dispatch.ts) */
+function generateAlternativesTransition(ctx: GeneratorContext, group: Transition[], stateName: string, machineName: string, env: StatemachineEnv): Generated {
+    const event = group[0].event.$refText;
+    const coroutineName = (transition: Transition) => `${stateName}_${event}_${group.indexOf(transition)}_run`;
+    const coroutines = reachableAlternatives(group).filter(transition => suspendsOnTimeout(ctx, transition))
+        .map(transition => generateCoroutine(ctx, transition, coroutineName(transition), machineName, env));
+    const body = (transition: Transition): Generated[] => suspendsOnTimeout(ctx, transition)
+        ? ['statemachine->suspended = true;', `${coroutineName(transition)}(statemachine);`]
+        : [...generateTracedActionLines(transition, env, ctx), ...generateTargetLines(ctx, transition)];
+    const entry = transitionProbe(ctx, 'transition_entry', stateName, group[0]);
+    const alternatives = generateAlternatives(group, env, 'statemachine->', body, generateRejectedLines(ctx, stateName, group[0]));
+    const lines = entry ? [entry, ...alternatives] : alternatives;
+    // What is not traced to one of the alternatives is traced to the first
+    return traceToNode(group[0])(node => appendLines(node.append(...coroutines, `
+    void ${stateName}::${event}(${machineName} *statemachine) const {
+`), lines, '        ').append(`
     }
-    `;
+    `));
 }
 
 function generateStateDefinition(ctx: GeneratorContext, state: State, env: StatemachineEnv): Generated {
-    const transitionsCode = state.transitions.map(transition => generateTransition(transition, state.name, env)).join('\n');
+    const transitionsCode = join(groupTransitionsByEvent(state), group => group.length === 1
+        ? generateTransition(ctx, group[0], state.name, ctx.statemachine.name, env)
+        : generateAlternativesTransition(ctx, group, state.name, ctx.statemachine.name, env), { separator: '\n' });
 
-    return toNode`
+    return expandTracedToNode(state)`
         // ${state.name}
+        const ${state.name} ${state.name}::instance;
     ${transitionsCode}
     `;
 }
 
-function convertExpressionToString(e: Expression, env: StatemachineEnv, refPrefix: string): string {
-    if (isLiteral(e)) {
-        if (e.val === undefined) {
-            throw new Error('Literal value is undefined');
-        }
-        return e.val.toString();
-    } else if (isRef(e)) {
-        // Write code to throw an error if the reference is not defined in the current scope, throw an error i.e.
-        if (!e.val.ref || !env.has(e.val.$refText)) {
-            throw new Error(`${e.val.$refText} Reference is undefined in this scope`);
-        }
-        return refPrefix + e.val.ref?.name ?? '';
-    } else if (isBinExpr(e)) {
-        let op = e.op;
-        let left = convertExpressionToString(e.e1, env, refPrefix);
-        let right = convertExpressionToString(e.e2, env, refPrefix);
-        return `(${left} ${op} ${right})`;
-    } else if (isNegExpr(e)) {
-        if (isNegIntExpr(e)) {
-            const expr = convertExpressionToString(e.ne, env, refPrefix);
-            return `-${expr}`;
-        } else if (isNegBoolExpr(e)) {
-            const expr = convertExpressionToString(e.ne, env, refPrefix);
-            return `!${expr}`;
-        }
-    } else if (isGroup(e)) {
-        let expr = convertExpressionToString(e.ge, env, refPrefix);
-        return `(${expr})`;
+/* Events in declaration order, which is the id order of binary event streams */
+function generateEventIds(ctx: GeneratorContext): Generated {
+    if (ctx.statemachine.events.length === 0) {
+        return undefined;
     }
-    throw new Error(chalk.red('Unhandled Expression: ' + e));
+    return toNode`
+        constexpr Event event_ids[${ctx.statemachine.events.length}] = { ${ctx.statemachine.events.map(event => `&${ctx.statemachine.name}::${event.name}`).join(', ')} };
+    `;
 }
 
 function generateMain(ctx: GeneratorContext, env: StatemachineEnv): Generated {
+    const coroutines = usesCoroutineTimeouts(ctx);
+    const invoke = (event: string) => coroutines ? `statemachine->post(${event});` : `(statemachine->*${event})();`;
+    const onEventId = ctx.statemachine.events.length === 0
+        ? '[](std::size_t, std::uint64_t) {}'
+        : `[statemachine](std::size_t id, std::uint64_t) { ${invoke('event_ids[id]')} }`;
     return toNode`
-        int main() {
-            ${ctx.statemachine.name} *statemachine = new ${ctx.statemachine.name}(new ${ctx.statemachine.init.$refText});
-
-            static std::map<std::string, Event> event_by_name;
-            ${joinWithExtraNL(ctx.statemachine.events, event => `event_by_name["${event.name}"] = &${ctx.statemachine.name}::${event.name};`)}
-            for (std::string input; std::getline(std::cin, input);) {
-                std::map<std::string, Event>::const_iterator event_by_name_it = event_by_name.find(input);
-                if (event_by_name_it == event_by_name.end()) {
-                    std::cout << "There is no event <" << input << "> in the ${ctx.statemachine.name} statemachine." << std::endl;
-                    continue;
-                }
-                Event event_invoker = event_by_name_it->second;
-                (statemachine->*event_invoker)();
+        int main(int argc, char **argv) {
+            std::ios::sync_with_stdio(false);
+            ${generateLogOpen(ctx, 'event_stream_fingerprint')}
+            ${ctx.timeline ? `SM_TIMELINE_OPEN("${ctx.statemachine.name}");` : undefined}
+            ${ctx.statemachine.name} *statemachine = new ${ctx.statemachine.name}(&${ctx.statemachine.init.$refText}::instance);
+
+            ${coroutines ? 'statemachine_input::before_stdin_read = statemachine_timer::run_timers_until_input;' : undefined}
+            const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+            int status = 0;
+            if (arguments.binary) {
+                status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, ${ctx.statemachine.events.length}, ${onEventId});
+            } else {
+                status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+                    const int slot = find_event_slot(input);
+                    if (slot < 0) {
+                        SM_TRACE("There is no event <" << input << "> in the ${ctx.statemachine.name} statemachine.");
+                        ${ctx.probes ? `SM_PROBE(unknown_event, statemachine, statemachine->state_id(), ${ctx.statemachine.events.length});` : undefined}
+                        return;
+                    }
+                    ${invoke('event_slot_values[slot]')}
+                });
             }
+            ${coroutines ? 'statemachine_timer::scheduler::instance().run_until_idle();' : undefined}
 
+            ${ctx.stats ? 'SM_STATS_DUMP(statemachine);' : undefined}
+            ${ctx.timeline ? 'SM_TIMELINE_FLUSH();' : undefined}
             delete statemachine;
-            return 0;
+            ${generateLogClose(ctx)}
+            return status;
         }
     `;
 }
\ No newline at end of file
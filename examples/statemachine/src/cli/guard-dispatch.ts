@@ -0,0 +1,177 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+import { type Generated, CompositeGeneratorNode, traceToNode } from 'langium/generate';
+import { type Attribute, type Expression, type State, type Transition, isBinExpr, isGroup, isLiteral, isNegIntExpr, isRef } from '../language-server/generated/ast.js';
+import type { StatemachineEnv } from './interpreter.js';
+import { cppType, generateGuardCondition } from './generator-util.js';
+import { isIntegerType } from './interpret-util.js';
+import { guardOutcome } from './expression-ir.js';
+
+/* The alternatives of every event a state handles, in the order the events first appear; within a group the
+   transitions keep their model order, which is the order their guards are tried in */
+export function groupTransitionsByEvent(state: State): Transition[][] {
+    const groups = new Map<string, Transition[]>();
+    for (const transition of state.transitions) {
+        const group = groups.get(transition.event.$refText);
+        if (group) {
+            group.push(transition);
+        } else {
+            groups.set(transition.event.$refText, [transition]);
+        }
+    }
+    return [...groups.values()];
+}
+
+/* Alternatives whose guard folds to false, and those after the first one whose guard is missing or folds to true, can
+   never fire */
+export function reachableAlternatives(group: Transition[]): Transition[] {
+    const firing = group.filter(transition => guardOutcome(transition) !== false);
+    const unguarded = firing.findIndex(transition => guardOutcome(transition) === true);
+    return unguarded < 0 ? firing : firing.slice(0, unguarded + 1);
+}
+
+/* Inclusive integer range of one attribute a guard selects; bounds may be infinite */
+interface GuardInterval {
+    attribute: Attribute;
+    low: number;
+    high: number;
+}
+
+function integerLiteral(e: Expression): number | undefined {
+    if (isGroup(e)) {
+        return integerLiteral(e.ge);
+    }
+    if (isNegIntExpr(e)) {
+        const value = integerLiteral(e.ne);
+        return value === undefined ? undefined : -value;
+    }
+    return isLiteral(e) && typeof e.val === 'number' && Number.isInteger(e.val) ? e.val : undefined;
+}
+
+function intAttribute(e: Expression): Attribute | undefined {
+    if (isGroup(e)) {
+        return intAttribute(e.ge);
+    }
+    return isRef(e) && e.val.ref && isIntegerType(e.val.ref.type) ? e.val.ref : undefined;
+}
+
+const MIRRORED: Record<string, string> = { '<': '>', '<=': '>=', '>': '<', '>=': '<=', '==': '==' };
+
+/* Recognizes `a op n`, `n op a` and conjunctions of those on the same integer attribute `a` */
+function guardInterval(e: Expression): GuardInterval | undefined {
+    if (isGroup(e)) {
+        return guardInterval(e.ge);
+    }
+    if (!isBinExpr(e)) {
+        return undefined;
+    }
+    if (e.op === '&&') {
+        const left = guardInterval(e.e1);
+        const right = guardInterval(e.e2);
+        if (left === undefined || right === undefined || left.attribute !== right.attribute) {
+            return undefined;
+        }
+        return { attribute: left.attribute, low: Math.max(left.low, right.low), high: Math.min(left.high, right.high) };
+    }
+    let attribute = intAttribute(e.e1);
+    let value = integerLiteral(e.e2);
+    let op: string | undefined = e.op;
+    if (attribute === undefined || value === undefined) {
+        attribute = intAttribute(e.e2);
+        value = integerLiteral(e.e1);
+        op = MIRRORED[e.op];
+    }
+    if (attribute === undefined || value === undefined) {
+        return undefined;
+    }
+    switch (op) {
+        case '<': return { attribute, low: -Infinity, high: value - 1 };
+        case '<=': return { attribute, low: -Infinity, high: value };
+        case '>': return { attribute, low: value + 1, high: Infinity };
+        case '>=': return { attribute, low: value, high: Infinity };
+        case '==': return { attribute, low: value, high: value };
+        default: return undefined;
+    }
+}
+
+interface DecisionTree {
+    attribute: Attribute;
+    intervals: Array<GuardInterval & { transition: Transition }>;
+}
+
+/* A decision tree applies when every guarded alternative selects a non-empty range of the same int attribute and no two
+   ranges overlap: then at most one guard holds, so their order does not matter and a binary search finds it */
+function planDecisionTree(guarded: Transition[]): DecisionTree | undefined {
+    if (guarded.length < 2) {
+        return undefined;
+    }
+    const intervals: DecisionTree['intervals'] = [];
+    for (const transition of guarded) {
+        const interval = guardInterval(transition.guard!);
+        if (interval === undefined || interval.low > interval.high) {
+            return undefined;
+        }
+        if (intervals.length > 0 && interval.attribute !== intervals[0].attribute) {
+            return undefined;
+        }
+        intervals.push({ ...interval, transition });
+    }
+    intervals.sort((a, b) => a.low - b.low);
+    for (let i = 1; i < intervals.length; i++) {
+        if (intervals[i - 1].high >= intervals[i].low) {
+            return undefined;
+        }
+    }
+    return { attribute: intervals[0].attribute, intervals };
+}
+
+function indent(lines: Generated[]): Generated[] {
+    return lines.map(line => typeof line !== 'string' ? new CompositeGeneratorNode('    ', line) : line.length > 0 ? `    ${line}` : line);
+}
+
+/* Code choosing among the alternatives of one (state, event): `body` emits what an alternative does once chosen and
+   `rejected` what happens if no guard holds. Disjoint ranges of one int attribute become a binary search, anything
+   else an if-chain in model order. Returns lines indented relative to the caller; the lines testing a guard are traced
+   to it */
+export function generateAlternatives(group: Transition[], env: StatemachineEnv, refPrefix: string, body: (transition: Transition) => Generated[], rejected: Generated[]): Generated[] {
+    const alternatives = reachableAlternatives(group);
+    const fallback = alternatives.length > 0 && guardOutcome(alternatives[alternatives.length - 1]) === true ? alternatives.pop()! : undefined;
+    const otherwise = fallback ? body(fallback) : rejected;
+    if (alternatives.length === 0) {
+        return otherwise;
+    }
+    // Also checks that every guard is a boolean expression over declared attributes
+    const conditions = alternatives.map(transition => generateGuardCondition(transition, env, refPrefix)!);
+    // Every gap between the ranges repeats the fallback, so only an action-free one keeps the tree small
+    const tree = fallback === undefined || fallback.actions.length === 0 ? planDecisionTree(alternatives) : undefined;
+    if (tree === undefined) {
+        const lines: Generated[] = [];
+        alternatives.forEach((transition, index) => {
+            lines.push(traceToNode(transition, 'guard')(`${index === 0 ? 'if' : '} else if'} (${conditions[index]}) {`), ...indent(body(transition)));
+        });
+        return [...lines, '} else {', ...indent(otherwise), '}'];
+    }
+    // [min, max] is what the enclosing branches already established about the value
+    const search = (first: number, last: number, min: number, max: number): Generated[] => {
+        if (first > last) {
+            return otherwise;
+        }
+        const middle = (first + last) >> 1;
+        const { low, high, transition } = tree.intervals[middle];
+        const branches: Array<[string, Generated[]]> = [];
+        if (low > min) {
+            branches.push([`value < ${low}`, search(first, middle - 1, min, low - 1)]);
+        }
+        if (high < max) {
+            branches.push([`value > ${high}`, search(middle + 1, last, high + 1, max)]);
+        }
+        const lines: Generated[] = [];
+        branches.forEach(([condition, branch], index) => lines.push(`${index === 0 ? 'if' : '} else if'} (${condition}) {`, ...indent(branch)));
+        return branches.length === 0 ? body(transition) : [...lines, '} else {', ...indent(body(transition)), '}'];
+    };
+    return [`const ${cppType(tree.attribute.type)} value = ${refPrefix}${tree.attribute.name};`, ...search(0, tree.intervals.length - 1, -Infinity, Infinity)];
+}
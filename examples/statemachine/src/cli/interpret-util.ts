@@ -6,8 +6,87 @@ import chalk from "chalk";
 
 // }
 export const ERROR_MESSAGE_GUARD_NOT_BOOL = 'Guard must be a boolean expression';
-export function getDefaultAttributeValue(attribute: Attribute): number | boolean {
-    return attribute.type == 'bool' ? false : 0;
+export function getDefaultAttributeValue(attribute: Attribute): number | boolean | bigint {
+    return attribute.type == 'bool' ? false : wrapToType(0, attribute.type);
+}
+
+/* Fixed-width attribute types. Arithmetic on them wraps around modulo 2^bits (two's complement for the signed ones)
+   after every operation, and so does assigning a constant out of range; `int` keeps the host's int */
+export const FIXED_WIDTH_TYPES: Record<string, { bits: number, signed: boolean, cpp: string }> = {
+    u8: { bits: 8, signed: false, cpp: 'std::uint8_t' },
+    u16: { bits: 16, signed: false, cpp: 'std::uint16_t' },
+    i16: { bits: 16, signed: true, cpp: 'std::int16_t' },
+    i32: { bits: 32, signed: true, cpp: 'std::int32_t' },
+    i64: { bits: 64, signed: true, cpp: 'std::int64_t' },
+};
+
+export function isIntegerType(type: string): boolean {
+    return type === 'int' || type in FIXED_WIDTH_TYPES;
+}
+
+/* Whether an expression reads no attribute, like the literal in `count + 1` */
+export function isConstantExpression(e: Expression): boolean {
+    if (isRef(e)) {
+        return false;
+    } else if (isBinExpr(e)) {
+        return isConstantExpression(e.e1) && isConstantExpression(e.e2);
+    } else if (isNegExpr(e)) {
+        return isConstantExpression(e.ne);
+    } else if (isGroup(e)) {
+        return isConstantExpression(e.ge);
+    }
+    return true;
+}
+
+/* Common type of two integer operands: a constant of type int takes the fixed-width type of the other operand */
+export function unifyIntegerTypes(e1: Expression, type1: string, e2: Expression, type2: string): string | undefined {
+    if (type1 === type2) {
+        return type1;
+    } else if (type1 === 'int' && type2 in FIXED_WIDTH_TYPES && isConstantExpression(e1)) {
+        return type2;
+    } else if (type2 === 'int' && type1 in FIXED_WIDTH_TYPES && isConstantExpression(e2)) {
+        return type1;
+    }
+    return undefined;
+}
+
+/* Whether a value of `valueType` may initialize or be assigned to an attribute of `targetType` */
+export function isAssignable(value: Expression, valueType: string, targetType: string): boolean {
+    return valueType === targetType || (valueType === 'int' && targetType in FIXED_WIDTH_TYPES && isConstantExpression(value));
+}
+
+/* Type of an integer expression, without the scope checks of inferType */
+export function integerTypeOf(e: Expression): string {
+    if (isRef(e)) {
+        return e.val.ref?.type ?? 'int';
+    } else if (isGroup(e)) {
+        return integerTypeOf(e.ge);
+    } else if (isNegIntExpr(e)) {
+        return integerTypeOf(e.ne);
+    } else if (isBinExpr(e)) {
+        return unifyIntegerTypes(e.e1, integerTypeOf(e.e1), e.e2, integerTypeOf(e.e2)) ?? 'int';
+    }
+    return 'int';
+}
+
+function toBigInt(value: number | bigint): bigint {
+    return typeof value === 'bigint' ? value : BigInt(Math.trunc(value));
+}
+
+/* Wraps an integer into a fixed-width type. i64 values are BigInts, as doubles cannot hold all of them; narrower
+   types stay numbers */
+export function wrapToType(value: number | bigint, type: string): number | bigint {
+    const fixed = FIXED_WIDTH_TYPES[type];
+    if (fixed === undefined) {
+        return value;
+    }
+    const wrapped = fixed.signed ? BigInt.asIntN(fixed.bits, toBigInt(value)) : BigInt.asUintN(fixed.bits, toBigInt(value));
+    return fixed.bits > 32 ? wrapped : Number(wrapped);
+}
+
+/* Value of an attribute after initialization or assignment: booleans as they are, integers wrapped into its type */
+export function coerceToAttributeType(value: number | boolean | bigint, type: string): number | boolean | bigint {
+    return typeof value === 'boolean' ? value : wrapToType(value, type);
 }
 
 export function eventsAreValid(model: Statemachine, eventNames: string[]): boolean {
@@ -41,10 +120,14 @@ export function inferType(e: Expression, env: StatemachineEnv, rootAssignableNam
         evalExpression(e, env);
         return e.val.ref?.type;
     } else if (isBinExpr(e) && e?.$type === 'BinExpr') {
-        const leftType = inferType(e.e1, env, rootAssignableName);
-        const rightType = inferType(e.e2, env, rootAssignableName);
+        let leftType = inferType(e.e1, env, rootAssignableName);
+        let rightType = inferType(e.e2, env, rootAssignableName);
         if (leftType !== rightType) {
-            throw new Error(`Type mismatch: ${leftType} ${e.op} ${rightType}`);
+            const common = unifyIntegerTypes(e.e1, leftType, e.e2, rightType);
+            if (common === undefined) {
+                throw new Error(`Type mismatch: ${leftType} ${e.op} ${rightType}`);
+            }
+            leftType = rightType = common;
         }
         if (e.op === '||' || e.op === '&&') {
             if (leftType !== 'bool' || rightType !== 'bool') {
@@ -54,12 +137,12 @@ export function inferType(e: Expression, env: StatemachineEnv, rootAssignableNam
         } else if (['==', '!='].includes(e.op)) {
             return 'bool';
         } else if (['<', '>', '<=', '>='].includes(e.op)) {
-            if (leftType !== 'int' || rightType !== 'int') {
+            if (!isIntegerType(leftType)) {
                 throw new Error(`Invalid types for comparison operation: ${leftType} ${e.op} ${rightType}`);
             }
             return 'bool';
         } else {
-            if (leftType !== 'int' || rightType !== 'int') {
+            if (!isIntegerType(leftType)) {
                 throw new Error(`Invalid types for arithmetic operation: ${leftType} ${e.op} ${rightType}`);
             }
             if (e.op === '/') {
@@ -81,15 +164,15 @@ export function inferType(e: Expression, env: StatemachineEnv, rootAssignableNam
                 //     console.error('error', (error as Error).message);
                 // }
             }
-            return 'int';
+            return leftType;
         }
     } else if (isNegExpr(e)) {
         if (isNegIntExpr(e)) {
             const exprType = inferType(e.ne, env, rootAssignableName);
-            if (exprType !== 'int') {
+            if (!isIntegerType(exprType)) {
                 throw new Error(`Invalid type for integer negation: ${exprType}`);
             }
-            return 'int';
+            return exprType;
         } else if (isNegBoolExpr(e)) {
             const exprType = inferType(e.ne, env, rootAssignableName);
             if (exprType !== 'bool') {
@@ -103,7 +186,7 @@ export function inferType(e: Expression, env: StatemachineEnv, rootAssignableNam
     throw new Error(chalk.red('Unhandled Expression: ' + e));
 }
 
-export function evalExpression(e: Expression, env: StatemachineEnv): number | boolean {
+export function evalExpression(e: Expression, env: StatemachineEnv): number | boolean | bigint {
     if (isLiteral(e)) {
         if (e.val === undefined)
             throw new Error('Literal value is undefined');
@@ -111,19 +194,23 @@ export function evalExpression(e: Expression, env: StatemachineEnv): number | bo
     } else if (isRef(e)) {
         const refName = e.val.ref?.name;
         if (refName && env.get(refName) !== undefined) {
-            return env.get(refName) as number | boolean;
+            return env.get(refName) as number | boolean | bigint;
         } else {
             throw new Error(`Undefined reference: ${refName}`);
         }
     } else if (isBinExpr(e) && e?.$type === 'BinExpr') {
         const leftValue = evalExpression(e.e1, env);
         const rightValue = evalExpression(e.e2, env);
-        const leftType = typeof leftValue;
-        const rightType = typeof rightValue;
+        // i64 values are BigInts, which mix with the numbers of int constants
+        const leftType = typeof leftValue === 'bigint' ? 'number' : typeof leftValue;
+        const rightType = typeof rightValue === 'bigint' ? 'number' : typeof rightValue;
         const opval = e.op;
         if (leftType != rightType) {
             // console.log(`Type sd mismatch: ${leftType} ${e.op} ${rightType}`);
             throw new Error(`Type sd mismatch: ${leftType} ${e.op} ${rightType}`);
+        } else if ((e.op === '!=' || e.op === '==') && (typeof leftValue === 'bigint' || typeof rightValue === 'bigint')) {
+            const equal = toBigInt(leftValue as number | bigint) === toBigInt(rightValue as number | bigint);
+            return e.op === '==' ? equal : !equal;
         } else if (e.op === '!=' || e.op === '==') {
             return e.op === '==' ? leftValue === rightValue : leftValue !== rightValue;
         } else if (e.op === '||' || e.op === '&&') {
@@ -131,6 +218,8 @@ export function evalExpression(e: Expression, env: StatemachineEnv): number | bo
                 throw new Error(`Invalid types for boolean operation: ${leftType} ${e.op} ${rightType}`);
             }
             return e.op === '||' ? leftValue || rightValue : leftValue && rightValue;
+        } else if (leftType === 'number' && ['<', '>', '<=', '>=', '/', '*', '+', '-'].includes(opval) && (typeof leftValue === 'bigint' || typeof rightValue === 'bigint' || integerTypeOf(e) in FIXED_WIDTH_TYPES)) {
+            return evalFixedWidthOperation(opval, toBigInt(leftValue as number | bigint), toBigInt(rightValue as number | bigint), integerTypeOf(e));
         } else if ((typeof leftValue === 'number' && typeof rightValue === 'number' && (['<', '>', '<=', '>=', '/', '*', '+', '-'].includes(opval)))) {
             switch (opval) {
                 case '<': return leftValue < rightValue;
@@ -143,7 +232,8 @@ export function evalExpression(e: Expression, env: StatemachineEnv): number | bo
                     if (rightValue == 0) {
                         throw new Error('Division by zero');
                     }
-                    return leftValue / rightValue;
+                    // Truncates towards zero like the generated C++
+                    return Math.trunc(leftValue / rightValue);
                 case '*': return leftValue * rightValue;
                 case '+': return leftValue + rightValue;
                 case '-': return leftValue - rightValue;
@@ -155,7 +245,8 @@ export function evalExpression(e: Expression, env: StatemachineEnv): number | bo
     } else if (isNegExpr(e)) {
         if (isNegIntExpr(e)) {
             const value = evalExpression(e.ne, env);
-            return -Number(value);
+            const type = integerTypeOf(e);
+            return type in FIXED_WIDTH_TYPES ? wrapToType(-toBigInt(value as number | bigint), type) : -Number(value);
         } else if (isNegBoolExpr(e)) {
             const value = evalExpression(e.ne, env);
             return !Boolean(value);
@@ -164,4 +255,28 @@ export function evalExpression(e: Expression, env: StatemachineEnv): number | bo
         return evalExpression(e.ge, env);
     }
     throw new Error('Unhandled Expression: ' + e);
-}
\ No newline at end of file
+}
+
+/* Arithmetic and comparisons on fixed-width operands, exact in BigInt; arithmetic results wrap into `type` */
+export function evalFixedWidthOperation(op: string, left: bigint, right: bigint, type: string): number | boolean | bigint {
+    // Constant operands of arithmetic are converted to the type first, as in the generated C++
+    if (['/', '*', '+', '-'].includes(op) && type in FIXED_WIDTH_TYPES) {
+        left = toBigInt(wrapToType(left, type));
+        right = toBigInt(wrapToType(right, type));
+    }
+    switch (op) {
+        case '<': return left < right;
+        case '>': return left > right;
+        case '<=': return left <= right;
+        case '>=': return left >= right;
+        case '/':
+            if (right === 0n) {
+                throw new Error('Division by zero');
+            }
+            return wrapToType(left / right, type);
+        case '*': return wrapToType(left * right, type);
+        case '+': return wrapToType(left + right, type);
+        case '-': return wrapToType(left - right, type);
+        default: throw new Error(`Unrecognized binary operator: ${op}`);
+    }
+}
@@ -2,9 +2,10 @@ import { setTimeout as delay } from 'timers/promises';  // Node.js timers/promis
 import * as readline from 'node:readline/promises';
 import chalk from 'chalk';
 import { Attribute, Command, Event, State, Transition, Action, Statemachine, isStringLiteral } from './../language-server/generated/ast.js';
-import { getDefaultAttributeValue, evalExpression, inferType } from './interpret-util.js';
-export { handleEvents as _testHandleEvents, };
-export type StatemachineEnv = Map<string, number | boolean | undefined>;
+import { getDefaultAttributeValue, evalExpression, inferType, coerceToAttributeType } from './interpret-util.js';
+import { EventQueue, type EventQueueOptions } from './event-queue.js';
+export { handleEvents as _testHandleEvents, selectTransition as _testSelectTransition };
+export type StatemachineEnv = Map<string, number | boolean | bigint | undefined>;
 export type AttributeEnv = Map<string, string[]>;
 export const env: StatemachineEnv = new Map();
 export const uniqueAttributeNames = new Set<string>();
@@ -12,7 +13,7 @@ export const attributeNames: string[] = [];
 
 interface ExecutionContext {
     currentState: State | undefined;
-    events: Event[];
+    events: EventQueue<Event>;
     commands: Command[];
     env: StatemachineEnv;
     attributes: any[];
@@ -28,7 +29,7 @@ async function executeAction(action: Action, context: ExecutionContext): Promise
         const variableName = action.assignment.variable.ref?.name;
         if (variableName) {
             const value = evalExpression(action.assignment.value, context.env);
-            context.env.set(variableName, value);
+            context.env.set(variableName, coerceToAttributeType(value, action.assignment.variable.ref!.type));
         }
     } else if (action.print) {
         const values = action.print.values.map(value => {
@@ -44,15 +45,24 @@ async function executeAction(action: Action, context: ExecutionContext): Promise
     }
 }
 
-async function executeTransition(transition: Transition, context: ExecutionContext): Promise<void> {
-    const guardExpression = (transition.guard && evalExpression(transition.guard, context.env)) ?? true;
-    if (transition.guard && typeof guardExpression !== 'boolean') {
-        throw new Error(`Guard expression must evaluate to a boolean value.`);
-    } else if (transition.guard && !guardExpression) {
-        console.log(chalk.yellow(`Transition failed from ${context.currentState?.name} to ${transition.state?.ref?.name} due to guard condition evaluating to false.`));
-        throw new Error(`Transition failed from ${context.currentState?.name} to ${transition.state?.ref?.name} due to guard condition evaluating to false.`);
+/* The alternatives for an event are tried in model order and the first whose guard holds fires, as in the generated code */
+function selectTransition(transitions: Transition[], eventName: string, env: StatemachineEnv): Transition | undefined {
+    for (const transition of transitions) {
+        if (transition.event.ref?.name !== eventName) {
+            continue;
+        }
+        const guardExpression = transition.guard ? evalExpression(transition.guard, env) : true;
+        if (typeof guardExpression !== 'boolean') {
+            throw new Error(`Guard expression must evaluate to a boolean value.`);
+        }
+        if (guardExpression) {
+            return transition;
+        }
     }
+    return undefined;
+}
 
+async function executeTransition(transition: Transition, context: ExecutionContext): Promise<void> {
     const oldState = context.currentState?.name;
     for (const action of transition.actions) {
         await executeAction(action, context);
@@ -67,18 +77,11 @@ async function handleEvents(context: ExecutionContext): Promise<void> {
         console.log(chalk.green(`Current State: ${context.currentState.name}`));
         const event = context.events.shift();
         if (event) {
-            for (const transition of context.currentState.transitions) {
-                if (transition.event.ref?.name === event.name) {
-                    try {
-                        await executeTransition(transition, context);
-                    } catch (error) {
-                        if ((error as Error).message === 'Guard expression must evaluate to a boolean value.') {
-                            throw error;
-                        } else {// Transition failed due to guard condition being false 
-                            continue;
-                        }
-                    }
-                }
+            const transition = selectTransition(context.currentState.transitions, event.name, context.env);
+            if (transition) {
+                await executeTransition(transition, context);
+            } else if (context.currentState.transitions.some(t => t.event.ref?.name === event.name)) {
+                console.log(chalk.yellow(`Transition failed from ${context.currentState.name} on ${event.name} because no guard condition evaluated to true.`));
             }
         }
     }
@@ -87,7 +90,7 @@ async function handleEvents(context: ExecutionContext): Promise<void> {
 function interpretModel(model: Statemachine) {
     const attributes = model.attributes.map((attribute: Attribute) => {
         attribute.defaultValue && inferType(attribute.defaultValue, env);
-        const attributeValue = attribute.defaultValue ? evalExpression(attribute.defaultValue, env) : getDefaultAttributeValue(attribute);
+        const attributeValue = attribute.defaultValue ? coerceToAttributeType(evalExpression(attribute.defaultValue, env), attribute.type) : getDefaultAttributeValue(attribute);
         env.set(attribute.name, attributeValue);
         return {
             ...attribute,
@@ -135,7 +138,7 @@ export async function interpretStatemachineStatic(model: Statemachine, events: s
 
     const context: ExecutionContext = {
         currentState: interpretedModel.initialState,
-        events: [],
+        events: new EventQueue(),
         env: env,
         commands: interpretedModel.commands,
         attributes: interpretedModel.attributes,
@@ -162,11 +165,11 @@ export async function interpretStatemachineStatic(model: Statemachine, events: s
     console.log('Interpretation completed successfully!');
     return context;
 }
-export async function interpretStatemachine(model: Statemachine): Promise<void> {
+export async function interpretStatemachine(model: Statemachine, options: EventQueueOptions = {}): Promise<void> {
     const interpretedModel = interpretModel(model);
     const context: ExecutionContext = {
         currentState: interpretedModel.initialState,
-        events: [],
+        events: new EventQueue(options),
         env: env,
         commands: interpretedModel.commands,
         attributes: interpretedModel.attributes,
@@ -184,21 +187,21 @@ export async function interpretStatemachine(model: Statemachine): Promise<void>
     let processingEvent = false;
 
     rl.on('line', async (input) => {
-        if (processingEvent) {
-            console.log(chalk.yellow(`Input ignored: Currently processing a transition...`));
-            return;  // Ignore input while processing an event
-        }
-
         const event = interpretedModel.events.find(e => e.name === input.trim());
-        if (event) {
-            processingEvent = true;  // Block further input
-            context.events.push(event);
-            await handleEvents(context);  // Await to handle async actions like setTimeout
-            console.log(chalk.green(`Current State: [${context.currentState?.name}]`));
-            processingEvent = false;  // Unblock input
-        } else {
+        if (!event) {
             console.error(`Event ${input} not found in the model.`);
+            return;
+        }
+        if (!context.events.push(event) && context.events.overflow === 'reject') {
+            console.log(chalk.yellow(`Input rejected: the event queue is full.`));
+        }
+        if (processingEvent) {
+            return;  // Queued events are handled by the transition in flight once it completes
         }
+        processingEvent = true;
+        await handleEvents(context);  // Await to handle async actions like setTimeout
+        console.log(chalk.green(`Current State: [${context.currentState?.name}]`));
+        processingEvent = false;
     });
 
     rl.on('close', () => {
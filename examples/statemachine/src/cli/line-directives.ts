@@ -0,0 +1,92 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+import * as url from 'node:url';
+import { type Generated, type TraceRegion, isGeneratorNode, toString, toStringAndTrace } from 'langium/generate';
+
+/* A line of the model file, 1-based as in #line */
+interface SourceLine {
+    file: string;
+    line: number;
+}
+
+function sourceFile(fileURI: string): string {
+    return fileURI.startsWith('file:') ? url.fileURLToPath(fileURI) : fileURI;
+}
+
+/* The model line each generated line comes from: that of the innermost traced region holding the line's first
+   non-blank character. Untraced and blank lines map to nothing */
+function mapLines(lines: string[], trace: TraceRegion): Array<SourceLine | undefined> {
+    const starts: number[] = [];
+    lines.reduce((offset, line) => {
+        starts.push(offset);
+        return offset + line.length + 1;
+    }, 0);
+    const firstCharacter = lines.map((line, index) => line.trim().length > 0 ? starts[index] + line.length - line.trimStart().length : -1);
+    const lineAt = (offset: number) => {
+        let low = 0;
+        let high = starts.length - 1;
+        while (low < high) {
+            const middle = (low + high + 1) >> 1;
+            if (starts[middle] <= offset) {
+                low = middle;
+            } else {
+                high = middle - 1;
+            }
+        }
+        return low;
+    };
+    const mapped: Array<SourceLine | undefined> = lines.map(() => undefined);
+    // Children come after their parent, so the innermost region wins; the file URI is only kept where it changes
+    const visit = (region: TraceRegion, fileURI: string | undefined) => {
+        const file = region.sourceRegion?.fileURI ?? fileURI;
+        const line = region.sourceRegion?.range?.start.line;
+        if (file !== undefined && line !== undefined) {
+            const { offset, end } = region.targetRegion;
+            for (let index = lineAt(offset); index < lines.length && starts[index] < end; index++) {
+                if (firstCharacter[index] >= offset && firstCharacter[index] < end) {
+                    mapped[index] = { file: sourceFile(file), line: line + 1 };
+                }
+            }
+        }
+        region.children?.forEach(child => visit(child, file));
+    };
+    visit(trace, undefined);
+    return mapped;
+}
+
+/* The text of a generated file with #line directives wherever the traced model line changes, so that compiler
+   diagnostics, debuggers, profilers and sanitizers point at the transition, guard or action in the .statemachine file.
+   Untraced code is set back to its own line in `generatedFile`. Blank lines and lines continuing a macro get no
+   directive */
+export function toStringWithLineDirectives(content: Generated, generatedFile: string): string {
+    if (!isGeneratorNode(content)) {
+        return toString(content);
+    }
+    const { text, trace } = toStringAndTrace(content);
+    const lines = text.split('\n');
+    const mapped = mapLines(lines, trace);
+    const output: string[] = [];
+    // Where the compiler believes the next line is
+    let file = generatedFile;
+    let next = 1;
+    lines.forEach((line, index) => {
+        const continued = index > 0 && lines[index - 1].endsWith('\\');
+        if (line.trim().length > 0 && !continued) {
+            const source = mapped[index];
+            const target = source ?? { file: generatedFile, line: output.length + 1 };
+            if (target.file !== file || target.line !== next) {
+                // The directive pushes a generated line one further down
+                file = target.file;
+                next = source ? source.line : output.length + 2;
+                output.push(`#line ${next} ${JSON.stringify(file)}`);
+            }
+        }
+        output.push(line);
+        next++;
+    });
+    return output.join('\n');
+}
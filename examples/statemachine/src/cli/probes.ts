@@ -0,0 +1,108 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+import { expandToNode as toNode, type Generated } from 'langium/generate';
+import type { Action, Transition } from '../language-server/generated/ast.js';
+import type { GeneratorContext } from './generator-util.js';
+import { mergedStateNames } from './state-minimization.js';
+
+/*
+ * USDT probes of machines generated with `--probes`, under the machine's name as provider:
+ *
+ *   transition_entry(machine, state, event)         a handler of the state starts on the event
+ *   transition_exit(machine, target, event)         the machine is in the target state of the transition
+ *   guard_rejected(machine, state, event)           no guard of the handler held
+ *   unknown_event(machine, state, event)            the state has no transition for the event; the event is
+ *                                                   event_count for input that names no event at all
+ *   command(machine, state, event, command)         a run action of the transition invokes the command
+ *
+ * `machine` is the address of the machine, the others are indices in model order. An entry is followed by either
+ * an exit or a rejection, so the time between them is the latency of the transition, delays included.
+ */
+export type ProbeName = 'transition_entry' | 'transition_exit' | 'guard_rejected' | 'unknown_event';
+
+/* SM_PROBE and SM_PROBE_COMMAND: sys/sdt.h probes where the header exists, otherwise the same nop and .note.stapsdt
+   entry written inline on x86-64 ELF targets, and nothing elsewhere or with -DSM_PROBES=0 */
+export function generateProbeMacros(ctx: GeneratorContext): Generated {
+    if (!ctx.probes) {
+        return undefined;
+    }
+    const provider = ctx.statemachine.name;
+    return toNode`
+        #ifndef SM_PROBES
+        #define SM_PROBES 1
+        #endif
+        #if SM_PROBES && __has_include(<sys/sdt.h>)
+        #include <sys/sdt.h>
+        #define SM_PROBE(name, machine, state, event) \\
+            DTRACE_PROBE3(${provider}, name, reinterpret_cast<std::uintptr_t>(machine), static_cast<std::uint32_t>(state), static_cast<std::uint32_t>(event))
+        #define SM_PROBE_COMMAND(machine, state, event, command_id) \\
+            DTRACE_PROBE4(${provider}, command, reinterpret_cast<std::uintptr_t>(machine), static_cast<std::uint32_t>(state), static_cast<std::uint32_t>(event), static_cast<std::uint32_t>(command_id))
+        #elif SM_PROBES && defined(__x86_64__) && defined(__ELF__) && defined(__GNUC__)
+        // What sys/sdt.h emits: a nop to place the uprobe on, and a note telling tracers where it is and where its
+        // arguments are. The note is not loaded, so a probe costs the nop and the moves of its arguments.
+        #define SM_PROBE_ASM(name, arguments) \\
+            "990: nop\\n" \\
+            ".pushsection .note.stapsdt,\\"?\\",\\"note\\"\\n" \\
+            ".balign 4\\n" \\
+            ".4byte 992f-991f, 994f-993f, 3\\n" \\
+            "991: .asciz \\"stapsdt\\"\\n" \\
+            "992: .balign 4\\n" \\
+            "993: .8byte 990b\\n" \\
+            ".8byte _.stapsdt.base\\n" \\
+            ".8byte 0\\n" \\
+            ".asciz \\"${provider}\\"\\n" \\
+            ".asciz \\"" #name "\\"\\n" \\
+            ".asciz \\"" arguments "\\"\\n" \\
+            "994: .balign 4\\n" \\
+            ".popsection\\n" \\
+            ".ifndef _.stapsdt.base\\n" \\
+            ".pushsection .stapsdt.base,\\"aG\\",\\"progbits\\",.stapsdt.base,comdat\\n" \\
+            ".weak _.stapsdt.base\\n" \\
+            ".hidden _.stapsdt.base\\n" \\
+            "_.stapsdt.base: .space 1\\n" \\
+            ".size _.stapsdt.base, 1\\n" \\
+            ".popsection\\n" \\
+            ".endif\\n"
+        #define SM_PROBE_OPERANDS(machine, state, event) [sm_machine] "nor"(reinterpret_cast<std::uintptr_t>(machine)), [sm_state] "nor"(static_cast<std::uint32_t>(state)), [sm_event] "nor"(static_cast<std::uint32_t>(event))
+        #define SM_PROBE(name, machine, state, event) \\
+            __asm__ __volatile__(SM_PROBE_ASM(name, "8@%[sm_machine] 4@%[sm_state] 4@%[sm_event]") :: SM_PROBE_OPERANDS(machine, state, event))
+        #define SM_PROBE_COMMAND(machine, state, event, command_id) \\
+            __asm__ __volatile__(SM_PROBE_ASM(command, "8@%[sm_machine] 4@%[sm_state] 4@%[sm_event] 4@%[sm_command]") \\
+                :: SM_PROBE_OPERANDS(machine, state, event), [sm_command] "nor"(static_cast<std::uint32_t>(command_id)))
+        #else
+        #define SM_PROBE(name, machine, state, event) static_cast<void>(0)
+        #define SM_PROBE_COMMAND(machine, state, event, command_id) static_cast<void>(0)
+        #endif
+    `;
+}
+
+/* Index of the state named `name` in the generated machine; after minimisation the name may be an alias */
+function stateId(ctx: GeneratorContext, name: string): number {
+    return ctx.statemachine.states.findIndex(state => state.name === name || mergedStateNames(state).includes(name));
+}
+
+function eventId(ctx: GeneratorContext, transition: Transition): number {
+    return ctx.statemachine.events.findIndex(event => event.name === transition.event.$refText);
+}
+
+/* A probe at a transition of the state named `stateName`, or undefined without `--probes` */
+export function transitionProbe(ctx: GeneratorContext, probe: ProbeName, stateName: string, transition: Transition): string | undefined {
+    if (!ctx.probes) {
+        return undefined;
+    }
+    return `SM_PROBE(${probe}, statemachine, ${stateId(ctx, stateName)}, ${eventId(ctx, transition)});`;
+}
+
+/* The command probe of a run action, which precedes the command */
+export function commandProbe(ctx: GeneratorContext, action: Action): string | undefined {
+    if (!ctx.probes || !action.command) {
+        return undefined;
+    }
+    const transition = action.$container;
+    const command = ctx.statemachine.commands.findIndex(command => command.name === action.command!.$refText);
+    return `SM_PROBE_COMMAND(statemachine, ${stateId(ctx, transition.$container.name)}, ${eventId(ctx, transition)}, ${command});`;
+}
@@ -0,0 +1,234 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+import { type Attribute, type Expression, type State, type Statemachine, type Transition, isBinExpr, isGroup, isLiteral, isNegBoolExpr, isNegIntExpr, isRef } from '../language-server/generated/ast.js';
+import { type Interval, evalInterval, inferAttributeRanges } from './attribute-layout.js';
+import { guardOutcome, lowerExpression, optimizeExpression } from './expression-ir.js';
+import { groupTransitionsByEvent } from './guard-dispatch.js';
+import { type GeneratorContext, hostSetsAttributes } from './generator-util.js';
+
+/* States that can be entered from the initial state, and the transitions of those states that can fire. `falseGuards`
+   are the transitions of those states that cannot fire because their guard never holds; the others that cannot fire
+   come after one whose guard always holds */
+export interface Reachability {
+    states: Set<State>;
+    transitions: Set<Transition>;
+    falseGuards: Set<Transition>;
+}
+
+export interface ReachabilityOptions {
+    /* Attributes may be set from outside the model, as through set_<attribute>() in library mode and the freestanding
+       profile; a guard is then only ruled out if it folds to false */
+    externalWrites?: boolean;
+}
+
+/* Values the attributes can hold while only the given transitions fire: a range per int attribute and the possible
+   values of each bool attribute. Attributes of the fixed-width types are not tracked */
+interface AttributeFacts {
+    ranges: Map<Attribute, Interval>;
+    bools: Map<Attribute, Set<boolean>>;
+}
+
+function constantBool(e: Expression): boolean | undefined {
+    try {
+        const node = optimizeExpression(lowerExpression(e));
+        return node.kind === 'constant' && typeof node.value === 'boolean' ? node.value : undefined;
+    } catch {
+        return undefined;
+    }
+}
+
+function inferAttributeFacts(statemachine: Statemachine, transitions: Transition[]): AttributeFacts {
+    const bools = new Map<Attribute, Set<boolean>>();
+    const possible = (e: Expression | undefined): boolean[] => {
+        const value = e && constantBool(e);
+        return value === undefined ? [false, true] : [value];
+    };
+    for (const attribute of statemachine.attributes.filter(attribute => attribute.type === 'bool')) {
+        bools.set(attribute, new Set(possible(attribute.defaultValue)));
+    }
+    for (const action of transitions.flatMap(transition => transition.actions)) {
+        const values = action.assignment?.variable.ref && bools.get(action.assignment.variable.ref);
+        possible(action.assignment?.value).forEach(value => values?.add(value));
+    }
+    return { ranges: inferAttributeRanges(statemachine, transitions), bools };
+}
+
+/* Whether every attribute the expression reads is an int attribute with a known range and every literal an integer, so
+   that evalInterval bounds its value */
+function hasInterval(e: Expression, facts: AttributeFacts): boolean {
+    if (isGroup(e)) {
+        return hasInterval(e.ge, facts);
+    }
+    if (isLiteral(e)) {
+        return typeof e.val === 'number' && Number.isInteger(e.val);
+    }
+    if (isRef(e)) {
+        return e.val.ref !== undefined && facts.ranges.has(e.val.ref);
+    }
+    if (isNegIntExpr(e)) {
+        return hasInterval(e.ne, facts);
+    }
+    return isBinExpr(e) && ['+', '-', '*', '/'].includes(e.op) && hasInterval(e.e1, facts) && hasInterval(e.e2, facts);
+}
+
+function compareIntervals(op: string, a: Interval, b: Interval): boolean | undefined {
+    switch (op) {
+        case '<': return a.high < b.low ? true : a.low >= b.high ? false : undefined;
+        case '<=': return a.high <= b.low ? true : a.low > b.high ? false : undefined;
+        case '>': return compareIntervals('<', b, a);
+        case '>=': return compareIntervals('<=', b, a);
+        case '==': return a.low === a.high && b.low === b.high && a.low === b.low ? true : a.high < b.low || b.high < a.low ? false : undefined;
+        case '!=': {
+            const equal = compareIntervals('==', a, b);
+            return equal === undefined ? undefined : !equal;
+        }
+    }
+    return undefined;
+}
+
+/* True or false if the guard has that value for all attribute values the facts allow, undefined if it depends on them */
+function evalGuard(e: Expression, facts: AttributeFacts): boolean | undefined {
+    if (isGroup(e)) {
+        return evalGuard(e.ge, facts);
+    }
+    if (isLiteral(e)) {
+        return typeof e.val === 'boolean' ? e.val : undefined;
+    }
+    if (isRef(e)) {
+        const values = e.val.ref && facts.bools.get(e.val.ref);
+        return values?.size === 1 ? [...values][0] : undefined;
+    }
+    if (isNegBoolExpr(e)) {
+        const operand = evalGuard(e.ne, facts);
+        return operand === undefined ? undefined : !operand;
+    }
+    if (!isBinExpr(e)) {
+        return undefined;
+    }
+    if (e.op === '&&' || e.op === '||') {
+        const left = evalGuard(e.e1, facts);
+        const right = evalGuard(e.e2, facts);
+        const dominant = e.op === '||';
+        return left === dominant || right === dominant ? dominant : left === undefined || right === undefined ? undefined : !dominant;
+    }
+    if (hasInterval(e.e1, facts) && hasInterval(e.e2, facts)) {
+        return compareIntervals(e.op, evalInterval(e.e1, facts.ranges), evalInterval(e.e2, facts.ranges));
+    }
+    if (e.op === '==' || e.op === '!=') {
+        const left = evalGuard(e.e1, facts);
+        const right = evalGuard(e.e2, facts);
+        return left === undefined || right === undefined ? undefined : (left === right) === (e.op === '==');
+    }
+    return undefined;
+}
+
+function transitionOutcome(transition: Transition, facts: AttributeFacts | undefined): boolean | undefined {
+    return guardOutcome(transition) ?? (facts && transition.guard && evalGuard(transition.guard, facts));
+}
+
+/* Breadth-first search from the initial state over the candidate transitions that can fire: within the alternatives
+   for one event those whose guard never holds are skipped, and those after one whose guard always holds are never tried */
+function explore(statemachine: Statemachine, candidates: Set<Transition>, facts: AttributeFacts | undefined): Reachability {
+    const initial = statemachine.init?.ref;
+    const states = new Set<State>(initial ? [initial] : []);
+    const transitions = new Set<Transition>();
+    const falseGuards = new Set<Transition>();
+    const queue = [...states];
+    for (let state = queue.shift(); state !== undefined; state = queue.shift()) {
+        for (const group of groupTransitionsByEvent(state)) {
+            for (const transition of group.filter(transition => candidates.has(transition))) {
+                const outcome = transitionOutcome(transition, facts);
+                if (outcome === false) {
+                    falseGuards.add(transition);
+                    continue;
+                }
+                transitions.add(transition);
+                const target = transition.state.ref;
+                if (target && !states.has(target)) {
+                    states.add(target);
+                    queue.push(target);
+                }
+                if (outcome === true) {
+                    break;
+                }
+            }
+        }
+    }
+    return { states, transitions, falseGuards };
+}
+
+/* Reachable states and transitions that can fire. Guards are judged by the attribute values the transitions found so
+   far can produce; as fewer transitions fire, fewer values are possible and further guards may be ruled out, so the
+   search repeats until the set of transitions no longer shrinks. A machine whose initial state does not resolve is left
+   as it is */
+export function analyzeReachability(statemachine: Statemachine, options: ReachabilityOptions = {}): Reachability {
+    const all = statemachine.states.flatMap(state => state.transitions);
+    if (statemachine.init?.ref === undefined) {
+        return { states: new Set(statemachine.states), transitions: new Set(all), falseGuards: new Set() };
+    }
+    let candidates = new Set(all);
+    const falseGuards = new Set<Transition>();
+    for (;;) {
+        const facts = options.externalWrites ? undefined : inferAttributeFacts(statemachine, [...candidates]);
+        const result = explore(statemachine, candidates, facts);
+        result.falseGuards.forEach(transition => falseGuards.add(transition));
+        if (result.transitions.size === candidates.size) {
+            const reachable = statemachine.states.filter(state => result.states.has(state)).flatMap(state => state.transitions);
+            return { ...result, falseGuards: new Set(reachable.filter(transition => falseGuards.has(transition))) };
+        }
+        candidates = result.transitions;
+    }
+}
+
+const prunedMachines = new WeakMap<Statemachine, Map<boolean, Statemachine>>();
+
+/* The machine without its unreachable states and without transitions that can never fire. Where no transition of a
+   state can fire for an event, one stays behind with a `false` guard, so the event is still rejected rather than
+   reported impossible. The copy shares the AST nodes of everything it keeps, and is cached so that analyses cached
+   per machine, such as the packed layout, run once */
+export function pruneStatemachine(statemachine: Statemachine, options: ReachabilityOptions = {}): Statemachine {
+    const cache = prunedMachines.get(statemachine) ?? new Map<boolean, Statemachine>();
+    prunedMachines.set(statemachine, cache);
+    const cached = cache.get(options.externalWrites ?? false);
+    if (cached) {
+        return cached;
+    }
+    const reachability = analyzeReachability(statemachine, options);
+    const states = statemachine.states.filter(state => reachability.states.has(state)).map(state => {
+        const groups = groupTransitionsByEvent(state);
+        if (groups.every(group => group.every(transition => reachability.transitions.has(transition)))) {
+            return state;
+        }
+        const copy: State = { ...state, transitions: [] };
+        copy.transitions = groups.flatMap(group => {
+            const firing = group.filter(transition => reachability.transitions.has(transition));
+            return firing.length > 0 ? firing : [rejectingTransition(group[0], copy)];
+        });
+        return copy;
+    });
+    const pruned: Statemachine = { ...statemachine, states };
+    cache.set(options.externalWrites ?? false, pruned);
+    return pruned;
+}
+
+function rejectingTransition(transition: Transition, state: State): Transition {
+    const rejecting: Transition = { ...transition, $container: state, actions: [], state: { ...transition.state, ref: state, $refText: state.name } };
+    rejecting.guard = { $type: 'Literal', $container: rejecting, val: false } as Expression;
+    return rejecting;
+}
+
+/* The context the backends generate from: with `prune`, the machine is replaced by its pruned copy. Hosts can set the
+   attributes in library mode and the freestanding profile, so there only guards that fold to false are ruled out */
+export function prunedContext<T extends GeneratorContext>(ctx: T): T {
+    if (!ctx.prune) {
+        return ctx;
+    }
+    if (ctx.log === 'binary') {
+        throw new Error('--prune renumbers the states, so it cannot be combined with --log binary, whose logs are decoded against the whole model');
+    }
+    return { ...ctx, statemachine: pruneStatemachine(ctx.statemachine, { externalWrites: hostSetsAttributes(ctx) }) };
+}
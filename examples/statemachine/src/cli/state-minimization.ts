@@ -0,0 +1,171 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+import { type Action, type Expression, type State, type Statemachine, type Transition, isStringLiteral } from '../language-server/generated/ast.js';
+import { emitExpression, lowerExpression } from './expression-ir.js';
+import { groupTransitionsByEvent } from './guard-dispatch.js';
+import type { GeneratorContext } from './generator-util.js';
+
+function expressionKey(e: Expression): string {
+    return emitExpression(lowerExpression(e), '');
+}
+
+function actionKey(action: Action): string {
+    if (action.assignment) {
+        return `${action.assignment.variable.$refText}=${expressionKey(action.assignment.value)}`;
+    } else if (action.print) {
+        return `print(${action.print.values.map(value => isStringLiteral(value) ? JSON.stringify(value.value) : expressionKey(value)).join(',')})`;
+    } else if (action.command) {
+        return `run ${action.command.$refText}`;
+    } else if (action.setTimeout) {
+        return `setTimeout(${action.setTimeout.duration})`;
+    }
+    throw new Error('Unhandled action');
+}
+
+/* Everything a state's transitions do apart from where they lead, one label per alternative: the event, the position
+   among the alternatives for it, the guard and the actions, printed canonically so that only syntactically identical
+   transitions share a label. Undefined if some part does not resolve; such a state is never merged */
+function transitionLabels(state: State): string[] | undefined {
+    try {
+        return groupTransitionsByEvent(state).flatMap(group => group.map((transition, index) =>
+            `${transition.event.$refText}#${index} when ${transition.guard ? expressionKey(transition.guard) : 'true'} do ${transition.actions.map(actionKey).join('; ')}`));
+    } catch {
+        return undefined;
+    }
+}
+
+/* Classes of behaviourally equivalent states, found with Hopcroft's partition refinement: states start out grouped by
+   their labels, and a class is split as long as some of its states reach a class under a label and others do not.
+   Classes keep their states in model order and are ordered by their first state */
+export function equivalentStates(statemachine: Statemachine): State[][] {
+    const targets = new Map<State, Map<string, State>>();
+    const initial = new Map<string, State[]>();
+    statemachine.states.forEach((state, index) => {
+        const stateLabels = transitionLabels(state);
+        const transitions = stateLabels && groupTransitionsByEvent(state).flat();
+        if (stateLabels === undefined || transitions!.some(transition => transition.state.ref === undefined)) {
+            initial.set(`#unresolved ${index}`, [state]);
+            return;
+        }
+        targets.set(state, new Map(stateLabels.map((label, i) => [label, transitions![i].state.ref!])));
+        const signature = [...stateLabels].sort().join('\n');
+        initial.set(signature, [...(initial.get(signature) ?? []), state]);
+    });
+    const blocks: Array<Set<State>> = [...initial.values()].map(states => new Set(states));
+    const blockOf = new Map<State, number>();
+    blocks.forEach((block, index) => block.forEach(state => blockOf.set(state, index)));
+    // predecessors.get(label).get(target) are the states whose transition with that label leads to target
+    const predecessors = new Map<string, Map<State, State[]>>();
+    for (const [state, stateTargets] of targets) {
+        for (const [label, target] of stateTargets) {
+            const byTarget = predecessors.get(label) ?? new Map<State, State[]>();
+            predecessors.set(label, byTarget);
+            byTarget.set(target, [...(byTarget.get(target) ?? []), state]);
+        }
+    }
+    const allLabels = [...predecessors.keys()];
+    const waiting: Array<[number, string]> = [];
+    const isWaiting = new Set<string>();
+    const wait = (block: number, label: string) => {
+        if (!isWaiting.has(`${block} ${label}`)) {
+            isWaiting.add(`${block} ${label}`);
+            waiting.push([block, label]);
+        }
+    };
+    blocks.forEach((_, block) => allLabels.forEach(label => wait(block, label)));
+    while (waiting.length > 0) {
+        const [splitter, label] = waiting.pop()!;
+        isWaiting.delete(`${splitter} ${label}`);
+        const byTarget = predecessors.get(label)!;
+        const reaching = new Set([...blocks[splitter]].flatMap(target => byTarget.get(target) ?? []));
+        const touched = new Set([...reaching].map(state => blockOf.get(state)!));
+        for (const block of touched) {
+            const inside = [...blocks[block]].filter(state => reaching.has(state));
+            if (inside.length === blocks[block].size) {
+                continue;
+            }
+            const outside = [...blocks[block]].filter(state => !reaching.has(state));
+            const split = blocks.length;
+            blocks[block] = new Set(inside);
+            blocks.push(new Set(outside));
+            outside.forEach(state => blockOf.set(state, split));
+            for (const each of allLabels) {
+                if (isWaiting.has(`${block} ${each}`)) {
+                    wait(split, each);
+                } else {
+                    wait(inside.length <= outside.length ? block : split, each);
+                }
+            }
+        }
+    }
+    const order = new Map(statemachine.states.map((state, index) => [state, index]));
+    return blocks.map(block => [...block].sort((a, b) => order.get(a)! - order.get(b)!))
+        .sort((a, b) => order.get(a[0])! - order.get(b[0])!);
+}
+
+/* Names of the states merged into each state of a minimized machine */
+const stateAliases = new WeakMap<State, string[]>();
+
+/* Names of the other states a state of a minimized machine stands for */
+export function mergedStateNames(state: State): string[] {
+    return stateAliases.get(state) ?? [];
+}
+
+/* The name a state is traced as: in a minimized machine, the names of all states merged into it */
+export function stateDisplayName(state: State): string {
+    return [state.name, ...mergedStateNames(state)].join('|');
+}
+
+/* Enumerators of a state enum: one per state, followed by the merged states of a minimized machine as aliases of the
+   state they were merged into, so that code naming them still compiles */
+export function stateEnumerators(statemachine: Statemachine): string[] {
+    const aliases = statemachine.states.flatMap(state => mergedStateNames(state).map(alias => `${alias} = ${state.name}`));
+    return [...statemachine.states.map(state => state.name), ...aliases];
+}
+
+const minimizedMachines = new WeakMap<Statemachine, Statemachine>();
+
+/* The machine with each class of equivalent states replaced by its first state in model order, which keeps the names of
+   the others as aliases; transitions into a merged state lead to that state instead. Cached like pruneStatemachine */
+export function minimizeStatemachine(statemachine: Statemachine): Statemachine {
+    const cached = minimizedMachines.get(statemachine);
+    if (cached) {
+        return cached;
+    }
+    const classes = equivalentStates(statemachine);
+    const representative = new Map<State, State>();
+    const copies = classes.map(members => {
+        const copy: State = { ...members[0] };
+        members.forEach(member => representative.set(member, copy));
+        if (members.length > 1) {
+            stateAliases.set(copy, members.slice(1).map(member => member.name));
+        }
+        return copy;
+    });
+    const retarget = <T extends Transition>(transition: T, container: State): T => {
+        const target = transition.state.ref && representative.get(transition.state.ref);
+        return target ? { ...transition, $container: container, state: { ...transition.state, ref: target, $refText: target.name } } : transition;
+    };
+    for (const copy of copies) {
+        copy.transitions = copy.transitions.map(transition => retarget(transition, copy));
+    }
+    const init = statemachine.init.ref && representative.get(statemachine.init.ref);
+    const minimized: Statemachine = { ...statemachine, states: copies, init: init ? { ...statemachine.init, ref: init, $refText: init.name } : statemachine.init };
+    minimizedMachines.set(statemachine, minimized);
+    return minimized;
+}
+
+/* The context the backends generate from: with `minimize`, the machine is replaced by its minimized copy */
+export function minimizedContext<T extends GeneratorContext>(ctx: T): T {
+    if (!ctx.minimize) {
+        return ctx;
+    }
+    if (ctx.log === 'binary') {
+        throw new Error('--minimize renumbers the states, so it cannot be combined with --log binary, whose logs are decoded against the whole model');
+    }
+    return { ...ctx, statemachine: minimizeStatemachine(ctx.statemachine) };
+}
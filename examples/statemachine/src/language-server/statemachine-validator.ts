@@ -2,8 +2,9 @@ import type { ValidationAcceptor, ValidationChecks } from 'langium';
 import { type State, type Statemachine, type StatemachineAstType, type Event, type Attribute, Assignment, PrintStatement, isStringLiteral, Transition } from './generated/ast.js';
 import type { StatemachineServices } from './statemachine-module.js';
 import { MultiMap } from 'langium';
-import { evalExpression, inferType } from '../cli/interpret-util.js';
+import { coerceToAttributeType, evalExpression, inferType, isAssignable } from '../cli/interpret-util.js';
 import { attributeNames, env } from '../cli/interpreter.js';
+import { analyzeReachability } from '../cli/reachability.js';
 
 export function registerValidationChecks(services: StatemachineServices) {
     const registry = services.validation.ValidationRegistry;
@@ -44,6 +45,27 @@ export class StatemachineValidator {
         this.addSymbolsToMap(allSymbols, names);
         this.checkForDuplicateNames(names, accept);
         this.updateAndValidateAttributes(attributes, accept);
+        if (this.initialStateExists(statemachine, initialStateName)) {
+            this.checkReachability(statemachine, accept);
+        }
+    }
+
+    /* Warns about states the machine can never enter and transitions that can never fire, which --prune leaves out */
+    checkReachability(statemachine: Statemachine, accept: ValidationAcceptor): void {
+        const reachability = analyzeReachability(statemachine);
+        for (const state of statemachine.states) {
+            if (!reachability.states.has(state)) {
+                accept('warning', `State ${state.name} is unreachable from the initial state ${statemachine.init.ref?.name}.`, { node: state, property: 'name' });
+                continue;
+            }
+            for (const transition of state.transitions.filter(transition => !reachability.transitions.has(transition))) {
+                if (reachability.falseGuards.has(transition)) {
+                    accept('warning', 'This transition can never fire: its guard is false for every value the model assigns to the attributes.', { node: transition, property: 'guard' });
+                } else {
+                    accept('warning', `This transition can never fire: an earlier transition for ${transition.event.$refText} always does.`, { node: transition, property: 'event' });
+                }
+            }
+        }
     }
 
     initialStateExists(statemachine: Statemachine, initialStateName: string | undefined): boolean {
@@ -84,11 +106,11 @@ export class StatemachineValidator {
         if (attribute.defaultValue) {
             try {
                 const inferredType = inferType(attribute.defaultValue, env, attribute.name);
-                if (inferredType !== attribute.type) {
+                if (!isAssignable(attribute.defaultValue, inferredType, attribute.type)) {
                     accept('error', `In Statemachine: Attribute initialization: Type mismatch: ${attribute.name} is of type ${attribute.type}, but assigned value is of type ${inferredType}.`, { node: attribute, property: 'defaultValue' });
                 }
                 const value = evalExpression(attribute.defaultValue, env);
-                env.set(attribute.name, value);
+                env.set(attribute.name, coerceToAttributeType(value, attribute.type));
             } catch (error) {
                 accept('error', `In Statemachine: Attribute initialization: ${(error as Error).message}`, { node: attribute, property: 'defaultValue' });
             }
@@ -108,7 +130,7 @@ export class StatemachineValidator {
                     accept('error', `In Assignment: This variable is not declared.`, { node: assignment, property: 'variable' });
                 }
                 const inferredType = inferType(assignment.value, env);
-                if (inferredType !== assignment.variable.ref?.type) {
+                if (assignment.variable.ref && !isAssignable(assignment.value, inferredType, assignment.variable.ref.type)) {
                     accept('error', `In Assignment: Type mismatch: ${assignment.variable.ref?.name} is of type ${assignment.variable.ref?.type}, but assigned value is of type ${inferredType}.`, { node: assignment, property: 'value' });
                 }
             } catch (error) {
@@ -0,0 +1,198 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+// Deferred binary logging for machines generated with `--log=binary`.
+// The hot path only appends a format id and the raw integer arguments to a
+// per-thread ring; a background thread drains the rings into a file, which
+// `statemachine-cli decode-log` turns back into text. The format strings are
+// numbered by the generator and never reach the program.
+
+#ifndef STATEMACHINE_LOG_HPP
+#define STATEMACHINE_LOG_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define SM_BINARY_LOG 1
+
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+
+// Formats 0 and 1 are reserved for the initial state and transitions; print
+// actions are numbered from 2 in model order.
+#if SM_TRACE_LEVEL >= 1
+#define SM_LOG_STATE(state) statemachine_log::write(0, state)
+#define SM_LOG_TRANSITION(from, to) statemachine_log::write(1, from, to)
+#else
+#define SM_LOG_STATE(state) static_cast<void>(0)
+#define SM_LOG_TRANSITION(from, to) static_cast<void>(0)
+#endif
+
+namespace statemachine_log {
+
+// Single-producer single-consumer byte ring. A record is published only once
+// it is complete, so the consumer never sees a partial one.
+class ring {
+public:
+    static constexpr std::size_t capacity = std::size_t{1} << 20;
+
+    // Returns false if the record does not fit until the consumer catches up.
+    bool try_write(const unsigned char *record, std::size_t size) {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if (capacity - (h - tail.load(std::memory_order_acquire)) < size) {
+            return false;
+        }
+        const std::size_t begin = h % capacity;
+        const std::size_t first = std::min(size, capacity - begin);
+        std::memcpy(data + begin, record, first);
+        std::memcpy(data, record + first, size - first);
+        head.store(h + size, std::memory_order_release);
+        return true;
+    }
+
+    // Writes everything published so far to out and returns its size.
+    std::size_t drain(std::FILE *out) {
+        const std::size_t t = tail.load(std::memory_order_relaxed);
+        const std::size_t size = head.load(std::memory_order_acquire) - t;
+        const std::size_t begin = t % capacity;
+        const std::size_t first = std::min(size, capacity - begin);
+        std::fwrite(data + begin, 1, first, out);
+        std::fwrite(data, 1, size - first, out);
+        tail.store(t + size, std::memory_order_release);
+        return size;
+    }
+
+private:
+    alignas(64) std::atomic<std::size_t> head{0};
+    alignas(64) std::atomic<std::size_t> tail{0};
+    alignas(64) unsigned char data[capacity];
+};
+
+// Owns the log file, one ring per logging thread and the thread draining them.
+class logger {
+public:
+    static logger &instance() {
+        static logger shared;
+        return shared;
+    }
+
+    // Starts logging to path; the header carries the model fingerprint so the
+    // decoder can refuse a log of another model.
+    bool open(const char *path, std::uint64_t fingerprint) {
+        file = std::fopen(path, "wb");
+        if (file == nullptr) {
+            return false;
+        }
+        unsigned char header[16] = {'S', 'M', 'L', 'G', 1, 0, 0, 0};
+        for (int i = 0; i < 8; ++i) {
+            header[8 + i] = static_cast<unsigned char>(fingerprint >> (8 * i));
+        }
+        std::fwrite(header, 1, sizeof header, file);
+        running.store(true, std::memory_order_release);
+        drainer = std::thread([this] {
+            while (running.load(std::memory_order_acquire)) {
+                if (drain_all() == 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+        });
+        return true;
+    }
+
+    // Stops the drain thread and writes the remaining records.
+    void close() {
+        if (file == nullptr) {
+            return;
+        }
+        running.store(false, std::memory_order_release);
+        drainer.join();
+        drain_all();
+        std::fclose(file);
+        file = nullptr;
+    }
+
+    bool is_open() const {
+        return running.load(std::memory_order_relaxed);
+    }
+
+    ring &local_ring() {
+        thread_local ring *local = nullptr;
+        if (local == nullptr) {
+            std::lock_guard<std::mutex> lock(mutex);
+            rings.push_back(std::make_unique<ring>());
+            local = rings.back().get();
+        }
+        return *local;
+    }
+
+private:
+    std::size_t drain_all() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::size_t drained = 0;
+        for (const std::unique_ptr<ring> &r : rings) {
+            drained += r->drain(file);
+        }
+        std::fflush(file);
+        return drained;
+    }
+
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ring>> rings;
+    std::FILE *file = nullptr;
+    std::atomic<bool> running{false};
+    std::thread drainer;
+};
+
+inline void store(unsigned char *record, std::size_t &at, std::int64_t value) {
+    const std::uint64_t bits = static_cast<std::uint64_t>(value);
+    for (int i = 0; i < 8; ++i) {
+        record[at++] = static_cast<unsigned char>(bits >> (8 * i));
+    }
+}
+
+// Appends one record: the little-endian u16 format id followed by every
+// argument as a little-endian i64. Waits while the ring is full.
+template <typename... Args>
+void write(std::uint16_t format, Args... args) {
+    logger &log = logger::instance();
+    if (!log.is_open()) {
+        return;
+    }
+    unsigned char record[2 + 8 * sizeof...(Args)];
+    record[0] = static_cast<unsigned char>(format);
+    record[1] = static_cast<unsigned char>(format >> 8);
+    [[maybe_unused]] std::size_t at = 2;
+    (store(record, at, static_cast<std::int64_t>(args)), ...);
+    ring &local = log.local_ring();
+    while (!local.try_write(record, sizeof record)) {
+        std::this_thread::yield();
+    }
+}
+
+// Opens the log named by the SM_LOG_FILE environment variable, or default_path.
+inline bool open_log(const char *default_path, std::uint64_t fingerprint) {
+    const char *path = std::getenv("SM_LOG_FILE");
+    return logger::instance().open(path != nullptr ? path : default_path, fingerprint);
+}
+
+inline void close_log() {
+    logger::instance().close();
+}
+
+} // namespace statemachine_log
+
+#endif // STATEMACHINE_LOG_HPP
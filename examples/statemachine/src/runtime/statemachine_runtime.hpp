@@ -0,0 +1,211 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+// Header-only runtime shared by machines generated with `--backend=crtp`.
+// The generator only emits a traits struct, the machine class and one
+// `transition<S, E>` specialization per transition; everything else lives here.
+
+#ifndef STATEMACHINE_RUNTIME_HPP
+#define STATEMACHINE_RUNTIME_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "statemachine_input.hpp"
+#include "statemachine_queue.hpp"
+
+// Diagnostic output: 0 = none, 1 = state changes, 2 = also rejected and unknown events.
+// Generated machines define the level chosen with `--trace` unless it is set when compiling.
+// With `--log=binary`, statemachine_log.hpp is included first and state changes go to its log.
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+
+namespace statemachine_runtime {
+
+enum class result {
+    transitioned,
+    suspended,
+    rejected,
+    impossible
+};
+
+// No transition leaves state S on event E unless the generated code specializes this.
+// A specialization provides `defined`, `target`, `guard(Machine *)` and `action(Machine *)`.
+// Transitions that wait in setTimeout also set `suspends`; their action is a coroutine
+// that calls `complete_transition(target)` on the machine when it is done.
+template <auto S, auto E>
+struct transition {
+    static constexpr bool defined = false;
+};
+
+template <typename Entry, typename = void>
+struct suspends : std::false_type {};
+
+template <typename Entry>
+struct suspends<Entry, std::void_t<decltype(Entry::suspends)>> : std::bool_constant<Entry::suspends> {};
+
+// CRTP base of a generated machine. Traits provides the `state_id` and `event_id`
+// enums, `state_count`, `event_count`, `machine_name`, `state_names`, `event_names`
+// (left out when there are no events, as ISO C++ has no empty arrays),
+// the binary event stream `fingerprint`, `find_event(std::string_view, event_id &)`,
+// which the generator backs with a perfect hash over the event names, and the
+// `queue_capacity` and `queue_policy` of the events queued during a suspended transition.
+// The (state, event) dispatch is expanded at compile time into direct calls of the
+// matching `transition` specialization, so guards and actions can be inlined.
+template <typename Derived, typename Traits>
+class machine {
+public:
+    using state_id = typename Traits::state_id;
+    using event_id = typename Traits::event_id;
+
+    explicit machine(state_id initial_state) : state(initial_state) {
+#ifdef SM_BINARY_LOG
+        SM_LOG_STATE(static_cast<std::size_t>(state));
+#else
+        SM_TRACE_TRANSITION("[" << state_name(state) << "]");
+#endif
+    }
+
+    state_id current_state() const {
+        return state;
+    }
+
+    static std::string_view state_name(state_id id) {
+        return Traits::state_names[static_cast<std::size_t>(id)];
+    }
+
+    result dispatch(event_id event) {
+        return dispatch_state(event, std::make_index_sequence<Traits::state_count>{});
+    }
+
+    // Looks up and dispatches one event name, reporting failures on stdout.
+    void handle_line(std::string_view input) {
+        event_id event;
+        if (!Traits::find_event(input, event)) {
+            SM_TRACE("There is no event <" << input << "> in the " << Traits::machine_name << " statemachine.");
+            return;
+        }
+        post(event);
+    }
+
+    // Dispatches an event, or queues it while a transition is suspended in setTimeout;
+    // queued events are dispatched in arrival order once that transition completes.
+    void post(event_id event) {
+        if (suspended) {
+            if (!pending.push(event) && Traits::queue_policy == statemachine_queue::queue_overflow::reject) {
+                SM_TRACE("The event queue is full; the event is rejected.");
+            }
+            return;
+        }
+        report(dispatch(event));
+    }
+
+    // Ends a suspended transition and dispatches the events queued meanwhile.
+    void complete_transition(state_id target) {
+        change_state(target);
+        suspended = false;
+        while (!suspended && !pending.empty()) {
+            report(dispatch(pending.pop()));
+        }
+    }
+
+    // Prints why an event did not lead to a transition.
+    static void report(result r) {
+        switch (r) {
+        case result::impossible:
+            SM_TRACE("Impossible event for the current state.");
+            break;
+        case result::rejected:
+            SM_TRACE("Transition not allowed.");
+            break;
+        case result::transitioned:
+        case result::suspended:
+            break;
+        }
+    }
+
+    // Dispatches every event of the file named on the command line, or of stdin, until it
+    // ends; `--binary` reads an event stream written by `statemachine-cli encode-events`.
+    int run(int argc, char **argv) {
+        const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+        if (arguments.binary) {
+            return statemachine_input::read_event_stream(arguments.path, Traits::fingerprint, Traits::event_count, [this](std::size_t id, std::uint64_t) {
+                post(static_cast<event_id>(id));
+            });
+        }
+        return statemachine_input::read_events(arguments.path, [this](std::string_view input) { handle_line(input); });
+    }
+
+private:
+    state_id state;
+    bool suspended = false;
+    statemachine_queue::event_queue<event_id, Traits::queue_capacity, Traits::queue_policy> pending;
+
+    void change_state(state_id target) {
+#ifdef SM_BINARY_LOG
+        SM_LOG_TRANSITION(static_cast<std::size_t>(state), static_cast<std::size_t>(target));
+#else
+        SM_TRACE_TRANSITION(state_name(state) << " ===> " << state_name(target));
+#endif
+        state = target;
+    }
+
+    template <std::size_t... S>
+    result dispatch_state(event_id event, std::index_sequence<S...>) {
+        result r = result::impossible;
+        (void)((static_cast<std::size_t>(state) == S
+            && (r = dispatch_event<static_cast<state_id>(S)>(event, std::make_index_sequence<Traits::event_count>{}), true)) || ...);
+        return r;
+    }
+
+    template <state_id S, std::size_t... E>
+    result dispatch_event([[maybe_unused]] event_id event, std::index_sequence<E...>) {
+        result r = result::impossible;
+        (void)((static_cast<std::size_t>(event) == E && (r = fire<S, static_cast<event_id>(E)>(), true)) || ...);
+        return r;
+    }
+
+    template <state_id S, event_id E>
+    result fire() {
+        using entry = transition<S, E>;
+        if constexpr (!entry::defined) {
+            return result::impossible;
+        } else {
+            Derived *self = static_cast<Derived *>(this);
+            if (!entry::guard(self)) {
+                return result::rejected;
+            }
+            if constexpr (suspends<entry>::value) {
+                suspended = true;
+                entry::action(self);
+                return result::suspended;
+            } else {
+                entry::action(self);
+                change_state(entry::target);
+                return result::transitioned;
+            }
+        }
+    }
+};
+
+} // namespace statemachine_runtime
+
+#endif // STATEMACHINE_RUNTIME_HPP
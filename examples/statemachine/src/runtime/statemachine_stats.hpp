@@ -0,0 +1,255 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+// Per-transition statistics for machines generated with `--stats`.
+// Every dispatch of an event counts, for the (state, event) pair it starts
+// from, as a hit or a rejection and adds its duration in clock ticks to a
+// log-linear histogram. Only the pairs with a transition get their own
+// statistics: the generated machine maps each (state, event) pair to a dense
+// id, and all pairs without a transition share id 0. The statistics are
+// written as JSON when the program ends, and at the next event after SIGUSR1.
+// With -DSM_STATS=0 the macros expand to nothing.
+
+#ifndef STATEMACHINE_STATS_HPP
+#define STATEMACHINE_STATS_HPP
+
+#ifndef SM_STATS
+#define SM_STATS 1
+#endif
+
+#if SM_STATS
+
+#include <array>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#endif
+
+// Opens a measured dispatch counted for the pair with the given dense id; the scope ends with the enclosing block.
+#define SM_STATS_SCOPE(machine, pair) const statemachine_stats::scope sm_stats_scope((machine)->stats, pair)
+// Marks the running dispatch as rejected: a guard did not hold, or the state has no transition for the event.
+#define SM_STATS_REJECT() (statemachine_stats::rejected = true)
+#define SM_STATS_DUMP(machine) ((machine)->stats.dump())
+
+namespace statemachine_stats {
+
+// Time stamp counter where there is one, else the steady clock. Ticks are
+// only converted to nanoseconds when the statistics are written, with the
+// rate measured against the steady clock over the whole run.
+inline std::uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    std::uint64_t value;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// Values below 2^sub_bits get a bucket each; above, every power of two is
+// split into 2^sub_bits equal buckets, so a bucket is at most 25% wide.
+// Durations of 2^max_bits ticks (minutes at GHz rates) and more all fall
+// into the last bucket.
+constexpr unsigned sub_bits = 2;
+constexpr unsigned max_bits = 40;
+constexpr std::size_t sub_count = std::size_t{1} << sub_bits;
+constexpr std::size_t bucket_count = (max_bits - sub_bits + 1) * sub_count;
+
+inline unsigned highest_bit(std::uint64_t value) {
+#if defined(__GNUC__)
+    return 63 - static_cast<unsigned>(__builtin_clzll(value));
+#else
+    unsigned bit = 0;
+    while (value >>= 1) {
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+inline std::size_t bucket(std::uint64_t value) {
+    if (value < sub_count) {
+        return static_cast<std::size_t>(value);
+    }
+    if (value >> max_bits != 0) {
+        return bucket_count - 1;
+    }
+    const unsigned shift = highest_bit(value) - sub_bits;
+    return ((shift + 1) << sub_bits) + static_cast<std::size_t>((value >> shift) & (sub_count - 1));
+}
+
+// Smallest value counted in the bucket.
+inline std::uint64_t bucket_floor(std::size_t index) {
+    if (index < sub_count) {
+        return index;
+    }
+    const unsigned shift = static_cast<unsigned>(index >> sub_bits) - 1;
+    return static_cast<std::uint64_t>(sub_count + (index & (sub_count - 1))) << shift;
+}
+
+// A bucket saturates rather than wrap after 2^32 - 1 dispatches; hits and rejects keep counting.
+struct pair_stats {
+    std::uint64_t hits = 0;
+    std::uint64_t rejects = 0;
+    std::uint64_t total_ticks = 0;
+    std::uint32_t histogram[bucket_count] = {};
+};
+
+// The state and event of a pair with a transition, as written to the JSON.
+struct pair_name {
+    const char *state;
+    const char *event;
+};
+
+inline volatile std::sig_atomic_t dump_requested = 0;
+
+// Whether the dispatch running on this thread was rejected; the states set it before the machine is defined.
+inline thread_local bool rejected = false;
+
+inline void request_dump(int) {
+    dump_requested = 1;
+}
+
+template <typename Recorder>
+class scope;
+
+// The statistics of one machine with Pairs (state, event) pairs that have a
+// transition. Pair id 0 counts the dispatches of all other pairs, and pair id
+// n >= 1 is named by names[n - 1].
+template <std::size_t Pairs>
+class recorder {
+public:
+    recorder(const char *machine, std::array<pair_name, Pairs> names) : machine(machine), names(names) {
+#ifdef SIGUSR1
+        std::signal(SIGUSR1, request_dump);
+#endif
+    }
+
+    // Writes the statistics to the file named by the SM_STATS_FILE environment variable, or <Machine>.stats.json.
+    void dump() {
+        dump_requested = 0;
+        const char *variable = std::getenv("SM_STATS_FILE");
+        char fallback[256];
+        std::snprintf(fallback, sizeof fallback, "%s.stats.json", machine);
+        std::FILE *out = std::fopen(variable != nullptr ? variable : fallback, "w");
+        if (out == nullptr) {
+            return;
+        }
+        const double ns_per_tick = tick_rate();
+        std::fprintf(out, "{\n  \"machine\": \"%s\",\n  \"ns_per_tick\": %.6f,\n  \"transitions\": [", machine, ns_per_tick);
+        const char *separator = "\n";
+        for (std::size_t pair = 1; pair <= Pairs; ++pair) {
+            if (pairs[pair].hits + pairs[pair].rejects == 0) {
+                continue;
+            }
+            std::fprintf(out, "%s    {\"state\": \"%s\", \"event\": \"%s\", ", separator, names[pair - 1].state, names[pair - 1].event);
+            write(out, pairs[pair], ns_per_tick);
+            separator = ",\n";
+        }
+        std::fprintf(out, "\n  ],\n  \"no_transition\": {");
+        write(out, pairs[0], ns_per_tick);
+        std::fprintf(out, "\n}\n");
+        std::fclose(out);
+    }
+
+private:
+    template <typename Recorder>
+    friend class scope;
+
+    double tick_rate() const {
+        const std::uint64_t elapsed_ticks = ticks() - start_ticks;
+        const auto elapsed = std::chrono::steady_clock::now() - start_time;
+        return elapsed_ticks == 0 ? 0.0 : static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / static_cast<double>(elapsed_ticks);
+    }
+
+    // The counters, times and non-empty histogram buckets of one pair, and the closing brace.
+    static void write(std::FILE *out, const pair_stats &stats, double ns_per_tick) {
+        std::fprintf(out, "\"hits\": %llu, \"rejects\": %llu, \"total_ns\": %.0f, ", static_cast<unsigned long long>(stats.hits),
+            static_cast<unsigned long long>(stats.rejects), static_cast<double>(stats.total_ticks) * ns_per_tick);
+        std::fprintf(out, "\"p50_ns\": %.0f, \"p99_ns\": %.0f, \"histogram\": [",
+            static_cast<double>(quantile(stats, 0.5)) * ns_per_tick, static_cast<double>(quantile(stats, 0.99)) * ns_per_tick);
+        const char *bucket_separator = "";
+        for (std::size_t index = 0; index < bucket_count; ++index) {
+            if (stats.histogram[index] != 0) {
+                std::fprintf(out, "%s[%.0f, %lu]", bucket_separator, static_cast<double>(bucket_floor(index)) * ns_per_tick,
+                    static_cast<unsigned long>(stats.histogram[index]));
+                bucket_separator = ", ";
+            }
+        }
+        std::fprintf(out, "]}");
+    }
+
+    // Lower bound of the bucket holding the q-quantile of the durations.
+    static std::uint64_t quantile(const pair_stats &stats, double q) {
+        const double rank = q * static_cast<double>(stats.hits + stats.rejects);
+        std::uint64_t seen = 0;
+        for (std::size_t index = 0; index < bucket_count; ++index) {
+            seen += stats.histogram[index];
+            if (static_cast<double>(seen) >= rank && stats.histogram[index] != 0) {
+                return bucket_floor(index);
+            }
+        }
+        return 0;
+    }
+
+    const char *machine;
+    std::array<pair_name, Pairs> names;
+    std::array<pair_stats, Pairs + 1> pairs{};
+    const std::uint64_t start_ticks = ticks();
+    const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+};
+
+// One dispatch, from its construction to the end of the enclosing block. A
+// pending dump is written first, so that it is not measured.
+template <typename Recorder>
+class scope {
+public:
+    scope(Recorder &recorder, std::size_t pair) : stats(recorder.pairs[pair]) {
+        if (dump_requested) {
+            recorder.dump();
+        }
+        rejected = false;
+        start = ticks();
+    }
+
+    scope(const scope &) = delete;
+    scope &operator=(const scope &) = delete;
+
+    ~scope() {
+        const std::uint64_t elapsed = ticks() - start;
+        ++(rejected ? stats.rejects : stats.hits);
+        stats.total_ticks += elapsed;
+        std::uint32_t &count = stats.histogram[bucket(elapsed)];
+        if (count != UINT32_MAX) {
+            ++count;
+        }
+    }
+
+private:
+    pair_stats &stats;
+    std::uint64_t start = 0;
+};
+
+} // namespace statemachine_stats
+
+#else
+
+#define SM_STATS_SCOPE(machine, pair) static_cast<void>(0)
+#define SM_STATS_REJECT() static_cast<void>(0)
+#define SM_STATS_DUMP(machine) static_cast<void>(0)
+
+#endif
+
+#endif // STATEMACHINE_STATS_HPP
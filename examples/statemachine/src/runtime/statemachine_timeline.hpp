@@ -0,0 +1,232 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+// Timeline of machines generated with `--timeline`, written as Chrome
+// trace_event JSON for Perfetto or chrome://tracing.
+// Every thread records begin and end events into its own fixed-size ring,
+// which overwrites its oldest records when full; recording takes no lock and
+// allocates nothing. The rings are preallocated for SM_TIMELINE_THREADS
+// threads, later threads record nothing. Names are string literals, so a
+// record is a time stamp and two words. The timeline is written when the
+// program ends, and at the next event after SIGUSR2. That write happens
+// before the event's slice opens, so it shows up in no slice, but the event
+// is dispatched only once the file is written. With -DSM_TIMELINE=0 the
+// macros expand to nothing.
+
+#ifndef STATEMACHINE_TIMELINE_HPP
+#define STATEMACHINE_TIMELINE_HPP
+
+#ifndef SM_TIMELINE
+#define SM_TIMELINE 1
+#endif
+
+#if SM_TIMELINE
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+#ifndef SM_TIMELINE_CAPACITY
+#define SM_TIMELINE_CAPACITY 8192
+#endif
+#ifndef SM_TIMELINE_THREADS
+#define SM_TIMELINE_THREADS 16
+#endif
+
+#define SM_TIMELINE_OPEN(machine) statemachine_timeline::open(machine)
+// A slice from here to the end of the enclosing block.
+#define SM_TIMELINE_SLICE(name) const statemachine_timeline::slice sm_timeline_slice(name)
+#define SM_TIMELINE_BEGIN(name) statemachine_timeline::record('B', name)
+#define SM_TIMELINE_END() statemachine_timeline::record('E', nullptr)
+// Slices that may end after other work on the thread, such as a suspended delay, matched by name and id.
+#define SM_TIMELINE_ASYNC_BEGIN(name, id) statemachine_timeline::record('b', name, reinterpret_cast<std::uintptr_t>(id))
+#define SM_TIMELINE_ASYNC_END(name, id) statemachine_timeline::record('e', name, reinterpret_cast<std::uintptr_t>(id))
+#define SM_TIMELINE_FLUSH() statemachine_timeline::flush()
+// Writes the timeline if SIGUSR2 asked for it; call it outside any slice, as the write is slow.
+#define SM_TIMELINE_FLUSH_PENDING() statemachine_timeline::flush_pending()
+
+namespace statemachine_timeline {
+
+constexpr std::size_t capacity = SM_TIMELINE_CAPACITY;
+constexpr std::size_t max_threads = SM_TIMELINE_THREADS;
+
+// Fields are relaxed atomics, which cost nothing more than plain stores, so
+// that a flush may read a ring while its thread writes it.
+struct event {
+    std::atomic<std::uint64_t> time{0}; // nanoseconds since open()
+    std::atomic<const char *> name{nullptr};
+    std::atomic<std::uintptr_t> id{0};
+    std::atomic<char> phase{0};
+};
+
+// Single writer: only the owning thread records, so head needs no read-modify-write.
+struct ring {
+    std::atomic<std::uint64_t> head{0};
+    event events[capacity];
+};
+
+inline ring rings[max_threads];
+inline std::atomic<std::size_t> claimed{0};
+inline const char *machine_name = "statemachine";
+inline std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+inline volatile std::sig_atomic_t flush_requested = 0;
+// Held while flush writes the file, as the snapshot it takes of a ring is too large for the stack.
+inline std::mutex flush_mutex;
+
+inline void request_flush(int) {
+    flush_requested = 1;
+}
+
+inline void open(const char *machine) {
+    machine_name = machine;
+    start = std::chrono::steady_clock::now();
+#ifdef SIGUSR2
+    std::signal(SIGUSR2, request_flush);
+#endif
+}
+
+// The ring of the calling thread, claimed on its first event; null once all are taken.
+inline ring *local_ring() {
+    thread_local ring *local = nullptr;
+    thread_local bool tried = false;
+    if (!tried) {
+        tried = true;
+        const std::size_t index = claimed.fetch_add(1, std::memory_order_relaxed);
+        local = index < max_threads ? &rings[index] : nullptr;
+    }
+    return local;
+}
+
+inline void record(char phase, const char *name, std::uintptr_t id = 0) {
+    ring *local = local_ring();
+    if (local == nullptr) {
+        return;
+    }
+    const std::uint64_t head = local->head.load(std::memory_order_relaxed);
+    event &slot = local->events[head % capacity];
+    // As in a seqlock writer: a flush that reads any of the stores below also sees the previous head, so it
+    // knows that this slot is being overwritten
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time.store(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()), std::memory_order_relaxed);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.id.store(id, std::memory_order_relaxed);
+    slot.phase.store(phase, std::memory_order_relaxed);
+    local->head.store(head + 1, std::memory_order_release);
+}
+
+struct snapshot_event {
+    std::uint64_t time;
+    const char *name;
+    std::uintptr_t id;
+    char phase;
+};
+
+// Writes the events still in the rings to the file named by the SM_TIMELINE_FILE environment variable, or
+// <Machine>.trace.json. Events overwritten while they were read are left out, and so are ends whose beginning
+// was overwritten before. Threads flushing at the same time take turns.
+inline void flush() {
+    const std::lock_guard<std::mutex> lock(flush_mutex);
+    flush_requested = 0;
+    const char *variable = std::getenv("SM_TIMELINE_FILE");
+    char fallback[256];
+    std::snprintf(fallback, sizeof fallback, "%s.trace.json", machine_name);
+    std::FILE *out = std::fopen(variable != nullptr ? variable : fallback, "w");
+    if (out == nullptr) {
+        return;
+    }
+    std::fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    std::fprintf(out, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"%s\"}}", machine_name);
+    static snapshot_event events[capacity];
+    const std::size_t threads = claimed.load(std::memory_order_acquire);
+    for (std::size_t thread = 0; thread < threads && thread < max_threads; ++thread) {
+        ring &source = rings[thread];
+        const std::uint64_t end = source.head.load(std::memory_order_acquire);
+        const std::uint64_t begin = end > capacity ? end - capacity : 0;
+        for (std::uint64_t position = begin; position < end; ++position) {
+            const event &slot = source.events[position % capacity];
+            events[position - begin] = {slot.time.load(std::memory_order_relaxed), slot.name.load(std::memory_order_relaxed),
+                slot.id.load(std::memory_order_relaxed), slot.phase.load(std::memory_order_relaxed)};
+        }
+        // The writer may have overwritten the oldest slots meanwhile, including the one it is writing now
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const std::uint64_t head = source.head.load(std::memory_order_relaxed);
+        const std::uint64_t valid = head >= capacity ? head - capacity + 1 : 0;
+        std::fprintf(out, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %zu, \"args\": {\"name\": \"thread %zu\"}}", thread, thread);
+        std::size_t depth = 0;
+        std::size_t pending = 0;
+        for (std::uint64_t position = begin > valid ? begin : valid; position < end; ++position) {
+            const snapshot_event &e = events[position - begin];
+            if (e.phase == 'B') {
+                ++depth;
+            } else if (e.phase == 'E') {
+                if (depth == 0) {
+                    continue;
+                }
+                --depth;
+            } else if (e.phase == 'b') {
+                ++pending;
+            } else if (e.phase == 'e') {
+                if (pending == 0) {
+                    continue;
+                }
+                --pending;
+            }
+            std::fprintf(out, ",\n{\"ph\": \"%c\", \"pid\": 1, \"tid\": %zu, \"ts\": %llu.%03llu", e.phase, thread,
+                static_cast<unsigned long long>(e.time / 1000), static_cast<unsigned long long>(e.time % 1000));
+            if (e.name != nullptr) {
+                std::fprintf(out, ", \"name\": \"%s\"", e.name);
+            }
+            if (e.phase == 'b' || e.phase == 'e') {
+                std::fprintf(out, ", \"cat\": \"delay\", \"id\": \"0x%llx\"", static_cast<unsigned long long>(e.id));
+            }
+            std::fprintf(out, "}");
+        }
+    }
+    std::fprintf(out, "\n]}\n");
+    std::fclose(out);
+}
+
+inline void flush_pending() {
+    if (flush_requested) {
+        flush();
+    }
+}
+
+class slice {
+public:
+    explicit slice(const char *name) {
+        record('B', name);
+    }
+
+    slice(const slice &) = delete;
+    slice &operator=(const slice &) = delete;
+
+    ~slice() {
+        record('E', nullptr);
+    }
+};
+
+} // namespace statemachine_timeline
+
+#else
+
+#define SM_TIMELINE_OPEN(machine) static_cast<void>(0)
+#define SM_TIMELINE_SLICE(name) static_cast<void>(0)
+#define SM_TIMELINE_BEGIN(name) static_cast<void>(0)
+#define SM_TIMELINE_END() static_cast<void>(0)
+#define SM_TIMELINE_ASYNC_BEGIN(name, id) static_cast<void>(0)
+#define SM_TIMELINE_ASYNC_END(name, id) static_cast<void>(0)
+#define SM_TIMELINE_FLUSH() static_cast<void>(0)
+#define SM_TIMELINE_FLUSH_PENDING() static_cast<void>(0)
+
+#endif
+
+#endif // STATEMACHINE_TIMELINE_HPP
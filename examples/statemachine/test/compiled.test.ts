@@ -0,0 +1,310 @@
+/******************************************************************************
+ * Copyright 2021 TypeFox GmbH
+ * This program and the accompanying materials are made available under the
+ * terms of the MIT License, which is available in the project root.
+ ******************************************************************************/
+
+import { execFileSync } from 'node:child_process';
+import * as fs from 'node:fs';
+import * as os from 'node:os';
+import * as path from 'node:path';
+import { EmptyFileSystem } from 'langium';
+import { toString } from 'langium/generate';
+import { parseHelper } from 'langium/test';
+import { afterAll, describe, expect, test } from 'vitest';
+import type { GeneratorOptions } from '../src/cli/generator.js';
+import { generateLibraryContent, libraryFileNames } from '../src/cli/generator-library.js';
+import { env } from '../src/cli/interpreter.js';
+import type { Statemachine } from '../src/language-server/generated/ast.js';
+import { createStatemachineServices } from '../src/language-server/statemachine-module.js';
+
+// These tests compile generated code and the runtime headers with the C++ compiler named by CXX
+// and run it; they are skipped where there is no compiler.
+const compiler = process.env.CXX ?? 'c++';
+const hasCompiler = (() => {
+    try {
+        execFileSync(compiler, ['--version'], { stdio: 'ignore' });
+        return true;
+    } catch {
+        return false;
+    }
+})();
+
+const runtimeDir = path.resolve(__dirname, '../src/runtime');
+const workDir = fs.mkdtempSync(path.join(os.tmpdir(), 'statemachine-compiled-'));
+afterAll(() => fs.rmSync(workDir, { recursive: true, force: true }));
+
+const services = createStatemachineServices(EmptyFileSystem).statemachine;
+const parse = parseHelper<Statemachine>(services);
+
+/* Writes `files` into a directory of their own, compiles its sources into one program and returns the program's path */
+function build(name: string, files: Record<string, string>, flags: string[] = []): string {
+    const dir = path.join(workDir, name);
+    fs.mkdirSync(dir, { recursive: true });
+    for (const [fileName, text] of Object.entries(files)) {
+        fs.writeFileSync(path.join(dir, fileName), text);
+    }
+    const sources = Object.keys(files).filter(fileName => fileName.endsWith('.cpp')).map(fileName => path.join(dir, fileName));
+    const program = path.join(dir, name);
+    execFileSync(compiler, ['-std=c++20', '-Wall', '-Wextra', '-pedantic-errors', '-O1', `-I${runtimeDir}`, ...flags, ...sources, '-o', program], { stdio: 'pipe' });
+    return program;
+}
+
+/* The library mode header and source of `model`, under their generated names */
+async function libraryFiles(model: string, options: GeneratorOptions = {}): Promise<Record<string, string>> {
+    const ctx = { ...options, statemachine: (await parse(model)).parseResult.value, destination: undefined!, fileName: undefined!, mode: 'library' as const };
+    const files = generateLibraryContent(ctx, env);
+    const names = libraryFileNames(ctx);
+    return { [names.header]: toString(files.header), [names.source]: toString(files.source) };
+}
+
+describe.skipIf(!hasCompiler)('Tests the library mode when compiled', () => {
+
+    test('dispatch_batch behaves like dispatch for every event, hooks included', async () => {
+        const files = await libraryFiles(`
+            statemachine BatchCheck
+            events up down reset
+            commands beep
+            attributes count: int = 0
+            initialState Low
+            state Low
+                up when (count < 5000) => High with{
+                    count = count + 1
+                    print("up ", count)
+                    run beep
+                };
+                down when (count > 3000) => Low with{ count = count - 3000 };
+                down when (count <= 3000) => High with{ print("down ", count) };
+            end
+            state High
+                up => High with{ count = count + 7 };
+                reset => Low with{ count = count / 3 };
+            end
+        `);
+        // The hooks and the command log what they see of the machine, and on_transition also
+        // changes an attribute the guards depend on
+        const program = build('batch', { ...files, 'main.cpp': `
+            #include "BatchCheck.hpp"
+
+            #include <iostream>
+            #include <string>
+            #include <vector>
+
+            struct Commands : batch_check::NoCommands {
+                const void *machine = nullptr;
+                void beep();
+            };
+
+            using Machine = batch_check::Machine<Commands>;
+
+            static std::string log;
+
+            static std::string describe(const Machine &machine) {
+                return std::string(batch_check::state_name(machine.current_state())) + " count=" + std::to_string(machine.get_count());
+            }
+
+            void Commands::beep() {
+                log += "beep in " + describe(*static_cast<const Machine *>(machine)) + "\\n";
+            }
+
+            int main() {
+                std::vector<batch_check::Event> events;
+                unsigned seed = 7;
+                for (int i = 0; i < 500; ++i) {
+                    seed = seed * 1103515245u + 12345u;
+                    events.push_back(static_cast<batch_check::Event>((seed >> 16) % batch_check::event_count));
+                }
+                std::string runs[2];
+                for (int batch = 0; batch < 2; ++batch) {
+                    Machine machine;
+                    machine.commands.machine = &machine;
+                    machine.hook_context = &machine;
+                    machine.on_print = [](void *context, std::string_view text) {
+                        log += "print '" + std::string(text) + "' in " + describe(*static_cast<Machine *>(context)) + "\\n";
+                    };
+                    machine.on_transition = [](void *context, batch_check::State from, batch_check::State to) {
+                        Machine &self = *static_cast<Machine *>(context);
+                        log += std::string(batch_check::state_name(from)) + " -> " + std::string(batch_check::state_name(to)) + " in " + describe(self) + "\\n";
+                        self.set_count(self.get_count() + 1000);
+                    };
+                    log.clear();
+                    std::size_t rejected_at = events.size();
+                    if (batch == 1) {
+                        rejected_at = machine.dispatch_batch(events.data(), events.size()).rejected_at;
+                    } else {
+                        for (std::size_t i = 0; i < events.size(); ++i) {
+                            const batch_check::Result result = machine.dispatch(events[i]);
+                            if (rejected_at == events.size() && result != batch_check::Result::transitioned) {
+                                rejected_at = i;
+                            }
+                        }
+                    }
+                    runs[batch] = log + "first rejection at " + std::to_string(rejected_at) + ", ends in " + describe(machine) + "\\n";
+                }
+                std::cout << runs[0] << "---\\n" << runs[1];
+            }
+        ` });
+        const [perEvent, batch] = execFileSync(program, { encoding: 'utf-8' }).split('---\n');
+        expect(perEvent).toMatch(/print 'down \d+' in Low count=\d+/);
+        expect(perEvent).toContain('beep in Low');
+        expect(batch).toBe(perEvent);
+    });
+
+    test('events dispatched from hooks and commands are queued until the transition is done', async () => {
+        // A queue of one event: the command's event finds it full
+        const files = await libraryFiles(`
+            statemachine Nested
+            events go back
+            commands ring
+            initialState Idle
+            state Idle
+                go => Busy with{
+                    print("going")
+                    run ring
+                };
+            end
+            state Busy
+                back => Idle;
+            end
+        `, { queueCapacity: 1 });
+        const program = build('queued', { ...files, 'main.cpp': `
+            #include "Nested.hpp"
+
+            #include <iostream>
+
+            struct Commands : nested::NoCommands {
+                void *machine = nullptr;
+                void ring();
+            };
+
+            using Machine = nested::Machine<Commands>;
+
+            static const char *result_name(nested::Result result) {
+                switch (result) {
+                case nested::Result::transitioned:
+                    return "transitioned";
+                case nested::Result::queued:
+                    return "queued";
+                case nested::Result::dropped:
+                    return "dropped";
+                default:
+                    return "other";
+                }
+            }
+
+            void Commands::ring() {
+                const nested::Event back = nested::Event::back;
+                std::cout << "ring: " << result_name(static_cast<Machine *>(machine)->dispatch_batch(&back, 1).rejection) << '\\n';
+            }
+
+            int main() {
+                Machine machine;
+                machine.commands.machine = &machine;
+                machine.hook_context = &machine;
+                machine.on_print = [](void *context, std::string_view) {
+                    std::cout << "print: " << result_name(static_cast<Machine *>(context)->dispatch(nested::Event::back)) << '\\n';
+                };
+                machine.on_transition = [](void *, nested::State, nested::State to) {
+                    std::cout << "transition to " << nested::state_name(to) << '\\n';
+                };
+                machine.on_queued_result = [](void *, nested::Event event, nested::Result result) {
+                    std::cout << "queued " << nested::event_name(event) << ": " << result_name(result) << '\\n';
+                };
+                const nested::Result go = machine.dispatch(nested::Event::go);
+                std::cout << "go: " << result_name(go) << ", now " << nested::state_name(machine.current_state()) << '\\n';
+                const nested::Event events[] = {nested::Event::go, nested::Event::go};
+                const nested::BatchResult batch = machine.dispatch_batch(events, 2);
+                std::cout << "batch: " << result_name(batch.rejection) << ", now " << nested::state_name(machine.current_state()) << '\\n';
+            }
+        ` });
+        const go = ['print: queued', 'ring: dropped', 'transition to Busy', 'transition to Idle', 'queued back: transitioned'];
+        expect(execFileSync(program, { encoding: 'utf-8' })).toBe([
+            ...go,
+            'go: transitioned, now Idle',
+            ...go,
+            ...go,
+            'batch: transitioned, now Idle',
+            ''
+        ].join('\n'));
+    });
+});
+
+describe.skipIf(!hasCompiler)('Tests the runtime headers when compiled', () => {
+
+    test('Every duration falls into the statistics bucket whose floor it reaches', () => {
+        const program = build('stats', { 'main.cpp': `
+            #include "statemachine_stats.hpp"
+
+            #include <cstdint>
+            #include <iostream>
+            #include <limits>
+
+            using namespace statemachine_stats;
+
+            int main() {
+                // Buckets are contiguous: each starts one past the end of the previous, and the last one ends at the largest value
+                for (std::size_t index = 0; index < bucket_count; ++index) {
+                    const std::uint64_t floor = bucket_floor(index);
+                    const std::uint64_t last = index + 1 < bucket_count ? bucket_floor(index + 1) - 1 : std::numeric_limits<std::uint64_t>::max();
+                    if (bucket(floor) != index || bucket(last) != index || last < floor) {
+                        std::cout << "bucket " << index << " spans " << floor << ".." << last << '\\n';
+                    }
+                    // Above the exact buckets, a bucket is at most a quarter of its floor wide, except the last one that takes all longer durations
+                    if (floor >= sub_count && index + 1 < bucket_count && (last - floor) > floor / 4) {
+                        std::cout << "bucket " << index << " is too wide\\n";
+                    }
+                }
+                // One recorded hit and one rejection of a pair with a transition, and one dispatch without a transition, written as JSON
+                recorder<2> stats("Check", {{{"A", "stop"}, {"B", "go"}}});
+                {
+                    scope<recorder<2>> hit(stats, 2);
+                }
+                {
+                    scope<recorder<2>> reject(stats, 2);
+                    rejected = true;
+                }
+                {
+                    scope<recorder<2>> none(stats, 0);
+                    rejected = true;
+                }
+                stats.dump();
+            }
+        ` });
+        const file = path.join(workDir, 'stats', 'Check.stats.json');
+        expect(execFileSync(program, { encoding: 'utf-8', env: { ...process.env, SM_STATS_FILE: file } })).toBe('');
+        const json = JSON.parse(fs.readFileSync(file, 'utf-8'));
+        expect(json.machine).toBe('Check');
+        expect(json.transitions).toHaveLength(1);
+        const [pair] = json.transitions;
+        expect(pair).toMatchObject({ state: 'B', event: 'go', hits: 1, rejects: 1 });
+        expect(pair.p50_ns).toBeLessThanOrEqual(pair.p99_ns);
+        expect(pair.histogram.reduce((sum: number, [, count]: number[]) => sum + count, 0)).toBe(2);
+        expect(json.no_transition).toMatchObject({ hits: 0, rejects: 1 });
+    });
+
+    test('The timeline keeps the newest slices after its ring wrapped', () => {
+        const program = build('timeline', { 'main.cpp': `
+            #include "statemachine_timeline.hpp"
+
+            static const char *const names[] = {"s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9"};
+
+            int main() {
+                SM_TIMELINE_OPEN("Check");
+                // The ring holds 8 events, so the outer slice and the first slices are overwritten
+                SM_TIMELINE_BEGIN("outer");
+                for (const char *name : names) {
+                    SM_TIMELINE_SLICE(name);
+                }
+                SM_TIMELINE_END();
+                SM_TIMELINE_FLUSH();
+            }
+        ` }, ['-DSM_TIMELINE_CAPACITY=8']);
+        const file = path.join(workDir, 'timeline', 'Check.trace.json');
+        execFileSync(program, { env: { ...process.env, SM_TIMELINE_FILE: file } });
+        const events: Array<{ ph: string, name?: string }> = JSON.parse(fs.readFileSync(file, 'utf-8')).traceEvents;
+        expect(events.filter(event => event.ph === 'M').map(event => event.name)).toEqual(['process_name', 'thread_name']);
+        // The end of s6 is the oldest event left whole, but its beginning is gone; so is the beginning of outer
+        expect(events.filter(event => event.ph !== 'M').map(event => event.name ? `${event.ph} ${event.name}` : event.ph))
+            .toEqual(['B s7', 'E', 'B s8', 'E', 'B s9', 'E']);
+    });
+});
@@ -1,116 +1,142 @@
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
-#include <map>
 #include <string>
+#include <string_view>
 #include <chrono>
 #include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
 class BooleanSwitch;
 
 class State {
-protected:
-    BooleanSwitch *statemachine;
-
 public:
     virtual ~State() {}
 
-    void set_context(BooleanSwitch *statemachine) {
-        this->statemachine = statemachine;
-    }
-
-    virtual std::string get_name() {
+    virtual std::string_view get_name() const {
         return "Unknown";
     }
 
-    virtual void toggle() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void toggle(BooleanSwitch *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 };
 
 class BooleanSwitch {
 private:
-    State* state = nullptr;
+    const State* state = nullptr;
 public:
     int count = 0;
     bool isOn = false;
     bool isActive = true;
-    BooleanSwitch(State* initial_state) {
-        initial_state->set_context(this);
+    BooleanSwitch(const State* initial_state) {
         state = initial_state;
-        std::cout << "[" << state->get_name() <<  "]" << std::endl;
+        SM_TRACE_TRANSITION("[" << state->get_name() << "]");
     }
 
-    ~BooleanSwitch() {
-        if (state != nullptr) {
-            delete state;
-        }
-    }
-
-    void transition_to(State *new_state) {
-        std::cout << state->get_name() << " ===> " << new_state->get_name() << std::endl;
-        if (state != nullptr) {
-            delete state;
-        }
-        new_state->set_context(this);
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());
         state = new_state;
     }
     void toggle() {
-        state->toggle();
+        state->toggle(this);
     }
 };
 
 class Off : public State {
 public:
-    std::string get_name() override { return "Off"; }
-    void toggle() override;
+    static const Off instance;
+    std::string_view get_name() const override { return "Off"; }
+    void toggle(BooleanSwitch *statemachine) const override;
 };
 class On : public State {
 public:
-    std::string get_name() override { return "On"; }
-    void toggle() override;
+    static const On instance;
+    std::string_view get_name() const override { return "On"; }
+    void toggle(BooleanSwitch *statemachine) const override;
 };
     // Off
+    const Off Off::instance;
 
-    void Off::toggle() {
-        if (true) {
-            statemachine->isOn = true;
-            statemachine->count = (statemachine->count + 1);
-            statemachine->isActive = (statemachine->isOn && ((statemachine->count > 0)));
-            statemachine->transition_to(new On);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Off::toggle(BooleanSwitch *statemachine) const {
+        statemachine->isOn = true;
+        statemachine->count = (statemachine->count + 1);
+        statemachine->isActive = (statemachine->isOn && (statemachine->count > 0));
+        statemachine->transition_to(&On::instance);
     }
     
     // On
+    const On On::instance;
 
-    void On::toggle() {
-        if (true) {
-            statemachine->isOn = false;
-            statemachine->count = (statemachine->count * 2);
-            statemachine->isActive = (statemachine->isOn || ((statemachine->count < 5)));
-            statemachine->transition_to(new Off);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void On::toggle(BooleanSwitch *statemachine) const {
+        statemachine->isOn = false;
+        statemachine->count = (statemachine->count * 2);
+        statemachine->isActive = (statemachine->isOn || (statemachine->count < 5));
+        statemachine->transition_to(&Off::instance);
     }
     
 
 typedef void (BooleanSwitch::*Event)();
 
-int main() {
-    BooleanSwitch *statemachine = new BooleanSwitch(new Off);
-
-    static std::map<std::string, Event> event_by_name;
-    event_by_name["toggle"] = &BooleanSwitch::toggle;
-    for (std::string input; std::getline(std::cin, input);) {
-        std::map<std::string, Event>::const_iterator event_by_name_it = event_by_name.find(input);
-        if (event_by_name_it == event_by_name.end()) {
-            std::cout << "There is no event <" << input << "> in the BooleanSwitch statemachine." << std::endl;
-            continue;
-        }
-        Event event_invoker = event_by_name_it->second;
-        (statemachine->*event_invoker)();
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 1;
+constexpr std::int32_t event_displacements[event_slot_count] = { -1 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "toggle" };
+constexpr Event event_slot_values[event_slot_count] = { &BooleanSwitch::toggle };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0xf87bb428cd318863ull;
+constexpr Event event_ids[1] = { &BooleanSwitch::toggle };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    BooleanSwitch *statemachine = new BooleanSwitch(&Off::instance);
+
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 1, [statemachine](std::size_t id, std::uint64_t) { (statemachine->*event_ids[id])(); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the BooleanSwitch statemachine.");
+                return;
+            }
+            (statemachine->*event_slot_values[slot])();
+        });
     }
 
     delete statemachine;
-    return 0;
+    return status;
 }
@@ -0,0 +1,185 @@
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+class DeadStates;
+
+class State {
+public:
+    virtual ~State() {}
+
+    virtual std::string_view get_name() const {
+        return "Unknown";
+    }
+
+    virtual void start(DeadStates *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+
+    virtual void stop(DeadStates *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+
+    virtual void fault(DeadStates *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+
+    virtual void repair(DeadStates *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+};
+
+class DeadStates {
+private:
+    const State* state = nullptr;
+public:
+    int speed = 0;
+    int gear = 1;
+    bool overheated = false;
+    DeadStates(const State* initial_state) {
+        state = initial_state;
+        SM_TRACE_TRANSITION("[" << state->get_name() << "]");
+    }
+
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());
+        state = new_state;
+    }
+    void start() {
+        state->start(this);
+    }
+    void stop() {
+        state->stop(this);
+    }
+    void fault() {
+        state->fault(this);
+    }
+    void repair() {
+        state->repair(this);
+    }
+};
+
+class Idle : public State {
+public:
+    static const Idle instance;
+    std::string_view get_name() const override { return "Idle"; }
+    void start(DeadStates *statemachine) const override;
+    void fault(DeadStates *statemachine) const override;
+};
+class Running : public State {
+public:
+    static const Running instance;
+    std::string_view get_name() const override { return "Running"; }
+    void start(DeadStates *statemachine) const override;
+    void stop(DeadStates *statemachine) const override;
+    void fault(DeadStates *statemachine) const override;
+};
+    // Idle
+    const Idle Idle::instance;
+
+    void Idle::start(DeadStates *statemachine) const {
+        statemachine->speed = 1;
+        statemachine->gear = 2;
+        statemachine->transition_to(&Running::instance);
+    }
+    
+
+    void Idle::fault([[maybe_unused]] DeadStates *statemachine) const {
+        SM_TRACE("Transition not allowed.");
+    }
+    
+    // Running
+    const Running Running::instance;
+
+    void Running::start(DeadStates *statemachine) const {
+        const int cse_0 = statemachine->speed;
+        if ((cse_0 < 3)) {
+            statemachine->speed = (cse_0 + 1);
+            statemachine->transition_to(&Running::instance);
+        } else {
+            SM_TRACE("Transition not allowed.");
+        }
+    }
+    
+
+    void Running::stop(DeadStates *statemachine) const {
+        statemachine->speed = 0;
+        statemachine->gear = 1;
+        statemachine->transition_to(&Idle::instance);
+    }
+    
+
+    void Running::fault([[maybe_unused]] DeadStates *statemachine) const {
+        SM_TRACE("Transition not allowed.");
+    }
+    
+
+typedef void (DeadStates::*Event)();
+
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 4;
+constexpr std::int32_t event_displacements[event_slot_count] = { 0, 0, 1, 1 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "start", "repair", "fault", "stop" };
+constexpr Event event_slot_values[event_slot_count] = { &DeadStates::start, &DeadStates::repair, &DeadStates::fault, &DeadStates::stop };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0xf40e73b338ede7a4ull;
+constexpr Event event_ids[4] = { &DeadStates::start, &DeadStates::stop, &DeadStates::fault, &DeadStates::repair };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    DeadStates *statemachine = new DeadStates(&Idle::instance);
+
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 4, [statemachine](std::size_t id, std::uint64_t) { (statemachine->*event_ids[id])(); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the DeadStates statemachine.");
+                return;
+            }
+            (statemachine->*event_slot_values[slot])();
+        });
+    }
+
+    delete statemachine;
+    return status;
+}
@@ -0,0 +1,207 @@
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+#ifndef SM_PROBES
+#define SM_PROBES 1
+#endif
+#if SM_PROBES && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SM_PROBE(name, machine, state, event) \
+    DTRACE_PROBE3(Door, name, reinterpret_cast<std::uintptr_t>(machine), static_cast<std::uint32_t>(state), static_cast<std::uint32_t>(event))
+#define SM_PROBE_COMMAND(machine, state, event, command_id) \
+    DTRACE_PROBE4(Door, command, reinterpret_cast<std::uintptr_t>(machine), static_cast<std::uint32_t>(state), static_cast<std::uint32_t>(event), static_cast<std::uint32_t>(command_id))
+#elif SM_PROBES && defined(__x86_64__) && defined(__ELF__) && defined(__GNUC__)
+// What sys/sdt.h emits: a nop to place the uprobe on, and a note telling tracers where it is and where its
+// arguments are. The note is not loaded, so a probe costs the nop and the moves of its arguments.
+#define SM_PROBE_ASM(name, arguments) \
+    "990: nop\n" \
+    ".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+    ".balign 4\n" \
+    ".4byte 992f-991f, 994f-993f, 3\n" \
+    "991: .asciz \"stapsdt\"\n" \
+    "992: .balign 4\n" \
+    "993: .8byte 990b\n" \
+    ".8byte _.stapsdt.base\n" \
+    ".8byte 0\n" \
+    ".asciz \"Door\"\n" \
+    ".asciz \"" #name "\"\n" \
+    ".asciz \"" arguments "\"\n" \
+    "994: .balign 4\n" \
+    ".popsection\n" \
+    ".ifndef _.stapsdt.base\n" \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+    ".weak _.stapsdt.base\n" \
+    ".hidden _.stapsdt.base\n" \
+    "_.stapsdt.base: .space 1\n" \
+    ".size _.stapsdt.base, 1\n" \
+    ".popsection\n" \
+    ".endif\n"
+#define SM_PROBE_OPERANDS(machine, state, event) [sm_machine] "nor"(reinterpret_cast<std::uintptr_t>(machine)), [sm_state] "nor"(static_cast<std::uint32_t>(state)), [sm_event] "nor"(static_cast<std::uint32_t>(event))
+#define SM_PROBE(name, machine, state, event) \
+    __asm__ __volatile__(SM_PROBE_ASM(name, "8@%[sm_machine] 4@%[sm_state] 4@%[sm_event]") :: SM_PROBE_OPERANDS(machine, state, event))
+#define SM_PROBE_COMMAND(machine, state, event, command_id) \
+    __asm__ __volatile__(SM_PROBE_ASM(command, "8@%[sm_machine] 4@%[sm_state] 4@%[sm_event] 4@%[sm_command]") \
+        :: SM_PROBE_OPERANDS(machine, state, event), [sm_command] "nor"(static_cast<std::uint32_t>(command_id)))
+#else
+#define SM_PROBE(name, machine, state, event) static_cast<void>(0)
+#define SM_PROBE_COMMAND(machine, state, event, command_id) static_cast<void>(0)
+#endif
+class Door;
+
+class State {
+public:
+    virtual ~State() {}
+
+    virtual std::string_view get_name() const {
+        return "Unknown";
+    }
+    virtual std::size_t get_id() const = 0;
+
+    virtual void open([[maybe_unused]] Door *statemachine) const {
+        SM_TRACE("Impossible event for the current state.");
+        SM_PROBE(unknown_event, statemachine, get_id(), 0);
+    }
+
+    virtual void close([[maybe_unused]] Door *statemachine) const {
+        SM_TRACE("Impossible event for the current state.");
+        SM_PROBE(unknown_event, statemachine, get_id(), 1);
+    }
+};
+
+class Door {
+private:
+    const State* state = nullptr;
+public:
+    bool locked = false;
+    Door(const State* initial_state) {
+        state = initial_state;
+        SM_TRACE_TRANSITION("[" << state->get_name() << "]");
+    }
+
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());
+        state = new_state;
+    }
+    
+    std::size_t state_id() const {
+        return state->get_id();
+    }
+    void open() {
+        state->open(this);
+    }
+    void close() {
+        state->close(this);
+    }
+};
+
+class Closed : public State {
+public:
+    static const Closed instance;
+    std::string_view get_name() const override { return "Closed"; }
+    std::size_t get_id() const override { return 0; }
+    void open(Door *statemachine) const override;
+};
+class Open : public State {
+public:
+    static const Open instance;
+    std::string_view get_name() const override { return "Open"; }
+    std::size_t get_id() const override { return 1; }
+    void close(Door *statemachine) const override;
+};
+    // Closed
+    const Closed Closed::instance;
+
+    void Closed::open(Door *statemachine) const {
+        SM_PROBE(transition_entry, statemachine, 0, 0);
+        if (!statemachine->locked) {
+            SM_PROBE_COMMAND(statemachine, 0, 0, 0);
+            std::cout << "Run Command: beep()" << '\n';
+            statemachine->transition_to(&Open::instance);
+            SM_PROBE(transition_exit, statemachine, 1, 0);
+        } else {
+            SM_TRACE("Transition not allowed.");
+            SM_PROBE(guard_rejected, statemachine, 0, 0);
+        }
+    }
+    
+    // Open
+    const Open Open::instance;
+
+    void Open::close(Door *statemachine) const {
+        SM_PROBE(transition_entry, statemachine, 1, 1);
+        statemachine->transition_to(&Closed::instance);
+        SM_PROBE(transition_exit, statemachine, 0, 1);
+    }
+    
+
+typedef void (Door::*Event)();
+
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 2;
+constexpr std::int32_t event_displacements[event_slot_count] = { 0, 2 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "close", "open" };
+constexpr Event event_slot_values[event_slot_count] = { &Door::close, &Door::open };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0x83dd0ecdd52e3f0bull;
+constexpr Event event_ids[2] = { &Door::open, &Door::close };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    Door *statemachine = new Door(&Closed::instance);
+
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 2, [statemachine](std::size_t id, std::uint64_t) { (statemachine->*event_ids[id])(); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the Door statemachine.");
+                SM_PROBE(unknown_event, statemachine, statemachine->state_id(), 2);
+                return;
+            }
+            (statemachine->*event_slot_values[slot])();
+        });
+    }
+
+    delete statemachine;
+    return status;
+}
@@ -0,0 +1,187 @@
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+class EquivalentStates;
+
+class State {
+public:
+    virtual ~State() {}
+
+    virtual std::string_view get_name() const {
+        return "Unknown";
+    }
+
+    virtual void coin(EquivalentStates *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+
+    virtual void push(EquivalentStates *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+
+    virtual void kick(EquivalentStates *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+};
+
+class EquivalentStates {
+private:
+    const State* state = nullptr;
+public:
+    int coins = 0;
+    EquivalentStates(const State* initial_state) {
+        state = initial_state;
+        SM_TRACE_TRANSITION("[" << state->get_name() << "]");
+    }
+
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());
+        state = new_state;
+    }
+    void coin() {
+        state->coin(this);
+    }
+    void push() {
+        state->push(this);
+    }
+    void kick() {
+        state->kick(this);
+    }
+};
+
+class Locked : public State {
+public:
+    static const Locked instance;
+    std::string_view get_name() const override { return "Locked|Relocked"; }
+    void coin(EquivalentStates *statemachine) const override;
+    void push(EquivalentStates *statemachine) const override;
+    void kick(EquivalentStates *statemachine) const override;
+};
+using Relocked = Locked;
+class Unlocked : public State {
+public:
+    static const Unlocked instance;
+    std::string_view get_name() const override { return "Unlocked|Open"; }
+    void push(EquivalentStates *statemachine) const override;
+    void coin(EquivalentStates *statemachine) const override;
+};
+using Open = Unlocked;
+class Alarm : public State {
+public:
+    static const Alarm instance;
+    std::string_view get_name() const override { return "Alarm"; }
+    void push(EquivalentStates *statemachine) const override;
+};
+    // Locked
+    const Locked Locked::instance;
+
+    void Locked::coin(EquivalentStates *statemachine) const {
+        statemachine->coins = (statemachine->coins + 1);
+        statemachine->transition_to(&Unlocked::instance);
+    }
+    
+
+    void Locked::push(EquivalentStates *statemachine) const {
+        statemachine->transition_to(&Locked::instance);
+    }
+    
+
+    void Locked::kick(EquivalentStates *statemachine) const {
+        if ((statemachine->coins > 2)) {
+            statemachine->transition_to(&Alarm::instance);
+        } else {
+            SM_TRACE("Transition not allowed.");
+        }
+    }
+    
+    // Unlocked
+    const Unlocked Unlocked::instance;
+
+    void Unlocked::push(EquivalentStates *statemachine) const {
+        statemachine->transition_to(&Locked::instance);
+    }
+    
+
+    void Unlocked::coin(EquivalentStates *statemachine) const {
+        statemachine->transition_to(&Unlocked::instance);
+    }
+    
+    // Alarm
+    const Alarm Alarm::instance;
+
+    void Alarm::push(EquivalentStates *statemachine) const {
+        std::cout << "Alarm cleared" << '\n';
+        statemachine->transition_to(&Locked::instance);
+    }
+    
+
+typedef void (EquivalentStates::*Event)();
+
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 3;
+constexpr std::int32_t event_displacements[event_slot_count] = { 1, -1, 0 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "push", "kick", "coin" };
+constexpr Event event_slot_values[event_slot_count] = { &EquivalentStates::push, &EquivalentStates::kick, &EquivalentStates::coin };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0x1122936e1e03146cull;
+constexpr Event event_ids[3] = { &EquivalentStates::coin, &EquivalentStates::push, &EquivalentStates::kick };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    EquivalentStates *statemachine = new EquivalentStates(&Locked::instance);
+
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 3, [statemachine](std::size_t id, std::uint64_t) { (statemachine->*event_ids[id])(); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the EquivalentStates statemachine.");
+                return;
+            }
+            (statemachine->*event_slot_values[slot])();
+        });
+    }
+
+    delete statemachine;
+    return status;
+}
@@ -0,0 +1,205 @@
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+class FixedWidthCounters;
+
+namespace fixed_width {
+    template <typename T>
+    constexpr T add(T a, T b) {
+        return static_cast<T>(static_cast<std::uint64_t>(a) + static_cast<std::uint64_t>(b));
+    }
+
+    template <typename T>
+    constexpr T sub(T a, T b) {
+        return static_cast<T>(static_cast<std::uint64_t>(a) - static_cast<std::uint64_t>(b));
+    }
+
+    template <typename T>
+    constexpr T mul(T a, T b) {
+        return static_cast<T>(static_cast<std::uint64_t>(a) * static_cast<std::uint64_t>(b));
+    }
+
+    // The smallest signed value divided by -1 overflows; it wraps around to itself, like the negation it is
+    template <typename T>
+    constexpr T div(T a, T b) {
+        return T(-1) < T(0) && b == T(-1) ? sub<T>(0, a) : static_cast<T>(a / b);
+    }
+}
+class State {
+public:
+    virtual ~State() {}
+
+    virtual std::string_view get_name() const {
+        return "Unknown";
+    }
+
+    virtual void tick(FixedWidthCounters *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+
+    virtual void back(FixedWidthCounters *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+
+    virtual void big(FixedWidthCounters *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+
+    virtual void reset(FixedWidthCounters *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+};
+
+class FixedWidthCounters {
+private:
+    const State* state = nullptr;
+public:
+    std::uint8_t ticks = 250;
+    std::int16_t level = -32760;
+    std::uint16_t steps;
+    std::int32_t sum = 2147483000;
+    std::int64_t total = 4000000000;
+    int count = 0;
+    bool armed = true;
+    FixedWidthCounters(const State* initial_state) {
+        state = initial_state;
+        SM_TRACE_TRANSITION("[" << state->get_name() << "]");
+    }
+
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());
+        state = new_state;
+    }
+    void tick() {
+        state->tick(this);
+    }
+    void back() {
+        state->back(this);
+    }
+    void big() {
+        state->big(this);
+    }
+    void reset() {
+        state->reset(this);
+    }
+};
+
+class Counting : public State {
+public:
+    static const Counting instance;
+    std::string_view get_name() const override { return "Counting"; }
+    void tick(FixedWidthCounters *statemachine) const override;
+    void back(FixedWidthCounters *statemachine) const override;
+    void big(FixedWidthCounters *statemachine) const override;
+    void reset(FixedWidthCounters *statemachine) const override;
+};
+    // Counting
+    const Counting Counting::instance;
+
+    void Counting::tick(FixedWidthCounters *statemachine) const {
+        statemachine->ticks = fixed_width::add<std::uint8_t>(statemachine->ticks, 3);
+        statemachine->count = (statemachine->count + 1);
+        std::cout << "ticks: " << static_cast<int>(statemachine->ticks) << " count: " << statemachine->count << '\n';
+        statemachine->transition_to(&Counting::instance);
+    }
+    
+
+    void Counting::back(FixedWidthCounters *statemachine) const {
+        statemachine->level = fixed_width::sub<std::int16_t>(statemachine->level, 5);
+        statemachine->steps = fixed_width::sub<std::uint16_t>(statemachine->steps, 1);
+        std::cout << "level: " << statemachine->level << " steps: " << statemachine->steps << '\n';
+        statemachine->transition_to(&Counting::instance);
+    }
+    
+
+    void Counting::big(FixedWidthCounters *statemachine) const {
+        statemachine->sum = fixed_width::add<std::int32_t>(statemachine->sum, 1000);
+        statemachine->total = fixed_width::mul<std::int64_t>(statemachine->total, 3);
+        statemachine->ticks = fixed_width::sub<std::uint8_t>(0, statemachine->ticks);
+        std::cout << "sum: " << statemachine->sum << " total: " << statemachine->total << " ticks: " << static_cast<int>(statemachine->ticks) << '\n';
+        statemachine->transition_to(&Counting::instance);
+    }
+    
+
+    void Counting::reset(FixedWidthCounters *statemachine) const {
+        if ((statemachine->ticks < 10)) {
+            statemachine->ticks = 44;
+            statemachine->level = fixed_width::div<std::int16_t>(statemachine->level, -1);
+            std::cout << "reset " << static_cast<int>(statemachine->ticks) << " " << statemachine->level << '\n';
+            statemachine->transition_to(&Counting::instance);
+        } else {
+            SM_TRACE("Transition not allowed.");
+        }
+    }
+    
+
+typedef void (FixedWidthCounters::*Event)();
+
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 4;
+constexpr std::int32_t event_displacements[event_slot_count] = { -4, 1, -2, 0 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "back", "big", "reset", "tick" };
+constexpr Event event_slot_values[event_slot_count] = { &FixedWidthCounters::back, &FixedWidthCounters::big, &FixedWidthCounters::reset, &FixedWidthCounters::tick };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0xed7d90cdcfc7932bull;
+constexpr Event event_ids[4] = { &FixedWidthCounters::tick, &FixedWidthCounters::back, &FixedWidthCounters::big, &FixedWidthCounters::reset };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    FixedWidthCounters *statemachine = new FixedWidthCounters(&Counting::instance);
+
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 4, [statemachine](std::size_t id, std::uint64_t) { (statemachine->*event_ids[id])(); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the FixedWidthCounters statemachine.");
+                return;
+            }
+            (statemachine->*event_slot_values[slot])();
+        });
+    }
+
+    delete statemachine;
+    return status;
+}
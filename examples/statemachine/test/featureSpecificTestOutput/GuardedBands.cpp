@@ -0,0 +1,356 @@
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <queue>
+#ifdef STATEMACHINE_POSIX_IO
+#include <poll.h>
+#endif
+#include "statemachine_queue.hpp"
+class GuardedBands;
+
+namespace statemachine_timer {
+
+using clock = std::chrono::steady_clock;
+
+// Event loop for transitions suspended in setTimeout. Timers are kept in a min-heap
+// and resumed in deadline order (ties in the order they were started).
+class scheduler {
+public:
+    static scheduler &instance() {
+        static scheduler shared;
+        return shared;
+    }
+
+    void schedule(clock::time_point deadline, std::coroutine_handle<> handle) {
+        timers.push(timer{deadline, next_sequence++, handle});
+    }
+
+    // Resumes every timer that is due and returns whether any are left.
+    bool run_due() {
+        while (!timers.empty() && timers.top().deadline <= clock::now()) {
+            const std::coroutine_handle<> handle = timers.top().handle;
+            timers.pop();
+            handle.resume();
+        }
+        return !timers.empty();
+    }
+
+#ifdef STATEMACHINE_POSIX_IO
+    // Returns once the input on fd is readable, running due timers while waiting.
+    void run_until_readable(int fd) {
+        for (;;) {
+            const bool pending = run_due();
+            std::cout.flush();
+            if (!pending) {
+                return;
+            }
+            const auto delay = std::chrono::ceil<std::chrono::milliseconds>(timers.top().deadline - clock::now());
+            pollfd input{fd, POLLIN, 0};
+            if (poll(&input, 1, static_cast<int>(std::max<std::chrono::milliseconds::rep>(delay.count(), 0))) != 0) {
+                return;
+            }
+        }
+    }
+#endif
+
+    // Sleeps until every pending timer has fired.
+    void run_until_idle() {
+        while (run_due()) {
+            std::cout.flush();
+            std::this_thread::sleep_until(timers.top().deadline);
+        }
+    }
+
+private:
+    struct timer {
+        clock::time_point deadline;
+        std::uint64_t sequence;
+        std::coroutine_handle<> handle;
+
+        bool operator>(const timer &other) const {
+            return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+        }
+    };
+
+    std::priority_queue<timer, std::vector<timer>, std::greater<timer>> timers;
+    std::uint64_t next_sequence = 0;
+};
+
+// Awaitable of setTimeout: suspends the transition and resumes it from the scheduler.
+struct sleep_for {
+    std::chrono::milliseconds duration;
+
+    bool await_ready() const noexcept {
+        return duration.count() <= 0;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) const {
+        scheduler::instance().schedule(clock::now() + duration, handle);
+    }
+
+    void await_resume() const noexcept {}
+};
+
+// Fire-and-forget coroutine of a transition body; it starts eagerly and its frame
+// is freed when the body returns.
+struct task {
+    struct promise_type {
+        task get_return_object() noexcept {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept {
+            std::terminate();
+        }
+    };
+};
+
+// Installed as before_stdin_read, so suspended transitions keep completing while the
+// program waits for input.
+inline void run_timers_until_input() {
+#ifdef STATEMACHINE_POSIX_IO
+    scheduler::instance().run_until_readable(STDIN_FILENO);
+#else
+    scheduler::instance().run_due();
+#endif
+}
+
+} // namespace statemachine_timer
+
+class State {
+public:
+    virtual ~State() {}
+
+    virtual std::string_view get_name() const {
+        return "Unknown";
+    }
+
+    virtual void sample(GuardedBands *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+
+    virtual void reset(GuardedBands *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+};
+
+class GuardedBands {
+private:
+    const State* state = nullptr;
+public:
+    int level = 0;
+    int alarms = 0;
+    GuardedBands(const State* initial_state) {
+        state = initial_state;
+        SM_TRACE_TRANSITION("[" << state->get_name() << "]");
+    }
+
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());
+        state = new_state;
+    }
+    void sample() {
+        state->sample(this);
+    }
+    void reset() {
+        state->reset(this);
+    }
+    
+    using event_handle = void (GuardedBands::*)();
+    bool suspended = false;
+    statemachine_queue::event_queue<event_handle, 64, statemachine_queue::queue_overflow::reject> pending;
+
+    void post(event_handle event) {
+        if (suspended) {
+            if (!pending.push(event)) {
+                SM_TRACE("The event queue is full; the event is rejected.");
+            }
+            return;
+        }
+        (this->*event)();
+    }
+
+    void resume_pending() {
+        suspended = false;
+        while (!suspended && !pending.empty()) {
+            (this->*pending.pop())();
+        }
+    }
+};
+
+class Normal : public State {
+public:
+    static const Normal instance;
+    std::string_view get_name() const override { return "Normal"; }
+    void sample(GuardedBands *statemachine) const override;
+    void reset(GuardedBands *statemachine) const override;
+};
+class Warning : public State {
+public:
+    static const Warning instance;
+    std::string_view get_name() const override { return "Warning"; }
+    void sample(GuardedBands *statemachine) const override;
+    void reset(GuardedBands *statemachine) const override;
+};
+class Alarm : public State {
+public:
+    static const Alarm instance;
+    std::string_view get_name() const override { return "Alarm"; }
+    void reset(GuardedBands *statemachine) const override;
+};
+    // Normal
+    const Normal Normal::instance;
+
+    void Normal::sample(GuardedBands *statemachine) const {
+        const int value = statemachine->level;
+        if (value < 10) {
+            statemachine->level = (statemachine->level + 7);
+            std::cout << "low " << statemachine->level << '\n';
+            statemachine->transition_to(&Normal::instance);
+        } else if (value > 19) {
+            if (value < 30) {
+                SM_TRACE("Transition not allowed.");
+            } else {
+                statemachine->alarms = (statemachine->alarms + 1);
+                statemachine->transition_to(&Alarm::instance);
+            }
+        } else {
+            std::cout << "warning " << statemachine->level << '\n';
+            statemachine->transition_to(&Warning::instance);
+        }
+    }
+    
+
+    void Normal::reset(GuardedBands *statemachine) const {
+        statemachine->level = (statemachine->level - 8);
+        statemachine->transition_to(&Normal::instance);
+    }
+    
+    // Warning
+    const Warning Warning::instance;
+
+    void Warning::sample(GuardedBands *statemachine) const {
+        if ((statemachine->alarms > 2)) {
+            statemachine->transition_to(&Alarm::instance);
+        } else if ((statemachine->level > 15)) {
+            statemachine->alarms = (statemachine->alarms + 1);
+            statemachine->transition_to(&Alarm::instance);
+        } else {
+            statemachine->level = (statemachine->level + 3);
+            statemachine->transition_to(&Normal::instance);
+        }
+    }
+    
+
+    void Warning::reset(GuardedBands *statemachine) const {
+        statemachine->level = 0;
+        statemachine->transition_to(&Normal::instance);
+    }
+    
+    // Alarm
+    const Alarm Alarm::instance;
+
+    static statemachine_timer::task Alarm_reset_0_run(GuardedBands *statemachine) {
+            statemachine->level = 35;
+            SM_TRACE("Delaying transition for 10 milliseconds...");
+            co_await statemachine_timer::sleep_for{std::chrono::milliseconds(10)};
+        statemachine->transition_to(&Normal::instance);
+        statemachine->resume_pending();
+    }
+
+    void Alarm::reset(GuardedBands *statemachine) const {
+        if ((statemachine->alarms < 3)) {
+            statemachine->suspended = true;
+            Alarm_reset_0_run(statemachine);
+        } else {
+            statemachine->transition_to(&Alarm::instance);
+        }
+    }
+    
+
+typedef void (GuardedBands::*Event)();
+
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 2;
+constexpr std::int32_t event_displacements[event_slot_count] = { 0, 4 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "reset", "sample" };
+constexpr Event event_slot_values[event_slot_count] = { &GuardedBands::reset, &GuardedBands::sample };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0x8a15d8c93c86c75aull;
+constexpr Event event_ids[2] = { &GuardedBands::sample, &GuardedBands::reset };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    GuardedBands *statemachine = new GuardedBands(&Normal::instance);
+
+    statemachine_input::before_stdin_read = statemachine_timer::run_timers_until_input;
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 2, [statemachine](std::size_t id, std::uint64_t) { statemachine->post(event_ids[id]); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the GuardedBands statemachine.");
+                return;
+            }
+            statemachine->post(event_slot_values[slot]);
+        });
+    }
+    statemachine_timer::scheduler::instance().run_until_idle();
+
+    delete statemachine;
+    return status;
+}
@@ -0,0 +1,596 @@
+#ifndef GUARDED_BANDS_HPP
+#define GUARDED_BANDS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+#if __has_include(<span>)
+#include <span>
+#endif
+#include <chrono>
+#include <coroutine>
+#include <exception>
+
+#include "statemachine_queue.hpp"
+
+namespace guarded_bands {
+
+enum class State : std::uint8_t {
+    Normal,
+    Warning,
+    Alarm
+};
+
+enum class Event : std::uint8_t {
+    sample,
+    reset
+};
+
+constexpr std::size_t state_count = 3;
+constexpr std::size_t event_count = 2;
+
+enum class Result : std::uint8_t {
+    transitioned, // the machine is in the target state of the transition
+    rejected,     // the guard of the transition did not hold
+    impossible,   // the current state has no transition for the event
+    suspended,    // the transition waits in setTimeout until run_timers completes it
+    queued,       // another transition is in flight; the event is dispatched after it
+    dropped       // another transition is in flight and the event queue is full
+};
+
+// Outcome of Machine::dispatch_batch.
+struct BatchResult {
+    std::size_t processed;   // events taken from the batch; fewer only if a transition suspended
+    std::size_t rejected_at; // index of the first rejected, impossible or dropped event, or processed if there was none
+    Result rejection;        // the result of that event, else Result::transitioned
+};
+
+std::string_view state_name(State state);
+std::string_view event_name(Event event);
+
+// Looks up an event by its name in the model.
+std::optional<Event> find_event(std::string_view name);
+
+// Default Commands policy: every command of the model is a no-op. A host policy derives
+// from it and hides the commands it implements; the others still compile to nothing.
+struct NoCommands {
+};
+
+namespace detail {
+
+// Stack buffer a print action is formatted into, sized by the generator for its longest output.
+// Output beyond the capacity is cut off rather than written past the buffer.
+template <std::size_t Capacity>
+struct text {
+    char data[Capacity];
+    std::size_t size = 0;
+
+    void put(char c) {
+        if (size < Capacity) {
+            data[size++] = c;
+        }
+    }
+
+    void append(const char *literal) {
+        while (*literal != '\0') {
+            put(*literal++);
+        }
+    }
+
+    void append(long long value) {
+        char digits[20];
+        std::size_t count = 0;
+        unsigned long long magnitude = value < 0 ? 0ull - static_cast<unsigned long long>(value) : static_cast<unsigned long long>(value);
+        do {
+            digits[count++] = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude != 0);
+        if (value < 0) {
+            put('-');
+        }
+        while (count > 0) {
+            put(digits[--count]);
+        }
+    }
+};
+
+// Fire-and-forget coroutine of a transition body; it starts eagerly and its frame
+// is freed when the body returns.
+struct task {
+    struct promise_type {
+        task get_return_object() noexcept {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept {
+            std::terminate();
+        }
+    };
+};
+
+} // namespace detail
+
+// Command actions call the members of Commands directly, so they inline into dispatch.
+template <typename Commands = NoCommands>
+class Machine {
+public:
+    Commands commands;
+    // Hooks are optional; an unset hook costs a single branch. They are plain function
+    // pointers, so calling them never allocates, and hook_context is passed to them unchanged.
+    void *hook_context = nullptr;
+    void (*on_transition)(void *context, State from, State to) = nullptr;
+    // The text is formatted into a stack buffer and only valid during the call.
+    void (*on_print)(void *context, std::string_view text) = nullptr;
+    // Events dispatched while a transition is in flight, such as those a hook or command
+    // dispatches, are queued, and dispatch returns Result::queued. Their own result is passed
+    // to on_queued_result once they are dispatched.
+    void (*on_queued_result)(void *context, Event event, Result result) = nullptr;
+
+    Machine() = default;
+
+    explicit Machine(Commands commands) : commands(std::move(commands)) {}
+    
+    Machine(const Machine &) = delete;
+    Machine &operator=(const Machine &) = delete;
+
+    ~Machine() {
+        if (waiting) {
+            waiting.destroy();
+        }
+    }
+
+    Result dispatch(Event event) {
+        if (dispatching || waiting) {
+            return pending.push(event) ? Result::queued : Result::dropped;
+        }
+        dispatching = true;
+        const Result result = take_transition(event);
+        dispatching = false;
+        dispatch_pending();
+        return result;
+    }
+
+    // Same as calling dispatch for every event, but the state and the attributes stay in locals
+    // between the hooks and commands; before each of them they are stored back, and after it
+    // reloaded, so host code sees and changes the machine as it would during dispatch.
+    BatchResult dispatch_batch(const Event *events, std::size_t size) {
+        if (dispatching || waiting) {
+            BatchResult queued{size, size, Result::transitioned};
+            for (std::size_t i = 0; i < size; ++i) {
+                if (!pending.push(events[i]) && queued.rejection == Result::transitioned) {
+                    queued.rejected_at = i;
+                    queued.rejection = Result::dropped;
+                }
+            }
+            return queued;
+        }
+        dispatching = true;
+        [[maybe_unused]] Machine *const statemachine = this;
+        State current = state;
+        int local_level = level;
+        int local_alarms = alarms;
+        BatchResult result{size, size, Result::transitioned};
+        for (std::size_t i = 0; i < size; ++i) {
+            Result outcome = Result::impossible;
+            switch (current) {
+            case State::Normal:
+                switch (events[i]) {
+                case Event::sample:
+                    {
+                        const int value = local_level;
+                        if (value < 10) {
+                            local_level = (local_level + 7);
+                            state = current;
+                            level = local_level;
+                            alarms = local_alarms;
+                            if (statemachine->on_print) {
+                                detail::text<24> text;
+                                text.append("low ");
+                                text.append(static_cast<long long>(local_level));
+                                statemachine->on_print(statemachine->hook_context, std::string_view(text.data, text.size));
+                            }
+                            local_level = level;
+                            local_alarms = alarms;
+                            if (on_transition) {
+                                state = State::Normal;
+                                level = local_level;
+                                alarms = local_alarms;
+                                on_transition(hook_context, current, State::Normal);
+                                local_level = level;
+                                local_alarms = alarms;
+                            }
+                            current = State::Normal;
+                            outcome = Result::transitioned;
+                        } else if (value > 19) {
+                            if (value < 30) {
+                                outcome = Result::rejected;
+                            } else {
+                                local_alarms = (local_alarms + 1);
+                                if (on_transition) {
+                                    state = State::Alarm;
+                                    level = local_level;
+                                    alarms = local_alarms;
+                                    on_transition(hook_context, current, State::Alarm);
+                                    local_level = level;
+                                    local_alarms = alarms;
+                                }
+                                current = State::Alarm;
+                                outcome = Result::transitioned;
+                            }
+                        } else {
+                            state = current;
+                            level = local_level;
+                            alarms = local_alarms;
+                            if (statemachine->on_print) {
+                                detail::text<28> text;
+                                text.append("warning ");
+                                text.append(static_cast<long long>(local_level));
+                                statemachine->on_print(statemachine->hook_context, std::string_view(text.data, text.size));
+                            }
+                            local_level = level;
+                            local_alarms = alarms;
+                            if (on_transition) {
+                                state = State::Warning;
+                                level = local_level;
+                                alarms = local_alarms;
+                                on_transition(hook_context, current, State::Warning);
+                                local_level = level;
+                                local_alarms = alarms;
+                            }
+                            current = State::Warning;
+                            outcome = Result::transitioned;
+                        }
+                    }
+                    break;
+                case Event::reset:
+                    local_level = (local_level - 8);
+                    if (on_transition) {
+                        state = State::Normal;
+                        level = local_level;
+                        alarms = local_alarms;
+                        on_transition(hook_context, current, State::Normal);
+                        local_level = level;
+                        local_alarms = alarms;
+                    }
+                    current = State::Normal;
+                    outcome = Result::transitioned;
+                    break;
+                default:
+                    break;
+                }
+                break;
+            case State::Warning:
+                switch (events[i]) {
+                case Event::sample:
+                    {
+                        if ((local_alarms > 2)) {
+                            if (on_transition) {
+                                state = State::Alarm;
+                                level = local_level;
+                                alarms = local_alarms;
+                                on_transition(hook_context, current, State::Alarm);
+                                local_level = level;
+                                local_alarms = alarms;
+                            }
+                            current = State::Alarm;
+                            outcome = Result::transitioned;
+                        } else if ((local_level > 15)) {
+                            local_alarms = (local_alarms + 1);
+                            if (on_transition) {
+                                state = State::Alarm;
+                                level = local_level;
+                                alarms = local_alarms;
+                                on_transition(hook_context, current, State::Alarm);
+                                local_level = level;
+                                local_alarms = alarms;
+                            }
+                            current = State::Alarm;
+                            outcome = Result::transitioned;
+                        } else {
+                            local_level = (local_level + 3);
+                            if (on_transition) {
+                                state = State::Normal;
+                                level = local_level;
+                                alarms = local_alarms;
+                                on_transition(hook_context, current, State::Normal);
+                                local_level = level;
+                                local_alarms = alarms;
+                            }
+                            current = State::Normal;
+                            outcome = Result::transitioned;
+                        }
+                    }
+                    break;
+                case Event::reset:
+                    local_level = 0;
+                    if (on_transition) {
+                        state = State::Normal;
+                        level = local_level;
+                        alarms = local_alarms;
+                        on_transition(hook_context, current, State::Normal);
+                        local_level = level;
+                        local_alarms = alarms;
+                    }
+                    current = State::Normal;
+                    outcome = Result::transitioned;
+                    break;
+                default:
+                    break;
+                }
+                break;
+            case State::Alarm:
+                switch (events[i]) {
+                case Event::reset:
+                    state = current;
+                    level = local_level;
+                    alarms = local_alarms;
+                    outcome = Alarm_reset(this);
+                    current = state;
+                    local_level = level;
+                    local_alarms = alarms;
+                    break;
+                default:
+                    break;
+                }
+                break;
+            }
+            if ((outcome == Result::rejected || outcome == Result::impossible) && result.rejection == Result::transitioned) {
+                result.rejected_at = i;
+                result.rejection = outcome;
+            }
+            if (outcome == Result::suspended) {
+                result.processed = i + 1;
+                break;
+            }
+            // Events the hooks and commands dispatched follow the one that raised them, as with dispatch
+            if (!pending.empty()) {
+                state = current;
+                level = local_level;
+                alarms = local_alarms;
+                dispatching = false;
+                dispatch_pending();
+                dispatching = true;
+                current = state;
+                local_level = level;
+                local_alarms = alarms;
+                if (waiting) {
+                    result.processed = i + 1;
+                    break;
+                }
+            }
+        }
+        state = current;
+        level = local_level;
+        alarms = local_alarms;
+        dispatching = false;
+        return result;
+    }
+    #ifdef __cpp_lib_span
+
+    BatchResult dispatch_batch(std::span<const Event> events) {
+        return dispatch_batch(events.data(), events.size());
+    }
+    #endif
+
+    State current_state() const {
+        return state;
+    }
+    
+    // Completes the suspended transition once its delay has elapsed and dispatches the
+    // events queued meanwhile; returns whether a transition is still suspended.
+    bool run_timers() {
+        if (waiting && std::chrono::steady_clock::now() >= deadline) {
+            const std::coroutine_handle<> handle = waiting;
+            waiting = nullptr;
+            dispatching = true;
+            handle.resume();
+            dispatching = false;
+            dispatch_pending();
+        }
+        return static_cast<bool>(waiting);
+    }
+
+    bool suspended() const {
+        return static_cast<bool>(waiting);
+    }
+
+    // When the suspended transition is due to continue.
+    std::chrono::steady_clock::time_point next_deadline() const {
+        return deadline;
+    }
+    
+    int get_level() const {
+        return level;
+    }
+
+    void set_level(int value) {
+        level = value;
+    }
+
+    int get_alarms() const {
+        return alarms;
+    }
+
+    void set_alarms(int value) {
+        alarms = value;
+    }
+
+private:
+    // Awaitable of setTimeout: parks the transition on its machine until run_timers resumes it.
+    struct delay {
+        Machine *machine;
+        std::chrono::milliseconds duration;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) const {
+            machine->waiting = handle;
+            machine->deadline = std::chrono::steady_clock::now() + duration;
+        }
+
+        void await_resume() const noexcept {}
+    };
+    void change_state(State target) {
+        const State from = state;
+        state = target;
+        if (on_transition) {
+            on_transition(hook_context, from, target);
+        }
+    }
+
+    Result take_transition(Event event) {
+        switch (state) {
+        case State::Normal:
+            switch (event) {
+            case Event::sample:
+                return Normal_sample(this);
+            case Event::reset:
+                return Normal_reset(this);
+            default:
+                break;
+            }
+            break;
+        case State::Warning:
+            switch (event) {
+            case Event::sample:
+                return Warning_sample(this);
+            case Event::reset:
+                return Warning_reset(this);
+            default:
+                break;
+            }
+            break;
+        case State::Alarm:
+            switch (event) {
+            case Event::reset:
+                return Alarm_reset(this);
+            default:
+                break;
+            }
+            break;
+        }
+        return Result::impossible;
+    }
+
+    // Dispatches the queued events in arrival order until a transition suspends.
+    void dispatch_pending() {
+        while (!waiting && !pending.empty()) {
+            const Event event = pending.pop();
+            dispatching = true;
+            const Result result = take_transition(event);
+            dispatching = false;
+            if (on_queued_result) {
+                on_queued_result(hook_context, event, result);
+            }
+        }
+    }
+
+    // Normal
+    
+    static Result Normal_sample([[maybe_unused]] Machine *statemachine) {
+        const int value = statemachine->level;
+        if (value < 10) {
+            statemachine->level = (statemachine->level + 7);
+            if (statemachine->on_print) {
+                detail::text<24> text;
+                text.append("low ");
+                text.append(static_cast<long long>(statemachine->level));
+                statemachine->on_print(statemachine->hook_context, std::string_view(text.data, text.size));
+            }
+            statemachine->change_state(State::Normal);
+            return Result::transitioned;
+        } else if (value > 19) {
+            if (value < 30) {
+                return Result::rejected;
+            } else {
+                statemachine->alarms = (statemachine->alarms + 1);
+                statemachine->change_state(State::Alarm);
+                return Result::transitioned;
+            }
+        } else {
+            if (statemachine->on_print) {
+                detail::text<28> text;
+                text.append("warning ");
+                text.append(static_cast<long long>(statemachine->level));
+                statemachine->on_print(statemachine->hook_context, std::string_view(text.data, text.size));
+            }
+            statemachine->change_state(State::Warning);
+            return Result::transitioned;
+        }
+    }
+
+    
+    static Result Normal_reset([[maybe_unused]] Machine *statemachine) {
+            statemachine->level = (statemachine->level - 8);
+        statemachine->change_state(State::Normal);
+        return Result::transitioned;
+    }
+
+    // Warning
+    
+    static Result Warning_sample([[maybe_unused]] Machine *statemachine) {
+        if ((statemachine->alarms > 2)) {
+            statemachine->change_state(State::Alarm);
+            return Result::transitioned;
+        } else if ((statemachine->level > 15)) {
+            statemachine->alarms = (statemachine->alarms + 1);
+            statemachine->change_state(State::Alarm);
+            return Result::transitioned;
+        } else {
+            statemachine->level = (statemachine->level + 3);
+            statemachine->change_state(State::Normal);
+            return Result::transitioned;
+        }
+    }
+
+    
+    static Result Warning_reset([[maybe_unused]] Machine *statemachine) {
+            statemachine->level = 0;
+        statemachine->change_state(State::Normal);
+        return Result::transitioned;
+    }
+
+    // Alarm
+    
+    static detail::task Alarm_reset_0_run(Machine *statemachine) {
+            statemachine->level = 35;
+            co_await Machine::delay{statemachine, std::chrono::milliseconds(10)};
+        statemachine->change_state(State::Normal);
+    }
+
+    static Result Alarm_reset([[maybe_unused]] Machine *statemachine) {
+        if ((statemachine->alarms < 3)) {
+            Alarm_reset_0_run(statemachine);
+            return statemachine->waiting ? Result::suspended : Result::transitioned;
+        } else {
+            statemachine->change_state(State::Alarm);
+            return Result::transitioned;
+        }
+    }
+
+    State state = State::Normal;
+    bool dispatching = false;
+    int level = 0;
+    int alarms = 0;
+    std::coroutine_handle<> waiting;
+    std::chrono::steady_clock::time_point deadline;
+    statemachine_queue::event_queue<Event, 64, statemachine_queue::queue_overflow::reject> pending;
+};
+
+} // namespace guarded_bands
+
+#endif // GUARDED_BANDS_HPP
@@ -0,0 +1,105 @@
+#include "GuardedBands.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <queue>
+#ifdef STATEMACHINE_POSIX_IO
+#include <poll.h>
+#endif
+#include "statemachine_queue.hpp"
+
+constexpr std::uint64_t event_stream_fingerprint = 0x8a15d8c93c86c75aull;
+
+static guarded_bands::Machine<> machine;
+
+// Installed as before_stdin_read, so suspended transitions keep completing while the
+// program waits for input.
+static void run_timers_until_input() {
+    for (;;) {
+        const bool waiting = machine.run_timers();
+        std::cout.flush();
+        if (!waiting) {
+            return;
+        }
+#ifdef STATEMACHINE_POSIX_IO
+        const auto delay = std::chrono::ceil<std::chrono::milliseconds>(machine.next_deadline() - std::chrono::steady_clock::now());
+        pollfd input{STDIN_FILENO, POLLIN, 0};
+        if (poll(&input, 1, static_cast<int>(std::max<std::chrono::milliseconds::rep>(delay.count(), 0))) != 0) {
+            return;
+        }
+#else
+        return;
+#endif
+    }
+}
+
+static void report([[maybe_unused]] guarded_bands::Result result) {
+    if (result == guarded_bands::Result::rejected) {
+        SM_TRACE("Transition not allowed.");
+    } else if (result == guarded_bands::Result::impossible) {
+        SM_TRACE("Impossible event for the current state.");
+    } else if (result == guarded_bands::Result::dropped) {
+                    SM_TRACE("The event queue is full; the event is rejected.");
+                }
+}
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    machine.on_transition = [](void *, [[maybe_unused]] guarded_bands::State from, [[maybe_unused]] guarded_bands::State to) {
+        SM_TRACE_TRANSITION(guarded_bands::state_name(from) << " ===> " << guarded_bands::state_name(to));
+    };
+    machine.on_print = [](void *, std::string_view text) {
+        std::cout << text << '\n';
+    };
+    // Events typed while a transition was suspended are reported once they are dispatched
+    machine.on_queued_result = [](void *, guarded_bands::Event, guarded_bands::Result result) {
+        report(result);
+    };
+    SM_TRACE_TRANSITION("[" << guarded_bands::state_name(machine.current_state()) << "]");
+
+    statemachine_input::before_stdin_read = run_timers_until_input;
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, guarded_bands::event_count, [](std::size_t id, std::uint64_t) {
+            report(machine.dispatch(static_cast<guarded_bands::Event>(id)));
+        });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [](std::string_view input) {
+            const std::optional<guarded_bands::Event> event = guarded_bands::find_event(input);
+            if (!event) {
+                SM_TRACE("There is no event <" << input << "> in the GuardedBands statemachine.");
+                return;
+            }
+            report(machine.dispatch(*event));
+        });
+    }
+    while (machine.run_timers()) {
+        std::cout.flush();
+        std::this_thread::sleep_until(machine.next_deadline());
+    }
+    return status;
+}
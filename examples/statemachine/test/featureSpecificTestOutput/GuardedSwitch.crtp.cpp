@@ -0,0 +1,138 @@
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#include "statemachine_runtime.hpp"
+#include <cstdint>
+#include <chrono>
+#include <thread>
+
+enum class GuardedSwitchState : std::uint8_t {
+    Off,
+    On
+};
+
+enum class GuardedSwitchEvent : std::uint8_t {
+    toggle,
+    reset
+};
+
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 2;
+constexpr std::int32_t event_displacements[event_slot_count] = { 0, 1 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "reset", "toggle" };
+constexpr GuardedSwitchEvent event_slot_values[event_slot_count] = { GuardedSwitchEvent::reset, GuardedSwitchEvent::toggle };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+struct GuardedSwitchTraits {
+    using state_id = GuardedSwitchState;
+    using event_id = GuardedSwitchEvent;
+    static constexpr std::size_t state_count = 2;
+    static constexpr std::size_t event_count = 2;
+    static constexpr std::string_view machine_name = "GuardedSwitch";
+    static constexpr std::uint64_t fingerprint = 0x0d029afac78e132aull;
+    static constexpr std::size_t queue_capacity = 64;
+    static constexpr statemachine_queue::queue_overflow queue_policy = statemachine_queue::queue_overflow::reject;
+    static constexpr std::string_view state_names[state_count] = {
+        "Off",
+        "On"
+    };
+    static constexpr std::string_view event_names[event_count] = {
+        "toggle",
+        "reset"
+    };
+
+    static bool find_event(std::string_view name, event_id &event) {
+        const int slot = find_event_slot(name);
+        if (slot < 0) {
+            return false;
+        }
+        event = event_slot_values[slot];
+        return true;
+    }
+};
+
+class GuardedSwitch : public statemachine_runtime::machine<GuardedSwitch, GuardedSwitchTraits> {
+public:
+    int count = 0;
+    bool isOn = false;
+    bool isActive = true;
+    GuardedSwitch() : machine(state_id::Off) {}
+};
+
+namespace statemachine_runtime {
+// Off
+
+template <>
+struct transition<GuardedSwitchTraits::state_id::Off, GuardedSwitchTraits::event_id::toggle> {
+    static constexpr bool defined = true;
+    static constexpr GuardedSwitchTraits::state_id target = GuardedSwitchTraits::state_id::On;
+
+    static bool guard([[maybe_unused]] GuardedSwitch *statemachine) {
+        return (statemachine->count < 3);
+    }
+
+    static void action([[maybe_unused]] GuardedSwitch *statemachine) {
+            statemachine->isOn = true;
+            statemachine->count = (statemachine->count + 1);
+    }
+};
+
+// On
+
+template <>
+struct transition<GuardedSwitchTraits::state_id::On, GuardedSwitchTraits::event_id::toggle> {
+    static constexpr bool defined = true;
+    static constexpr GuardedSwitchTraits::state_id target = GuardedSwitchTraits::state_id::Off;
+
+    static bool guard([[maybe_unused]] GuardedSwitch *statemachine) {
+        return true;
+    }
+
+    static void action([[maybe_unused]] GuardedSwitch *statemachine) {
+            statemachine->isOn = false;
+            statemachine->count = (statemachine->count * 2);
+    }
+};
+
+
+template <>
+struct transition<GuardedSwitchTraits::state_id::On, GuardedSwitchTraits::event_id::reset> {
+    static constexpr bool defined = true;
+    static constexpr GuardedSwitchTraits::state_id target = GuardedSwitchTraits::state_id::Off;
+
+    static bool guard([[maybe_unused]] GuardedSwitch *statemachine) {
+        return true;
+    }
+
+    static void action([[maybe_unused]] GuardedSwitch *statemachine) {
+            statemachine->isOn = false;
+            statemachine->count = 0;
+            statemachine->isActive = false;
+    }
+};
+
+} // namespace statemachine_runtime
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    GuardedSwitch statemachine;
+    const int status = statemachine.run(argc, argv);
+    return status;
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+module;
+
+#include "GuardedSwitch.hpp"
+
+export module GuardedSwitch;
+
+export using State = ::State;
+export using GuardedSwitch = ::GuardedSwitch;
+export using Off = ::Off;
+export using On = ::On;
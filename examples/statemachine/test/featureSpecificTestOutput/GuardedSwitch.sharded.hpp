@@ -0,0 +1,83 @@
+#ifndef GUARDED_SWITCH_HPP
+#define GUARDED_SWITCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+class GuardedSwitch;
+
+class State {
+public:
+    virtual ~State() {}
+
+    virtual std::string_view get_name() const {
+        return "Unknown";
+    }
+
+    virtual void toggle(GuardedSwitch *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+
+    virtual void reset(GuardedSwitch *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+};
+
+class GuardedSwitch {
+private:
+    const State* state = nullptr;
+public:
+    int count = 0;
+    bool isOn = false;
+    bool isActive = true;
+    GuardedSwitch(const State* initial_state) {
+        state = initial_state;
+        SM_TRACE_TRANSITION("[" << state->get_name() << "]");
+    }
+
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());
+        state = new_state;
+    }
+    void toggle() {
+        state->toggle(this);
+    }
+    void reset() {
+        state->reset(this);
+    }
+};
+
+class Off : public State {
+public:
+    static const Off instance;
+    std::string_view get_name() const override { return "Off"; }
+    void toggle(GuardedSwitch *statemachine) const override;
+};
+class On : public State {
+public:
+    static const On instance;
+    std::string_view get_name() const override { return "On"; }
+    void toggle(GuardedSwitch *statemachine) const override;
+    void reset(GuardedSwitch *statemachine) const override;
+};
+
+#endif // GUARDED_SWITCH_HPP
\ No newline at end of file
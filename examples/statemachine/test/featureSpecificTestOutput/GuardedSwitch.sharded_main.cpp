@@ -0,0 +1,53 @@
+#include "GuardedSwitch.hpp"
+
+typedef void (GuardedSwitch::*Event)();
+
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 2;
+constexpr std::int32_t event_displacements[event_slot_count] = { 0, 1 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "reset", "toggle" };
+constexpr Event event_slot_values[event_slot_count] = { &GuardedSwitch::reset, &GuardedSwitch::toggle };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0x0d029afac78e132aull;
+constexpr Event event_ids[2] = { &GuardedSwitch::toggle, &GuardedSwitch::reset };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    GuardedSwitch *statemachine = new GuardedSwitch(&Off::instance);
+
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 2, [statemachine](std::size_t id, std::uint64_t) { (statemachine->*event_ids[id])(); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the GuardedSwitch statemachine.");
+                return;
+            }
+            (statemachine->*event_slot_values[slot])();
+        });
+    }
+
+    delete statemachine;
+    return status;
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#include "GuardedSwitch.hpp"
+
+    // Off
+    const Off Off::instance;
+
+    void Off::toggle(GuardedSwitch *statemachine) const {
+        const int cse_0 = statemachine->count;
+        if ((cse_0 < 3)) {
+            statemachine->isOn = true;
+            statemachine->count = (cse_0 + 1);
+            statemachine->transition_to(&On::instance);
+        } else {
+            SM_TRACE("Transition not allowed.");
+        }
+    }
+    
@@ -0,0 +1,19 @@
+#include "GuardedSwitch.hpp"
+
+    // On
+    const On On::instance;
+
+    void On::toggle(GuardedSwitch *statemachine) const {
+        statemachine->isOn = false;
+        statemachine->count = (statemachine->count * 2);
+        statemachine->transition_to(&Off::instance);
+    }
+    
+
+    void On::reset(GuardedSwitch *statemachine) const {
+        statemachine->isOn = false;
+        statemachine->count = 0;
+        statemachine->isActive = false;
+        statemachine->transition_to(&Off::instance);
+    }
+    
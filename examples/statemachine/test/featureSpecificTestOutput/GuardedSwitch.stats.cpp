@@ -0,0 +1,180 @@
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+#include "statemachine_stats.hpp"
+class GuardedSwitch;
+
+class State {
+public:
+    virtual ~State() {}
+
+    virtual std::string_view get_name() const {
+        return "Unknown";
+    }
+    virtual std::size_t get_id() const = 0;
+
+    virtual void toggle(GuardedSwitch *) const {
+        SM_TRACE("Impossible event for the current state.");
+        SM_STATS_REJECT();
+    }
+
+    virtual void reset(GuardedSwitch *) const {
+        SM_TRACE("Impossible event for the current state.");
+        SM_STATS_REJECT();
+    }
+};
+
+class GuardedSwitch {
+private:
+    const State* state = nullptr;
+public:
+    int count = 0;
+    bool isOn = false;
+    bool isActive = true;
+    GuardedSwitch(const State* initial_state) {
+        state = initial_state;
+        SM_TRACE_TRANSITION("[" << state->get_name() << "]");
+    }
+
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());
+        state = new_state;
+    }
+    
+    std::size_t state_id() const {
+        return state->get_id();
+    }
+    #if SM_STATS
+        // Statistics id of each dispatch, at state_id() * 2 + event; 0 where the state has no transition for the event.
+        static constexpr std::uint8_t stats_pairs[] = {1, 0, 2, 3};
+        statemachine_stats::recorder<3> stats{"GuardedSwitch", {{{"Off", "toggle"}, {"On", "toggle"}, {"On", "reset"}}}};
+    #endif
+    void toggle() {
+        SM_STATS_SCOPE(this, stats_pairs[state_id() * 2 + 0]);
+        state->toggle(this);
+    }
+    void reset() {
+        SM_STATS_SCOPE(this, stats_pairs[state_id() * 2 + 1]);
+        state->reset(this);
+    }
+};
+
+class Off : public State {
+public:
+    static const Off instance;
+    std::string_view get_name() const override { return "Off"; }
+    std::size_t get_id() const override { return 0; }
+    void toggle(GuardedSwitch *statemachine) const override;
+};
+class On : public State {
+public:
+    static const On instance;
+    std::string_view get_name() const override { return "On"; }
+    std::size_t get_id() const override { return 1; }
+    void toggle(GuardedSwitch *statemachine) const override;
+    void reset(GuardedSwitch *statemachine) const override;
+};
+    // Off
+    const Off Off::instance;
+
+    void Off::toggle(GuardedSwitch *statemachine) const {
+        const int cse_0 = statemachine->count;
+        if ((cse_0 < 3)) {
+            statemachine->isOn = true;
+            statemachine->count = (cse_0 + 1);
+            statemachine->transition_to(&On::instance);
+        } else {
+            SM_TRACE("Transition not allowed.");
+            SM_STATS_REJECT();
+        }
+    }
+    
+    // On
+    const On On::instance;
+
+    void On::toggle(GuardedSwitch *statemachine) const {
+        statemachine->isOn = false;
+        statemachine->count = (statemachine->count * 2);
+        statemachine->transition_to(&Off::instance);
+    }
+    
+
+    void On::reset(GuardedSwitch *statemachine) const {
+        statemachine->isOn = false;
+        statemachine->count = 0;
+        statemachine->isActive = false;
+        statemachine->transition_to(&Off::instance);
+    }
+    
+
+typedef void (GuardedSwitch::*Event)();
+
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 2;
+constexpr std::int32_t event_displacements[event_slot_count] = { 0, 1 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "reset", "toggle" };
+constexpr Event event_slot_values[event_slot_count] = { &GuardedSwitch::reset, &GuardedSwitch::toggle };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0x0d029afac78e132aull;
+constexpr Event event_ids[2] = { &GuardedSwitch::toggle, &GuardedSwitch::reset };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    GuardedSwitch *statemachine = new GuardedSwitch(&Off::instance);
+
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 2, [statemachine](std::size_t id, std::uint64_t) { (statemachine->*event_ids[id])(); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the GuardedSwitch statemachine.");
+                return;
+            }
+            (statemachine->*event_slot_values[slot])();
+        });
+    }
+
+    SM_STATS_DUMP(statemachine);
+    delete statemachine;
+    return status;
+}
@@ -0,0 +1,161 @@
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+
+enum class StateId : std::uint8_t {
+    Off,
+    On
+};
+
+enum class EventId : std::uint8_t {
+    toggle,
+    reset
+};
+
+constexpr std::size_t state_count = 2;
+constexpr std::size_t event_count = 2;
+
+constexpr std::string_view state_names[state_count] = {
+    "Off",
+    "On"
+};
+
+class GuardedSwitch;
+
+struct TransitionEntry {
+    bool defined;
+    StateId target;
+    bool (*guard)(GuardedSwitch *statemachine);
+    void (*action)(GuardedSwitch *statemachine);
+};
+
+class GuardedSwitch {
+private:
+    StateId state;
+public:
+    int count = 0;
+    bool isOn = false;
+    bool isActive = true;
+    GuardedSwitch(StateId initial_state) : state(initial_state) {
+        SM_TRACE_TRANSITION("[" << state_names[static_cast<std::size_t>(state)] << "]");
+    }
+
+    void dispatch(EventId event);
+};
+
+// Off
+
+static bool Off_toggle_guard([[maybe_unused]] GuardedSwitch *statemachine) {
+    return (statemachine->count < 3);
+}
+
+static void Off_toggle_action([[maybe_unused]] GuardedSwitch *statemachine) {
+            statemachine->isOn = true;
+            statemachine->count = (statemachine->count + 1);
+}
+
+// On
+
+static void On_toggle_action([[maybe_unused]] GuardedSwitch *statemachine) {
+            statemachine->isOn = false;
+            statemachine->count = (statemachine->count * 2);
+}
+
+
+static void On_reset_action([[maybe_unused]] GuardedSwitch *statemachine) {
+            statemachine->isOn = false;
+            statemachine->count = 0;
+            statemachine->isActive = false;
+}
+
+constexpr TransitionEntry transition_table[state_count][event_count] = {
+    /* Off */ { { true, StateId::On, &Off_toggle_guard, &Off_toggle_action }, { false, StateId::Off, nullptr, nullptr } },
+    /* On */ { { true, StateId::Off, nullptr, &On_toggle_action }, { true, StateId::Off, nullptr, &On_reset_action } }
+};
+
+void GuardedSwitch::dispatch(EventId event) {
+    const TransitionEntry &entry = transition_table[static_cast<std::size_t>(state)][static_cast<std::size_t>(event)];
+    if (!entry.defined) {
+        SM_TRACE("Impossible event for the current state.");
+        return;
+    }
+    if (entry.guard != nullptr && !entry.guard(this)) {
+        SM_TRACE("Transition not allowed.");
+        return;
+    }
+    if (entry.action != nullptr) {
+        entry.action(this);
+    }
+    const StateId target = entry.target;
+    SM_TRACE_TRANSITION(state_names[static_cast<std::size_t>(state)] << " ===> " << state_names[static_cast<std::size_t>(target)]);
+    state = target;
+}
+
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 2;
+constexpr std::int32_t event_displacements[event_slot_count] = { 0, 1 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "reset", "toggle" };
+constexpr EventId event_slot_values[event_slot_count] = { EventId::reset, EventId::toggle };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0x0d029afac78e132aull;
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    GuardedSwitch *statemachine = new GuardedSwitch(StateId::Off);
+
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, event_count, [statemachine](std::size_t id, std::uint64_t) {
+            statemachine->dispatch(static_cast<EventId>(id));
+        });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the GuardedSwitch statemachine.");
+                return;
+            }
+            statemachine->dispatch(event_slot_values[slot]);
+        });
+    }
+
+    delete statemachine;
+    return status;
+}
@@ -0,0 +1,88 @@
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+
+enum class StateId : std::uint8_t {
+    Waiting
+};
+
+enum class EventId : std::uint8_t {
+};
+
+constexpr std::size_t state_count = 1;
+constexpr std::size_t event_count = 0;
+
+constexpr std::string_view state_names[state_count] = {
+    "Waiting"
+};
+
+class NoEvents;
+
+struct TransitionEntry {
+    bool defined;
+    StateId target;
+    bool (*guard)(NoEvents *statemachine);
+    void (*action)(NoEvents *statemachine);
+};
+
+class NoEvents {
+private:
+    StateId state;
+public:
+    NoEvents(StateId initial_state) : state(initial_state) {
+        SM_TRACE_TRANSITION("[" << state_names[static_cast<std::size_t>(state)] << "]");
+    }
+
+    void dispatch(EventId event);
+};
+
+// Waiting
+void NoEvents::dispatch(EventId) {
+    SM_TRACE("Impossible event for the current state.");
+}
+
+constexpr const EventId *event_slot_values = nullptr;
+
+inline int find_event_slot(std::string_view) {
+    return -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0xb6a2e17230dc8b3full;
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    NoEvents *statemachine = new NoEvents(StateId::Waiting);
+
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, event_count, [statemachine](std::size_t id, std::uint64_t) {
+            statemachine->dispatch(static_cast<EventId>(id));
+        });
+    } else {
+        status = statemachine_input::read_events(arguments.path, []([[maybe_unused]] std::string_view input) {
+            SM_TRACE("There is no event <" << input << "> in the NoEvents statemachine.");
+        });
+    }
+
+    delete statemachine;
+    return status;
+}
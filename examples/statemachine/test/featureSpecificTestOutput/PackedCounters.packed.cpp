@@ -0,0 +1,182 @@
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+class PackedCounters;
+
+class State {
+public:
+    virtual ~State() {}
+
+    virtual std::string_view get_name() const {
+        return "Unknown";
+    }
+
+    virtual void press(PackedCounters *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+
+    virtual void release(PackedCounters *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+
+    virtual void tick(PackedCounters *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+};
+
+class PackedCounters {
+private:
+    const State* state = nullptr;
+public:
+    std::uint8_t mode = 0;
+    bool pressed : 1;
+    bool enabled : 1;
+    std::int8_t offset = -3;
+    int total = 0;
+    std::uint16_t label = 1000;
+    PackedCounters(const State* initial_state) : pressed(false), enabled(true) {
+        state = initial_state;
+        SM_TRACE_TRANSITION("[" << state->get_name() << "]");
+    }
+
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());
+        state = new_state;
+    }
+    void press() {
+        state->press(this);
+    }
+    void release() {
+        state->release(this);
+    }
+    void tick() {
+        state->tick(this);
+    }
+};
+
+class Idle : public State {
+public:
+    static const Idle instance;
+    std::string_view get_name() const override { return "Idle"; }
+    void press(PackedCounters *statemachine) const override;
+    void tick(PackedCounters *statemachine) const override;
+};
+class Active : public State {
+public:
+    static const Active instance;
+    std::string_view get_name() const override { return "Active"; }
+    void release(PackedCounters *statemachine) const override;
+    void tick(PackedCounters *statemachine) const override;
+};
+    // Idle
+    const Idle Idle::instance;
+
+    void Idle::press(PackedCounters *statemachine) const {
+        const int cse_0 = statemachine->mode;
+        if ((statemachine->enabled && (cse_0 < 2))) {
+            statemachine->pressed = true;
+            statemachine->mode = (2 - cse_0);
+            statemachine->total = (statemachine->total + 1);
+            statemachine->transition_to(&Active::instance);
+        } else {
+            SM_TRACE("Transition not allowed.");
+        }
+    }
+    
+
+    void Idle::tick(PackedCounters *statemachine) const {
+        std::cout << "label " << statemachine->label << " offset " << static_cast<int>(statemachine->offset) << '\n';
+        statemachine->transition_to(&Idle::instance);
+    }
+    
+    // Active
+    const Active Active::instance;
+
+    void Active::release(PackedCounters *statemachine) const {
+        statemachine->pressed = false;
+        statemachine->offset = -statemachine->offset;
+        statemachine->transition_to(&Idle::instance);
+    }
+    
+
+    void Active::tick(PackedCounters *statemachine) const {
+        if ((statemachine->mode == 2)) {
+            statemachine->mode = 0;
+            statemachine->enabled = !statemachine->pressed;
+            statemachine->transition_to(&Idle::instance);
+        } else {
+            SM_TRACE("Transition not allowed.");
+        }
+    }
+    
+
+typedef void (PackedCounters::*Event)();
+
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 3;
+constexpr std::int32_t event_displacements[event_slot_count] = { 0, -2, 2 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "press", "release", "tick" };
+constexpr Event event_slot_values[event_slot_count] = { &PackedCounters::press, &PackedCounters::release, &PackedCounters::tick };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0x829dcfcc2c1913adull;
+constexpr Event event_ids[3] = { &PackedCounters::press, &PackedCounters::release, &PackedCounters::tick };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    PackedCounters *statemachine = new PackedCounters(&Idle::instance);
+
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 3, [statemachine](std::size_t id, std::uint64_t) { (statemachine->*event_ids[id])(); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the PackedCounters statemachine.");
+                return;
+            }
+            (statemachine->*event_slot_values[slot])();
+        });
+    }
+
+    delete statemachine;
+    return status;
+}
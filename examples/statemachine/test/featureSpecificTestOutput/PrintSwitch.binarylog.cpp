@@ -0,0 +1,150 @@
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+#include "statemachine_log.hpp"
+class PrintSwitch;
+
+class State {
+public:
+    virtual ~State() {}
+
+    virtual std::string_view get_name() const {
+        return "Unknown";
+    }
+    virtual std::size_t get_id() const = 0;
+
+    virtual void toggle(PrintSwitch *) const {
+        SM_TRACE("Impossible event for the current state.");
+    }
+};
+
+class PrintSwitch {
+private:
+    const State* state = nullptr;
+public:
+    int count = 0;
+    bool isOn = false;
+    PrintSwitch(const State* initial_state) {
+        state = initial_state;
+        SM_LOG_STATE(state->get_id());
+    }
+
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_LOG_TRANSITION(state->get_id(), new_state->get_id());
+        state = new_state;
+    }
+    void toggle() {
+        state->toggle(this);
+    }
+};
+
+class Off : public State {
+public:
+    static const Off instance;
+    std::string_view get_name() const override { return "Off"; }
+    std::size_t get_id() const override { return 0; }
+    void toggle(PrintSwitch *statemachine) const override;
+};
+class On : public State {
+public:
+    static const On instance;
+    std::string_view get_name() const override { return "On"; }
+    std::size_t get_id() const override { return 1; }
+    void toggle(PrintSwitch *statemachine) const override;
+};
+    // Off
+    const Off Off::instance;
+
+    void Off::toggle(PrintSwitch *statemachine) const {
+        statemachine->isOn = true;
+        statemachine->count = (statemachine->count + 1);
+        statemachine_log::write(2, statemachine->count);
+        statemachine->transition_to(&On::instance);
+    }
+    
+    // On
+    const On On::instance;
+
+    void On::toggle(PrintSwitch *statemachine) const {
+        statemachine->isOn = false;
+        statemachine_log::write(3, statemachine->isOn);
+        statemachine_log::write(2, statemachine->count);
+        statemachine->transition_to(&Off::instance);
+    }
+    
+
+typedef void (PrintSwitch::*Event)();
+
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 1;
+constexpr std::int32_t event_displacements[event_slot_count] = { -1 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "toggle" };
+constexpr Event event_slot_values[event_slot_count] = { &PrintSwitch::toggle };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0x464de2e9329a7112ull;
+constexpr Event event_ids[1] = { &PrintSwitch::toggle };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    if (!statemachine_log::open_log("PrintSwitch.smlog", event_stream_fingerprint)) {
+        std::cerr << "Cannot open the statemachine log: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    PrintSwitch *statemachine = new PrintSwitch(&Off::instance);
+
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 1, [statemachine](std::size_t id, std::uint64_t) { (statemachine->*event_ids[id])(); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the PrintSwitch statemachine.");
+                return;
+            }
+            (statemachine->*event_slot_values[slot])();
+        });
+    }
+
+    delete statemachine;
+    statemachine_log::close_log();
+    return status;
+}
@@ -0,0 +1,89 @@
+#include "PrintSwitch.hpp"
+
+namespace print_switch {
+
+namespace {
+
+struct name {
+    const char *data;
+    std::size_t size;
+
+    template <std::size_t Size>
+    constexpr name(const char (&text)[Size]) : data(text), size(Size - 1) {}
+
+    constexpr name(const char *data, std::size_t size) : data(data), size(size) {}
+
+    constexpr const char *begin() const {
+        return data;
+    }
+
+    constexpr const char *end() const {
+        return data + size;
+    }
+
+    constexpr bool operator==(const name &other) const {
+        if (size != other.size) {
+            return false;
+        }
+        for (std::size_t i = 0; i < size; ++i) {
+            if (data[i] != other.data[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+constexpr const char *state_names[state_count] = {
+    "Off",
+    "On"
+};
+
+constexpr const char *event_names[event_count] = {
+    "toggle"
+};
+
+constexpr std::uint32_t event_hash(std::uint32_t seed, name name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 1;
+constexpr std::int32_t event_displacements[event_slot_count] = { -1 };
+constexpr name event_slot_names[event_slot_count] = { "toggle" };
+constexpr Event event_slot_values[event_slot_count] = { Event::toggle };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(name name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+} // namespace
+
+const char *state_name(State state) {
+    return state_names[static_cast<std::size_t>(state)];
+}
+
+const char *event_name(Event event) {
+    return event_names[static_cast<std::size_t>(event)];
+}
+
+bool find_event(const char *text, std::size_t length, Event &event) {
+    const int slot = find_event_slot(name(text, length));
+    if (slot < 0) {
+        return false;
+    }
+    event = event_slot_values[slot];
+    return true;
+}
+
+} // namespace print_switch
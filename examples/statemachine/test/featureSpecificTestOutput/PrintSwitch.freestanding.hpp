@@ -0,0 +1,184 @@
+#ifndef PRINT_SWITCH_HPP
+#define PRINT_SWITCH_HPP
+
+// Freestanding build of the PrintSwitch statemachine: no iostream, exceptions, RTTI
+// or heap. A Machine lives in static storage and only talks to the firmware through Hooks.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace print_switch {
+
+enum class State : std::uint8_t {
+    Off,
+    On
+};
+
+enum class Event : std::uint8_t {
+    toggle
+};
+
+constexpr std::size_t state_count = 2;
+constexpr std::size_t event_count = 1;
+
+enum class Result : std::uint8_t {
+    transitioned, // the machine is in the target state of the transition
+    rejected,     // the guard of the transition did not hold
+    impossible    // the current state has no transition for the event
+};
+
+// Model names of states and events, as NUL-terminated strings in ROM.
+const char *state_name(State state);
+const char *event_name(Event event);
+
+// Looks up an event by the length characters at name; returns false if the model has no such event.
+bool find_event(const char *name, std::size_t length, Event &event);
+
+// Provided by the firmware; a null hook skips its output.
+struct Hooks {
+    void (*print)(const char *text, std::size_t length);
+    void (*transition)(State from, State to);
+};
+
+namespace detail {
+
+// Stack buffer a print action is formatted into, sized by the generator for its longest output.
+// Output beyond the capacity is cut off rather than written past the buffer.
+template <std::size_t Capacity>
+struct text {
+    char data[Capacity];
+    std::size_t size = 0;
+
+    void put(char c) {
+        if (size < Capacity) {
+            data[size++] = c;
+        }
+    }
+
+    void append(const char *literal) {
+        while (*literal != '\0') {
+            put(*literal++);
+        }
+    }
+
+    void append(long long value) {
+        char digits[20];
+        std::size_t count = 0;
+        unsigned long long magnitude = value < 0 ? 0ull - static_cast<unsigned long long>(value) : static_cast<unsigned long long>(value);
+        do {
+            digits[count++] = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude != 0);
+        if (value < 0) {
+            put('-');
+        }
+        while (count > 0) {
+            put(digits[--count]);
+        }
+    }
+};
+
+} // namespace detail
+
+class Machine {
+public:
+    // constexpr, so a Machine in static storage is initialized without startup code.
+    constexpr explicit Machine(Hooks hooks) : hooks(hooks) {}
+
+    Result dispatch(Event event) {
+        switch (state) {
+        case State::Off:
+            switch (event) {
+            case Event::toggle:
+                return Off_toggle(this);
+            default:
+                break;
+            }
+            break;
+        case State::On:
+            switch (event) {
+            case Event::toggle:
+                return On_toggle(this);
+            default:
+                break;
+            }
+            break;
+        }
+        return Result::impossible;
+    }
+
+    State current_state() const {
+        return state;
+    }
+    
+    int get_count() const {
+        return count;
+    }
+
+    void set_count(int value) {
+        count = value;
+    }
+
+    bool get_isOn() const {
+        return isOn;
+    }
+
+    void set_isOn(bool value) {
+        isOn = value;
+    }
+
+private:
+    void change_state(State target) {
+        const State from = state;
+        state = target;
+        if (hooks.transition) {
+            hooks.transition(from, target);
+        }
+    }
+
+    // Off
+    
+    static Result Off_toggle([[maybe_unused]] Machine *statemachine) {
+            statemachine->isOn = true;
+            statemachine->count = (statemachine->count + 1);
+            if (statemachine->hooks.print) {
+                detail::text<38> text;
+                text.append("Switched on ");
+                text.append(static_cast<long long>(statemachine->count));
+                text.append(" times");
+                statemachine->hooks.print(text.data, text.size);
+            }
+        statemachine->change_state(State::On);
+        return Result::transitioned;
+    }
+
+    // On
+    
+    static Result On_toggle([[maybe_unused]] Machine *statemachine) {
+            statemachine->isOn = false;
+            if (statemachine->hooks.print) {
+                detail::text<33> text;
+                text.append("Light is on: ");
+                text.append(static_cast<long long>(statemachine->isOn));
+                statemachine->hooks.print(text.data, text.size);
+            }
+            if (statemachine->hooks.print) {
+                detail::text<38> text;
+                text.append("Switched on ");
+                text.append(static_cast<long long>(statemachine->count));
+                text.append(" times");
+                statemachine->hooks.print(text.data, text.size);
+            }
+        statemachine->change_state(State::Off);
+        return Result::transitioned;
+    }
+
+    Hooks hooks;
+    int count = 0;
+    bool isOn = false;
+    State state = State::Off;
+};
+
+} // namespace print_switch
+
+#endif // PRINT_SWITCH_HPP
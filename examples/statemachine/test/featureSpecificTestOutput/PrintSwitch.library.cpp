@@ -0,0 +1,58 @@
+#include "PrintSwitch.hpp"
+
+namespace print_switch {
+
+namespace {
+
+constexpr std::string_view state_names[state_count] = {
+    "Off",
+    "On"
+};
+
+constexpr std::string_view event_names[event_count] = {
+    "toggle"
+};
+
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 1;
+constexpr std::int32_t event_displacements[event_slot_count] = { -1 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "toggle" };
+constexpr Event event_slot_values[event_slot_count] = { Event::toggle };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+} // namespace
+
+std::string_view state_name(State state) {
+    return state_names[static_cast<std::size_t>(state)];
+}
+
+std::string_view event_name(Event event) {
+    return event_names[static_cast<std::size_t>(event)];
+}
+
+std::optional<Event> find_event(std::string_view name) {
+    const int slot = find_event_slot(name);
+    if (slot < 0) {
+        return std::nullopt;
+    }
+    return event_slot_values[slot];
+}
+
+} // namespace print_switch
@@ -0,0 +1,364 @@
+#ifndef PRINT_SWITCH_HPP
+#define PRINT_SWITCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+#if __has_include(<span>)
+#include <span>
+#endif
+
+#include "statemachine_queue.hpp"
+
+namespace print_switch {
+
+enum class State : std::uint8_t {
+    Off,
+    On
+};
+
+enum class Event : std::uint8_t {
+    toggle
+};
+
+constexpr std::size_t state_count = 2;
+constexpr std::size_t event_count = 1;
+
+enum class Result : std::uint8_t {
+    transitioned, // the machine is in the target state of the transition
+    rejected,     // the guard of the transition did not hold
+    impossible,   // the current state has no transition for the event
+    queued,       // another transition is in flight; the event is dispatched after it
+    dropped       // another transition is in flight and the event queue is full
+};
+
+// Outcome of Machine::dispatch_batch.
+struct BatchResult {
+    std::size_t processed;   // events taken from the batch
+    std::size_t rejected_at; // index of the first rejected, impossible or dropped event, or processed if there was none
+    Result rejection;        // the result of that event, else Result::transitioned
+};
+
+std::string_view state_name(State state);
+std::string_view event_name(Event event);
+
+// Looks up an event by its name in the model.
+std::optional<Event> find_event(std::string_view name);
+
+// Default Commands policy: every command of the model is a no-op. A host policy derives
+// from it and hides the commands it implements; the others still compile to nothing.
+struct NoCommands {
+};
+
+namespace detail {
+
+// Stack buffer a print action is formatted into, sized by the generator for its longest output.
+// Output beyond the capacity is cut off rather than written past the buffer.
+template <std::size_t Capacity>
+struct text {
+    char data[Capacity];
+    std::size_t size = 0;
+
+    void put(char c) {
+        if (size < Capacity) {
+            data[size++] = c;
+        }
+    }
+
+    void append(const char *literal) {
+        while (*literal != '\0') {
+            put(*literal++);
+        }
+    }
+
+    void append(long long value) {
+        char digits[20];
+        std::size_t count = 0;
+        unsigned long long magnitude = value < 0 ? 0ull - static_cast<unsigned long long>(value) : static_cast<unsigned long long>(value);
+        do {
+            digits[count++] = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude != 0);
+        if (value < 0) {
+            put('-');
+        }
+        while (count > 0) {
+            put(digits[--count]);
+        }
+    }
+};
+
+} // namespace detail
+
+// Command actions call the members of Commands directly, so they inline into dispatch.
+template <typename Commands = NoCommands>
+class Machine {
+public:
+    Commands commands;
+    // Hooks are optional; an unset hook costs a single branch. They are plain function
+    // pointers, so calling them never allocates, and hook_context is passed to them unchanged.
+    void *hook_context = nullptr;
+    void (*on_transition)(void *context, State from, State to) = nullptr;
+    // The text is formatted into a stack buffer and only valid during the call.
+    void (*on_print)(void *context, std::string_view text) = nullptr;
+    // Events dispatched while a transition is in flight, such as those a hook or command
+    // dispatches, are queued, and dispatch returns Result::queued. Their own result is passed
+    // to on_queued_result once they are dispatched.
+    void (*on_queued_result)(void *context, Event event, Result result) = nullptr;
+
+    Machine() = default;
+
+    explicit Machine(Commands commands) : commands(std::move(commands)) {}
+
+    Result dispatch(Event event) {
+        if (dispatching) {
+            return pending.push(event) ? Result::queued : Result::dropped;
+        }
+        dispatching = true;
+        const Result result = take_transition(event);
+        dispatching = false;
+        dispatch_pending();
+        return result;
+    }
+
+    // Same as calling dispatch for every event, but the state and the attributes stay in locals
+    // between the hooks and commands; before each of them they are stored back, and after it
+    // reloaded, so host code sees and changes the machine as it would during dispatch.
+    BatchResult dispatch_batch(const Event *events, std::size_t size) {
+        if (dispatching) {
+            BatchResult queued{size, size, Result::transitioned};
+            for (std::size_t i = 0; i < size; ++i) {
+                if (!pending.push(events[i]) && queued.rejection == Result::transitioned) {
+                    queued.rejected_at = i;
+                    queued.rejection = Result::dropped;
+                }
+            }
+            return queued;
+        }
+        dispatching = true;
+        [[maybe_unused]] Machine *const statemachine = this;
+        State current = state;
+        int local_count = count;
+        bool local_isOn = isOn;
+        BatchResult result{size, size, Result::transitioned};
+        for (std::size_t i = 0; i < size; ++i) {
+            Result outcome = Result::impossible;
+            switch (current) {
+            case State::Off:
+                switch (events[i]) {
+                case Event::toggle:
+                    local_isOn = true;
+                    local_count = (local_count + 1);
+                    state = current;
+                    count = local_count;
+                    isOn = local_isOn;
+                    if (statemachine->on_print) {
+                        detail::text<38> text;
+                        text.append("Switched on ");
+                        text.append(static_cast<long long>(local_count));
+                        text.append(" times");
+                        statemachine->on_print(statemachine->hook_context, std::string_view(text.data, text.size));
+                    }
+                    local_count = count;
+                    local_isOn = isOn;
+                    if (on_transition) {
+                        state = State::On;
+                        count = local_count;
+                        isOn = local_isOn;
+                        on_transition(hook_context, current, State::On);
+                        local_count = count;
+                        local_isOn = isOn;
+                    }
+                    current = State::On;
+                    outcome = Result::transitioned;
+                    break;
+                default:
+                    break;
+                }
+                break;
+            case State::On:
+                switch (events[i]) {
+                case Event::toggle:
+                    local_isOn = false;
+                    state = current;
+                    count = local_count;
+                    isOn = local_isOn;
+                    if (statemachine->on_print) {
+                        detail::text<33> text;
+                        text.append("Light is on: ");
+                        text.append(static_cast<long long>(local_isOn));
+                        statemachine->on_print(statemachine->hook_context, std::string_view(text.data, text.size));
+                    }
+                    local_count = count;
+                    local_isOn = isOn;
+                    state = current;
+                    count = local_count;
+                    isOn = local_isOn;
+                    if (statemachine->on_print) {
+                        detail::text<38> text;
+                        text.append("Switched on ");
+                        text.append(static_cast<long long>(local_count));
+                        text.append(" times");
+                        statemachine->on_print(statemachine->hook_context, std::string_view(text.data, text.size));
+                    }
+                    local_count = count;
+                    local_isOn = isOn;
+                    if (on_transition) {
+                        state = State::Off;
+                        count = local_count;
+                        isOn = local_isOn;
+                        on_transition(hook_context, current, State::Off);
+                        local_count = count;
+                        local_isOn = isOn;
+                    }
+                    current = State::Off;
+                    outcome = Result::transitioned;
+                    break;
+                default:
+                    break;
+                }
+                break;
+            }
+            if ((outcome == Result::rejected || outcome == Result::impossible) && result.rejection == Result::transitioned) {
+                result.rejected_at = i;
+                result.rejection = outcome;
+            }
+            // Events the hooks and commands dispatched follow the one that raised them, as with dispatch
+            if (!pending.empty()) {
+                state = current;
+                count = local_count;
+                isOn = local_isOn;
+                dispatching = false;
+                dispatch_pending();
+                dispatching = true;
+                current = state;
+                local_count = count;
+                local_isOn = isOn;
+            }
+        }
+        state = current;
+        count = local_count;
+        isOn = local_isOn;
+        dispatching = false;
+        return result;
+    }
+    #ifdef __cpp_lib_span
+
+    BatchResult dispatch_batch(std::span<const Event> events) {
+        return dispatch_batch(events.data(), events.size());
+    }
+    #endif
+
+    State current_state() const {
+        return state;
+    }
+    
+    int get_count() const {
+        return count;
+    }
+
+    void set_count(int value) {
+        count = value;
+    }
+
+    bool get_isOn() const {
+        return isOn;
+    }
+
+    void set_isOn(bool value) {
+        isOn = value;
+    }
+
+private:
+    void change_state(State target) {
+        const State from = state;
+        state = target;
+        if (on_transition) {
+            on_transition(hook_context, from, target);
+        }
+    }
+
+    Result take_transition(Event event) {
+        switch (state) {
+        case State::Off:
+            switch (event) {
+            case Event::toggle:
+                return Off_toggle(this);
+            default:
+                break;
+            }
+            break;
+        case State::On:
+            switch (event) {
+            case Event::toggle:
+                return On_toggle(this);
+            default:
+                break;
+            }
+            break;
+        }
+        return Result::impossible;
+    }
+
+    // Dispatches the queued events in arrival order.
+    void dispatch_pending() {
+        while (!pending.empty()) {
+            const Event event = pending.pop();
+            dispatching = true;
+            const Result result = take_transition(event);
+            dispatching = false;
+            if (on_queued_result) {
+                on_queued_result(hook_context, event, result);
+            }
+        }
+    }
+
+    // Off
+    
+    static Result Off_toggle([[maybe_unused]] Machine *statemachine) {
+            statemachine->isOn = true;
+            statemachine->count = (statemachine->count + 1);
+            if (statemachine->on_print) {
+                detail::text<38> text;
+                text.append("Switched on ");
+                text.append(static_cast<long long>(statemachine->count));
+                text.append(" times");
+                statemachine->on_print(statemachine->hook_context, std::string_view(text.data, text.size));
+            }
+        statemachine->change_state(State::On);
+        return Result::transitioned;
+    }
+
+    // On
+    
+    static Result On_toggle([[maybe_unused]] Machine *statemachine) {
+            statemachine->isOn = false;
+            if (statemachine->on_print) {
+                detail::text<33> text;
+                text.append("Light is on: ");
+                text.append(static_cast<long long>(statemachine->isOn));
+                statemachine->on_print(statemachine->hook_context, std::string_view(text.data, text.size));
+            }
+            if (statemachine->on_print) {
+                detail::text<38> text;
+                text.append("Switched on ");
+                text.append(static_cast<long long>(statemachine->count));
+                text.append(" times");
+                statemachine->on_print(statemachine->hook_context, std::string_view(text.data, text.size));
+            }
+        statemachine->change_state(State::Off);
+        return Result::transitioned;
+    }
+
+    State state = State::Off;
+    bool dispatching = false;
+    int count = 0;
+    bool isOn = false;
+    statemachine_queue::event_queue<Event, 64, statemachine_queue::queue_overflow::reject> pending;
+};
+
+} // namespace print_switch
+
+#endif // PRINT_SWITCH_HPP
@@ -0,0 +1,64 @@
+#include "PrintSwitch.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+
+constexpr std::uint64_t event_stream_fingerprint = 0x464de2e9329a7112ull;
+
+static print_switch::Machine<> machine;
+
+static void report([[maybe_unused]] print_switch::Result result) {
+    if (result == print_switch::Result::rejected) {
+        SM_TRACE("Transition not allowed.");
+    } else if (result == print_switch::Result::impossible) {
+        SM_TRACE("Impossible event for the current state.");
+    }
+}
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    machine.on_transition = [](void *, [[maybe_unused]] print_switch::State from, [[maybe_unused]] print_switch::State to) {
+        SM_TRACE_TRANSITION(print_switch::state_name(from) << " ===> " << print_switch::state_name(to));
+    };
+    machine.on_print = [](void *, std::string_view text) {
+        std::cout << text << '\n';
+    };
+    SM_TRACE_TRANSITION("[" << print_switch::state_name(machine.current_state()) << "]");
+
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, print_switch::event_count, [](std::size_t id, std::uint64_t) {
+            report(machine.dispatch(static_cast<print_switch::Event>(id)));
+        });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [](std::string_view input) {
+            const std::optional<print_switch::Event> event = print_switch::find_event(input);
+            if (!event) {
+                SM_TRACE("There is no event <" << input << "> in the PrintSwitch statemachine.");
+                return;
+            }
+            report(machine.dispatch(*event));
+        });
+    }
+    return status;
+}
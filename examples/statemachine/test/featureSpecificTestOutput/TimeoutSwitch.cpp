@@ -1,114 +1,295 @@
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
-#include <map>
 #include <string>
+#include <string_view>
 #include <chrono>
 #include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <queue>
+#ifdef STATEMACHINE_POSIX_IO
+#include <poll.h>
+#endif
+#include "statemachine_queue.hpp"
 class TimeoutSwitch;
 
-class State {
-protected:
-    TimeoutSwitch *statemachine;
+namespace statemachine_timer {
+
+using clock = std::chrono::steady_clock;
 
+// Event loop for transitions suspended in setTimeout. Timers are kept in a min-heap
+// and resumed in deadline order (ties in the order they were started).
+class scheduler {
 public:
-    virtual ~State() {}
+    static scheduler &instance() {
+        static scheduler shared;
+        return shared;
+    }
+
+    void schedule(clock::time_point deadline, std::coroutine_handle<> handle) {
+        timers.push(timer{deadline, next_sequence++, handle});
+    }
+
+    // Resumes every timer that is due and returns whether any are left.
+    bool run_due() {
+        while (!timers.empty() && timers.top().deadline <= clock::now()) {
+            const std::coroutine_handle<> handle = timers.top().handle;
+            timers.pop();
+            handle.resume();
+        }
+        return !timers.empty();
+    }
+
+#ifdef STATEMACHINE_POSIX_IO
+    // Returns once the input on fd is readable, running due timers while waiting.
+    void run_until_readable(int fd) {
+        for (;;) {
+            const bool pending = run_due();
+            std::cout.flush();
+            if (!pending) {
+                return;
+            }
+            const auto delay = std::chrono::ceil<std::chrono::milliseconds>(timers.top().deadline - clock::now());
+            pollfd input{fd, POLLIN, 0};
+            if (poll(&input, 1, static_cast<int>(std::max<std::chrono::milliseconds::rep>(delay.count(), 0))) != 0) {
+                return;
+            }
+        }
+    }
+#endif
+
+    // Sleeps until every pending timer has fired.
+    void run_until_idle() {
+        while (run_due()) {
+            std::cout.flush();
+            std::this_thread::sleep_until(timers.top().deadline);
+        }
+    }
+
+private:
+    struct timer {
+        clock::time_point deadline;
+        std::uint64_t sequence;
+        std::coroutine_handle<> handle;
+
+        bool operator>(const timer &other) const {
+            return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+        }
+    };
+
+    std::priority_queue<timer, std::vector<timer>, std::greater<timer>> timers;
+    std::uint64_t next_sequence = 0;
+};
+
+// Awaitable of setTimeout: suspends the transition and resumes it from the scheduler.
+struct sleep_for {
+    std::chrono::milliseconds duration;
+
+    bool await_ready() const noexcept {
+        return duration.count() <= 0;
+    }
 
-    void set_context(TimeoutSwitch *statemachine) {
-        this->statemachine = statemachine;
+    void await_suspend(std::coroutine_handle<> handle) const {
+        scheduler::instance().schedule(clock::now() + duration, handle);
     }
 
-    virtual std::string get_name() {
+    void await_resume() const noexcept {}
+};
+
+// Fire-and-forget coroutine of a transition body; it starts eagerly and its frame
+// is freed when the body returns.
+struct task {
+    struct promise_type {
+        task get_return_object() noexcept {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept {
+            std::terminate();
+        }
+    };
+};
+
+// Installed as before_stdin_read, so suspended transitions keep completing while the
+// program waits for input.
+inline void run_timers_until_input() {
+#ifdef STATEMACHINE_POSIX_IO
+    scheduler::instance().run_until_readable(STDIN_FILENO);
+#else
+    scheduler::instance().run_due();
+#endif
+}
+
+} // namespace statemachine_timer
+
+class State {
+public:
+    virtual ~State() {}
+
+    virtual std::string_view get_name() const {
         return "Unknown";
     }
 
-    virtual void toggle() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void toggle(TimeoutSwitch *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 };
 
 class TimeoutSwitch {
 private:
-    State* state = nullptr;
+    const State* state = nullptr;
 public:
     bool isOn = false;
-    TimeoutSwitch(State* initial_state) {
-        initial_state->set_context(this);
+    TimeoutSwitch(const State* initial_state) {
         state = initial_state;
-        std::cout << "[" << state->get_name() <<  "]" << std::endl;
+        SM_TRACE_TRANSITION("[" << state->get_name() << "]");
     }
 
-    ~TimeoutSwitch() {
-        if (state != nullptr) {
-            delete state;
-        }
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());
+        state = new_state;
+    }
+    void toggle() {
+        state->toggle(this);
     }
+    
+    using event_handle = void (TimeoutSwitch::*)();
+    bool suspended = false;
+    statemachine_queue::event_queue<event_handle, 64, statemachine_queue::queue_overflow::reject> pending;
 
-    void transition_to(State *new_state) {
-        std::cout << state->get_name() << " ===> " << new_state->get_name() << std::endl;
-        if (state != nullptr) {
-            delete state;
+    void post(event_handle event) {
+        if (suspended) {
+            if (!pending.push(event)) {
+                SM_TRACE("The event queue is full; the event is rejected.");
+            }
+            return;
         }
-        new_state->set_context(this);
-        state = new_state;
+        (this->*event)();
     }
-    void toggle() {
-        state->toggle();
+
+    void resume_pending() {
+        suspended = false;
+        while (!suspended && !pending.empty()) {
+            (this->*pending.pop())();
+        }
     }
 };
 
 class Off : public State {
 public:
-    std::string get_name() override { return "Off"; }
-    void toggle() override;
+    static const Off instance;
+    std::string_view get_name() const override { return "Off"; }
+    void toggle(TimeoutSwitch *statemachine) const override;
 };
 class On : public State {
 public:
-    std::string get_name() override { return "On"; }
-    void toggle() override;
+    static const On instance;
+    std::string_view get_name() const override { return "On"; }
+    void toggle(TimeoutSwitch *statemachine) const override;
 };
     // Off
+    const Off Off::instance;
 
-    void Off::toggle() {
-        if (true) {
-            statemachine->isOn = true;
-            statemachine->transition_to(new On);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Off::toggle(TimeoutSwitch *statemachine) const {
+        statemachine->isOn = true;
+        statemachine->transition_to(&On::instance);
     }
     
     // On
+    const On On::instance;
 
-    void On::toggle() {
-        if (true) {
+    static statemachine_timer::task On_toggle_run(TimeoutSwitch *statemachine) {
             statemachine->isOn = false;
+            SM_TRACE("Delaying transition for 1000 milliseconds...");
+            co_await statemachine_timer::sleep_for{std::chrono::milliseconds(1000)};
+        statemachine->transition_to(&Off::instance);
+        statemachine->resume_pending();
+    }
 
-            std::cout << "Delaying transition for 1000 milliseconds..." << std::endl;
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        
-            statemachine->transition_to(new Off);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void On::toggle(TimeoutSwitch *statemachine) const {
+        statemachine->suspended = true;
+        On_toggle_run(statemachine);
     }
     
 
 typedef void (TimeoutSwitch::*Event)();
 
-int main() {
-    TimeoutSwitch *statemachine = new TimeoutSwitch(new Off);
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
 
-    static std::map<std::string, Event> event_by_name;
-    event_by_name["toggle"] = &TimeoutSwitch::toggle;
-    for (std::string input; std::getline(std::cin, input);) {
-        std::map<std::string, Event>::const_iterator event_by_name_it = event_by_name.find(input);
-        if (event_by_name_it == event_by_name.end()) {
-            std::cout << "There is no event <" << input << "> in the TimeoutSwitch statemachine." << std::endl;
-            continue;
-        }
-        Event event_invoker = event_by_name_it->second;
-        (statemachine->*event_invoker)();
+constexpr std::size_t event_slot_count = 1;
+constexpr std::int32_t event_displacements[event_slot_count] = { -1 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "toggle" };
+constexpr Event event_slot_values[event_slot_count] = { &TimeoutSwitch::toggle };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0x41eeaf964435c1b2ull;
+constexpr Event event_ids[1] = { &TimeoutSwitch::toggle };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    TimeoutSwitch *statemachine = new TimeoutSwitch(&Off::instance);
+
+    statemachine_input::before_stdin_read = statemachine_timer::run_timers_until_input;
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 1, [statemachine](std::size_t id, std::uint64_t) { statemachine->post(event_ids[id]); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the TimeoutSwitch statemachine.");
+                return;
+            }
+            statemachine->post(event_slot_values[slot]);
+        });
     }
+    statemachine_timer::scheduler::instance().run_until_idle();
 
     delete statemachine;
-    return 0;
+    return status;
 }
@@ -0,0 +1,117 @@
+#ifndef TIMEOUT_SWITCH_HPP
+#define TIMEOUT_SWITCH_HPP
+
+// Freestanding build of the TimeoutSwitch statemachine: no iostream, exceptions, RTTI
+// or heap. A Machine lives in static storage and only talks to the firmware through Hooks.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace timeout_switch {
+
+enum class State : std::uint8_t {
+    Off,
+    On
+};
+
+enum class Event : std::uint8_t {
+    toggle
+};
+
+constexpr std::size_t state_count = 2;
+constexpr std::size_t event_count = 1;
+
+enum class Result : std::uint8_t {
+    transitioned, // the machine is in the target state of the transition
+    rejected,     // the guard of the transition did not hold
+    impossible    // the current state has no transition for the event
+};
+
+// Model names of states and events, as NUL-terminated strings in ROM.
+const char *state_name(State state);
+const char *event_name(Event event);
+
+// Looks up an event by the length characters at name; returns false if the model has no such event.
+bool find_event(const char *name, std::size_t length, Event &event);
+
+// Provided by the firmware; a null hook skips its output.
+struct Hooks {
+    void (*transition)(State from, State to);
+    void (*delay_ms)(std::uint32_t milliseconds);
+};
+
+class Machine {
+public:
+    // constexpr, so a Machine in static storage is initialized without startup code.
+    constexpr explicit Machine(Hooks hooks) : hooks(hooks) {}
+
+    Result dispatch(Event event) {
+        switch (state) {
+        case State::Off:
+            switch (event) {
+            case Event::toggle:
+                return Off_toggle(this);
+            default:
+                break;
+            }
+            break;
+        case State::On:
+            switch (event) {
+            case Event::toggle:
+                return On_toggle(this);
+            default:
+                break;
+            }
+            break;
+        }
+        return Result::impossible;
+    }
+
+    State current_state() const {
+        return state;
+    }
+    
+    bool get_isOn() const {
+        return isOn;
+    }
+
+    void set_isOn(bool value) {
+        isOn = value;
+    }
+
+private:
+    void change_state(State target) {
+        const State from = state;
+        state = target;
+        if (hooks.transition) {
+            hooks.transition(from, target);
+        }
+    }
+
+    // Off
+    
+    static Result Off_toggle([[maybe_unused]] Machine *statemachine) {
+            statemachine->isOn = true;
+        statemachine->change_state(State::On);
+        return Result::transitioned;
+    }
+
+    // On
+    
+    static Result On_toggle([[maybe_unused]] Machine *statemachine) {
+            statemachine->isOn = false;
+            if (statemachine->hooks.delay_ms) {
+                statemachine->hooks.delay_ms(1000);
+            }
+        statemachine->change_state(State::Off);
+        return Result::transitioned;
+    }
+
+    Hooks hooks;
+    bool isOn = false;
+    State state = State::Off;
+};
+
+} // namespace timeout_switch
+
+#endif // TIMEOUT_SWITCH_HPP
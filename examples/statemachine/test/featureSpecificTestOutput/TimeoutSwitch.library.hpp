@@ -0,0 +1,341 @@
+#ifndef TIMEOUT_SWITCH_HPP
+#define TIMEOUT_SWITCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+#if __has_include(<span>)
+#include <span>
+#endif
+#include <chrono>
+#include <coroutine>
+#include <exception>
+
+#include "statemachine_queue.hpp"
+
+namespace timeout_switch {
+
+enum class State : std::uint8_t {
+    Off,
+    On
+};
+
+enum class Event : std::uint8_t {
+    toggle
+};
+
+constexpr std::size_t state_count = 2;
+constexpr std::size_t event_count = 1;
+
+enum class Result : std::uint8_t {
+    transitioned, // the machine is in the target state of the transition
+    rejected,     // the guard of the transition did not hold
+    impossible,   // the current state has no transition for the event
+    suspended,    // the transition waits in setTimeout until run_timers completes it
+    queued,       // another transition is in flight; the event is dispatched after it
+    dropped       // another transition is in flight and the event queue is full
+};
+
+// Outcome of Machine::dispatch_batch.
+struct BatchResult {
+    std::size_t processed;   // events taken from the batch; fewer only if a transition suspended
+    std::size_t rejected_at; // index of the first rejected, impossible or dropped event, or processed if there was none
+    Result rejection;        // the result of that event, else Result::transitioned
+};
+
+std::string_view state_name(State state);
+std::string_view event_name(Event event);
+
+// Looks up an event by its name in the model.
+std::optional<Event> find_event(std::string_view name);
+
+// Default Commands policy: every command of the model is a no-op. A host policy derives
+// from it and hides the commands it implements; the others still compile to nothing.
+struct NoCommands {
+};
+
+namespace detail {
+
+// Fire-and-forget coroutine of a transition body; it starts eagerly and its frame
+// is freed when the body returns.
+struct task {
+    struct promise_type {
+        task get_return_object() noexcept {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept {
+            std::terminate();
+        }
+    };
+};
+
+} // namespace detail
+
+// Command actions call the members of Commands directly, so they inline into dispatch.
+template <typename Commands = NoCommands>
+class Machine {
+public:
+    Commands commands;
+    // Hooks are optional; an unset hook costs a single branch. They are plain function
+    // pointers, so calling them never allocates, and hook_context is passed to them unchanged.
+    void *hook_context = nullptr;
+    void (*on_transition)(void *context, State from, State to) = nullptr;
+    // The text is formatted into a stack buffer and only valid during the call.
+    void (*on_print)(void *context, std::string_view text) = nullptr;
+    // Events dispatched while a transition is in flight, such as those a hook or command
+    // dispatches, are queued, and dispatch returns Result::queued. Their own result is passed
+    // to on_queued_result once they are dispatched.
+    void (*on_queued_result)(void *context, Event event, Result result) = nullptr;
+
+    Machine() = default;
+
+    explicit Machine(Commands commands) : commands(std::move(commands)) {}
+    
+    Machine(const Machine &) = delete;
+    Machine &operator=(const Machine &) = delete;
+
+    ~Machine() {
+        if (waiting) {
+            waiting.destroy();
+        }
+    }
+
+    Result dispatch(Event event) {
+        if (dispatching || waiting) {
+            return pending.push(event) ? Result::queued : Result::dropped;
+        }
+        dispatching = true;
+        const Result result = take_transition(event);
+        dispatching = false;
+        dispatch_pending();
+        return result;
+    }
+
+    // Same as calling dispatch for every event, but the state and the attributes stay in locals
+    // between the hooks and commands; before each of them they are stored back, and after it
+    // reloaded, so host code sees and changes the machine as it would during dispatch.
+    BatchResult dispatch_batch(const Event *events, std::size_t size) {
+        if (dispatching || waiting) {
+            BatchResult queued{size, size, Result::transitioned};
+            for (std::size_t i = 0; i < size; ++i) {
+                if (!pending.push(events[i]) && queued.rejection == Result::transitioned) {
+                    queued.rejected_at = i;
+                    queued.rejection = Result::dropped;
+                }
+            }
+            return queued;
+        }
+        dispatching = true;
+        [[maybe_unused]] Machine *const statemachine = this;
+        State current = state;
+        bool local_isOn = isOn;
+        BatchResult result{size, size, Result::transitioned};
+        for (std::size_t i = 0; i < size; ++i) {
+            Result outcome = Result::impossible;
+            switch (current) {
+            case State::Off:
+                switch (events[i]) {
+                case Event::toggle:
+                    local_isOn = true;
+                    if (on_transition) {
+                        state = State::On;
+                        isOn = local_isOn;
+                        on_transition(hook_context, current, State::On);
+                        local_isOn = isOn;
+                    }
+                    current = State::On;
+                    outcome = Result::transitioned;
+                    break;
+                default:
+                    break;
+                }
+                break;
+            case State::On:
+                switch (events[i]) {
+                case Event::toggle:
+                    state = current;
+                    isOn = local_isOn;
+                    outcome = On_toggle(this);
+                    current = state;
+                    local_isOn = isOn;
+                    break;
+                default:
+                    break;
+                }
+                break;
+            }
+            if ((outcome == Result::rejected || outcome == Result::impossible) && result.rejection == Result::transitioned) {
+                result.rejected_at = i;
+                result.rejection = outcome;
+            }
+            if (outcome == Result::suspended) {
+                result.processed = i + 1;
+                break;
+            }
+            // Events the hooks and commands dispatched follow the one that raised them, as with dispatch
+            if (!pending.empty()) {
+                state = current;
+                isOn = local_isOn;
+                dispatching = false;
+                dispatch_pending();
+                dispatching = true;
+                current = state;
+                local_isOn = isOn;
+                if (waiting) {
+                    result.processed = i + 1;
+                    break;
+                }
+            }
+        }
+        state = current;
+        isOn = local_isOn;
+        dispatching = false;
+        return result;
+    }
+    #ifdef __cpp_lib_span
+
+    BatchResult dispatch_batch(std::span<const Event> events) {
+        return dispatch_batch(events.data(), events.size());
+    }
+    #endif
+
+    State current_state() const {
+        return state;
+    }
+    
+    // Completes the suspended transition once its delay has elapsed and dispatches the
+    // events queued meanwhile; returns whether a transition is still suspended.
+    bool run_timers() {
+        if (waiting && std::chrono::steady_clock::now() >= deadline) {
+            const std::coroutine_handle<> handle = waiting;
+            waiting = nullptr;
+            dispatching = true;
+            handle.resume();
+            dispatching = false;
+            dispatch_pending();
+        }
+        return static_cast<bool>(waiting);
+    }
+
+    bool suspended() const {
+        return static_cast<bool>(waiting);
+    }
+
+    // When the suspended transition is due to continue.
+    std::chrono::steady_clock::time_point next_deadline() const {
+        return deadline;
+    }
+    
+    bool get_isOn() const {
+        return isOn;
+    }
+
+    void set_isOn(bool value) {
+        isOn = value;
+    }
+
+private:
+    // Awaitable of setTimeout: parks the transition on its machine until run_timers resumes it.
+    struct delay {
+        Machine *machine;
+        std::chrono::milliseconds duration;
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> handle) const {
+            machine->waiting = handle;
+            machine->deadline = std::chrono::steady_clock::now() + duration;
+        }
+
+        void await_resume() const noexcept {}
+    };
+    void change_state(State target) {
+        const State from = state;
+        state = target;
+        if (on_transition) {
+            on_transition(hook_context, from, target);
+        }
+    }
+
+    Result take_transition(Event event) {
+        switch (state) {
+        case State::Off:
+            switch (event) {
+            case Event::toggle:
+                return Off_toggle(this);
+            default:
+                break;
+            }
+            break;
+        case State::On:
+            switch (event) {
+            case Event::toggle:
+                return On_toggle(this);
+            default:
+                break;
+            }
+            break;
+        }
+        return Result::impossible;
+    }
+
+    // Dispatches the queued events in arrival order until a transition suspends.
+    void dispatch_pending() {
+        while (!waiting && !pending.empty()) {
+            const Event event = pending.pop();
+            dispatching = true;
+            const Result result = take_transition(event);
+            dispatching = false;
+            if (on_queued_result) {
+                on_queued_result(hook_context, event, result);
+            }
+        }
+    }
+
+    // Off
+    
+    static Result Off_toggle([[maybe_unused]] Machine *statemachine) {
+            statemachine->isOn = true;
+        statemachine->change_state(State::On);
+        return Result::transitioned;
+    }
+
+    // On
+    
+    static detail::task On_toggle_run(Machine *statemachine) {
+            statemachine->isOn = false;
+            co_await Machine::delay{statemachine, std::chrono::milliseconds(1000)};
+        statemachine->change_state(State::Off);
+    }
+
+    static Result On_toggle(Machine *statemachine) {
+        On_toggle_run(statemachine);
+        return statemachine->waiting ? Result::suspended : Result::transitioned;
+    }
+
+    State state = State::Off;
+    bool dispatching = false;
+    bool isOn = false;
+    std::coroutine_handle<> waiting;
+    std::chrono::steady_clock::time_point deadline;
+    statemachine_queue::event_queue<Event, 64, statemachine_queue::queue_overflow::reject> pending;
+};
+
+} // namespace timeout_switch
+
+#endif // TIMEOUT_SWITCH_HPP
@@ -0,0 +1,105 @@
+#include "TimeoutSwitch.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <queue>
+#ifdef STATEMACHINE_POSIX_IO
+#include <poll.h>
+#endif
+#include "statemachine_queue.hpp"
+
+constexpr std::uint64_t event_stream_fingerprint = 0x41eeaf964435c1b2ull;
+
+static timeout_switch::Machine<> machine;
+
+// Installed as before_stdin_read, so suspended transitions keep completing while the
+// program waits for input.
+static void run_timers_until_input() {
+    for (;;) {
+        const bool waiting = machine.run_timers();
+        std::cout.flush();
+        if (!waiting) {
+            return;
+        }
+#ifdef STATEMACHINE_POSIX_IO
+        const auto delay = std::chrono::ceil<std::chrono::milliseconds>(machine.next_deadline() - std::chrono::steady_clock::now());
+        pollfd input{STDIN_FILENO, POLLIN, 0};
+        if (poll(&input, 1, static_cast<int>(std::max<std::chrono::milliseconds::rep>(delay.count(), 0))) != 0) {
+            return;
+        }
+#else
+        return;
+#endif
+    }
+}
+
+static void report([[maybe_unused]] timeout_switch::Result result) {
+    if (result == timeout_switch::Result::rejected) {
+        SM_TRACE("Transition not allowed.");
+    } else if (result == timeout_switch::Result::impossible) {
+        SM_TRACE("Impossible event for the current state.");
+    } else if (result == timeout_switch::Result::dropped) {
+                    SM_TRACE("The event queue is full; the event is rejected.");
+                }
+}
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    machine.on_transition = [](void *, [[maybe_unused]] timeout_switch::State from, [[maybe_unused]] timeout_switch::State to) {
+        SM_TRACE_TRANSITION(timeout_switch::state_name(from) << " ===> " << timeout_switch::state_name(to));
+    };
+    machine.on_print = [](void *, std::string_view text) {
+        std::cout << text << '\n';
+    };
+    // Events typed while a transition was suspended are reported once they are dispatched
+    machine.on_queued_result = [](void *, timeout_switch::Event, timeout_switch::Result result) {
+        report(result);
+    };
+    SM_TRACE_TRANSITION("[" << timeout_switch::state_name(machine.current_state()) << "]");
+
+    statemachine_input::before_stdin_read = run_timers_until_input;
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, timeout_switch::event_count, [](std::size_t id, std::uint64_t) {
+            report(machine.dispatch(static_cast<timeout_switch::Event>(id)));
+        });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [](std::string_view input) {
+            const std::optional<timeout_switch::Event> event = timeout_switch::find_event(input);
+            if (!event) {
+                SM_TRACE("There is no event <" << input << "> in the TimeoutSwitch statemachine.");
+                return;
+            }
+            report(machine.dispatch(*event));
+        });
+    }
+    while (machine.run_timers()) {
+        std::cout.flush();
+        std::this_thread::sleep_until(machine.next_deadline());
+    }
+    return status;
+}
@@ -4,11 +4,23 @@
 //  * terms of the MIT License, which is available in the project root.s
 //  ******************************************************************************/
 import { EmptyFileSystem } from 'langium';
-import { toString, type Generated } from 'langium/generate';
+import { toString } from 'langium/generate';
 import { parseHelper } from 'langium/test';
 import { describe, expect, test } from 'vitest';
-import { generateCppContent } from '../src/cli/generator.js';
-import type { Statemachine } from '../src/language-server/generated/ast.js';
+import { describeMinimization, describePruning, generateCppContent, generateShardedContent, shardStates, type GeneratorOptions } from '../src/cli/generator.js';
+import { generateLibraryContent } from '../src/cli/generator-library.js';
+import { estimateFootprint, generateFreestandingContent } from '../src/cli/generator-freestanding.js';
+import { env } from '../src/cli/interpreter.js';
+import { buildEventPerfectHash, eventHash, type GeneratorContext } from '../src/cli/generator-util.js';
+import { inferAttributeRanges, planAttributeLayout } from '../src/cli/attribute-layout.js';
+import { encodeEventStream, eventStreamFingerprint } from '../src/cli/event-stream.js';
+import { evalExpression, wrapToType } from '../src/cli/interpret-util.js';
+import { decodeBinaryLog } from '../src/cli/binary-log.js';
+import { emitExpression, guardOutcome, lowerExpression, optimizeExpression } from '../src/cli/expression-ir.js';
+import { analyzeReachability } from '../src/cli/reachability.js';
+import { equivalentStates, minimizeStatemachine, stateDisplayName } from '../src/cli/state-minimization.js';
+import { toStringWithLineDirectives } from '../src/cli/line-directives.js';
+import type { Statemachine, Transition } from '../src/language-server/generated/ast.js';
 import { createStatemachineServices } from '../src/language-server/statemachine-module.js';
 import { normalizeCode } from './util.js';
 import * as fs from 'fs';
@@ -22,34 +34,54 @@ function readExampleFile(fileName: string, dir: string): string {
     return fs.readFileSync(path.join(dir, fileName), 'utf-8');
 }
 
-const testCases = [
+const services = createStatemachineServices(EmptyFileSystem).statemachine;
+const parse = parseHelper<Statemachine>(services);
+
+/* Parses a file of featureSpecificTestInput, or the model text itself */
+async function parseModel(model: string, documentUri?: string): Promise<Statemachine> {
+    const text = model.endsWith('.statemachine') ? readExampleFile(model, examplesDir) : model;
+    return (await parse(text, documentUri ? { documentUri } : undefined)).parseResult.value;
+}
+
+function context(statemachine: Statemachine, options?: GeneratorOptions & { fileName?: string }): GeneratorContext {
+    return { destination: undefined!, fileName: undefined!, ...options, statemachine };
+}
+
+async function generate(model: string | Statemachine, options?: GeneratorOptions & { fileName?: string }): Promise<string> {
+    const statemachine = typeof model === 'string' ? await parseModel(model) : model;
+    return toString(generateCppContent(context(statemachine, options)));
+}
+
+const testCases: Array<{ inputFile: string, expectedOutputFile: string, options?: GeneratorOptions }> = [
     { inputFile: 'BooleanSwitch.statemachine', expectedOutputFile: 'BooleanSwitch.cpp' },
     { inputFile: 'ComplexLogicSwitch.statemachine', expectedOutputFile: 'ComplexLogicSwitch.cpp' },
     { inputFile: 'GuardedSwitch.statemachine', expectedOutputFile: 'GuardedSwitch.cpp' },
+    { inputFile: 'GuardedBands.statemachine', expectedOutputFile: 'GuardedBands.cpp' },
     { inputFile: 'LightSwitch.statemachine', expectedOutputFile: 'LightSwitch.cpp' },
     { inputFile: 'TimeoutSwitch.statemachine', expectedOutputFile: 'TimeoutSwitch.cpp' },
+    { inputFile: 'GuardedSwitch.statemachine', expectedOutputFile: 'GuardedSwitch.table.cpp', options: { backend: 'table' } },
+    { inputFile: 'GuardedSwitch.statemachine', expectedOutputFile: 'GuardedSwitch.crtp.cpp', options: { backend: 'crtp' } },
+    { inputFile: 'PrintSwitch.statemachine', expectedOutputFile: 'PrintSwitch.cpp' },
+    { inputFile: 'PrintSwitch.statemachine', expectedOutputFile: 'PrintSwitch.binarylog.cpp', options: { log: 'binary' } },
+    { inputFile: 'TimeoutSwitch.statemachine', expectedOutputFile: 'TimeoutSwitch.blocking.cpp', options: { timeouts: 'blocking' } },
+    { inputFile: 'TimeoutSwitch.statemachine', expectedOutputFile: 'TimeoutSwitch.dropoldest.cpp', options: { queueCapacity: 8, queueOverflow: 'drop-oldest' } },
+    { inputFile: 'PackedCounters.statemachine', expectedOutputFile: 'PackedCounters.packed.cpp', options: { layout: 'packed' } },
+    { inputFile: 'FixedWidthCounters.statemachine', expectedOutputFile: 'FixedWidthCounters.cpp' },
+    { inputFile: 'DeadStates.statemachine', expectedOutputFile: 'DeadStates.pruned.cpp', options: { prune: true } },
+    { inputFile: 'EquivalentStates.statemachine', expectedOutputFile: 'EquivalentStates.minimized.cpp', options: { minimize: true } },
+    { inputFile: 'NoEvents.statemachine', expectedOutputFile: 'NoEvents.table.cpp', options: { backend: 'table' } },
+    { inputFile: 'Door.statemachine', expectedOutputFile: 'Door.probes.cpp', options: { probes: true } },
+    { inputFile: 'GuardedSwitch.statemachine', expectedOutputFile: 'GuardedSwitch.stats.cpp', options: { stats: true } },
+    { inputFile: 'TimeoutSwitch.statemachine', expectedOutputFile: 'TimeoutSwitch.timeline.cpp', options: { timeline: true } },
 ];
 
 /********************************************/
 describe('Tests the code generator', () => {
     /* Old Code by @Eclipse-Langium Team ***********************/
-    const services = createStatemachineServices(EmptyFileSystem).statemachine;
-    const parse = parseHelper<Statemachine>(services);
-
-    testCases.forEach(({ inputFile, expectedOutputFile }) => {
-        test(`Generation test for ${inputFile}`, async () => {
-            const input = readExampleFile(inputFile, examplesDir);
+    testCases.forEach(({ inputFile, expectedOutputFile, options }) => {
+        test(`Generation test for ${inputFile} (${expectedOutputFile})`, async () => {
             const expectedOutput = readExampleFile(expectedOutputFile, expectedOutputDir);
-
-            const ast = await parse(input);
-
-            const generated: Generated = generateCppContent({
-                statemachine: ast.parseResult.value,
-                destination: undefined!, // not needed
-                fileName: undefined!,    // not needed
-            });
-
-            const text = toString(generated);
+            const text = await generate(inputFile, options);
             /********************************************/
 
             /* New Changes by @jaspreetq ***************************/
@@ -62,6 +94,358 @@ describe('Tests the code generator', () => {
     });
 });
 
+const libraryTestCases: Array<{ inputFile: string, expectedOutputPrefix: string, options?: GeneratorOptions }> = [
+    { inputFile: 'PrintSwitch.statemachine', expectedOutputPrefix: 'PrintSwitch.library' },
+    { inputFile: 'TimeoutSwitch.statemachine', expectedOutputPrefix: 'TimeoutSwitch.library' },
+    { inputFile: 'GuardedBands.statemachine', expectedOutputPrefix: 'GuardedBands.library' },
+];
+
+describe('Tests the library mode generator', () => {
+    libraryTestCases.forEach(({ inputFile, expectedOutputPrefix, options }) => {
+        test(`Library generation test for ${inputFile}`, async () => {
+            const files = generateLibraryContent(context(await parseModel(inputFile), { ...options, mode: 'library' }), env);
+
+            for (const [part, suffix] of [['header', '.hpp'], ['source', '.cpp'], ['driver', '_main.cpp']] as const) {
+                const expectedOutput = readExampleFile(expectedOutputPrefix + suffix, expectedOutputDir);
+                expect(normalizeCode(toString(files[part]))).toBe(normalizeCode(expectedOutput));
+            }
+        });
+    });
+
+    test('Attributes without a default value are value-initialized', async () => {
+        const statemachine = await parseModel(`
+            statemachine Unset
+            events go
+            attributes
+                count: int
+                armed: bool
+            initialState Idle
+            state Idle
+                go => Idle with{ count = count + 1 };
+            end
+        `);
+        for (const layout of ['declared', 'packed'] as const) {
+            const header = toString(generateLibraryContent(context(statemachine, { mode: 'library', layout }), env).header);
+            expect(header).toContain('int count{};');
+            expect(header).toMatch(/bool armed\{\};|armed\(false\)/);
+            expect(header).toContain('Machine()');
+        }
+    });
+});
+
+const freestandingTestCases: Array<{ inputFile: string, expectedOutputPrefix: string }> = [
+    { inputFile: 'PrintSwitch.statemachine', expectedOutputPrefix: 'PrintSwitch.freestanding' },
+    { inputFile: 'TimeoutSwitch.statemachine', expectedOutputPrefix: 'TimeoutSwitch.freestanding' },
+];
+
+describe('Tests the freestanding profile', () => {
+    freestandingTestCases.forEach(({ inputFile, expectedOutputPrefix }) => {
+        test(`Freestanding generation test for ${inputFile}`, async () => {
+            const files = generateFreestandingContent(context(await parseModel(inputFile), { profile: 'freestanding' }), env);
+
+            for (const [part, suffix] of [['header', '.hpp'], ['source', '.cpp']] as const) {
+                const expectedOutput = readExampleFile(expectedOutputPrefix + suffix, expectedOutputDir);
+                expect(normalizeCode(toString(files[part]))).toBe(normalizeCode(expectedOutput));
+            }
+        });
+    });
+
+    test('The RAM estimate is the size of the machine on a 32-bit target', async () => {
+        // print and transition hooks, int count, bool isOn and the state, padded to 4 bytes
+        const footprint = estimateFootprint(context(await parseModel('PrintSwitch.statemachine')));
+        expect(footprint.ram).toBe(16);
+        expect(footprint.stack).toBeGreaterThan(0);
+    });
+
+    test('Print buffers are sized in UTF-8 bytes', async () => {
+        const statemachine = await parseModel(`
+            statemachine Accents
+            events go
+            initialState Idle
+            state Idle
+                go => Idle with{ print("héé") };
+            end
+        `);
+        // Each é takes two bytes
+        expect(toString(generateFreestandingContent(context(statemachine, { profile: 'freestanding' }), env).header)).toContain('detail::text<5> text;');
+        expect(estimateFootprint(context(statemachine, { profile: 'freestanding' })).rom).toBe(estimateFootprint(context(await parseModel(`
+            statemachine Accents
+            events go
+            initialState Idle
+            state Idle
+                go => Idle with{ print("hello") };
+            end
+        `), { profile: 'freestanding' })).rom);
+    });
+});
+
+describe('Tests the table backend', () => {
+    test('A machine without events has no transition table', async () => {
+        // ISO C++ has no arrays of length zero
+        expect(await generate('NoEvents.statemachine', { backend: 'table' })).not.toContain('transition_table');
+    });
+});
+
+describe('Tests the packed attribute layout', () => {
+    test('Ranges cover every value the assignments can produce', async () => {
+        const statemachine = await parseModel('PackedCounters.statemachine');
+        const ranges = new Map([...inferAttributeRanges(statemachine)].map(([attribute, range]) => [attribute.name, range]));
+        expect(ranges.get('mode')).toEqual({ low: 0, high: 2 });
+        expect(ranges.get('offset')).toEqual({ low: -3, high: 3 });
+        expect(ranges.get('label')).toEqual({ low: 1000, high: 1000 });
+        // total is incremented without bound, so it keeps the whole int range
+        expect(ranges.get('total')).toEqual({ low: -(2 ** 31), high: 2 ** 31 - 1 });
+    });
+
+    test('Guarded attributes come first and bools share a bitfield', async () => {
+        const statemachine = await parseModel('PackedCounters.statemachine');
+        const layout = planAttributeLayout(statemachine).map(slot => `${slot.type} ${slot.attribute.name}`);
+        expect(layout).toEqual(['std::uint8_t mode', 'bool pressed', 'bool enabled', 'std::int8_t offset', 'int total', 'std::uint16_t label']);
+    });
+
+    test('Attributes the host can set keep int storage', async () => {
+        const statemachine = await parseModel('PackedCounters.statemachine');
+        const layout = planAttributeLayout(statemachine, { externalWrites: true }).map(slot => `${slot.type} ${slot.attribute.name}`);
+        expect(layout).toEqual(['int mode', 'bool pressed', 'bool enabled', 'int total', 'int offset', 'int label']);
+        const library = toString(generateLibraryContent(context(statemachine, { mode: 'library', layout: 'packed' }), env).header);
+        const freestanding = toString(generateFreestandingContent(context(statemachine, { profile: 'freestanding', layout: 'packed' }), env).header);
+        for (const header of [library, freestanding]) {
+            expect(header).toContain('int mode = 0;');
+            expect(header).not.toContain('std::uint8_t mode');
+        }
+    });
+});
+
+describe('Tests fixed-width attribute types', () => {
+    test('Constants wrap around into the type', () => {
+        expect(wrapToType(300, 'u8')).toBe(44);
+        expect(wrapToType(-1, 'u16')).toBe(65535);
+        expect(wrapToType(32768, 'i16')).toBe(-32768);
+        expect(wrapToType(2 ** 31, 'i32')).toBe(-(2 ** 31));
+        expect(wrapToType(2n ** 63n, 'i64')).toBe(-(2n ** 63n));
+        expect(wrapToType(300, 'int')).toBe(300);
+    });
+
+    test('Arithmetic wraps after every operation', async () => {
+        const statemachine = await parseModel('FixedWidthCounters.statemachine');
+        const counting = statemachine.states[0];
+        const assigned = (event: string, attribute: string) => counting.transitions.find(transition => transition.event.$refText === event)!
+            .actions.find(action => action.assignment?.variable.ref?.name === attribute)!.assignment!.value;
+        const values = new Map<string, number | boolean | bigint | undefined>([
+            ['ticks', 254], ['level', -32768], ['steps', 0], ['sum', 2 ** 31 - 1], ['total', 2n ** 62n], ['count', 0], ['armed', true]
+        ]);
+        expect(evalExpression(assigned('tick', 'ticks'), values)).toBe(1);
+        expect(evalExpression(assigned('back', 'level'), values)).toBe(32763);
+        expect(evalExpression(assigned('back', 'steps'), values)).toBe(65535);
+        expect(evalExpression(assigned('big', 'sum'), values)).toBe(-(2 ** 31) + 999);
+        expect(evalExpression(assigned('big', 'total'), values)).toBe(-(2n ** 62n));
+        expect(evalExpression(assigned('big', 'ticks'), values)).toBe(2);
+        // The smallest i16 divided by -1 wraps around to itself
+        expect(evalExpression(assigned('reset', 'level'), values)).toBe(-32768);
+    });
+});
+
+describe('Tests the expression IR', () => {
+    const model = `statemachine Folding
+events
+    go
+    stop
+attributes
+    level: int = 2 * 3
+    ready: bool = true
+initialState Idle
+state Idle
+    go when (ready && true) => Idle with{
+        level = level * 1 + 0
+    };
+    stop when (1 > 2 && !(level < 4)) => Idle;
+end`;
+    const optimized = (e: Parameters<typeof lowerExpression>[0]) => emitExpression(optimizeExpression(lowerExpression(e)), 'statemachine->');
+
+    test('Constants are folded and identities removed', async () => {
+        const statemachine = await parseModel(model);
+        const [go, stop] = statemachine.states[0].transitions;
+        expect(optimized(statemachine.attributes[0].defaultValue!)).toBe('6');
+        expect(optimized(go.guard!)).toBe('statemachine->ready');
+        expect(optimized(go.actions[0].assignment!.value)).toBe('statemachine->level');
+        expect(guardOutcome(stop)).toBe(false);
+    });
+
+    test('Guards that always hold emit no condition', async () => {
+        const statemachine = await parseModel(model.replace('ready && true', '1 < 2'));
+        const text = await generate(statemachine);
+        expect(guardOutcome(statemachine.states[0].transitions[0])).toBe(true);
+        expect(text).toMatch(/Idle::go\(Folding \*statemachine\) const \{\s*statemachine->level = statemachine->level;/);
+        // A guard that never holds leaves the transition without a body
+        expect(text).toContain('void Idle::stop([[maybe_unused]] Folding *statemachine) const');
+    });
+
+    test('Repeated loads behind the machine pointer share a local', async () => {
+        const text = await generate('GuardedSwitch.statemachine');
+        expect(text).toContain('const int cse_0 = statemachine->count;');
+        expect(text).toContain('statemachine->count = (cse_0 + 1);');
+    });
+});
+
+describe('Tests the reachability analysis', () => {
+    const names = (transitions: Set<Transition>) => [...transitions].map(transition => `${transition.$container.name}.${transition.event.$refText}`);
+
+    test('Guards are judged by the values the model assigns', async () => {
+        const statemachine = await parseModel('DeadStates.statemachine');
+        const reachability = analyzeReachability(statemachine);
+        expect([...reachability.states].map(state => state.name)).toEqual(['Idle', 'Running']);
+        expect(names(reachability.transitions)).toEqual(['Idle.start', 'Running.start', 'Running.stop']);
+        // overheated is never set to true and gear stays within [1, 2]
+        expect(names(reachability.falseGuards)).toEqual(['Idle.fault', 'Running.fault']);
+    });
+
+    test('Attributes set by the host keep their guards', async () => {
+        const statemachine = await parseModel('DeadStates.statemachine');
+        const reachability = analyzeReachability(statemachine, { externalWrites: true });
+        expect([...reachability.states].map(state => state.name)).toEqual(['Idle', 'Running', 'Broken']);
+        expect(reachability.falseGuards.size).toBe(0);
+    });
+
+    test('Pruning is reported', async () => {
+        const statemachine = await parseModel('DeadStates.statemachine');
+        const report = describePruning(context(statemachine));
+        expect(report).toMatch(/^DeadStates pruned: 2 unreachable states and 5 transitions that can never fire; \d+ of \d+ lines of C\+\+/);
+        expect(() => generateCppContent(context(statemachine, { prune: true, log: 'binary' }))).toThrow('--log binary');
+    });
+});
+
+describe('Tests the state minimisation', () => {
+    test('States that behave the same are merged', async () => {
+        const statemachine = await parseModel('EquivalentStates.statemachine');
+        expect(equivalentStates(statemachine).map(members => members.map(state => state.name))).toEqual([['Locked', 'Relocked'], ['Unlocked', 'Open'], ['Alarm']]);
+        const minimized = minimizeStatemachine(statemachine);
+        expect(minimized.states.map(stateDisplayName)).toEqual(['Locked|Relocked', 'Unlocked|Open', 'Alarm']);
+        expect(minimized.states[1].transitions.map(transition => transition.state.$refText)).toEqual(['Locked', 'Unlocked']);
+    });
+
+    test('Guards and actions must be syntactically identical', async () => {
+        const statemachine = await parseModel(`
+            statemachine Counter
+            events inc
+            attributes count: int = 0
+            initialState A
+            state A
+                inc => B with{ count = count + 1 };
+            end
+            state B
+                inc => A with{ count = 1 + count };
+            end
+            state C
+                inc when (count > 0) => C;
+            end
+            state D
+                inc when (0 < count) => D;
+            end
+        `);
+        expect(equivalentStates(statemachine).map(members => members.map(state => state.name))).toEqual([['A'], ['B'], ['C'], ['D']]);
+        expect(describeMinimization(context(statemachine))).toBe('Counter minimized: no two states behave the same');
+        expect(() => generateCppContent(context(statemachine, { minimize: true, log: 'binary' }))).toThrow('--log binary');
+    });
+});
+
+describe('Tests the sharded output', () => {
+    test('States are split into balanced runs', async () => {
+        const statemachine = await parseModel('EquivalentStates.statemachine');
+        expect(shardStates(statemachine.states, 2).map(slice => slice.map(state => state.name))).toEqual([['Locked', 'Unlocked'], ['Relocked', 'Open', 'Alarm']]);
+        expect(shardStates(statemachine.states, 10)).toHaveLength(5);
+    });
+
+    test('The header declares what the shards define', async () => {
+        const statemachine = await parseModel('GuardedSwitch.statemachine');
+        const files = generateShardedContent(context(statemachine, { fileName: 'GuardedSwitch.cpp', shards: 2, module: true }));
+        expect(files.shards).toHaveLength(2);
+        const parts = [[files.header, '.hpp'], [files.shards[0], '_states0.cpp'], [files.shards[1], '_states1.cpp'], [files.main, '_main.cpp'], [files.module!, '.cppm']] as const;
+        for (const [part, suffix] of parts) {
+            const expectedOutput = readExampleFile('GuardedSwitch.sharded' + suffix, expectedOutputDir);
+            expect(normalizeCode(toString(part))).toBe(normalizeCode(expectedOutput));
+        }
+        expect(() => generateShardedContent(context(statemachine, { shards: 2, backend: 'table' }))).toThrow('--backend virtual');
+    });
+});
+
+describe('Tests the line directives', () => {
+    test('Actions point at the model and the rest at the generated file', async () => {
+        const statemachine = await parseModel('LightSwitch.statemachine', 'file:///models/LightSwitch.statemachine');
+        const lines = toStringWithLineDirectives(generateCppContent(context(statemachine, { fileName: 'LightSwitch.cpp' })), '/out/LightSwitch.cpp').split('\n');
+        const action = lines.findIndex(line => line.includes('statemachine->isOn = true;'));
+        // The handler sits on the transition's line, so the action follows on the next one without a directive of its own
+        expect(lines.slice(action - 2, action + 1)).toEqual([
+            '#line 11 "/models/LightSwitch.statemachine"',
+            '    void Off::toggle(LightSwitch *statemachine) const {',
+            '        statemachine->isOn = true;'
+        ]);
+        lines.forEach((line, index) => {
+            const match = /^#line (\d+) "\/out\/LightSwitch.cpp"$/.exec(line);
+            if (match) {
+                expect(Number(match[1])).toBe(index + 2);
+            }
+        });
+    });
+});
+
+describe('Tests the USDT probes', () => {
+    test('Probes are only compiled in on request', async () => {
+        expect(await generate('Door.statemachine')).not.toContain('SM_PROBE');
+    });
+});
+
+describe('Tests the event name perfect hash', () => {
+    test('Every event name is found in its own slot', () => {
+        const names = Array.from({ length: 200 }, (_, i) => `event${i}`);
+        const { displacements, slots } = buildEventPerfectHash(names);
+        names.forEach((name, index) => {
+            const displacement = displacements[eventHash(0, name) % names.length];
+            const slot = displacement < 0 ? -displacement - 1 : eventHash(displacement, name) % names.length;
+            expect(slots[slot]).toBe(index);
+        });
+    });
+});
+
+describe('Tests the binary event stream encoder', () => {
+    test('Event names are encoded as their declaration index', async () => {
+        const statemachine = await parseModel('LightSwitch.statemachine');
+        const stream = encodeEventStream(statemachine, 'toggle\ntoggle\n');
+        expect(stream.subarray(0, 4).toString('latin1')).toBe('SMEV');
+        expect(stream.readBigUInt64LE(8)).toBe(eventStreamFingerprint(statemachine));
+        expect([...stream.subarray(16)]).toEqual([0, 0]);
+    });
+
+    test('Timestamps are encoded as varint deltas', async () => {
+        const statemachine = await parseModel('LightSwitch.statemachine');
+        const stream = encodeEventStream(statemachine, '5 toggle\n300 toggle\n', { timestamps: true });
+        expect(stream[6]).toBe(1);
+        expect([...stream.subarray(16)]).toEqual([0, 5, 0, 0xa7, 0x02]);
+    });
+
+    test('Unknown events are rejected', async () => {
+        const statemachine = await parseModel('LightSwitch.statemachine');
+        expect(() => encodeEventStream(statemachine, 'toggle\nunknown\n')).toThrow('line 2');
+    });
+});
+
+describe('Tests the binary log decoder', () => {
+    test('Records are printed with their generated formats', async () => {
+        const statemachine = await parseModel('PrintSwitch.statemachine');
+        const header = Buffer.alloc(16);
+        header.write('SMLG', 0, 'latin1');
+        header.writeUInt8(1, 4);
+        header.writeBigUInt64LE(eventStreamFingerprint(statemachine), 8);
+        const record = (format: number, ...args: number[]) => {
+            const bytes = Buffer.alloc(2 + 8 * args.length);
+            bytes.writeUInt16LE(format, 0);
+            args.forEach((arg, index) => bytes.writeBigInt64LE(BigInt(arg), 2 + 8 * index));
+            return bytes;
+        };
+        const log = Buffer.concat([header, record(0, 0), record(2, 1), record(1, 0, 1), record(3, 0)]);
+        expect(decodeBinaryLog(statemachine, log)).toBe('[Off]\nSwitched on 1 times\nOff ===> On\nLight is on: 0\n');
+    });
+});
+
 // import { describe, expect, test } from 'vitest';
 // import { generateCppContent } from '../src/cli/generator.js';
 // import { createStatemachineServices } from '../src/language-server/statemachine-module.js';
@@ -254,4 +638,4 @@ describe('Tests the code generator', () => {
 //             fs.unlinkSync(path.join(examplesDir, inputFile));
 //         });
 //     });
-// });
\ No newline at end of file
+// });
@@ -1,5 +1,14 @@
 // import { describe, expect, test } from 'vitest';
 // import { _testHandleEvents, interpretStatemachineStatic } from '../src/cli/interpreter.js';
+import { EmptyFileSystem } from 'langium';
+import { parseHelper } from 'langium/test';
+import { describe, expect, test } from 'vitest';
+import { EventQueue } from '../src/cli/event-queue.js';
+import { _testSelectTransition, type StatemachineEnv } from '../src/cli/interpreter.js';
+import type { Statemachine } from '../src/language-server/generated/ast.js';
+import { createStatemachineServices } from '../src/language-server/statemachine-module.js';
+import * as fs from 'fs';
+import * as path from 'path';
 // import { createStatemachineServices } from '../src/language-server/statemachine-module.js';
 // // import { parseHelper } from 'langium/test';
 // import { NodeFileSystem } from 'langium/node';
@@ -273,4 +282,54 @@ describe('Statemachine Interpreter Tests', () => {
             fs.unlinkSync(fileName);
         });
     });
-});
\ No newline at end of file
+});
+describe('Interpreter event queue', () => {
+    const fill = (queue: EventQueue<number>, count: number) => Array.from({ length: count }, (_, i) => queue.push(i));
+    const drain = (queue: EventQueue<number>) => Array.from({ length: queue.length }, () => queue.shift());
+
+    test('keeps events in arrival order across the end of the ring', () => {
+        const queue = new EventQueue<number>({ queueCapacity: 3 });
+        fill(queue, 2);
+        expect(queue.shift()).toBe(0);
+        expect(queue.push(2)).toBe(true);
+        expect(queue.push(3)).toBe(true);
+        expect(drain(queue)).toEqual([1, 2, 3]);
+        expect(queue.shift()).toBeUndefined();
+    });
+
+    test('reject and drop-newest refuse events once full', () => {
+        for (const queueOverflow of ['reject', 'drop-newest'] as const) {
+            const queue = new EventQueue<number>({ queueCapacity: 2, queueOverflow });
+            expect(fill(queue, 4)).toEqual([true, true, false, false]);
+            expect(drain(queue)).toEqual([0, 1]);
+        }
+    });
+
+    test('drop-oldest keeps the latest events', () => {
+        const queue = new EventQueue<number>({ queueCapacity: 2, queueOverflow: 'drop-oldest' });
+        expect(fill(queue, 5)).toEqual([true, true, true, true, true]);
+        expect(queue.length).toBe(2);
+        expect(drain(queue)).toEqual([3, 4]);
+    });
+
+    test('rejects a capacity below one', () => {
+        expect(() => new EventQueue<number>({ queueCapacity: 0 })).toThrow();
+    });
+});
+
+describe('Interpreter guarded alternatives', () => {
+    const services = createStatemachineServices(EmptyFileSystem).statemachine;
+    const parse = parseHelper<Statemachine>(services);
+
+    test('the first alternative whose guard holds fires', async () => {
+        const ast = await parse(fs.readFileSync(path.resolve(__dirname, 'featureSpecificTestInput/GuardedBands.statemachine'), 'utf-8'));
+        const warning = ast.parseResult.value.states.find(state => state.name === 'Warning')!;
+        const select = (level: number, alarms: number) => {
+            const env: StatemachineEnv = new Map([['level', level], ['alarms', alarms]]);
+            return _testSelectTransition(warning.transitions, 'sample', env)?.state.$refText;
+        };
+        expect(select(12, 3)).toBe('Alarm');
+        expect(select(16, 0)).toBe('Alarm');
+        expect(select(12, 0)).toBe('Normal');
+    });
+});
@@ -1,160 +1,183 @@
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
-#include <map>
 #include <string>
+#include <string_view>
 #include <chrono>
 #include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
 class HomeSecurity;
 
 class State {
-protected:
-    HomeSecurity *statemachine;
-
 public:
     virtual ~State() {}
 
-    void set_context(HomeSecurity *statemachine) {
-        this->statemachine = statemachine;
-    }
-
-    virtual std::string get_name() {
+    virtual std::string_view get_name() const {
         return "Unknown";
     }
 
-    virtual void resetSystem() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void resetSystem(HomeSecurity *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 
-    virtual void disarmSystem() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void disarmSystem(HomeSecurity *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 
-    virtual void triggerAlarm() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void triggerAlarm(HomeSecurity *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 };
 
 class HomeSecurity {
 private:
-    State* state = nullptr;
+    const State* state = nullptr;
 public:
     bool systemArmed = false;
     int attempts = 0;
     int maxAttempts = 3;
-    HomeSecurity(State* initial_state) {
-        initial_state->set_context(this);
+    HomeSecurity(const State* initial_state) {
         state = initial_state;
-        std::cout << "[" << state->get_name() <<  "]" << std::endl;
-    }
-
-    ~HomeSecurity() {
-        if (state != nullptr) {
-            delete state;
-        }
+        SM_TRACE_TRANSITION("[" << state->get_name() << "]");
     }
 
-    void transition_to(State *new_state) {
-        std::cout << state->get_name() << " ===> " << new_state->get_name() << std::endl;
-        if (state != nullptr) {
-            delete state;
-        }
-        new_state->set_context(this);
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());
         state = new_state;
     }
     void resetSystem() {
-        state->resetSystem();
+        state->resetSystem(this);
     }
     void disarmSystem() {
-        state->disarmSystem();
+        state->disarmSystem(this);
     }
     void triggerAlarm() {
-        state->triggerAlarm();
+        state->triggerAlarm(this);
     }
 };
 
 class Disarmed : public State {
 public:
-    std::string get_name() override { return "Disarmed"; }
-    void triggerAlarm() override;
+    static const Disarmed instance;
+    std::string_view get_name() const override { return "Disarmed"; }
+    void triggerAlarm(HomeSecurity *statemachine) const override;
 };
 class AlarmTriggered : public State {
 public:
-    std::string get_name() override { return "AlarmTriggered"; }
-    void resetSystem() override;
-    void disarmSystem() override;
+    static const AlarmTriggered instance;
+    std::string_view get_name() const override { return "AlarmTriggered"; }
+    void resetSystem(HomeSecurity *statemachine) const override;
+    void disarmSystem(HomeSecurity *statemachine) const override;
 };
 class Locked : public State {
 public:
-    std::string get_name() override { return "Locked"; }
-    void disarmSystem() override;
+    static const Locked instance;
+    std::string_view get_name() const override { return "Locked"; }
+    void disarmSystem(HomeSecurity *statemachine) const override;
 };
     // Disarmed
+    const Disarmed Disarmed::instance;
 
-    void Disarmed::triggerAlarm() {
-        if (true) {
-            statemachine->systemArmed = true;
-            statemachine->attempts = 0;
-            std::cout << "Alarm triggered! System armed." << std::endl;
-            statemachine->transition_to(new AlarmTriggered);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Disarmed::triggerAlarm(HomeSecurity *statemachine) const {
+        statemachine->systemArmed = true;
+        statemachine->attempts = 0;
+        std::cout << "Alarm triggered! System armed." << '\n';
+        statemachine->transition_to(&AlarmTriggered::instance);
     }
     
     // AlarmTriggered
-
-    void AlarmTriggered::resetSystem() {
-        if (((statemachine->attempts < statemachine->maxAttempts))) {
-            statemachine->attempts = (statemachine->attempts + 1);
-            std::cout << "Reset attempt: " << statemachine->attempts << std::endl;
-            statemachine->transition_to(new AlarmTriggered);
+    const AlarmTriggered AlarmTriggered::instance;
+
+    void AlarmTriggered::resetSystem(HomeSecurity *statemachine) const {
+        const int cse_0 = statemachine->attempts;
+        if ((cse_0 < statemachine->maxAttempts)) {
+            statemachine->attempts = (cse_0 + 1);
+            std::cout << "Reset attempt: " << statemachine->attempts << '\n';
+            statemachine->transition_to(&AlarmTriggered::instance);
         } else {
-            std::cout << "Transition not allowed." << std::endl;
+            SM_TRACE("Transition not allowed.");
         }
     }
     
 
-    void AlarmTriggered::disarmSystem() {
-        if (true) {
-            statemachine->systemArmed = false;
-            std::cout << "System disarmed." << std::endl;
-            statemachine->transition_to(new Disarmed);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void AlarmTriggered::disarmSystem(HomeSecurity *statemachine) const {
+        statemachine->systemArmed = false;
+        std::cout << "System disarmed." << '\n';
+        statemachine->transition_to(&Disarmed::instance);
     }
     
     // Locked
+    const Locked Locked::instance;
 
-    void Locked::disarmSystem() {
-        if (true) {
-            statemachine->systemArmed = false;
-            std::cout << "System disarmed from locked state." << std::endl;
-            statemachine->transition_to(new Disarmed);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Locked::disarmSystem(HomeSecurity *statemachine) const {
+        statemachine->systemArmed = false;
+        std::cout << "System disarmed from locked state." << '\n';
+        statemachine->transition_to(&Disarmed::instance);
     }
     
 
 typedef void (HomeSecurity::*Event)();
 
-int main() {
-    HomeSecurity *statemachine = new HomeSecurity(new Disarmed);
-
-    static std::map<std::string, Event> event_by_name;
-    event_by_name["resetSystem"] = &HomeSecurity::resetSystem;
-    event_by_name["disarmSystem"] = &HomeSecurity::disarmSystem;
-    event_by_name["triggerAlarm"] = &HomeSecurity::triggerAlarm;
-    for (std::string input; std::getline(std::cin, input);) {
-        std::map<std::string, Event>::const_iterator event_by_name_it = event_by_name.find(input);
-        if (event_by_name_it == event_by_name.end()) {
-            std::cout << "There is no event <" << input << "> in the HomeSecurity statemachine." << std::endl;
-            continue;
-        }
-        Event event_invoker = event_by_name_it->second;
-        (statemachine->*event_invoker)();
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 3;
+constexpr std::int32_t event_displacements[event_slot_count] = { -3, -2, -1 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "disarmSystem", "triggerAlarm", "resetSystem" };
+constexpr Event event_slot_values[event_slot_count] = { &HomeSecurity::disarmSystem, &HomeSecurity::triggerAlarm, &HomeSecurity::resetSystem };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0xabc5a041908f5f10ull;
+constexpr Event event_ids[3] = { &HomeSecurity::resetSystem, &HomeSecurity::disarmSystem, &HomeSecurity::triggerAlarm };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    HomeSecurity *statemachine = new HomeSecurity(&Disarmed::instance);
+
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 3, [statemachine](std::size_t id, std::uint64_t) { (statemachine->*event_ids[id])(); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the HomeSecurity statemachine.");
+                return;
+            }
+            (statemachine->*event_slot_values[slot])();
+        });
     }
 
     delete statemachine;
-    return 0;
+    return status;
 }
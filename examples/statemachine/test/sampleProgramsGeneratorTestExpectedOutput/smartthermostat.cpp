@@ -1,45 +1,54 @@
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
-#include <map>
 #include <string>
+#include <string_view>
 #include <chrono>
 #include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
 class SmartThermostat;
 
 class State {
-protected:
-    SmartThermostat *statemachine;
-
 public:
     virtual ~State() {}
 
-    void set_context(SmartThermostat *statemachine) {
-        this->statemachine = statemachine;
-    }
-
-    virtual std::string get_name() {
+    virtual std::string_view get_name() const {
         return "Unknown";
     }
 
-    virtual void increaseTemperature() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void increaseTemperature(SmartThermostat *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 
-    virtual void decreaseTemperature() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void decreaseTemperature(SmartThermostat *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 
-    virtual void setMode() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void setMode(SmartThermostat *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 
-    virtual void reset() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void reset(SmartThermostat *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 };
 
 class SmartThermostat {
 private:
-    State* state = nullptr;
+    const State* state = nullptr;
 public:
     int currentTemperature = 22;
     int targetTemperature = 24;
@@ -47,232 +56,220 @@ public:
     bool coolingEnabled = false;
     int safetyThreshold = 30;
     bool energySavingMode = false;
-    SmartThermostat(State* initial_state) {
-        initial_state->set_context(this);
+    SmartThermostat(const State* initial_state) {
         state = initial_state;
-        std::cout << "[" << state->get_name() <<  "]" << std::endl;
-    }
-
-    ~SmartThermostat() {
-        if (state != nullptr) {
-            delete state;
-        }
+        SM_TRACE_TRANSITION("[" << state->get_name() << "]");
     }
 
-    void transition_to(State *new_state) {
-        std::cout << state->get_name() << " ===> " << new_state->get_name() << std::endl;
-        if (state != nullptr) {
-            delete state;
-        }
-        new_state->set_context(this);
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());
         state = new_state;
     }
     void increaseTemperature() {
-        state->increaseTemperature();
+        state->increaseTemperature(this);
     }
     void decreaseTemperature() {
-        state->decreaseTemperature();
+        state->decreaseTemperature(this);
     }
     void setMode() {
-        state->setMode();
+        state->setMode(this);
     }
     void reset() {
-        state->reset();
+        state->reset(this);
     }
 };
 
 class Idle : public State {
 public:
-    std::string get_name() override { return "Idle"; }
-    void increaseTemperature() override;
-    void decreaseTemperature() override;
-    void setMode() override;
-    void setMode() override;
+    static const Idle instance;
+    std::string_view get_name() const override { return "Idle"; }
+    void increaseTemperature(SmartThermostat *statemachine) const override;
+    void decreaseTemperature(SmartThermostat *statemachine) const override;
+    void setMode(SmartThermostat *statemachine) const override;
 };
 class AdjustingTemperature : public State {
 public:
-    std::string get_name() override { return "AdjustingTemperature"; }
-    void reset() override;
-    void increaseTemperature() override;
-    void decreaseTemperature() override;
-    void setMode() override;
+    static const AdjustingTemperature instance;
+    std::string_view get_name() const override { return "AdjustingTemperature"; }
+    void reset(SmartThermostat *statemachine) const override;
+    void increaseTemperature(SmartThermostat *statemachine) const override;
+    void decreaseTemperature(SmartThermostat *statemachine) const override;
+    void setMode(SmartThermostat *statemachine) const override;
 };
 class SafetyLock : public State {
 public:
-    std::string get_name() override { return "SafetyLock"; }
-    void reset() override;
+    static const SafetyLock instance;
+    std::string_view get_name() const override { return "SafetyLock"; }
+    void reset(SmartThermostat *statemachine) const override;
 };
 class EnergySavingMode : public State {
 public:
-    std::string get_name() override { return "EnergySavingMode"; }
-    void reset() override;
-    void increaseTemperature() override;
-    void decreaseTemperature() override;
+    static const EnergySavingMode instance;
+    std::string_view get_name() const override { return "EnergySavingMode"; }
+    void reset(SmartThermostat *statemachine) const override;
+    void increaseTemperature(SmartThermostat *statemachine) const override;
+    void decreaseTemperature(SmartThermostat *statemachine) const override;
 };
     // Idle
+    const Idle Idle::instance;
 
-    void Idle::increaseTemperature() {
-        if (true) {
-            statemachine->targetTemperature = (statemachine->targetTemperature + 2);
-            std::cout << "Increasing target temperature to " << statemachine->targetTemperature << std::endl;
-            statemachine->transition_to(new AdjustingTemperature);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
-    }
-    
-
-    void Idle::decreaseTemperature() {
-        if (true) {
-            statemachine->targetTemperature = (statemachine->targetTemperature - 2);
-            std::cout << "Decreasing target temperature to " << statemachine->targetTemperature << std::endl;
-            statemachine->transition_to(new AdjustingTemperature);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Idle::increaseTemperature(SmartThermostat *statemachine) const {
+        statemachine->targetTemperature = (statemachine->targetTemperature + 2);
+        std::cout << "Increasing target temperature to " << statemachine->targetTemperature << '\n';
+        statemachine->transition_to(&AdjustingTemperature::instance);
     }
     
 
-    void Idle::setMode() {
-        if (((statemachine->targetTemperature > statemachine->safetyThreshold))) {
-            std::cout << "Run Command: notifyUser()" << std::endl;
-            std::cout << "Temperature exceeds safety threshold! Locking system." << std::endl;
-            statemachine->transition_to(new SafetyLock);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void Idle::decreaseTemperature(SmartThermostat *statemachine) const {
+        statemachine->targetTemperature = (statemachine->targetTemperature - 2);
+        std::cout << "Decreasing target temperature to " << statemachine->targetTemperature << '\n';
+        statemachine->transition_to(&AdjustingTemperature::instance);
     }
     
 
-    void Idle::setMode() {
-        if (((statemachine->targetTemperature <= statemachine->safetyThreshold))) {
-            statemachine->heatingEnabled = ((statemachine->currentTemperature < statemachine->targetTemperature));
-            statemachine->coolingEnabled = ((statemachine->currentTemperature > statemachine->targetTemperature));
+    void Idle::setMode(SmartThermostat *statemachine) const {
+        if ((statemachine->targetTemperature > statemachine->safetyThreshold)) {
+            std::cout << "Run Command: notifyUser()" << '\n';
+            std::cout << "Temperature exceeds safety threshold! Locking system." << '\n';
+            statemachine->transition_to(&SafetyLock::instance);
+        } else if ((statemachine->targetTemperature <= statemachine->safetyThreshold)) {
+            const int cse_0 = statemachine->targetTemperature;
+            const int cse_1 = statemachine->currentTemperature;
+            statemachine->heatingEnabled = (cse_1 < cse_0);
+            statemachine->coolingEnabled = (cse_1 > cse_0);
             statemachine->energySavingMode = false;
-            std::cout << "Adjusting system mode. Heating: " << statemachine->heatingEnabled << ", Cooling: " << statemachine->coolingEnabled << std::endl;
-            statemachine->transition_to(new AdjustingTemperature);
+            std::cout << "Adjusting system mode. Heating: " << statemachine->heatingEnabled << ", Cooling: " << statemachine->coolingEnabled << '\n';
+            statemachine->transition_to(&AdjustingTemperature::instance);
         } else {
-            std::cout << "Transition not allowed." << std::endl;
+            SM_TRACE("Transition not allowed.");
         }
     }
     
     // AdjustingTemperature
+    const AdjustingTemperature AdjustingTemperature::instance;
 
-    void AdjustingTemperature::reset() {
-        if (true) {
-            statemachine->heatingEnabled = false;
-            statemachine->coolingEnabled = false;
-            std::cout << "Resetting to idle mode." << std::endl;
-            statemachine->transition_to(new Idle);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void AdjustingTemperature::reset(SmartThermostat *statemachine) const {
+        statemachine->heatingEnabled = false;
+        statemachine->coolingEnabled = false;
+        std::cout << "Resetting to idle mode." << '\n';
+        statemachine->transition_to(&Idle::instance);
     }
     
 
-    void AdjustingTemperature::increaseTemperature() {
-        if (true) {
-            statemachine->targetTemperature = (statemachine->targetTemperature + 1);
-            statemachine->heatingEnabled = ((statemachine->currentTemperature < statemachine->targetTemperature));
-            statemachine->coolingEnabled = ((statemachine->currentTemperature > statemachine->targetTemperature));
-            std::cout << "Target temperature increased to " << statemachine->targetTemperature << ". Heating: " << statemachine->heatingEnabled << ", Cooling: " << statemachine->coolingEnabled << std::endl;
-            statemachine->transition_to(new AdjustingTemperature);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void AdjustingTemperature::increaseTemperature(SmartThermostat *statemachine) const {
+        statemachine->targetTemperature = (statemachine->targetTemperature + 1);
+        const int cse_0 = statemachine->targetTemperature;
+        const int cse_1 = statemachine->currentTemperature;
+        statemachine->heatingEnabled = (cse_1 < cse_0);
+        statemachine->coolingEnabled = (cse_1 > cse_0);
+        std::cout << "Target temperature increased to " << cse_0 << ". Heating: " << statemachine->heatingEnabled << ", Cooling: " << statemachine->coolingEnabled << '\n';
+        statemachine->transition_to(&AdjustingTemperature::instance);
     }
     
 
-    void AdjustingTemperature::decreaseTemperature() {
-        if (true) {
-            statemachine->targetTemperature = (statemachine->targetTemperature - 1);
-            statemachine->heatingEnabled = ((statemachine->currentTemperature < statemachine->targetTemperature));
-            statemachine->coolingEnabled = ((statemachine->currentTemperature > statemachine->targetTemperature));
-            std::cout << "Target temperature decreased to " << statemachine->targetTemperature << ". Heating: " << statemachine->heatingEnabled << ", Cooling: " << statemachine->coolingEnabled << std::endl;
-            statemachine->transition_to(new AdjustingTemperature);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void AdjustingTemperature::decreaseTemperature(SmartThermostat *statemachine) const {
+        statemachine->targetTemperature = (statemachine->targetTemperature - 1);
+        const int cse_0 = statemachine->targetTemperature;
+        const int cse_1 = statemachine->currentTemperature;
+        statemachine->heatingEnabled = (cse_1 < cse_0);
+        statemachine->coolingEnabled = (cse_1 > cse_0);
+        std::cout << "Target temperature decreased to " << cse_0 << ". Heating: " << statemachine->heatingEnabled << ", Cooling: " << statemachine->coolingEnabled << '\n';
+        statemachine->transition_to(&AdjustingTemperature::instance);
     }
     
 
-    void AdjustingTemperature::setMode() {
-        if ((statemachine->energySavingMode)) {
-            std::cout << "Switching to energy-saving mode." << std::endl;
-            statemachine->transition_to(new EnergySavingMode);
+    void AdjustingTemperature::setMode(SmartThermostat *statemachine) const {
+        if (statemachine->energySavingMode) {
+            std::cout << "Switching to energy-saving mode." << '\n';
+            statemachine->transition_to(&EnergySavingMode::instance);
         } else {
-            std::cout << "Transition not allowed." << std::endl;
+            SM_TRACE("Transition not allowed.");
         }
     }
     
     // SafetyLock
+    const SafetyLock SafetyLock::instance;
 
-    void SafetyLock::reset() {
-        if (true) {
-            statemachine->heatingEnabled = false;
-            statemachine->coolingEnabled = false;
-            std::cout << "Safety lock reset. Returning to idle mode." << std::endl;
-            statemachine->transition_to(new Idle);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void SafetyLock::reset(SmartThermostat *statemachine) const {
+        statemachine->heatingEnabled = false;
+        statemachine->coolingEnabled = false;
+        std::cout << "Safety lock reset. Returning to idle mode." << '\n';
+        statemachine->transition_to(&Idle::instance);
     }
     
     // EnergySavingMode
+    const EnergySavingMode EnergySavingMode::instance;
 
-    void EnergySavingMode::reset() {
-        if (true) {
-            statemachine->energySavingMode = false;
-            std::cout << "Energy-saving mode disabled. Returning to idle mode." << std::endl;
-            statemachine->transition_to(new Idle);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void EnergySavingMode::reset(SmartThermostat *statemachine) const {
+        statemachine->energySavingMode = false;
+        std::cout << "Energy-saving mode disabled. Returning to idle mode." << '\n';
+        statemachine->transition_to(&Idle::instance);
     }
     
 
-    void EnergySavingMode::increaseTemperature() {
-        if (true) {
-            statemachine->targetTemperature = (statemachine->targetTemperature + 1);
-            std::cout << "Increased temperature in energy-saving mode to " << statemachine->targetTemperature << std::endl;
-            statemachine->transition_to(new EnergySavingMode);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void EnergySavingMode::increaseTemperature(SmartThermostat *statemachine) const {
+        statemachine->targetTemperature = (statemachine->targetTemperature + 1);
+        std::cout << "Increased temperature in energy-saving mode to " << statemachine->targetTemperature << '\n';
+        statemachine->transition_to(&EnergySavingMode::instance);
     }
     
 
-    void EnergySavingMode::decreaseTemperature() {
-        if (true) {
-            statemachine->targetTemperature = (statemachine->targetTemperature - 1);
-            std::cout << "Decreased temperature in energy-saving mode to " << statemachine->targetTemperature << std::endl;
-            statemachine->transition_to(new EnergySavingMode);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void EnergySavingMode::decreaseTemperature(SmartThermostat *statemachine) const {
+        statemachine->targetTemperature = (statemachine->targetTemperature - 1);
+        std::cout << "Decreased temperature in energy-saving mode to " << statemachine->targetTemperature << '\n';
+        statemachine->transition_to(&EnergySavingMode::instance);
     }
     
 
 typedef void (SmartThermostat::*Event)();
 
-int main() {
-    SmartThermostat *statemachine = new SmartThermostat(new Idle);
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
 
-    static std::map<std::string, Event> event_by_name;
-    event_by_name["increaseTemperature"] = &SmartThermostat::increaseTemperature;
-    event_by_name["decreaseTemperature"] = &SmartThermostat::decreaseTemperature;
-    event_by_name["setMode"] = &SmartThermostat::setMode;
-    event_by_name["reset"] = &SmartThermostat::reset;
-    for (std::string input; std::getline(std::cin, input);) {
-        std::map<std::string, Event>::const_iterator event_by_name_it = event_by_name.find(input);
-        if (event_by_name_it == event_by_name.end()) {
-            std::cout << "There is no event <" << input << "> in the SmartThermostat statemachine." << std::endl;
-            continue;
-        }
-        Event event_invoker = event_by_name_it->second;
-        (statemachine->*event_invoker)();
+constexpr std::size_t event_slot_count = 4;
+constexpr std::int32_t event_displacements[event_slot_count] = { -4, -3, -2, -1 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "setMode", "increaseTemperature", "reset", "decreaseTemperature" };
+constexpr Event event_slot_values[event_slot_count] = { &SmartThermostat::setMode, &SmartThermostat::increaseTemperature, &SmartThermostat::reset, &SmartThermostat::decreaseTemperature };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0xa8f652ee0bc4d35bull;
+constexpr Event event_ids[4] = { &SmartThermostat::increaseTemperature, &SmartThermostat::decreaseTemperature, &SmartThermostat::setMode, &SmartThermostat::reset };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    SmartThermostat *statemachine = new SmartThermostat(&Idle::instance);
+
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 4, [statemachine](std::size_t id, std::uint64_t) { (statemachine->*event_ids[id])(); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the SmartThermostat statemachine.");
+                return;
+            }
+            (statemachine->*event_slot_values[slot])();
+        });
     }
 
     delete statemachine;
-    return 0;
+    return status;
 }
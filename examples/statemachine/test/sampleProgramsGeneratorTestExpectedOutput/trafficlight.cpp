@@ -1,204 +1,380 @@
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
-#include <map>
 #include <string>
+#include <string_view>
 #include <chrono>
 #include <thread>
+#include "statemachine_input.hpp"
+#ifndef SM_TRACE_LEVEL
+#define SM_TRACE_LEVEL 2
+#endif
+#if SM_TRACE_LEVEL >= 1
+#define SM_TRACE_TRANSITION(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE_TRANSITION(output) static_cast<void>(0)
+#endif
+#if SM_TRACE_LEVEL >= 2
+#define SM_TRACE(output) (std::cout << output << '\n')
+#else
+#define SM_TRACE(output) static_cast<void>(0)
+#endif
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <queue>
+#ifdef STATEMACHINE_POSIX_IO
+#include <poll.h>
+#endif
+#include "statemachine_queue.hpp"
 class TrafficLight;
 
-class State {
-protected:
-    TrafficLight *statemachine;
+namespace statemachine_timer {
+
+using clock = std::chrono::steady_clock;
 
+// Event loop for transitions suspended in setTimeout. Timers are kept in a min-heap
+// and resumed in deadline order (ties in the order they were started).
+class scheduler {
 public:
-    virtual ~State() {}
+    static scheduler &instance() {
+        static scheduler shared;
+        return shared;
+    }
+
+    void schedule(clock::time_point deadline, std::coroutine_handle<> handle) {
+        timers.push(timer{deadline, next_sequence++, handle});
+    }
+
+    // Resumes every timer that is due and returns whether any are left.
+    bool run_due() {
+        while (!timers.empty() && timers.top().deadline <= clock::now()) {
+            const std::coroutine_handle<> handle = timers.top().handle;
+            timers.pop();
+            handle.resume();
+        }
+        return !timers.empty();
+    }
+
+#ifdef STATEMACHINE_POSIX_IO
+    // Returns once the input on fd is readable, running due timers while waiting.
+    void run_until_readable(int fd) {
+        for (;;) {
+            const bool pending = run_due();
+            std::cout.flush();
+            if (!pending) {
+                return;
+            }
+            const auto delay = std::chrono::ceil<std::chrono::milliseconds>(timers.top().deadline - clock::now());
+            pollfd input{fd, POLLIN, 0};
+            if (poll(&input, 1, static_cast<int>(std::max<std::chrono::milliseconds::rep>(delay.count(), 0))) != 0) {
+                return;
+            }
+        }
+    }
+#endif
+
+    // Sleeps until every pending timer has fired.
+    void run_until_idle() {
+        while (run_due()) {
+            std::cout.flush();
+            std::this_thread::sleep_until(timers.top().deadline);
+        }
+    }
+
+private:
+    struct timer {
+        clock::time_point deadline;
+        std::uint64_t sequence;
+        std::coroutine_handle<> handle;
+
+        bool operator>(const timer &other) const {
+            return deadline != other.deadline ? deadline > other.deadline : sequence > other.sequence;
+        }
+    };
+
+    std::priority_queue<timer, std::vector<timer>, std::greater<timer>> timers;
+    std::uint64_t next_sequence = 0;
+};
 
-    void set_context(TrafficLight *statemachine) {
-        this->statemachine = statemachine;
+// Awaitable of setTimeout: suspends the transition and resumes it from the scheduler.
+struct sleep_for {
+    std::chrono::milliseconds duration;
+
+    bool await_ready() const noexcept {
+        return duration.count() <= 0;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) const {
+        scheduler::instance().schedule(clock::now() + duration, handle);
     }
 
-    virtual std::string get_name() {
+    void await_resume() const noexcept {}
+};
+
+// Fire-and-forget coroutine of a transition body; it starts eagerly and its frame
+// is freed when the body returns.
+struct task {
+    struct promise_type {
+        task get_return_object() noexcept {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept {
+            std::terminate();
+        }
+    };
+};
+
+// Installed as before_stdin_read, so suspended transitions keep completing while the
+// program waits for input.
+inline void run_timers_until_input() {
+#ifdef STATEMACHINE_POSIX_IO
+    scheduler::instance().run_until_readable(STDIN_FILENO);
+#else
+    scheduler::instance().run_due();
+#endif
+}
+
+} // namespace statemachine_timer
+
+class State {
+public:
+    virtual ~State() {}
+
+    virtual std::string_view get_name() const {
         return "Unknown";
     }
 
-    virtual void next() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void next(TrafficLight *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 
-    virtual void switchMode() {
-        std::cout << "Impossible event for the current state." << std::endl;
+    virtual void switchMode(TrafficLight *) const {
+        SM_TRACE("Impossible event for the current state.");
     }
 };
 
 class TrafficLight {
 private:
-    State* state = nullptr;
+    const State* state = nullptr;
 public:
     int timeElapsedInSec = 0;
     bool isNightMode = false;
-    TrafficLight(State* initial_state) {
-        initial_state->set_context(this);
+    TrafficLight(const State* initial_state) {
         state = initial_state;
-        std::cout << "[" << state->get_name() <<  "]" << std::endl;
-    }
-
-    ~TrafficLight() {
-        if (state != nullptr) {
-            delete state;
-        }
+        SM_TRACE_TRANSITION("[" << state->get_name() << "]");
     }
 
-    void transition_to(State *new_state) {
-        std::cout << state->get_name() << " ===> " << new_state->get_name() << std::endl;
-        if (state != nullptr) {
-            delete state;
-        }
-        new_state->set_context(this);
+    // States are stateless flyweights, so a transition only swaps a pointer.
+    void transition_to(const State *new_state) {
+        SM_TRACE_TRANSITION(state->get_name() << " ===> " << new_state->get_name());
         state = new_state;
     }
     void next() {
-        state->next();
+        state->next(this);
     }
     void switchMode() {
-        state->switchMode();
+        state->switchMode(this);
+    }
+    
+    using event_handle = void (TrafficLight::*)();
+    bool suspended = false;
+    statemachine_queue::event_queue<event_handle, 64, statemachine_queue::queue_overflow::reject> pending;
+
+    void post(event_handle event) {
+        if (suspended) {
+            if (!pending.push(event)) {
+                SM_TRACE("The event queue is full; the event is rejected.");
+            }
+            return;
+        }
+        (this->*event)();
+    }
+
+    void resume_pending() {
+        suspended = false;
+        while (!suspended && !pending.empty()) {
+            (this->*pending.pop())();
+        }
     }
 };
 
 class RedLight : public State {
 public:
-    std::string get_name() override { return "RedLight"; }
-    void switchMode() override;
-    void next() override;
+    static const RedLight instance;
+    std::string_view get_name() const override { return "RedLight"; }
+    void switchMode(TrafficLight *statemachine) const override;
+    void next(TrafficLight *statemachine) const override;
 };
 class GreenLight : public State {
 public:
-    std::string get_name() override { return "GreenLight"; }
-    void next() override;
-    void switchMode() override;
+    static const GreenLight instance;
+    std::string_view get_name() const override { return "GreenLight"; }
+    void next(TrafficLight *statemachine) const override;
+    void switchMode(TrafficLight *statemachine) const override;
 };
 class YellowLight : public State {
 public:
-    std::string get_name() override { return "YellowLight"; }
-    void next() override;
-    void switchMode() override;
+    static const YellowLight instance;
+    std::string_view get_name() const override { return "YellowLight"; }
+    void next(TrafficLight *statemachine) const override;
+    void switchMode(TrafficLight *statemachine) const override;
 };
 class NightMode : public State {
 public:
-    std::string get_name() override { return "NightMode"; }
-    void next() override;
+    static const NightMode instance;
+    std::string_view get_name() const override { return "NightMode"; }
+    void next(TrafficLight *statemachine) const override;
 };
     // RedLight
+    const RedLight RedLight::instance;
 
-    void RedLight::switchMode() {
-        if (true) {
-            statemachine->isNightMode = true;
-            std::cout << "Switching to night mode." << std::endl;
-            statemachine->transition_to(new NightMode);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void RedLight::switchMode(TrafficLight *statemachine) const {
+        statemachine->isNightMode = true;
+        std::cout << "Switching to night mode." << '\n';
+        statemachine->transition_to(&NightMode::instance);
     }
     
 
-    void RedLight::next() {
-        if (true) {
-
-            std::cout << "Delaying transition for 6000 milliseconds..." << std::endl;
-            std::this_thread::sleep_for(std::chrono::milliseconds(6000));
-        
+    static statemachine_timer::task RedLight_next_run(TrafficLight *statemachine) {
+            SM_TRACE("Delaying transition for 6000 milliseconds...");
+            co_await statemachine_timer::sleep_for{std::chrono::milliseconds(6000)};
             statemachine->timeElapsedInSec = 6;
-            std::cout << "Switching to Yellow Light after " << statemachine->timeElapsedInSec << " seconds of Red Light." << std::endl;
-            statemachine->transition_to(new YellowLight);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+            std::cout << "Switching to Yellow Light after " << statemachine->timeElapsedInSec << " seconds of Red Light." << '\n';
+        statemachine->transition_to(&YellowLight::instance);
+        statemachine->resume_pending();
+    }
+
+    void RedLight::next(TrafficLight *statemachine) const {
+        statemachine->suspended = true;
+        RedLight_next_run(statemachine);
     }
     
     // GreenLight
+    const GreenLight GreenLight::instance;
 
-    void GreenLight::next() {
-        if ((((statemachine->timeElapsedInSec >= 5) || statemachine->isNightMode))) {
-
-            std::cout << "Delaying transition for 6000 milliseconds..." << std::endl;
-            std::this_thread::sleep_for(std::chrono::milliseconds(6000));
-        
+    static statemachine_timer::task GreenLight_next_run(TrafficLight *statemachine) {
+            SM_TRACE("Delaying transition for 6000 milliseconds...");
+            co_await statemachine_timer::sleep_for{std::chrono::milliseconds(6000)};
             statemachine->timeElapsedInSec = 6;
-            std::cout << "Switching to Red Light after " << statemachine->timeElapsedInSec << " seconds of Green Light." << std::endl;
-            statemachine->transition_to(new RedLight);
+            std::cout << "Switching to Red Light after " << statemachine->timeElapsedInSec << " seconds of Green Light." << '\n';
+        statemachine->transition_to(&RedLight::instance);
+        statemachine->resume_pending();
+    }
+
+    void GreenLight::next(TrafficLight *statemachine) const {
+        if (((statemachine->timeElapsedInSec >= 5) || statemachine->isNightMode)) {
+            statemachine->suspended = true;
+            GreenLight_next_run(statemachine);
         } else {
-            std::cout << "Transition not allowed." << std::endl;
+            SM_TRACE("Transition not allowed.");
         }
     }
     
 
-    void GreenLight::switchMode() {
-        if (true) {
-            statemachine->isNightMode = true;
-            std::cout << "Switching to night mode." << std::endl;
-            statemachine->transition_to(new NightMode);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void GreenLight::switchMode(TrafficLight *statemachine) const {
+        statemachine->isNightMode = true;
+        std::cout << "Switching to night mode." << '\n';
+        statemachine->transition_to(&NightMode::instance);
     }
     
     // YellowLight
+    const YellowLight YellowLight::instance;
 
-    void YellowLight::next() {
-        if (true) {
-
-            std::cout << "Delaying transition for 3000 milliseconds..." << std::endl;
-            std::this_thread::sleep_for(std::chrono::milliseconds(3000));
-        
+    static statemachine_timer::task YellowLight_next_run(TrafficLight *statemachine) {
+            SM_TRACE("Delaying transition for 3000 milliseconds...");
+            co_await statemachine_timer::sleep_for{std::chrono::milliseconds(3000)};
             statemachine->timeElapsedInSec = (statemachine->timeElapsedInSec + 3);
-            std::cout << "Switching to Green Light after 3 seconds of Yellow Light." << std::endl;
-            statemachine->transition_to(new GreenLight);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+            std::cout << "Switching to Green Light after 3 seconds of Yellow Light." << '\n';
+        statemachine->transition_to(&GreenLight::instance);
+        statemachine->resume_pending();
+    }
+
+    void YellowLight::next(TrafficLight *statemachine) const {
+        statemachine->suspended = true;
+        YellowLight_next_run(statemachine);
     }
     
 
-    void YellowLight::switchMode() {
-        if (true) {
-            statemachine->isNightMode = true;
-            std::cout << "Switching to night mode." << std::endl;
-            statemachine->transition_to(new NightMode);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void YellowLight::switchMode(TrafficLight *statemachine) const {
+        statemachine->isNightMode = true;
+        std::cout << "Switching to night mode." << '\n';
+        statemachine->transition_to(&NightMode::instance);
     }
     
     // NightMode
+    const NightMode NightMode::instance;
 
-    void NightMode::next() {
-        if (true) {
-            statemachine->timeElapsedInSec = 0;
-            statemachine->isNightMode = false;
-            std::cout << "Exiting night mode. Switching to Red Light." << std::endl;
-            statemachine->transition_to(new RedLight);
-        } else {
-            std::cout << "Transition not allowed." << std::endl;
-        }
+    void NightMode::next(TrafficLight *statemachine) const {
+        statemachine->timeElapsedInSec = 0;
+        statemachine->isNightMode = false;
+        std::cout << "Exiting night mode. Switching to Red Light." << '\n';
+        statemachine->transition_to(&RedLight::instance);
     }
     
 
 typedef void (TrafficLight::*Event)();
 
-int main() {
-    TrafficLight *statemachine = new TrafficLight(new RedLight);
-
-    static std::map<std::string, Event> event_by_name;
-    event_by_name["next"] = &TrafficLight::next;
-    event_by_name["switchMode"] = &TrafficLight::switchMode;
-    for (std::string input; std::getline(std::cin, input);) {
-        std::map<std::string, Event>::const_iterator event_by_name_it = event_by_name.find(input);
-        if (event_by_name_it == event_by_name.end()) {
-            std::cout << "There is no event <" << input << "> in the TrafficLight statemachine." << std::endl;
-            continue;
-        }
-        Event event_invoker = event_by_name_it->second;
-        (statemachine->*event_invoker)();
+constexpr std::uint32_t event_hash(std::uint32_t seed, std::string_view name) {
+    std::uint32_t hash = 0x811c9dc5u ^ seed;
+    for (unsigned char c : name) {
+        hash = (hash ^ c) * 0x01000193u;
+    }
+    hash = (hash ^ (hash >> 16)) * 0x85ebca6bu;
+    hash = (hash ^ (hash >> 13)) * 0xc2b2ae35u;
+    return hash ^ (hash >> 16);
+}
+
+constexpr std::size_t event_slot_count = 2;
+constexpr std::int32_t event_displacements[event_slot_count] = { 0, 3 };
+constexpr std::string_view event_slot_names[event_slot_count] = { "next", "switchMode" };
+constexpr Event event_slot_values[event_slot_count] = { &TrafficLight::next, &TrafficLight::switchMode };
+
+// Minimal perfect hash over the event names; unknown names are rejected by the final compare.
+inline int find_event_slot(std::string_view name) {
+    const std::int32_t displacement = event_displacements[event_hash(0, name) % event_slot_count];
+    const std::size_t slot = displacement < 0
+        ? static_cast<std::size_t>(-displacement - 1)
+        : event_hash(static_cast<std::uint32_t>(displacement), name) % event_slot_count;
+    return event_slot_names[slot] == name ? static_cast<int>(slot) : -1;
+}
+
+constexpr std::uint64_t event_stream_fingerprint = 0xddb817bce70f827aull;
+constexpr Event event_ids[2] = { &TrafficLight::next, &TrafficLight::switchMode };
+
+int main(int argc, char **argv) {
+    std::ios::sync_with_stdio(false);
+    TrafficLight *statemachine = new TrafficLight(&RedLight::instance);
+
+    statemachine_input::before_stdin_read = statemachine_timer::run_timers_until_input;
+    const statemachine_input::input_arguments arguments = statemachine_input::parse_arguments(argc, argv);
+    int status = 0;
+    if (arguments.binary) {
+        status = statemachine_input::read_event_stream(arguments.path, event_stream_fingerprint, 2, [statemachine](std::size_t id, std::uint64_t) { statemachine->post(event_ids[id]); });
+    } else {
+        status = statemachine_input::read_events(arguments.path, [statemachine](std::string_view input) {
+            const int slot = find_event_slot(input);
+            if (slot < 0) {
+                SM_TRACE("There is no event <" << input << "> in the TrafficLight statemachine.");
+                return;
+            }
+            statemachine->post(event_slot_values[slot]);
+        });
     }
+    statemachine_timer::scheduler::instance().run_until_idle();
 
     delete statemachine;
-    return 0;
+    return status;
 }
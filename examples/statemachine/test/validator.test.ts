@@ -139,4 +139,35 @@ describe('Statemachine Validator Tests', () => {
         const model = await parse(input, { validation: true });
         expect(model.diagnostics).toHaveLength(1);  // Expecting validation errors for undefined attribute
     });
+
+    test('Unreachable states and transitions that can never fire are warned about', async () => {
+        const input = `
+        statemachine DeadCode
+        events
+            start stop fault
+        attributes
+            level: int = 1
+        initialState Idle
+        state Idle
+            start => Running with{
+                level = 2
+            };
+            fault when level > 5 => Broken;
+        end
+        state Running
+            stop => Idle;
+            stop => Broken;
+        end
+        state Broken
+            stop => Idle;
+        end
+        `;
+        const model = await parse(input, { validation: true });
+        expect(model.diagnostics?.map(diagnostic => diagnostic.message)).toEqual([
+            'This transition can never fire: its guard is false for every value the model assigns to the attributes.',
+            'This transition can never fire: an earlier transition for stop always does.',
+            'State Broken is unreachable from the initial state Idle.'
+        ]);
+        expect(model.diagnostics?.every(diagnostic => diagnostic.severity === 2)).toBe(true);
+    });
 });
\ No newline at end of file